@@ -14,7 +14,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <sys/time.h>
+#include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -23,40 +23,192 @@
 #include "libknot/errcode.h"
 #include "knot/common/evsched.h"
 
-/*! \brief Some implementations of timercmp >= are broken, this is for compat.*/
-static inline int timercmp_ge(struct timeval *a, struct timeval *b) {
-	return timercmp(a, b, >) || timercmp(a, b, ==);
+#define SLOTS0 (1 << EVSCHED_BITS0)
+#define SLOTS  (1 << EVSCHED_BITS)
+
+/*! \brief Level of events not present in the wheel (expired). */
+#define LEVEL_READY EVSCHED_LEVELS
+
+/*! \brief Wake up time if no event is scheduled. */
+#define WAKE_NEVER UINT64_MAX
+
+/*! \brief Ticks covered by one slot at the given level (bits). */
+static inline unsigned level_shift(unsigned level)
+{
+	return level == 0 ? 0 : EVSCHED_BITS0 + EVSCHED_BITS * (level - 1);
+}
+
+/*! \brief Get monotonic time in milliseconds. */
+static uint64_t monotonic_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*! \brief Get current wheel time. */
+static uint64_t wheel_now(evsched_t *sched)
+{
+	return monotonic_ms() - sched->base;
+}
+
+/*! \brief Insert event into the wheel. */
+static void wheel_insert(evsched_t *sched, event_t *ev)
+{
+	if (ev->expires < sched->cur) {
+		ev->expires = sched->cur;
+	}
+
+	uint64_t delta = ev->expires - sched->cur;
+	if (delta < SLOTS0) {
+		ev->level = 0;
+		add_tail(&sched->level0[ev->expires & (SLOTS0 - 1)], &ev->n);
+		sched->count[0] += 1;
+		return;
+	}
+
+	unsigned level = 1;
+	while (level < EVSCHED_LEVELS - 1 &&
+	       delta >= (1ULL << (level_shift(level) + EVSCHED_BITS))) {
+		level += 1;
+	}
+
+	/* Out of range, wait in the last slot. */
+	uint64_t expires = ev->expires;
+	uint64_t range = 1ULL << (level_shift(level) + EVSCHED_BITS);
+	if (delta >= range) {
+		expires = sched->cur + range - 1;
+	}
+
+	unsigned slot = (expires >> level_shift(level)) & (SLOTS - 1);
+	ev->level = level;
+	add_tail(&sched->levels[level - 1][slot], &ev->n);
+	sched->count[level] += 1;
 }
 
-static int compare_event_heap_nodes(event_t *e1, event_t *e2)
+/*! \brief Remove event from the wheel or the expired events. */
+static bool wheel_remove(evsched_t *sched, event_t *ev)
 {
-	if (timercmp(&e1->tv, &e2->tv, <)) return -1;
-	if (timercmp(&e1->tv, &e2->tv, >)) return 1;
+	if (ev->n.next == NULL) {
+		return false;
+	}
+
+	rem_node(&ev->n);
+	if (ev->level < EVSCHED_LEVELS) {
+		sched->count[ev->level] -= 1;
+	}
+
+	return true;
+}
+
+/*! \brief Redistribute events from higher levels at the given tick. */
+static void wheel_cascade(evsched_t *sched, uint64_t tick)
+{
+	for (unsigned level = 1; level < EVSCHED_LEVELS; level++) {
+		unsigned slot = (tick >> level_shift(level)) & (SLOTS - 1);
+		list_t *list = &sched->levels[level - 1][slot];
+
+		event_t *ev = NULL;
+		WALK_LIST_FIRST(ev, *list) {
+			wheel_remove(sched, ev);
+			wheel_insert(sched, ev);
+		}
+
+		/* Higher level moves only after this one wraps around. */
+		if (slot != 0) {
+			break;
+		}
+	}
+}
+
+/*! \brief Lowest non-empty level above the first one, 0 if none. */
+static unsigned wheel_lowest_level(evsched_t *sched)
+{
+	for (unsigned level = 1; level < EVSCHED_LEVELS; level++) {
+		if (sched->count[level] > 0) {
+			return level;
+		}
+	}
+
 	return 0;
 }
 
+/*! \brief First tick not below 'tick' where the level gets redistributed. */
+static uint64_t level_boundary(uint64_t tick, unsigned level)
+{
+	uint64_t mask = (1ULL << level_shift(level)) - 1;
+	return (tick + mask) & ~mask;
+}
+
 /*!
- * \brief Set event timer to T (now) + dt miliseconds.
+ * \brief Advance the wheel up to the given tick (inclusive).
+ *
+ * Expired events are moved to the list of ready events. Ranges of ticks
+ * without any events are skipped.
  */
-static void evsched_settimer(event_t *e, uint32_t dt)
+static void wheel_advance(evsched_t *sched, uint64_t to)
 {
-	if (!e) {
-		return;
+	while (sched->cur <= to) {
+		uint64_t tick = sched->cur;
+		if ((tick & (SLOTS0 - 1)) == 0) {
+			wheel_cascade(sched, tick);
+		}
+
+		list_t *list = &sched->level0[tick & (SLOTS0 - 1)];
+		event_t *ev = NULL;
+		WALK_LIST_FIRST(ev, *list) {
+			wheel_remove(sched, ev);
+			ev->level = LEVEL_READY;
+			add_tail(&sched->ready, &ev->n);
+		}
+
+		sched->cur = tick + 1;
+
+		/* Skip to the next redistribution if the first level is empty. */
+		if (sched->count[0] == 0) {
+			unsigned level = wheel_lowest_level(sched);
+			uint64_t next = to + 1;
+			if (level > 0) {
+				next = level_boundary(sched->cur, level);
+				if (next > to + 1) {
+					next = to + 1;
+				}
+			}
+			if (next > sched->cur) {
+				sched->cur = next;
+			}
+		}
 	}
+}
 
-	/* Get absolute time T. */
-	gettimeofday(&e->tv, 0);
+/*! \brief Find the tick of the next wheel processing, WAKE_NEVER if empty. */
+static uint64_t wheel_next(evsched_t *sched)
+{
+	uint64_t next = WAKE_NEVER;
 
-	/* Add number of seconds. */
-	e->tv.tv_sec += dt / 1000;
+	unsigned level = wheel_lowest_level(sched);
+	if (level > 0) {
+		next = level_boundary(sched->cur, level);
+	}
 
-	/* Add the number of microseconds. */
-	e->tv.tv_usec += (dt % 1000) * 1000;
+	if (sched->count[0] > 0) {
+		for (uint64_t tick = sched->cur; tick < next; tick++) {
+			if (!EMPTY_LIST(sched->level0[tick & (SLOTS0 - 1)])) {
+				return tick;
+			}
+		}
+	}
+
+	return next;
+}
 
-	/* Check for overflow. */
-	while (e->tv.tv_usec > 999999) {
-		e->tv.tv_sec += 1;
-		e->tv.tv_usec -= 1 * 1000 * 1000;
+/*! \brief Free events in the list. */
+static void free_events(list_t *list)
+{
+	event_t *ev = NULL;
+	WALK_LIST_FIRST(ev, *list) {
+		rem_node(&ev->n);
+		evsched_event_free(ev);
 	}
 }
 
@@ -67,9 +219,26 @@ int evsched_init(evsched_t *sched, void *ctx)
 
 	/* Initialize event calendar. */
 	pthread_mutex_init(&sched->run_lock, 0);
-	pthread_mutex_init(&sched->heap_lock, 0);
-	pthread_cond_init(&sched->notify, 0);
-	heap_init(&sched->heap, compare_event_heap_nodes, 0);
+	pthread_mutex_init(&sched->wheel_lock, 0);
+
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&sched->notify, &attr);
+	pthread_condattr_destroy(&attr);
+
+	for (unsigned i = 0; i < SLOTS0; i++) {
+		init_list(&sched->level0[i]);
+	}
+	for (unsigned level = 1; level < EVSCHED_LEVELS; level++) {
+		for (unsigned i = 0; i < SLOTS; i++) {
+			init_list(&sched->levels[level - 1][i]);
+		}
+	}
+	init_list(&sched->ready);
+
+	sched->base = monotonic_ms();
+	sched->wake_at = WAKE_NEVER;
 
 	return KNOT_EOK;
 }
@@ -82,17 +251,18 @@ void evsched_deinit(evsched_t *sched)
 
 	/* Deinitialize event calendar. */
 	pthread_mutex_destroy(&sched->run_lock);
-	pthread_mutex_destroy(&sched->heap_lock);
+	pthread_mutex_destroy(&sched->wheel_lock);
 	pthread_cond_destroy(&sched->notify);
 
-	while (! EMPTY_HEAP(&sched->heap))
-	{
-		event_t *e = *HHEAD(&sched->heap);
-		heap_delmin(&sched->heap);
-		evsched_event_free(e);
+	for (unsigned i = 0; i < SLOTS0; i++) {
+		free_events(&sched->level0[i]);
 	}
-
-	free(sched->heap.data);
+	for (unsigned level = 1; level < EVSCHED_LEVELS; level++) {
+		for (unsigned i = 0; i < SLOTS; i++) {
+			free_events(&sched->levels[level - 1][i]);
+		}
+	}
+	free_events(&sched->ready);
 
 	/* Clear the structure. */
 	memset(sched, 0, sizeof(evsched_t));
@@ -135,24 +305,24 @@ int evsched_schedule(event_t *ev, uint32_t dt)
 		return KNOT_EINVAL;
 	}
 
-	/* Update event timer. */
-	evsched_settimer(ev, dt);
-
 	/* Lock calendar. */
 	evsched_t *sched = ev->sched;
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->wheel_lock);
 
 	/* Make sure it's not already enqueued. */
-	int found = 0;
-	if ((found = heap_find(&sched->heap, ev))) {
-		heap_delete(&sched->heap, found);
-	}
+	wheel_remove(sched, ev);
+
+	/* Update event timer. */
+	ev->expires = wheel_now(sched) + dt;
+	wheel_insert(sched, ev);
 
-	heap_insert(&sched->heap, ev);
+	/* Wake up the scheduler only if the event is due earlier. */
+	if (ev->expires < sched->wake_at) {
+		pthread_cond_signal(&sched->notify);
+	}
 
 	/* Unlock calendar. */
-	pthread_cond_broadcast(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->wheel_lock);
 
 	return KNOT_EOK;
 }
@@ -164,17 +334,17 @@ static int evsched_try_cancel(evsched_t *sched, event_t *ev)
 	if (sched == NULL || ev == NULL) {
 		return KNOT_EINVAL;
 	}
-	
+
 	/* Make sure not running. If an event is starting, we race for this lock
-	 * and either win or lose. If we lose, we may find it in heap because
+	 * and either win or lose. If we lose, we may find it in wheel because
 	 * it rescheduled itself. Either way, it will be marked as last running. */
 	pthread_mutex_lock(&sched->run_lock);
-	
+
 	/* Lock calendar. */
-	pthread_mutex_lock(&sched->heap_lock);
-	
-	if ((found = heap_find(&sched->heap, ev))) {
-		heap_delete(&sched->heap, found);
+	pthread_mutex_lock(&sched->wheel_lock);
+
+	if (wheel_remove(sched, ev)) {
+		found = 1;
 	}
 
 	/* Last running event was (probably) the one we're trying to cancel. */
@@ -184,9 +354,8 @@ static int evsched_try_cancel(evsched_t *sched, event_t *ev)
 	}
 
 	/* Unlock calendar. */
-	pthread_cond_broadcast(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
-	
+	pthread_mutex_unlock(&sched->wheel_lock);
+
 	/* Enable running events. */
 	pthread_mutex_unlock(&sched->run_lock);
 
@@ -212,7 +381,7 @@ int evsched_cancel(event_t *ev)
 	}
 
 	/* Reset event timer. */
-	memset(&ev->tv, 0, sizeof(struct timeval));
+	ev->expires = 0;
 	/* Now we're sure event is canceled or finished. */
 	return KNOT_EOK;
 }
@@ -225,45 +394,43 @@ event_t* evsched_begin_process(evsched_t *sched)
 	}
 
 	/* Lock calendar. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->wheel_lock);
 
 	while(1) {
 
-		/* Check event heap. */
-		if (!EMPTY_HEAP(&sched->heap)) {
-
-			/* Get current time. */
-			struct timeval dt;
-			gettimeofday(&dt, 0);
-
-			/* Get next event. */
-			event_t *next_ev = *((event_t**)HHEAD(&sched->heap));
-			assert(next_ev != NULL);
-
-			/* Immediately return. */
-			if (timercmp_ge(&dt, &next_ev->tv)) {
-				sched->last_ev = next_ev;
-				sched->running = true;
-				heap_delmin(&sched->heap);
-				pthread_mutex_unlock(&sched->heap_lock);
-				pthread_mutex_lock(&sched->run_lock);
-				return next_ev;
-			}
+		/* Collect expired events. */
+		if (EMPTY_LIST(sched->ready)) {
+			wheel_advance(sched, wheel_now(sched));
+		}
+
+		/* Immediately return. */
+		if (!EMPTY_LIST(sched->ready)) {
+			event_t *next_ev = HEAD(sched->ready);
+			rem_node(&next_ev->n);
+			sched->wake_at = WAKE_NEVER;
+			sched->last_ev = next_ev;
+			sched->running = true;
+			pthread_mutex_unlock(&sched->wheel_lock);
+			pthread_mutex_lock(&sched->run_lock);
+			return next_ev;
+		}
 
-			/* Wait for next event or interrupt. Unlock calendar. */
-			/* FIXME: Blocks this the possibility to add any event earlier? */
+		/* Wait for next event or interrupt. Unlock calendar. */
+		sched->wake_at = wheel_next(sched);
+		if (sched->wake_at != WAKE_NEVER) {
+			uint64_t abs_ms = sched->base + sched->wake_at;
 			struct timespec ts;
-			ts.tv_sec = next_ev->tv.tv_sec;
-			ts.tv_nsec = next_ev->tv.tv_usec * 1000L;
-			pthread_cond_timedwait(&sched->notify, &sched->heap_lock, &ts);
+			ts.tv_sec = abs_ms / 1000;
+			ts.tv_nsec = (abs_ms % 1000) * 1000000L;
+			pthread_cond_timedwait(&sched->notify, &sched->wheel_lock, &ts);
 		} else {
 			/* Block until an event is scheduled. Unlock calendar.*/
-			pthread_cond_wait(&sched->notify, &sched->heap_lock);
+			pthread_cond_wait(&sched->notify, &sched->wheel_lock);
 		}
 	}
 
-	/* Unlock heap, this shouldn't happen. */
-	pthread_mutex_unlock(&sched->heap_lock);
+	/* Unlock wheel, this shouldn't happen. */
+	pthread_mutex_unlock(&sched->wheel_lock);
 	return NULL;
 }
 
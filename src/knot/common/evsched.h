@@ -20,6 +20,13 @@
  *
  * \brief Event scheduler.
  *
+ * Events are kept in a hierarchical timing wheel with millisecond ticks.
+ * The first level has a slot for each tick, each of the higher levels covers
+ * the range of the previous level in a single slot. Events from a slot of
+ * a higher level are redistributed into the lower levels when the wheel
+ * time reaches the slot. Scheduling and cancellation are O(1), all events
+ * expiring in one tick are collected at once.
+ *
  * \addtogroup common_lib
  * @{
  */
@@ -29,8 +36,14 @@
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
-#include <sys/time.h>
-#include "libknot/internal/heap.h"
+#include "libknot/internal/lists.h"
+
+/*! \brief Number of timing wheel levels. */
+#define EVSCHED_LEVELS 5
+/*! \brief Number of slots at the first level (bits). */
+#define EVSCHED_BITS0 8
+/*! \brief Number of slots at the higher levels (bits). */
+#define EVSCHED_BITS 6
 
 /* Forward decls. */
 struct evsched;
@@ -55,7 +68,9 @@ typedef int (*event_cb_t)(struct event *);
  * \brief Event structure.
  */
 typedef struct event {
-	struct timeval tv; /*!< Event scheduled time. */
+	node_t n;          /*!< Node in the wheel slot. */
+	uint64_t expires;  /*!< Event scheduled time (wheel tick). */
+	unsigned level;    /*!< Wheel level of the event. */
 	void *data;        /*!< Usable data ptr. */
 	event_cb_t cb;     /*!< Event callback. */
 	struct evsched *sched; /*!< Scheduler for this event. */
@@ -70,9 +85,15 @@ typedef struct evsched {
 	volatile bool running;     /*!< True if running. */
 	volatile event_t *last_ev; /*!< Last (or current) running event. */
 	pthread_mutex_t run_lock;  /*!< Event running lock. */
-	pthread_mutex_t heap_lock; /*!< Event heap locking. */
-	pthread_cond_t notify;     /*!< Event heap notification. */
-	struct heap heap;          /*!< Event heap. */
+	pthread_mutex_t wheel_lock; /*!< Event wheel locking. */
+	pthread_cond_t notify;     /*!< Event wheel notification. */
+	uint64_t base;             /*!< Wheel time origin (monotonic ms). */
+	uint64_t cur;              /*!< Next tick to be processed. */
+	uint64_t wake_at;          /*!< Tick the scheduler sleeps until. */
+	unsigned count[EVSCHED_LEVELS]; /*!< Number of events at each level. */
+	list_t level0[1 << EVSCHED_BITS0]; /*!< First level slots. */
+	list_t levels[EVSCHED_LEVELS - 1][1 << EVSCHED_BITS]; /*!< Higher levels. */
+	list_t ready;              /*!< Expired events. */
 	void *ctx;                 /*!< Scheduler context. */
 } evsched_t;
 
@@ -14,6 +14,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
@@ -39,6 +40,20 @@
 
 #define LOG_NULL_ZONE_STRING "?"
 
+/* Number of records in a per-thread ring (power of two). */
+#define LOG_RING_SIZE 128
+
+/* Writer thread sleep interval when there are no records, doubled while
+ * idle up to the maximum (ms). */
+#define LOG_WRITER_IDLE 10
+#define LOG_WRITER_IDLE_MAX 1000
+
+/* Size of a write batch for one log stream. */
+#define LOG_BATCH_SIZE (16 * 1024)
+
+/* Length of the formatted timestamp. */
+#define LOG_TIME_BUFLEN 64
+
 /*! Log source table. */
 struct log_sink
 {
@@ -55,6 +70,8 @@ struct log_sink *s_log = NULL;
 #define facility_next(f) (f) += (1 << LOG_SRC_BITS)
 #define facility_levels(f, i) *((f) + (i))
 
+static const char *level_prefix(int level);
+
 /*! \brief Close open files and free given sink. */
 static void sink_free(struct log_sink *log)
 {
@@ -189,6 +206,8 @@ int log_init()
 
 void log_close()
 {
+	log_async_stop();
+
 	sink_publish(NULL);
 
 	fflush(stdout);
@@ -238,6 +257,423 @@ int log_levels_add(int facility, logsrc_t src, uint8_t levels)
 	return sink_levels_add(s_log, facility, src, levels);
 }
 
+/*! \brief Get log stream of the facility. */
+static FILE *sink_stream(struct log_sink *log, int facility)
+{
+	switch(facility) {
+	case LOGT_STDERR: return stderr;
+	case LOGT_STDOUT: return stdout;
+	default:          return log->file[facility - LOGT_FILE];
+	}
+}
+
+/*! \brief Check if any facility accepts the message. */
+static bool sink_accepts(struct log_sink *log, int level, logsrc_t src)
+{
+	for (int i = LOGT_SYSLOG; i < LOGT_FILE + log->file_count; ++i) {
+		if (facility_levels(facility_at(log, i), src) & LOG_MASK(level)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*! \brief Send message to syslog if enabled. */
+static bool emit_syslog(struct log_sink *log, int level, logsrc_t src,
+                        const char *zone, size_t zone_len, const char *msg)
+{
+	uint8_t *f = facility_at(log, LOGT_SYSLOG);
+	if (!(facility_levels(f, src) & LOG_MASK(level))) {
+		return false;
+	}
+
+#ifdef ENABLE_SYSTEMD
+	char *zone_fmt = zone ? "ZONE=%.*s" : NULL;
+	sd_journal_send("PRIORITY=%d", level,
+	                "MESSAGE=%s", msg,
+	                zone_fmt, zone_len, zone,
+	                NULL);
+#else
+	syslog(level, "%s", msg);
+#endif
+	return true;
+}
+
+/*! \brief Format log timestamp. */
+static void format_time(time_t sec, char *tstr, size_t len)
+{
+	struct tm lt;
+	tstr[0] = '\0';
+	if (localtime_r(&sec, &lt) != NULL) {
+		strftime(tstr, len, KNOT_LOG_TIME_FORMAT " ", &lt);
+	}
+}
+
+/* -- asynchronous logging -------------------------------------------------- */
+
+/*! \brief Preformatted log record. */
+struct log_record {
+	time_t time;
+	int level;
+	uint16_t zone_off;         /* Zone name offset in the message. */
+	uint16_t zone_len;         /* Zone name length, 0 if not a zone message. */
+	char msg[LOG_BUFLEN];
+};
+
+/*! \brief Ring of log records written by one thread, read by the writer. */
+struct log_ring {
+	struct log_ring *next;
+	volatile unsigned head;    /* Next record to write (owner thread). */
+	volatile unsigned tail;    /* Next record to read (writer thread). */
+	volatile unsigned dropped; /* Records dropped on full ring. */
+	unsigned reported;         /* Drops already reported (writer thread). */
+	volatile bool orphan;      /* Owner thread terminated. */
+	struct log_record records[LOG_RING_SIZE];
+};
+
+/*! \brief Pending output of one log stream. */
+struct log_batch {
+	size_t len;
+	char buf[LOG_BATCH_SIZE];
+};
+
+/*! \brief Asynchronous logging state. */
+static struct {
+	pthread_once_t once;
+	pthread_key_t key;         /* Ring of the calling thread. */
+	pthread_mutex_t lock;      /* Protects list of rings. */
+	struct log_ring *rings;
+	pthread_t writer;
+	pthread_mutex_t wake_lock;
+	pthread_cond_t wake;       /* Writer wake up on stop. */
+	volatile bool running;
+	volatile uint64_t dropped; /* Total number of dropped records. */
+	struct log_batch *batch;   /* Writer stream batches. */
+	size_t batch_count;
+	time_t time_sec;           /* Writer cached timestamp. */
+	char time_str[LOG_TIME_BUFLEN];
+} s_async = {
+	.once = PTHREAD_ONCE_INIT,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake_lock = PTHREAD_MUTEX_INITIALIZER,
+	.time_sec = -1
+};
+
+/*! \brief Remove ring from the list. Call with the lock held. */
+static void ring_unlink(struct log_ring *ring)
+{
+	struct log_ring **it = &s_async.rings;
+	while (*it != ring) {
+		it = &(*it)->next;
+	}
+	*it = ring->next;
+	free(ring);
+}
+
+/*! \brief Ring release on thread termination. */
+static void ring_release(void *data)
+{
+	struct log_ring *ring = data;
+
+	pthread_mutex_lock(&s_async.lock);
+	if (s_async.running) {
+		ring->orphan = true; /* Released by the writer when drained. */
+	} else {
+		ring_unlink(ring);
+	}
+	pthread_mutex_unlock(&s_async.lock);
+}
+
+static void async_init(void)
+{
+	pthread_key_create(&s_async.key, ring_release);
+
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&s_async.wake, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+/*! \brief Get ring of the calling thread, create if doesn't exist. */
+static struct log_ring *ring_get(void)
+{
+	struct log_ring *ring = pthread_getspecific(s_async.key);
+	if (ring != NULL) {
+		return ring;
+	}
+
+	ring = calloc(1, sizeof(*ring));
+	if (ring == NULL) {
+		return NULL;
+	}
+
+	pthread_setspecific(s_async.key, ring);
+
+	pthread_mutex_lock(&s_async.lock);
+	ring->next = s_async.rings;
+	s_async.rings = ring;
+	pthread_mutex_unlock(&s_async.lock);
+
+	return ring;
+}
+
+/*! \brief Store message into the ring of the calling thread. */
+static bool ring_push(int level, const char *zone, size_t zone_len, const char *msg)
+{
+	struct log_ring *ring = ring_get();
+	if (ring == NULL) {
+		return false;
+	}
+
+	unsigned head = ring->head;
+	if (head - ring->tail >= LOG_RING_SIZE) {
+		ring->dropped += 1;
+		return true;
+	}
+
+	struct log_record *rec = &ring->records[head & (LOG_RING_SIZE - 1)];
+	rec->time = time(NULL);
+	rec->level = level;
+	rec->zone_off = zone ? zone - msg : 0;
+	rec->zone_len = zone ? zone_len : 0;
+	strlcpy(rec->msg, msg, sizeof(rec->msg));
+
+	/* Publish the record. */
+	__sync_synchronize();
+	ring->head = head + 1;
+
+	return true;
+}
+
+/*! \brief Write pending output of the stream. */
+static void batch_flush(FILE *stream, struct log_batch *batch)
+{
+	if (batch->len > 0) {
+		fwrite(batch->buf, 1, batch->len, stream);
+		batch->len = 0;
+	}
+}
+
+/*! \brief Make room for the batches of all streams of the sink. */
+static bool batch_reserve(struct log_sink *log)
+{
+	size_t count = LOGT_FILE + log->file_count;
+	if (count <= s_async.batch_count) {
+		return true;
+	}
+
+	struct log_batch *batch = realloc(s_async.batch, count * sizeof(*batch));
+	if (batch == NULL) {
+		return false;
+	}
+
+	for (size_t i = s_async.batch_count; i < count; i++) {
+		batch[i].len = 0;
+	}
+	s_async.batch = batch;
+	s_async.batch_count = count;
+
+	return true;
+}
+
+/*! \brief Write record to syslog or append it to stream batches. */
+static void writer_emit(struct log_sink *log, const struct log_record *rec)
+{
+	const char *zone = rec->zone_len > 0 ? rec->msg + rec->zone_off : NULL;
+	logsrc_t src = zone ? LOG_ZONE : LOG_SERVER;
+
+	emit_syslog(log, rec->level, src, zone, rec->zone_len, rec->msg);
+
+	/* Timestamp is formatted once per second. */
+	if (rec->time != s_async.time_sec) {
+		format_time(rec->time, s_async.time_str, sizeof(s_async.time_str));
+		s_async.time_sec = rec->time;
+	}
+
+	for (int i = LOGT_STDERR; i < LOGT_FILE + log->file_count; ++i) {
+		if (!(facility_levels(facility_at(log, i), src) & LOG_MASK(rec->level))) {
+			continue;
+		}
+
+		struct log_batch *batch = &s_async.batch[i];
+		size_t avail = sizeof(batch->buf) - batch->len;
+		int len = snprintf(batch->buf + batch->len, avail, "%s%s\n",
+		                   s_async.time_str, rec->msg);
+		if (len < 0) {
+			continue;
+		}
+		if (len >= avail) {
+			batch_flush(sink_stream(log, i), batch);
+			avail = sizeof(batch->buf);
+			len = snprintf(batch->buf, avail, "%s%s\n",
+			               s_async.time_str, rec->msg);
+			if (len < 0 || len >= avail) {
+				continue;
+			}
+		}
+		batch->len += len;
+	}
+}
+
+/*! \brief Report records dropped since the last report. */
+static void writer_report_drops(struct log_sink *log, unsigned drops)
+{
+	struct log_record rec = {
+		.time = time(NULL),
+		.level = LOG_WARNING
+	};
+	snprintf(rec.msg, sizeof(rec.msg), "%s: logging, %u messages dropped",
+	         level_prefix(LOG_WARNING), drops);
+	writer_emit(log, &rec);
+}
+
+/*! \brief Drain all rings, return number of written records. */
+static unsigned writer_drain(void)
+{
+	unsigned written = 0;
+	unsigned drops = 0;
+
+	rcu_read_lock();
+	struct log_sink *log = s_log;
+	bool ok = (log != NULL && batch_reserve(log));
+
+	pthread_mutex_lock(&s_async.lock);
+	struct log_ring *ring = s_async.rings;
+	while (ring != NULL) {
+		unsigned head = ring->head;
+		__sync_synchronize();
+		for (unsigned i = ring->tail; i != head; i++) {
+			if (ok) {
+				writer_emit(log, &ring->records[i & (LOG_RING_SIZE - 1)]);
+			}
+			written += 1;
+		}
+		__sync_synchronize();
+		ring->tail = head;
+
+		unsigned dropped = ring->dropped;
+		drops += dropped - ring->reported;
+		ring->reported = dropped;
+
+		struct log_ring *next = ring->next;
+		if (ring->orphan && ring->tail == ring->head) {
+			ring_unlink(ring);
+		}
+		ring = next;
+	}
+	pthread_mutex_unlock(&s_async.lock);
+
+	if (drops > 0) {
+		__sync_add_and_fetch(&s_async.dropped, drops);
+		if (ok) {
+			writer_report_drops(log, drops);
+		}
+	}
+
+	/* Write out batches before the sink can be replaced. */
+	if (ok) {
+		for (int i = LOGT_STDERR; i < LOGT_FILE + log->file_count; ++i) {
+			batch_flush(sink_stream(log, i), &s_async.batch[i]);
+		}
+		fflush(stdout);
+	}
+	rcu_read_unlock();
+
+	return written;
+}
+
+/*! \brief Sleep for the given time or until the writer is stopped. */
+static void writer_sleep(unsigned ms)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += ms / 1000;
+	ts.tv_nsec += (ms % 1000) * 1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec += 1;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&s_async.wake_lock);
+	if (s_async.running) {
+		pthread_cond_timedwait(&s_async.wake, &s_async.wake_lock, &ts);
+	}
+	pthread_mutex_unlock(&s_async.wake_lock);
+}
+
+/*!
+ * \brief Log writer thread.
+ *
+ * Producers never signal the writer, it polls the rings instead. The poll
+ * interval grows while there is nothing to write and drops back to the
+ * minimum once records appear.
+ */
+static void *writer_main(void *data)
+{
+	rcu_register_thread();
+
+	unsigned idle = LOG_WRITER_IDLE;
+	while (s_async.running) {
+		if (writer_drain() > 0) {
+			idle = LOG_WRITER_IDLE;
+			continue;
+		}
+
+		writer_sleep(idle);
+		idle = MIN(2 * idle, LOG_WRITER_IDLE_MAX);
+	}
+
+	/* Write remaining records. */
+	writer_drain();
+
+	rcu_unregister_thread();
+
+	return NULL;
+}
+
+int log_async_start(void)
+{
+	if (s_async.running) {
+		return KNOT_EOK;
+	}
+
+	pthread_once(&s_async.once, async_init);
+
+	s_async.running = true;
+	if (pthread_create(&s_async.writer, NULL, writer_main, NULL) != 0) {
+		s_async.running = false;
+		return KNOT_ERROR;
+	}
+
+	return KNOT_EOK;
+}
+
+void log_async_stop(void)
+{
+	if (!s_async.running) {
+		return;
+	}
+
+	pthread_mutex_lock(&s_async.wake_lock);
+	s_async.running = false;
+	pthread_cond_signal(&s_async.wake);
+	pthread_mutex_unlock(&s_async.wake_lock);
+	pthread_join(s_async.writer, NULL);
+
+	free(s_async.batch);
+	s_async.batch = NULL;
+	s_async.batch_count = 0;
+}
+
+uint64_t log_async_dropped(void)
+{
+	return s_async.dropped;
+}
+
+/* -- message output -------------------------------------------------------- */
+
 static int emit_log_msg(int level, const char *zone, size_t zone_len, const char *msg)
 {
 	rcu_read_lock();
@@ -247,21 +683,24 @@ static int emit_log_msg(int level, const char *zone, size_t zone_len, const char
 		return KNOT_ERROR;
 	}
 
-	int ret = 0;
-	uint8_t *f = facility_at(log, LOGT_SYSLOG);
 	logsrc_t src = zone ? LOG_ZONE : LOG_SERVER;
 
+	// Hand over to the writer thread
+	if (s_async.running) {
+		if (!sink_accepts(log, level, src)) {
+			rcu_read_unlock();
+			return 0;
+		}
+		if (ring_push(level, zone, zone_len, msg)) {
+			rcu_read_unlock();
+			return 1;
+		}
+	}
+
+	int ret = 0;
+
 	// Syslog
-	if (facility_levels(f, src) & LOG_MASK(level)) {
-#ifdef ENABLE_SYSTEMD
-		char *zone_fmt = zone ? "ZONE=%.*s" : NULL;
-		sd_journal_send("PRIORITY=%d", level,
-		                "MESSAGE=%s", msg,
-		                zone_fmt, zone_len, zone,
-		                NULL);
-#else
-		syslog(level, "%s", msg);
-#endif
+	if (emit_syslog(log, level, src, zone, zone_len, msg)) {
 		ret = 1; // To prevent considering the message as ignored.
 	}
 
@@ -269,29 +708,18 @@ static int emit_log_msg(int level, const char *zone, size_t zone_len, const char
 	level = LOG_MASK(level);
 
 	/* Prefix date and time. */
-	char tstr[LOG_BUFLEN] = {0};
-	struct tm lt;
-	struct timeval tv;
-	gettimeofday(&tv, NULL);
-	time_t sec = tv.tv_sec;
-	if (localtime_r(&sec, &lt) != NULL) {
-		strftime(tstr, sizeof(tstr), KNOT_LOG_TIME_FORMAT " ", &lt);
-	}
+	char tstr[LOG_TIME_BUFLEN];
+	format_time(time(NULL), tstr, sizeof(tstr));
 
 	// Log streams
 	for (int i = LOGT_STDERR; i < LOGT_FILE + log->file_count; ++i) {
 
 		// Check facility levels mask
-		f = facility_at(log, i);
+		uint8_t *f = facility_at(log, i);
 		if (facility_levels(f, src) & level) {
 
 			// Select stream
-			FILE *stream;
-			switch(i) {
-			case LOGT_STDERR: stream = stderr; break;
-			case LOGT_STDOUT: stream = stdout; break;
-			default: stream = log->file[i - LOGT_FILE]; break;
-			}
+			FILE *stream = sink_stream(log, i);
 
 			// Print
 			ret = fprintf(stream, "%s%s\n", tstr, msg);
@@ -370,10 +798,13 @@ static int log_msg_text(int level, const char *zone, const char *fmt, va_list ar
 			zone_len -= 1;
 		}
 
+		/* Refer to the zone name inside the message. */
+		const char *zone_msg = write + 1;
 		ret = log_msg_add(&write, &capacity, "[%.*s] ", zone_len, zone);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
+		zone = zone_msg;
 	}
 
 	/* Compile log message. */
@@ -100,6 +100,28 @@ int log_init();
  */
 void log_close();
 
+/*!
+ * \brief Switch to asynchronous logging.
+ *
+ * Messages are formatted by the caller and stored into a ring buffer of
+ * the calling thread. A writer thread collects the messages and writes
+ * them in batches. Messages are dropped if the ring of a thread is full.
+ *
+ * \retval KNOT_EOK on success.
+ * \retval KNOT_ERROR if the writer thread can't be started.
+ */
+int log_async_start(void);
+
+/*!
+ * \brief Write pending messages, stop the writer thread.
+ */
+void log_async_stop(void);
+
+/*!
+ * \brief Return number of messages dropped in asynchronous mode.
+ */
+uint64_t log_async_dropped(void);
+
 /*!
  * \brief Return true if log is open.
  */
@@ -36,6 +36,7 @@
 #include "libknot/dname.h"
 #include "libknot/binary.h"
 #include "libknot/rrtype/opt.h"
+#include "libknot/tsig-op.h"
 #include "knot/server/rrl.h"
 #include "knot/nameserver/query_module.h"
 #include "knot/conf/conf.h"
@@ -505,13 +506,18 @@ static void ident_auto(void *scanner, int tok, conf_t *conf, bool val)
 %token <tok> ZONES FILENAME
 %token <tok> DISABLE_ANY
 %token <tok> SEMANTIC_CHECKS
+%token <tok> SEMANTIC_CHECKS_SAMPLE
+%token <tok> CHECKS_FAST
 %token <tok> NOTIFY_RETRIES
 %token <tok> NOTIFY_TIMEOUT
 %token <tok> DBSYNC_TIMEOUT
+%token <tok> ZONEFILE_BINARY
 %token <tok> IXFR_FSLIMIT
 %token <tok> XFR_IN
 %token <tok> XFR_OUT
 %token <tok> UPDATE_IN
+%token <tok> DDNS_WINDOW
+%token <tok> DDNS_BATCH
 %token <tok> NOTIFY_IN
 %token <tok> NOTIFY_OUT
 %token <tok> BUILD_DIFFS
@@ -525,6 +531,7 @@ static void ident_auto(void *scanner, int tok, conf_t *conf, bool val)
 %token <TOK> STORAGE
 %token <tok> DNSSEC_ENABLE
 %token <tok> DNSSEC_KEYDIR
+%token <tok> DNSSEC_ONLINE
 %token <tok> SIGNATURE_LIFETIME
 %token <tok> SERIAL_POLICY
 %token <tok> SERIAL_POLICY_VAL
@@ -541,6 +548,7 @@ static void ident_auto(void *scanner, int tok, conf_t *conf, bool val)
 %token <tok> LOG_DEST
 %token <tok> LOG_SRC
 %token <tok> LOG_LEVEL
+%token <tok> LOG_ASYNC
 
 %%
 
@@ -718,6 +726,7 @@ keys:
                  knot_dname_free(&dname, NULL);
                  free(k);
              } else {
+                 knot_tsig_key_hmac_init(&k->k);
                  add_tail(&new_config->keys, &k->n);
              }
          }
@@ -916,6 +925,10 @@ zone:
  | zone FILENAME TEXT ';' { this_zone->file = $3.t; }
  | zone BUILD_DIFFS BOOL ';' { this_zone->build_diffs = $3.i; }
  | zone SEMANTIC_CHECKS BOOL ';' { this_zone->enable_checks = $3.i; }
+ | zone SEMANTIC_CHECKS CHECKS_FAST ';' { this_zone->enable_checks = $3.i; }
+ | zone SEMANTIC_CHECKS_SAMPLE NUM ';' {
+	SET_NUM(this_zone->checks_sample, $3.i, 1, 100, "semantic-checks-sample");
+ }
  | zone STORAGE TEXT ';' { this_zone->storage = $3.t; }
  | zone DNSSEC_KEYDIR TEXT ';' { this_zone->dnssec_keydir = $3.t; }
  | zone DISABLE_ANY BOOL ';' { this_zone->disable_any = $3.i; }
@@ -925,6 +938,7 @@ zone:
  | zone DBSYNC_TIMEOUT INTERVAL ';' {
 	SET_INT(this_zone->dbsync_timeout, $3.i, "zonefile-sync");
  }
+ | zone ZONEFILE_BINARY BOOL ';' { this_zone->zonefile_binary = $3.i; }
  | zone IXFR_FSLIMIT SIZE ';' {
 	SET_SIZE(new_config->ixfr_fslimit, $3.l, "ixfr-fslimit");
  }
@@ -938,6 +952,7 @@ zone:
 	SET_NUM(this_zone->notify_timeout, $3.i, 1, INT_MAX, "notify-timeout");
    }
  | zone DNSSEC_ENABLE BOOL ';' { this_zone->dnssec_enable = $3.i; }
+ | zone DNSSEC_ONLINE BOOL ';' { this_zone->dnssec_online = $3.i; }
  | zone SIGNATURE_LIFETIME NUM ';' {
 	SET_NUM(this_zone->sig_lifetime, $3.i, 10800, INT_MAX, "signature-lifetime");
  }
@@ -947,6 +962,12 @@ zone:
  | zone SERIAL_POLICY SERIAL_POLICY_VAL ';' {
 	this_zone->serial_policy = $3.i;
  }
+ | zone DDNS_WINDOW NUM ';' {
+	SET_NUM(this_zone->ddns_window, $3.i, 0, INT_MAX, "update-commit-window");
+ }
+ | zone DDNS_BATCH NUM ';' {
+	SET_NUM(this_zone->ddns_batch, $3.i, 0, INT_MAX, "update-commit-size");
+ }
  | zone QUERY_MODULE '{' query_module_list '}'
  ;
 
@@ -963,6 +984,10 @@ zones:
  | zones DISABLE_ANY BOOL ';' { new_config->disable_any = $3.i; }
  | zones BUILD_DIFFS BOOL ';' { new_config->build_diffs = $3.i; }
  | zones SEMANTIC_CHECKS BOOL ';' { new_config->zone_checks = $3.i; }
+ | zones SEMANTIC_CHECKS CHECKS_FAST ';' { new_config->zone_checks = $3.i; }
+ | zones SEMANTIC_CHECKS_SAMPLE NUM ';' {
+	SET_NUM(new_config->checks_sample, $3.i, 1, 100, "semantic-checks-sample");
+ }
  | zones IXFR_FSLIMIT SIZE ';' {
 	SET_SIZE(new_config->ixfr_fslimit, $3.l, "ixfr-fslimit");
  }
@@ -981,8 +1006,10 @@ zones:
  | zones DBSYNC_TIMEOUT INTERVAL ';' {
 	SET_NUM(new_config->dbsync_timeout, $3.i, 0, INT_MAX, "zonefile-sync");
  }
+ | zones ZONEFILE_BINARY BOOL ';' { new_config->zonefile_binary = $3.i; }
  | zones STORAGE TEXT ';' { new_config->storage = $3.t; }
  | zones DNSSEC_ENABLE BOOL ';' { new_config->dnssec_enable = $3.i; }
+ | zones DNSSEC_ONLINE BOOL ';' { new_config->dnssec_online = $3.i; }
  | zones DNSSEC_KEYDIR TEXT ';' { new_config->dnssec_keydir = $3.t; }
  | zones SIGNATURE_LIFETIME NUM ';' {
 	SET_NUM(new_config->sig_lifetime, $3.i, 10800, INT_MAX, "signature-lifetime");
@@ -993,6 +1020,12 @@ zones:
  | zones SERIAL_POLICY SERIAL_POLICY_VAL ';' {
 	new_config->serial_policy = $3.i;
  }
+ | zones DDNS_WINDOW NUM ';' {
+	SET_NUM(new_config->ddns_window, $3.i, 0, INT_MAX, "update-commit-window");
+ }
+ | zones DDNS_BATCH NUM ';' {
+	SET_NUM(new_config->ddns_batch, $3.i, 0, INT_MAX, "update-commit-size");
+ }
  | zones QUERY_MODULE '{' query_genmodule_list '}'
  ;
 
@@ -1075,6 +1108,7 @@ log_end: {
 log_start:
  | log_start log_dest '{' log_src '}'
  | log_start log_file '{' log_src '}'
+ | log_start LOG_ASYNC BOOL ';' { new_config->log_async = $3.i; }
  ;
 
 log: LOG { } '{' log_start log_end
@@ -301,6 +301,11 @@ static int conf_process(conf_t *conf)
 			zone->dbsync_timeout = conf->dbsync_timeout;
 		}
 
+		// Default policy for zone file format
+		if (zone->zonefile_binary < 0) {
+			zone->zonefile_binary = conf->zonefile_binary;
+		}
+
 		// Default policy for ixfr-from-differences
 		if (zone->build_diffs < 0) {
 			zone->build_diffs = conf->build_diffs;
@@ -310,6 +315,9 @@ static int conf_process(conf_t *conf)
 		if (zone->enable_checks < 0) {
 			zone->enable_checks = conf->zone_checks;
 		}
+		if (zone->checks_sample < 0) {
+			zone->checks_sample = conf->checks_sample;
+		}
 
 		// Default policy for disabling ANY type queries for AA
 		if (zone->disable_any < 0) {
@@ -340,6 +348,16 @@ static int conf_process(conf_t *conf)
 			zone->serial_policy = conf->serial_policy;
 		}
 
+		// Default policy for DDNS commit window
+		if (zone->ddns_window < 0) {
+			zone->ddns_window = conf->ddns_window;
+		}
+
+		// Default policy for DDNS commit batch size
+		if (zone->ddns_batch < 0) {
+			zone->ddns_batch = conf->ddns_batch;
+		}
+
 		// Default zone file
 		if (zone->file == NULL) {
 			zone->file = strcdup(zone->name, "zone");
@@ -366,6 +384,13 @@ static int conf_process(conf_t *conf)
 
 		assert(zone->dnssec_enable == 0 || zone->dnssec_enable == 1);
 
+		// Online signing is a mode of automatic signing
+		if (!zone->dnssec_enable) {
+			zone->dnssec_online = 0;
+		} else if (zone->dnssec_online < 0) {
+			zone->dnssec_online = conf->dnssec_online;
+		}
+
 		// DNSSEC required settings
 		if (zone->dnssec_enable) {
 			// Enable zone diffs (silently)
@@ -580,12 +605,17 @@ conf_t *conf_new(char* path)
 
 	/* Defaults. */
 	c->zone_checks = 0;
+	c->checks_sample = CONFIG_CHECKS_SAMPLE;
 	c->notify_retries = CONFIG_NOTIFY_RETRIES;
 	c->notify_timeout = CONFIG_NOTIFY_TIMEOUT;
 	c->dbsync_timeout = CONFIG_DBSYNC_TIMEOUT;
+	c->zonefile_binary = 0;
+	c->log_async = 0;
 	c->max_udp_payload = KNOT_EDNS_MAX_UDP_PAYLOAD;
 	c->sig_lifetime = KNOT_DNSSEC_DEFAULT_LIFETIME;
 	c->serial_policy = CONFIG_SERIAL_DEFAULT;
+	c->ddns_window = CONFIG_DDNS_WINDOW;
+	c->ddns_batch = 0; /* Unlimited. */
 	c->uid = -1;
 	c->gid = -1;
 	c->xfers = -1;
@@ -594,6 +624,7 @@ conf_t *conf_new(char* path)
 
 	/* DNSSEC. */
 	c->dnssec_enable = 0;
+	c->dnssec_online = 0;
 
 	return c;
 }
@@ -694,6 +725,7 @@ void conf_truncate(conf_t *conf, int unload_hooks)
 	query_plan_free(conf->query_plan);
 
 	conf->dnssec_enable = -1;
+	conf->dnssec_online = -1;
 	if (conf->filename) {
 		free(conf->filename);
 		conf->filename = NULL;
@@ -911,13 +943,18 @@ void conf_init_zone(conf_zone_t *zone)
 
 	// Default policy applies.
 	zone->enable_checks = -1;
+	zone->checks_sample = -1;
 	zone->notify_timeout = -1;
 	zone->notify_retries = 0;
 	zone->dbsync_timeout = -1;
+	zone->zonefile_binary = -1;
 	zone->disable_any = -1;
 	zone->build_diffs = -1;
 	zone->sig_lifetime = -1;
 	zone->dnssec_enable = -1;
+	zone->dnssec_online = -1;
+	zone->ddns_window = -1;
+	zone->ddns_batch = -1;
 
 	// Initialize ACL lists.
 	init_list(&zone->acl.xfr_in);
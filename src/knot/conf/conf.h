@@ -57,6 +57,8 @@
 #define CONFIG_RRL_SIZE 393241 /*!< Htable default size. */
 #define CONFIG_XFERS 10
 #define CONFIG_SERIAL_DEFAULT CONF_SERIAL_INCREMENT /*!< Default serial policy: increment. */
+#define CONFIG_DDNS_WINDOW 0 /*!< [ms] Commit each DDNS queue drain immediately. */
+#define CONFIG_CHECKS_SAMPLE 10 /*!< [%] Nodes with RRSIGs checked by 'fast' checks. */
 
 /*!
  * \brief Configuration for the interface
@@ -119,15 +121,20 @@ typedef struct conf_zone {
 	char *dnssec_keydir;       /*!< Path to a DNSSEC key dir. */
 	char *ixfr_db;             /*!< Path to a IXFR database file. */
 	int dnssec_enable;         /*!< DNSSEC: Online signing enabled. */
+	int dnssec_online;         /*!< DNSSEC: Sign answers on demand. */
 	size_t ixfr_fslimit;       /*!< File size limit for IXFR journal. */
 	int sig_lifetime;          /*!< Validity period of DNSSEC signatures. */
 	int dbsync_timeout;        /*!< Interval between syncing to zonefile.*/
+	int zonefile_binary;       /*!< Sync zonefile as binary dump. */
 	int enable_checks;         /*!< Semantic checks for parser.*/
+	int checks_sample;         /*!< Share of nodes with checked RRSIGs (%). */
 	int disable_any;           /*!< Disable ANY type queries for AA.*/
 	int notify_retries;        /*!< NOTIFY query retries. */
 	int notify_timeout;        /*!< Timeout for NOTIFY response (s). */
 	int build_diffs;           /*!< Calculate differences from changes. */
 	int serial_policy;         /*!< Serial policy when updating zone. */
+	int ddns_window;           /*!< DDNS commit window (ms). */
+	int ddns_batch;            /*!< Max. DDNS requests in one commit. */
 	struct {
 		list_t xfr_in;     /*!< Remotes accepted for for xfr-in.*/
 		list_t xfr_out;    /*!< Remotes accepted for xfr-out.*/
@@ -148,6 +155,15 @@ typedef enum conf_serial_policy_t {
 	CONF_SERIAL_UNIXTIME	= 1 << 1
 } conf_serial_policy_t;
 
+/*!
+ * \brief Semantic checks options.
+ */
+typedef enum conf_checks_t {
+	CONF_CHECKS_OFF		= 0,
+	CONF_CHECKS_ON		= 1, /*!< All optional checks. */
+	CONF_CHECKS_FAST	= 2  /*!< RRSIGs checked only in a sample of nodes. */
+} conf_checks_t;
+
 /*!
  * \brief Configuration sections.
  */
@@ -210,6 +226,7 @@ typedef struct conf {
 	 * Log
 	 */
 	list_t logs;      /*!< List of logging facilites. */
+	int log_async;    /*!< Log through a writer thread. */
 
 	/*
 	 * Interfaces
@@ -236,17 +253,22 @@ typedef struct conf {
 	 */
 	hattrie_t *zones;    /*!< List of zones. */
 	int zone_checks;     /*!< Semantic checks for parser.*/
+	int checks_sample;   /*!< Share of nodes with checked RRSIGs (%). */
 	int disable_any;     /*!< Disable ANY type queries for AA.*/
 	int notify_retries;  /*!< NOTIFY query retries. */
 	int notify_timeout;  /*!< Timeout for NOTIFY response in seconds. */
 	int dbsync_timeout;  /*!< Default interval between syncing to zonefile.*/
+	int zonefile_binary; /*!< Sync zonefile as binary dump. */
 	size_t ixfr_fslimit; /*!< File size limit for IXFR journal. */
 	int build_diffs;     /*!< Calculate differences from changes. */
 	char *storage;       /*!< Storage dir. */
 	char *dnssec_keydir; /*!< DNSSEC: Path to key directory. */
 	int dnssec_enable;   /*!< DNSSEC: Online signing enabled. */
+	int dnssec_online;   /*!< DNSSEC: Sign answers on demand. */
 	int sig_lifetime;    /*!< DNSSEC: Signature lifetime. */
 	int serial_policy;   /*!< Serial policy when updating zone. */
+	int ddns_window;     /*!< DDNS commit window in milliseconds. */
+	int ddns_batch;      /*!< Max. DDNS requests committed together. */
 	struct query_plan *query_plan;
 	list_t query_modules;
 
@@ -74,6 +74,7 @@ static int cmd_checkconf(int argc, char *argv[], unsigned flags);
 static int cmd_checkzone(int argc, char *argv[], unsigned flags);
 static int cmd_memstats(int argc, char *argv[], unsigned flags);
 static int cmd_signzone(int argc, char *argv[], unsigned flags);
+static int cmd_stats(int argc, char *argv[], unsigned flags);
 
 /*! \brief Table of remote commands. */
 knot_cmd_t knot_cmd_tbl[] = {
@@ -89,6 +90,7 @@ knot_cmd_t knot_cmd_tbl[] = {
 	{&cmd_checkzone,  1, "checkzone",  "[<zone>...]", "Check zones."},
 	{&cmd_memstats,   1, "memstats",   "[<zone>...]", "Estimate memory use for zones."},
 	{&cmd_signzone,   0, "signzone",   "<zone>...",   "Sign zones with available DNSSEC keys."},
+	{&cmd_stats,      0, "stats",      "",            "Show query processing statistics."},
 	{NULL, 0, NULL, NULL, NULL}
 };
 
@@ -652,6 +654,19 @@ static int cmd_signzone(int argc, char *argv[], unsigned flags)
 	return cmd_remote("signzone", KNOT_RRTYPE_NS, argc, argv);
 }
 
+static int cmd_stats(int argc, char *argv[], unsigned flags)
+{
+	UNUSED(argv);
+	UNUSED(flags);
+
+	if (argc > 0) {
+		printf("command does not take arguments\n");
+		return KNOT_EINVAL;
+	}
+
+	return cmd_remote("stats", KNOT_RRTYPE_TXT, 0, NULL);
+}
+
 static int cmd_checkconf(int argc, char *argv[], unsigned flags)
 {
 	UNUSED(argc);
@@ -30,6 +30,7 @@
 #include "libknot/internal/mem.h"
 #include "libknot/internal/net.h"
 #include "libknot/internal/strlcpy.h"
+#include "libknot/internal/utils.h"
 #include "libknot/dnssec/random.h"
 
 #define KNOT_CTL_REALM "knot."
@@ -115,6 +116,7 @@ static int remote_c_status(server_t *s, remote_cmdargs_t* a);
 static int remote_c_zonestatus(server_t *s, remote_cmdargs_t* a);
 static int remote_c_flush(server_t *s, remote_cmdargs_t* a);
 static int remote_c_signzone(server_t *s, remote_cmdargs_t* a);
+static int remote_c_stats(server_t *s, remote_cmdargs_t* a);
 
 /*! \brief Table of remote commands. */
 struct remote_cmd remote_cmd_tbl[] = {
@@ -126,6 +128,7 @@ struct remote_cmd remote_cmd_tbl[] = {
 	{ "zonestatus",&remote_c_zonestatus },
 	{ "flush",     &remote_c_flush },
 	{ "signzone",  &remote_c_signzone },
+	{ "stats",     &remote_c_stats },
 	{ NULL,        NULL }
 };
 
@@ -338,18 +341,32 @@ static int remote_zonestatus(zone_t *zone, remote_cmdargs_t *a)
 		memcpy(when, "idle", strlen("idle"));
 	}
 
+	/* Fetch NSEC3 proof cache counters. */
+	char nsec3_buf[128] = { '\0' };
+	if (zone->contents && knot_is_nsec3_enabled(zone->contents)) {
+		uint64_t hits = 0, misses = 0;
+		nsec3_cache_stats(zone->contents->nsec3_cache, &hits, &misses);
+		if (snprintf(nsec3_buf, sizeof(nsec3_buf),
+		             " | NSEC3 cache hits=%llu misses=%llu",
+		             (unsigned long long)hits,
+		             (unsigned long long)misses) < 0) {
+			return KNOT_ESPACE;
+		}
+	}
+
 	/* Prepare zone info. */
 	char buf[512] = { '\0' };
 	char dnssec_buf[128] = { '\0' };
 	int n = snprintf(buf, sizeof(buf),
-	                 "%s\ttype=%s | serial=%u | %s %s | %s %s\n",
+	                 "%s\ttype=%s | serial=%u | %s %s | %s %s%s\n",
 	                 zone->conf->name,
 	                 zone_master(zone) ? "slave" : "master",
 	                 serial,
 	                 next_name,
 	                 when,
 	                 zone->conf->dnssec_enable ? "automatic DNSSEC, resigning at:" : "DNSSEC signing disabled",
-	                 zone->conf->dnssec_enable ? dnssec_info(zone, dnssec_buf, sizeof(dnssec_buf)) : "");
+	                 zone->conf->dnssec_enable ? dnssec_info(zone, dnssec_buf, sizeof(dnssec_buf)) : "",
+	                 nsec3_buf);
 	if (n < 0 || n >= sizeof(buf)) {
 		return KNOT_ESPACE;
 	}
@@ -385,6 +402,88 @@ static int remote_c_zonestatus(server_t *s, remote_cmdargs_t* a)
 	return KNOT_EOK;
 }
 
+/*! \brief Append a line 'name: value' to the response. */
+static int remote_stats_line(remote_cmdargs_t *a, const char *prefix,
+                             const char *name, uint64_t value)
+{
+	char buf[128];
+	int n = snprintf(buf, sizeof(buf), "%s%s: %llu\n", prefix, name,
+	                 (unsigned long long)value);
+	if (n < 0 || n >= sizeof(buf)) {
+		return KNOT_ESPACE;
+	}
+
+	int ret = cmdargs_assure_avail(a, n);
+	if (ret == KNOT_EOK) {
+		memcpy(a->response + a->response_size, buf, n);
+		a->response_size += n;
+	}
+
+	return ret;
+}
+
+/*!
+ * \brief Remote command 'stats' handler.
+ *
+ * QNAME: stats
+ * DATA: NONE
+ */
+static int remote_c_stats(server_t *s, remote_cmdargs_t* a)
+{
+	dbg_server("remote: %s\n", __func__);
+
+	stats_data_t total;
+	stats_sum(&s->stats, &total);
+
+	int ret = KNOT_EOK;
+	for (int i = 0; i < STATS_COUNTERS && ret == KNOT_EOK; i++) {
+		ret = remote_stats_line(a, "", stats_counter_name(i),
+		                        total.counter[i]);
+	}
+	if (ret == KNOT_EOK) {
+		ret = remote_stats_line(a, "", "log-dropped", log_async_dropped());
+	}
+
+	/* Only non-zero RCODEs, QTYPEs and response sizes. */
+	char name[64];
+	for (int i = 0; i <= STATS_RCODE_OTHER && ret == KNOT_EOK; i++) {
+		if (total.rcode[i] == 0) {
+			continue;
+		}
+		lookup_table_t *rcode = lookup_by_id(knot_rcode_names, i);
+		if (i == STATS_RCODE_OTHER) {
+			strlcpy(name, "other", sizeof(name));
+		} else if (rcode != NULL) {
+			strlcpy(name, rcode->name, sizeof(name));
+		} else {
+			snprintf(name, sizeof(name), "RCODE%d", i);
+		}
+		ret = remote_stats_line(a, "rcode.", name, total.rcode[i]);
+	}
+
+	for (int i = 0; i <= STATS_QTYPE_OTHER && ret == KNOT_EOK; i++) {
+		if (total.qtype[i] == 0) {
+			continue;
+		}
+		if (i == STATS_QTYPE_OTHER) {
+			strlcpy(name, "other", sizeof(name));
+		} else if (knot_rrtype_to_string(i, name, sizeof(name)) < 0) {
+			continue;
+		}
+		ret = remote_stats_line(a, "qtype.", name, total.qtype[i]);
+	}
+
+	for (int i = 0; i < STATS_SIZES && ret == KNOT_EOK; i++) {
+		if (total.resp_size[i] == 0) {
+			continue;
+		}
+		snprintf(name, sizeof(name), "%u-%u", 1U << i, (2U << i) - 1);
+		ret = remote_stats_line(a, "response-size.", name, total.resp_size[i]);
+	}
+
+	return ret;
+}
+
 /*!
  * \brief Remote command 'refresh' handler.
  *
@@ -293,3 +293,198 @@ int knot_nsec_create_chain(const zone_contents_t *zone, uint32_t ttl,
 	return knot_nsec_chain_iterate_create(zone->nodes,
 	                                      connect_nsec_nodes, &data);
 }
+
+/* - API - Incremental chain update ----------------------------------------- */
+
+/*!
+ * \brief Checks whether the node should be covered by the NSEC chain.
+ *
+ * Mirrors the skipping rules of connect_nsec_nodes().
+ */
+static bool node_in_nsec_chain(const zone_node_t *n)
+{
+	if (n->rrset_count == 0 || n->flags & NODE_FLAGS_NONAUTH) {
+		return false;
+	}
+
+	return !(node_rrtype_exists(n, KNOT_RRTYPE_NSEC) &&
+	         knot_nsec_empty_nsec_and_rrsigs_in_node(n));
+}
+
+/*! \brief Finds the following node in the NSEC chain. */
+static zone_node_t *chain_next(zone_tree_t *nodes, const zone_node_t *n)
+{
+	zone_node_t *next = zone_tree_get_next(nodes, n->owner);
+	while (next != NULL && !node_in_nsec_chain(next)) {
+		next = zone_tree_get_next(nodes, next->owner);
+	}
+
+	return next;
+}
+
+/*! \brief Finds the preceding node in the NSEC chain. */
+static zone_node_t *chain_prev(zone_node_t *n)
+{
+	zone_node_t *prev = n;
+	while (prev != NULL && !node_in_nsec_chain(prev)) {
+		prev = prev->prev;
+	}
+
+	return prev;
+}
+
+/*! \brief Checks whether the update changes a delegation inside the zone. */
+static bool delegation_changed(const zone_contents_t *zone,
+                               const zone_contents_t *diff)
+{
+	if (zone_tree_is_empty(diff->nodes)) {
+		return false;
+	}
+
+	hattrie_iter_t *itt = hattrie_iter_begin(diff->nodes, false);
+	if (itt == NULL) {
+		return true; /* Be conservative. */
+	}
+
+	bool changed = false;
+	for (; !hattrie_iter_finished(itt); hattrie_iter_next(itt)) {
+		const zone_node_t *n = *hattrie_iter_val(itt);
+		if (node_rrtype_exists(n, KNOT_RRTYPE_NS) &&
+		    !knot_dname_is_equal(n->owner, zone->apex->owner)) {
+			changed = true;
+			break;
+		}
+	}
+	hattrie_iter_free(itt);
+
+	return changed;
+}
+
+/*!
+ * \brief Checks whether the changeset changes a delegation inside the zone.
+ */
+bool knot_nsec_delegation_changed(const zone_contents_t *zone,
+                                  const changeset_t *in_ch)
+{
+	return delegation_changed(zone, in_ch->add) ||
+	       delegation_changed(zone, in_ch->remove);
+}
+
+/*! \brief Remembers the node whose NSEC has to be checked. */
+static int note_chain_node(hattrie_t *touched, zone_node_t *n)
+{
+	if (n == NULL) {
+		return KNOT_EOK;
+	}
+
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, n->owner, NULL);
+	value_t *val = hattrie_get(touched, (char *)lf + 1, *lf);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+	*val = n;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Notes changed names and their predecessors in the chain. */
+static int note_chain_changes(const zone_contents_t *zone,
+                              const zone_contents_t *diff, hattrie_t *touched)
+{
+	if (zone_tree_is_empty(diff->nodes)) {
+		return KNOT_EOK;
+	}
+
+	hattrie_iter_t *itt = hattrie_iter_begin(diff->nodes, false);
+	if (itt == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	for (; !hattrie_iter_finished(itt); hattrie_iter_next(itt)) {
+		const zone_node_t *diff_node = *hattrie_iter_val(itt);
+
+		zone_node_t *node = NULL;
+		zone_node_t *prev = NULL;
+		zone_tree_get_less_or_equal(zone->nodes, diff_node->owner,
+		                            &node, &prev);
+		if (node != NULL &&
+		    !knot_dname_is_equal(node->owner, diff_node->owner)) {
+			node = NULL;
+		}
+
+		ret = note_chain_node(touched, node);
+		if (ret == KNOT_EOK) {
+			ret = note_chain_node(touched, chain_prev(prev));
+		}
+		if (ret != KNOT_EOK) {
+			break;
+		}
+	}
+
+	hattrie_iter_free(itt);
+
+	return ret;
+}
+
+/*! \brief Fixes NSEC record of a single touched node. */
+static int fix_chain_node(zone_node_t *n, nsec_chain_iterate_data_t *data)
+{
+	if (node_in_nsec_chain(n)) {
+		zone_node_t *next = chain_next(data->zone->nodes, n);
+		assert(next);
+		return connect_nsec_nodes(n, next, data);
+	}
+
+	/* Node left the chain, drop its redundant NSEC. */
+	if (n->rrset_count > 0 && !(n->flags & NODE_FLAGS_NONAUTH) &&
+	    node_rrtype_exists(n, KNOT_RRTYPE_NSEC)) {
+		return knot_nsec_changeset_remove(n, data->changeset);
+	}
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Update NSEC chain for names touched by the changeset only.
+ */
+int knot_nsec_fix_chain(const zone_contents_t *zone, const changeset_t *in_ch,
+                        uint32_t ttl, changeset_t *changeset)
+{
+	assert(zone);
+	assert(zone->nodes);
+	assert(in_ch);
+	assert(changeset);
+
+	/* Delegation changes alter authoritativeness of whole subtrees. */
+	if (!node_rrtype_exists(zone->apex, KNOT_RRTYPE_NSEC) ||
+	    knot_nsec_delegation_changed(zone, in_ch)) {
+		return knot_nsec_create_chain(zone, ttl, changeset);
+	}
+
+	hattrie_t *touched = hattrie_create();
+	if (touched == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = note_chain_changes(zone, in_ch->remove, touched);
+	if (ret == KNOT_EOK) {
+		ret = note_chain_changes(zone, in_ch->add, touched);
+	}
+
+	nsec_chain_iterate_data_t data = { ttl, changeset, zone };
+
+	hattrie_iter_t *itt = hattrie_iter_begin(touched, false);
+	if (itt == NULL) {
+		ret = KNOT_ENOMEM;
+	}
+	for (; ret == KNOT_EOK && !hattrie_iter_finished(itt);
+	     hattrie_iter_next(itt)) {
+		ret = fix_chain_node(*hattrie_iter_val(itt), &data);
+	}
+	hattrie_iter_free(itt);
+	hattrie_free(touched);
+
+	return ret;
+}
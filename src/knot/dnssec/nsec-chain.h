@@ -120,4 +120,35 @@ bool knot_nsec_empty_nsec_and_rrsigs_in_node(const zone_node_t *n);
 int knot_nsec_create_chain(const zone_contents_t *zone, uint32_t ttl,
                            changeset_t *changeset);
 
+/*!
+ * \brief Checks whether the changeset changes a delegation inside the zone.
+ *
+ * Such change alters authoritativeness of the whole subtree, so the chain
+ * can't be fixed for the changed names only.
+ *
+ * \param zone   Updated zone.
+ * \param in_ch  Changeset applied to the zone.
+ *
+ * \return True if NS records below the zone apex were changed.
+ */
+bool knot_nsec_delegation_changed(const zone_contents_t *zone,
+                                  const changeset_t *in_ch);
+
+/*!
+ * \brief Update NSEC chain for names touched by the changeset only.
+ *
+ * Only NSEC records of the changed names and their predecessors in the chain
+ * are checked. Falls back to knot_nsec_create_chain() when a delegation
+ * changes or the zone has no NSEC chain yet.
+ *
+ * \param zone       Updated zone.
+ * \param in_ch      Changeset applied to the zone.
+ * \param ttl        TTL for created NSEC records.
+ * \param changeset  Changeset the differences will be put into.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_nsec_fix_chain(const zone_contents_t *zone, const changeset_t *in_ch,
+                        uint32_t ttl, changeset_t *changeset);
+
 /*! @} */
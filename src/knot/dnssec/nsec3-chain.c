@@ -630,3 +630,514 @@ int knot_nsec3_create_chain(const zone_contents_t *zone, uint32_t ttl,
 
 	return result;
 }
+
+/* - Incremental chain update ----------------------------------------------- */
+
+/*!
+ * \brief Name whose NSEC3 record may change with the update.
+ */
+typedef struct {
+	knot_dname_t *owner;     /*!< Name in the zone. */
+	zone_node_t *node;       /*!< Zone node, NULL if the name was removed. */
+	unsigned empty_children; /*!< Children which get no NSEC3 record. */
+} fix_name_t;
+
+/*!
+ * \brief NSEC3 nodes changed by the update.
+ */
+typedef struct {
+	zone_tree_t *nodes;     /*!< Current NSEC3 nodes of the zone. */
+	zone_tree_t *removed;   /*!< Current nodes without a name in the zone. */
+	zone_tree_t *added;     /*!< New nodes for names without NSEC3 record. */
+	zone_tree_t *old_nodes; /*!< Current nodes being removed or replaced. */
+	zone_tree_t *new_nodes; /*!< New nodes and replacements (owned). */
+} nsec3_fix_t;
+
+/*! \brief Looks up name in a trie keyed by lookup format. */
+static value_t *fix_name_get(hattrie_t *names, const knot_dname_t *owner,
+                             bool create)
+{
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, owner, NULL);
+	if (create) {
+		return hattrie_get(names, (char *)lf + 1, *lf);
+	}
+
+	return hattrie_tryget(names, (char *)lf + 1, *lf);
+}
+
+/*!
+ * \brief Notes the changed name and its ancestors up to the zone apex.
+ *
+ * Ancestors are noted, as adding or removing a name may create or remove
+ * empty non-terminals above it.
+ */
+static int note_fix_name(hattrie_t *names, const zone_contents_t *zone,
+                         const knot_dname_t *owner)
+{
+	const knot_dname_t *name = owner;
+	while (*name != '\0') {
+		value_t *val = fix_name_get(names, name, true);
+		if (val == NULL) {
+			return KNOT_ENOMEM;
+		}
+		if (*val != NULL) {
+			return KNOT_EOK; /* Ancestors noted already. */
+		}
+
+		fix_name_t *entry = malloc(sizeof(fix_name_t));
+		if (entry == NULL) {
+			return KNOT_ENOMEM;
+		}
+		memset(entry, 0, sizeof(fix_name_t));
+		entry->owner = knot_dname_copy(name, NULL);
+		if (entry->owner == NULL) {
+			free(entry);
+			return KNOT_ENOMEM;
+		}
+		zone_tree_get(zone->nodes, name, &entry->node);
+		*val = entry;
+
+		if (knot_dname_is_equal(name, zone->apex->owner)) {
+			break;
+		}
+		name = knot_wire_next_label(name, NULL);
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Notes names of all nodes in the changeset part. */
+static int note_fix_names(hattrie_t *names, const zone_contents_t *zone,
+                          const zone_contents_t *diff)
+{
+	if (zone_tree_is_empty(diff->nodes)) {
+		return KNOT_EOK;
+	}
+
+	hattrie_iter_t *itt = hattrie_iter_begin(diff->nodes, false);
+	if (itt == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	for (; ret == KNOT_EOK && !hattrie_iter_finished(itt);
+	     hattrie_iter_next(itt)) {
+		const zone_node_t *n = *hattrie_iter_val(itt);
+		ret = note_fix_name(names, zone, n->owner);
+	}
+	hattrie_iter_free(itt);
+
+	return ret;
+}
+
+/*! \brief Frees noted names. */
+static void free_fix_names(hattrie_t *names)
+{
+	hattrie_iter_t *itt = hattrie_iter_begin(names, false);
+	for (; itt != NULL && !hattrie_iter_finished(itt);
+	     hattrie_iter_next(itt)) {
+		fix_name_t *entry = *hattrie_iter_val(itt);
+		knot_dname_free(&entry->owner, NULL);
+		free(entry);
+	}
+	hattrie_iter_free(itt);
+	hattrie_free(names);
+}
+
+/*!
+ * \brief Checks whether the name gets no NSEC3 record, same as nsec3_is_empty()
+ *        with the children marked by nsec3_mark_empty().
+ */
+static bool fix_name_is_empty(const fix_name_t *entry)
+{
+	const zone_node_t *n = entry->node;
+	return n->children <= entry->empty_children &&
+	       knot_nsec_empty_nsec_and_rrsigs_in_node(n);
+}
+
+/*!
+ * \brief Counts children without NSEC3 record for the noted names.
+ *
+ * Children follow their parent in canonical order, so the names are walked
+ * backwards and the parent is updated after all its changed children.
+ */
+static int count_empty_children(hattrie_t *names)
+{
+	size_t count = hattrie_weight(names);
+	if (count == 0) {
+		return KNOT_EOK;
+	}
+
+	fix_name_t **sorted = malloc(count * sizeof(fix_name_t *));
+	if (sorted == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	hattrie_build_index(names);
+	hattrie_iter_t *itt = hattrie_iter_begin(names, true);
+	if (itt == NULL) {
+		free(sorted);
+		return KNOT_ENOMEM;
+	}
+	size_t i = 0;
+	for (; !hattrie_iter_finished(itt); hattrie_iter_next(itt)) {
+		sorted[i++] = *hattrie_iter_val(itt);
+	}
+	hattrie_iter_free(itt);
+	assert(i == count);
+
+	while (i-- > 0) {
+		fix_name_t *entry = sorted[i];
+		if (entry->node == NULL || !fix_name_is_empty(entry) ||
+		    *entry->owner == '\0') {
+			continue;
+		}
+
+		const knot_dname_t *parent = knot_wire_next_label(entry->owner, NULL);
+		value_t *val = fix_name_get(names, parent, false);
+		if (val != NULL) {
+			fix_name_t *parent_entry = *val;
+			parent_entry->empty_children += 1;
+		}
+	}
+
+	free(sorted);
+
+	return KNOT_EOK;
+}
+
+/*! \brief Checks whether the node shall have NSEC3 record. */
+static bool fix_name_in_chain(const fix_name_t *entry)
+{
+	return entry->node != NULL &&
+	       !(entry->node->flags & NODE_FLAGS_NONAUTH) &&
+	       !fix_name_is_empty(entry);
+}
+
+/*! \brief Copies NSEC3 record of the node into a new node. */
+static zone_node_t *copy_nsec3_node(const zone_node_t *from)
+{
+	zone_node_t *to = node_new(from->owner, NULL);
+	if (to == NULL) {
+		return NULL;
+	}
+
+	knot_rrset_t nsec3 = node_rrset(from, KNOT_RRTYPE_NSEC3);
+	if (node_add_rrset(to, &nsec3, NULL) != KNOT_EOK) {
+		node_free(&to, NULL);
+		return NULL;
+	}
+
+	return to;
+}
+
+/*! \brief Checks whether the current NSEC3 node will be removed. */
+static bool fix_is_removed(nsec3_fix_t *fix, const zone_node_t *n)
+{
+	zone_node_t *found = NULL;
+	zone_tree_get(fix->removed, n->owner, &found);
+	return found != NULL;
+}
+
+/*!
+ * \brief Chooses the candidate closer to the owner in the chain.
+ *
+ * \param dir  1 to choose the following node, -1 to choose the preceding one.
+ */
+static zone_node_t *closer_node(const knot_dname_t *owner, zone_node_t *a,
+                                zone_node_t *b, int dir)
+{
+	if (a != NULL && knot_dname_is_equal(a->owner, owner)) {
+		a = NULL;
+	}
+	if (b != NULL && knot_dname_is_equal(b->owner, owner)) {
+		b = NULL;
+	}
+	if (a == NULL || b == NULL) {
+		return a ? a : b;
+	}
+
+	/* Prefer nodes not wrapping around the end of the chain. */
+	bool a_ahead = dir * knot_dname_cmp(a->owner, owner) > 0;
+	bool b_ahead = dir * knot_dname_cmp(b->owner, owner) > 0;
+	if (a_ahead != b_ahead) {
+		return a_ahead ? a : b;
+	}
+
+	return dir * knot_dname_cmp(a->owner, b->owner) < 0 ? a : b;
+}
+
+/*! \brief Finds the preceding node in the tree, wraps around. */
+static zone_node_t *tree_prev(zone_tree_t *tree, const knot_dname_t *owner)
+{
+	zone_node_t *found = NULL;
+	zone_node_t *prev = NULL;
+	if (zone_tree_get_less_or_equal(tree, owner, &found, &prev) < 0) {
+		return NULL;
+	}
+
+	return prev;
+}
+
+/*! \brief Finds the following node in the updated chain. */
+static zone_node_t *fix_next(nsec3_fix_t *fix, const knot_dname_t *owner)
+{
+	size_t skip = hattrie_weight(fix->removed);
+	zone_node_t *cur = zone_tree_get_next(fix->nodes, owner);
+	while (cur != NULL && fix_is_removed(fix, cur)) {
+		cur = (skip-- > 0) ? zone_tree_get_next(fix->nodes, cur->owner) : NULL;
+	}
+
+	zone_node_t *add = zone_tree_get_next(fix->added, owner);
+
+	return closer_node(owner, cur, add, 1);
+}
+
+/*! \brief Finds the preceding node in the updated chain. */
+static zone_node_t *fix_prev(nsec3_fix_t *fix, const knot_dname_t *owner)
+{
+	size_t skip = hattrie_weight(fix->removed);
+	zone_node_t *cur = tree_prev(fix->nodes, owner);
+	while (cur != NULL && fix_is_removed(fix, cur)) {
+		cur = (skip-- > 0) ? tree_prev(fix->nodes, cur->owner) : NULL;
+	}
+
+	zone_node_t *add = tree_prev(fix->added, owner);
+
+	return closer_node(owner, cur, add, -1);
+}
+
+/*!
+ * \brief Creates, replaces or removes NSEC3 node of a single noted name.
+ */
+static int fix_name_nsec3(const zone_contents_t *zone, const fix_name_t *entry,
+                          uint32_t ttl, nsec3_fix_t *fix)
+{
+	const knot_nsec3_params_t *params = &zone->nsec3_params;
+
+	zone_node_t *new_node = NULL;
+	zone_node_t *old_node = NULL;
+	if (fix_name_in_chain(entry)) {
+		new_node = create_nsec3_node_for_node(entry->node, zone->apex,
+		                                      params, ttl);
+		if (new_node == NULL) {
+			return KNOT_ENOMEM;
+		}
+		zone_tree_get(fix->nodes, new_node->owner, &old_node);
+	} else {
+		knot_dname_t *owner = knot_create_nsec3_owner(entry->owner,
+		                                              zone->apex->owner,
+		                                              params);
+		if (owner == NULL) {
+			return KNOT_ENOMEM;
+		}
+		zone_tree_get(fix->nodes, owner, &old_node);
+		knot_dname_free(&owner, NULL);
+	}
+
+	int ret = KNOT_EOK;
+	if (new_node != NULL) {
+		ret = zone_tree_insert(fix->new_nodes, new_node);
+		if (ret != KNOT_EOK) {
+			node_free_rrsets(new_node, NULL);
+			node_free(&new_node, NULL);
+			return ret;
+		}
+		if (old_node == NULL) {
+			ret = zone_tree_insert(fix->added, new_node);
+		}
+	} else if (old_node != NULL) {
+		ret = zone_tree_insert(fix->removed, old_node);
+	}
+
+	if (ret == KNOT_EOK && old_node != NULL) {
+		ret = zone_tree_insert(fix->old_nodes, old_node);
+	}
+
+	return ret;
+}
+
+/*!
+ * \brief Links the added nodes, so that their predecessors can be looked up.
+ */
+static void link_added_nodes(zone_tree_t *added)
+{
+	if (zone_tree_is_empty(added)) {
+		return;
+	}
+
+	hattrie_iter_t *itt = hattrie_iter_begin(added, true);
+	if (itt == NULL) {
+		return;
+	}
+
+	zone_node_t *first = NULL;
+	zone_node_t *prev = NULL;
+	for (; !hattrie_iter_finished(itt); hattrie_iter_next(itt)) {
+		zone_node_t *n = *hattrie_iter_val(itt);
+		if (first == NULL) {
+			first = n;
+		}
+		n->prev = prev;
+		prev = n;
+	}
+	hattrie_iter_free(itt);
+
+	first->prev = prev;
+}
+
+/*!
+ * \brief Adds copies of predecessors of the added and removed nodes, their
+ *        next hashed owner changes.
+ */
+static int add_predecessors(nsec3_fix_t *fix, zone_tree_t *changed)
+{
+	if (zone_tree_is_empty(changed)) {
+		return KNOT_EOK;
+	}
+
+	hattrie_iter_t *itt = hattrie_iter_begin(changed, false);
+	if (itt == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	for (; ret == KNOT_EOK && !hattrie_iter_finished(itt);
+	     hattrie_iter_next(itt)) {
+		const zone_node_t *n = *hattrie_iter_val(itt);
+		zone_node_t *prev = fix_prev(fix, n->owner);
+		if (prev == NULL) {
+			continue;
+		}
+
+		zone_node_t *found = NULL;
+		zone_tree_get(fix->new_nodes, prev->owner, &found);
+		if (found != NULL) {
+			continue;
+		}
+
+		zone_node_t *copy = copy_nsec3_node(prev);
+		if (copy == NULL) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
+		ret = zone_tree_insert(fix->new_nodes, copy);
+		if (ret != KNOT_EOK) {
+			node_free_rrsets(copy, NULL);
+			node_free(&copy, NULL);
+			break;
+		}
+		ret = zone_tree_insert(fix->old_nodes, prev);
+	}
+	hattrie_iter_free(itt);
+
+	return ret;
+}
+
+/*! \brief Fills next hashed owner of the new nodes. */
+static int connect_new_nodes(nsec3_fix_t *fix)
+{
+	if (zone_tree_is_empty(fix->new_nodes)) {
+		return KNOT_EOK;
+	}
+
+	hattrie_iter_t *itt = hattrie_iter_begin(fix->new_nodes, false);
+	if (itt == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	for (; ret == KNOT_EOK && !hattrie_iter_finished(itt);
+	     hattrie_iter_next(itt)) {
+		zone_node_t *n = *hattrie_iter_val(itt);
+		zone_node_t *next = fix_next(fix, n->owner);
+		ret = connect_nsec3_nodes(n, next ? next : n, NULL);
+	}
+	hattrie_iter_free(itt);
+
+	return ret;
+}
+
+/*!
+ * \brief Update NSEC3 chain for names touched by the changeset only.
+ */
+int knot_nsec3_fix_chain(const zone_contents_t *zone, const changeset_t *in_ch,
+                         uint32_t ttl, changeset_t *changeset)
+{
+	assert(zone);
+	assert(in_ch);
+	assert(changeset);
+
+	if (zone_tree_is_empty(zone->nsec3_nodes) ||
+	    node_rrtype_exists(zone->apex, KNOT_RRTYPE_NSEC) ||
+	    knot_nsec_delegation_changed(zone, in_ch)) {
+		return knot_nsec3_create_chain(zone, ttl, changeset);
+	}
+
+	hattrie_t *names = hattrie_create();
+	if (names == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = note_fix_names(names, zone, in_ch->remove);
+	if (ret == KNOT_EOK) {
+		ret = note_fix_names(names, zone, in_ch->add);
+	}
+	if (ret == KNOT_EOK) {
+		ret = count_empty_children(names);
+	}
+	if (ret != KNOT_EOK) {
+		free_fix_names(names);
+		return ret;
+	}
+
+	nsec3_fix_t fix = {
+		.nodes = zone->nsec3_nodes,
+		.removed = zone_tree_create(),
+		.added = zone_tree_create(),
+		.old_nodes = zone_tree_create(),
+		.new_nodes = zone_tree_create()
+	};
+	if (!fix.removed || !fix.added || !fix.old_nodes || !fix.new_nodes) {
+		ret = KNOT_ENOMEM;
+	}
+
+	hattrie_iter_t *itt = hattrie_iter_begin(names, false);
+	if (itt == NULL) {
+		ret = KNOT_ENOMEM;
+	}
+	for (; ret == KNOT_EOK && !hattrie_iter_finished(itt);
+	     hattrie_iter_next(itt)) {
+		ret = fix_name_nsec3(zone, *hattrie_iter_val(itt), ttl, &fix);
+	}
+	hattrie_iter_free(itt);
+	free_fix_names(names);
+
+	if (ret == KNOT_EOK) {
+		hattrie_build_index(fix.added);
+		link_added_nodes(fix.added);
+		ret = add_predecessors(&fix, fix.added);
+	}
+	if (ret == KNOT_EOK) {
+		ret = add_predecessors(&fix, fix.removed);
+	}
+	if (ret == KNOT_EOK) {
+		ret = connect_new_nodes(&fix);
+	}
+	if (ret == KNOT_EOK) {
+		hattrie_build_index(fix.old_nodes);
+		hattrie_build_index(fix.new_nodes);
+		copy_signatures(fix.old_nodes, fix.new_nodes);
+		ret = zone_tree_add_diff(fix.old_nodes, fix.new_nodes, changeset);
+	}
+
+	zone_tree_free(&fix.removed);
+	zone_tree_free(&fix.added);
+	zone_tree_free(&fix.old_nodes);
+	if (fix.new_nodes != NULL) {
+		free_nsec3_tree(fix.new_nodes);
+	}
+
+	return ret;
+}
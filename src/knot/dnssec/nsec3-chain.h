@@ -41,4 +41,22 @@
 int knot_nsec3_create_chain(const zone_contents_t *zone, uint32_t ttl,
                             changeset_t *changeset);
 
+/*!
+ * \brief Update NSEC3 chain for names touched by the changeset only.
+ *
+ * NSEC3 records of the changed names and their ancestors are created,
+ * updated or removed, and next hashed owners of their predecessors in the
+ * chain are fixed. Falls back to knot_nsec3_create_chain() when a delegation
+ * changes or the zone has no NSEC3 chain yet.
+ *
+ * \param zone       Updated zone.
+ * \param in_ch      Changeset applied to the zone.
+ * \param ttl        TTL for new records.
+ * \param changeset  Changeset to store changes into.
+ *
+ * \return KNOT_E*
+ */
+int knot_nsec3_fix_chain(const zone_contents_t *zone, const changeset_t *in_ch,
+                         uint32_t ttl, changeset_t *changeset);
+
 /*! @} */
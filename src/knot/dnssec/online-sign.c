@@ -0,0 +1,331 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/evp.h>
+
+#include "knot/common/log.h"
+#include "knot/dnssec/online-sign.h"
+#include "knot/dnssec/zone-keys.h"
+#include "knot/dnssec/zone-sign.h"
+#include "libknot/dname.h"
+#include "libknot/errcode.h"
+#include "libknot/dnssec/policy.h"
+#include "libknot/dnssec/rrset-sign.h"
+#include "libknot/internal/lists.h"
+#include "libknot/internal/trie/hat-trie.h"
+#include "libknot/internal/utils.h"
+
+/*! \brief Signature inception is moved back to tolerate clock skew. */
+#define ONLINE_SIGN_INCEPTION_OFFSET 3600
+
+/*! \brief Length of the cache key (SHA-256 of the covered RR set). */
+#define CACHE_KEY_LEN 32
+
+/*!
+ * \brief Cached signatures of one RR set.
+ */
+typedef struct {
+	node_t n;                     //!< Node in the LRU list.
+	uint8_t key[CACHE_KEY_LEN];   //!< Digest of the covered RR set.
+	uint32_t refresh_at;          //!< Signatures are recreated after this.
+	knot_rdataset_t rrsigs;       //!< RRSIG records.
+} sig_entry_t;
+
+/*!
+ * \brief Signature cache and signing contexts used by threads mapped onto it.
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	knot_dnssec_sign_context_t **contexts; //!< Context for each zone key.
+	hattrie_t *index;             //!< Cache key -> sig_entry_t.
+	list_t lru;                   //!< Entries, most recently used first.
+	size_t count;                 //!< Number of cached entries.
+} sign_slot_t;
+
+struct knot_online_sign {
+	knot_zone_keys_t keys;        //!< Zone keys.
+	size_t key_count;             //!< Number of zone keys.
+	uint32_t sign_lifetime;       //!< Signature lifetime.
+	sign_slot_t slots[ONLINE_SIGN_SLOTS];
+};
+
+/*!
+ * \brief Compute cache key for the RR set.
+ */
+static int cache_key(const knot_rrset_t *covered, uint8_t *key)
+{
+	EVP_MD_CTX *ctx = EVP_MD_CTX_create();
+	if (ctx == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	uint8_t header[4];
+	wire_write_u16(header, covered->type);
+	wire_write_u16(header + 2, covered->rclass);
+
+	unsigned int key_len = 0;
+	int ok = EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) &&
+	         EVP_DigestUpdate(ctx, covered->owner,
+	                          knot_dname_size(covered->owner)) &&
+	         EVP_DigestUpdate(ctx, header, sizeof(header)) &&
+	         EVP_DigestUpdate(ctx, covered->rrs.data,
+	                          knot_rdataset_size(&covered->rrs)) &&
+	         EVP_DigestFinal_ex(ctx, key, &key_len);
+	EVP_MD_CTX_destroy(ctx);
+
+	if (!ok || key_len != CACHE_KEY_LEN) {
+		return KNOT_ERROR;
+	}
+
+	return KNOT_EOK;
+}
+
+static void entry_free(sign_slot_t *slot, sig_entry_t *entry)
+{
+	hattrie_del(slot->index, (char *)entry->key, CACHE_KEY_LEN);
+	rem_node(&entry->n);
+	knot_rdataset_clear(&entry->rrsigs, NULL);
+	free(entry);
+	slot->count -= 1;
+}
+
+/*!
+ * \brief Sign the RR set with all keys applicable to the RR set.
+ */
+static int sign_covered(knot_online_sign_t *ctx, sign_slot_t *slot,
+                        const knot_rrset_t *covered, sig_entry_t *entry)
+{
+	knot_dnssec_policy_t policy;
+	knot_dnssec_init_default_policy(&policy);
+	policy.now -= ONLINE_SIGN_INCEPTION_OFFSET;
+	knot_dnssec_policy_set_sign_lifetime(&policy, ctx->sign_lifetime);
+
+	knot_rrset_t rrsigs;
+	knot_rrset_init(&rrsigs, covered->owner, KNOT_RRTYPE_RRSIG,
+	                covered->rclass);
+
+	int ret = KNOT_EOK;
+	size_t i = 0;
+	node_t *node = NULL;
+	WALK_LIST(node, ctx->keys.list) {
+		const knot_zone_key_t *key = (knot_zone_key_t *)node;
+		if (!knot_zone_sign_use_key(key, covered)) {
+			i += 1;
+			continue;
+		}
+
+		if (slot->contexts[i] == NULL) {
+			slot->contexts[i] = knot_zone_key_context_get(key);
+			if (slot->contexts[i] == NULL) {
+				ret = KNOT_ENOMEM;
+				break;
+			}
+		}
+
+		ret = knot_sign_rrset(&rrsigs, covered, &key->dnssec_key,
+		                      slot->contexts[i], &policy);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+		i += 1;
+	}
+
+	if (ret != KNOT_EOK) {
+		knot_rdataset_clear(&rrsigs.rrs, NULL);
+		return ret;
+	}
+
+	entry->rrsigs = rrsigs.rrs;
+	entry->refresh_at = knot_dnssec_policy_refresh_time(&policy,
+	                        policy.now + policy.sign_lifetime);
+
+	return KNOT_EOK;
+}
+
+knot_online_sign_t *knot_online_sign_new(const zone_contents_t *zone,
+                                         const conf_zone_t *zone_config)
+{
+	if (zone == NULL || zone_config == NULL) {
+		return NULL;
+	}
+
+	knot_online_sign_t *ctx = malloc(sizeof(*ctx));
+	if (ctx == NULL) {
+		return NULL;
+	}
+	memset(ctx, 0, sizeof(*ctx));
+
+	knot_init_zone_keys(&ctx->keys);
+	int ret = knot_load_zone_keys(zone_config->dnssec_keydir,
+	                              zone->apex->owner, false, &ctx->keys);
+	if (ret != KNOT_EOK) {
+		log_zone_error(zone->apex->owner, "DNSSEC, failed to load keys "
+		               "for online signing (%s)", knot_strerror(ret));
+		free(ctx);
+		return NULL;
+	}
+
+	node_t *node = NULL;
+	WALK_LIST(node, ctx->keys.list) {
+		ctx->key_count += 1;
+	}
+
+	ctx->sign_lifetime = KNOT_DNSSEC_DEFAULT_LIFETIME;
+	if (zone_config->sig_lifetime > 0) {
+		ctx->sign_lifetime = zone_config->sig_lifetime;
+	}
+
+	for (int i = 0; i < ONLINE_SIGN_SLOTS; i++) {
+		sign_slot_t *slot = &ctx->slots[i];
+		pthread_mutex_init(&slot->lock, NULL);
+		init_list(&slot->lru);
+	}
+
+	return ctx;
+}
+
+void knot_online_sign_free(knot_online_sign_t *ctx)
+{
+	if (ctx == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < ONLINE_SIGN_SLOTS; i++) {
+		sign_slot_t *slot = &ctx->slots[i];
+
+		sig_entry_t *entry = NULL;
+		sig_entry_t *next = NULL;
+		WALK_LIST_DELSAFE(entry, next, slot->lru) {
+			knot_rdataset_clear(&entry->rrsigs, NULL);
+			free(entry);
+		}
+		hattrie_free(slot->index);
+
+		if (slot->contexts != NULL) {
+			size_t k = 0;
+			node_t *node = NULL;
+			WALK_LIST(node, ctx->keys.list) {
+				const knot_zone_key_t *key = (knot_zone_key_t *)node;
+				knot_zone_key_context_put(key, slot->contexts[k]);
+				k += 1;
+			}
+			free(slot->contexts);
+		}
+
+		pthread_mutex_destroy(&slot->lock);
+	}
+
+	knot_free_zone_keys(&ctx->keys);
+	free(ctx);
+}
+
+/*!
+ * \brief Allocate slot structures on first use. Call with slot lock held.
+ */
+static int slot_init(knot_online_sign_t *ctx, sign_slot_t *slot)
+{
+	if (slot->index != NULL) {
+		return KNOT_EOK;
+	}
+
+	slot->contexts = calloc(ctx->key_count, sizeof(*slot->contexts));
+	if (slot->contexts == NULL && ctx->key_count > 0) {
+		return KNOT_ENOMEM;
+	}
+
+	slot->index = hattrie_create();
+	if (slot->index == NULL) {
+		free(slot->contexts);
+		slot->contexts = NULL;
+		return KNOT_ENOMEM;
+	}
+
+	return KNOT_EOK;
+}
+
+int knot_online_sign_rrset(knot_online_sign_t *ctx, unsigned thread_id,
+                           const knot_rrset_t *covered,
+                           knot_rdataset_t *rrsigs, mm_ctx_t *mm)
+{
+	if (ctx == NULL || knot_rrset_empty(covered) || rrsigs == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	uint8_t key[CACHE_KEY_LEN];
+	int ret = cache_key(covered, key);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	sign_slot_t *slot = &ctx->slots[thread_id % ONLINE_SIGN_SLOTS];
+	pthread_mutex_lock(&slot->lock);
+
+	ret = slot_init(ctx, slot);
+	if (ret != KNOT_EOK) {
+		pthread_mutex_unlock(&slot->lock);
+		return ret;
+	}
+
+	value_t *val = hattrie_tryget(slot->index, (char *)key, sizeof(key));
+	sig_entry_t *entry = val ? *val : NULL;
+	if (entry != NULL && entry->refresh_at <= time(NULL)) {
+		entry_free(slot, entry);
+		entry = NULL;
+	}
+
+	if (entry != NULL) {
+		rem_node(&entry->n);
+		add_head(&slot->lru, &entry->n);
+	} else {
+		entry = malloc(sizeof(*entry));
+		if (entry == NULL) {
+			pthread_mutex_unlock(&slot->lock);
+			return KNOT_ENOMEM;
+		}
+		memset(entry, 0, sizeof(*entry));
+		memcpy(entry->key, key, sizeof(key));
+
+		ret = sign_covered(ctx, slot, covered, entry);
+		val = (ret == KNOT_EOK) ?
+		      hattrie_get(slot->index, (char *)key, sizeof(key)) : NULL;
+		if (val == NULL) {
+			knot_rdataset_clear(&entry->rrsigs, NULL);
+			free(entry);
+			pthread_mutex_unlock(&slot->lock);
+			return (ret == KNOT_EOK) ? KNOT_ENOMEM : ret;
+		}
+
+		*val = entry;
+		add_head(&slot->lru, &entry->n);
+		slot->count += 1;
+
+		// evict least recently used signatures
+		if (slot->count > ONLINE_SIGN_CACHE_SIZE) {
+			entry_free(slot, TAIL(slot->lru));
+		}
+	}
+
+	ret = knot_rdataset_copy(rrsigs, &entry->rrsigs, mm);
+
+	pthread_mutex_unlock(&slot->lock);
+
+	return ret;
+}
@@ -0,0 +1,80 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file online-sign.h
+ *
+ * \brief Online signing of answers.
+ *
+ * Records of zones with online signing are not signed in advance, the
+ * signatures are created when the records are put into a response. Created
+ * signatures are kept in ONLINE_SIGN_SLOTS bounded LRU caches, each guarded
+ * by its own mutex. A thread uses the cache selected by its thread id modulo
+ * ONLINE_SIGN_SLOTS, so threads share a cache only above that count.
+ *
+ * \addtogroup dnssec
+ * @{
+ */
+
+#pragma once
+
+#include "knot/conf/conf.h"
+#include "knot/zone/contents.h"
+#include "libknot/internal/mempattern.h"
+#include "libknot/rrset.h"
+
+/*! \brief Number of signature caches (threads map onto caches by id). */
+#define ONLINE_SIGN_SLOTS 64
+
+/*! \brief Maximal number of cached RR set signatures per cache. */
+#define ONLINE_SIGN_CACHE_SIZE 4096
+
+struct knot_online_sign;
+typedef struct knot_online_sign knot_online_sign_t;
+
+/*!
+ * \brief Create online signing context, load zone keys.
+ *
+ * \param zone         Zone contents.
+ * \param zone_config  Zone configuration.
+ *
+ * \return Online signing context, NULL on error.
+ */
+knot_online_sign_t *knot_online_sign_new(const zone_contents_t *zone,
+                                         const conf_zone_t *zone_config);
+
+/*!
+ * \brief Free online signing context.
+ *
+ * \param ctx  Online signing context.
+ */
+void knot_online_sign_free(knot_online_sign_t *ctx);
+
+/*!
+ * \brief Get signatures for an RR set, sign the RR set if not cached.
+ *
+ * \param ctx        Online signing context.
+ * \param thread_id  Identifier of the calling thread (selects cache).
+ * \param covered    RR set to be signed.
+ * \param rrsigs     Output RRSIG records.
+ * \param mm         Memory context for the output records.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_online_sign_rrset(knot_online_sign_t *ctx, unsigned thread_id,
+                           const knot_rrset_t *covered,
+                           knot_rdataset_t *rrsigs, mm_ctx_t *mm);
+
+/*! @} */
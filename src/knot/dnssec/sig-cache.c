@@ -0,0 +1,201 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <openssl/evp.h>
+
+#include "knot/dnssec/sig-cache.h"
+#include "libknot/errcode.h"
+#include "libknot/dname.h"
+#include "libknot/internal/utils.h"
+#include "libknot/dnssec/rrset-sign.h"
+#include "libknot/rrtype/rrsig.h"
+
+/*! \brief Signature digest length (SHA-256). */
+#define SIG_DIGEST_LEN 32
+
+/*!
+ * \brief Compute digest identifying the signature and the signed data.
+ *
+ * TTLs of the covered records are included, the records are signed with
+ * their actual TTLs and a changed TTL invalidates the signature.
+ */
+static int sig_digest(const knot_rrset_t *covered, const knot_rrset_t *rrsigs,
+                      size_t pos, const knot_dnssec_key_t *key,
+                      uint8_t *digest)
+{
+	EVP_MD_CTX *ctx = EVP_MD_CTX_create();
+	if (ctx == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	uint8_t header[4];
+	wire_write_u16(header, covered->type);
+	wire_write_u16(header + 2, covered->rclass);
+
+	const knot_rdata_t *rrsig = knot_rdataset_at(&rrsigs->rrs, pos);
+
+	int ok = EVP_DigestInit_ex(ctx, EVP_sha256(), NULL);
+	ok = ok && EVP_DigestUpdate(ctx, key->dnskey_rdata.data,
+	                            key->dnskey_rdata.size);
+	ok = ok && EVP_DigestUpdate(ctx, knot_rdata_data(rrsig),
+	                            knot_rdata_rdlen(rrsig));
+	ok = ok && EVP_DigestUpdate(ctx, covered->owner,
+	                            knot_dname_size(covered->owner));
+	ok = ok && EVP_DigestUpdate(ctx, header, sizeof(header));
+
+	for (uint16_t i = 0; ok && i < covered->rrs.rr_count; i++) {
+		const knot_rdata_t *rr = knot_rdataset_at(&covered->rrs, i);
+		uint8_t rr_header[6];
+		wire_write_u32(rr_header, knot_rdata_ttl(rr));
+		wire_write_u16(rr_header + 4, knot_rdata_rdlen(rr));
+		ok = EVP_DigestUpdate(ctx, rr_header, sizeof(rr_header)) &&
+		     EVP_DigestUpdate(ctx, knot_rdata_data(rr),
+		                      knot_rdata_rdlen(rr));
+	}
+
+	unsigned int digest_len = 0;
+	ok = ok && EVP_DigestFinal_ex(ctx, digest, &digest_len);
+	EVP_MD_CTX_destroy(ctx);
+
+	if (!ok || digest_len != SIG_DIGEST_LEN) {
+		return KNOT_ERROR;
+	}
+
+	return KNOT_EOK;
+}
+
+int knot_sig_cache_init(knot_sig_cache_t *cache)
+{
+	if (cache == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	cache->entries = hattrie_create();
+	if (cache->entries == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	cache->hits = 0;
+	cache->misses = 0;
+
+	return KNOT_EOK;
+}
+
+void knot_sig_cache_deinit(knot_sig_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	hattrie_free(cache->entries);
+	cache->entries = NULL;
+}
+
+int knot_sig_cache_sweep(knot_sig_cache_t *cache, uint32_t limit)
+{
+	if (cache == NULL || cache->entries == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	hattrie_t *kept = hattrie_create();
+	if (kept == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	hattrie_iter_t *it = hattrie_iter_begin(cache->entries, false);
+	if (it == NULL) {
+		hattrie_free(kept);
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	for (; !hattrie_iter_finished(it); hattrie_iter_next(it)) {
+		value_t val = *hattrie_iter_val(it);
+		if ((uint32_t)(uintptr_t)val <= limit) {
+			continue;
+		}
+
+		size_t len = 0;
+		const char *key = hattrie_iter_key(it, &len);
+		value_t *slot = hattrie_get(kept, key, len);
+		if (slot == NULL) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
+		*slot = val;
+	}
+	hattrie_iter_free(it);
+
+	if (ret != KNOT_EOK) {
+		hattrie_free(kept);
+		return ret;
+	}
+
+	hattrie_free(cache->entries);
+	cache->entries = kept;
+
+	return KNOT_EOK;
+}
+
+int knot_sig_cache_verify(knot_sig_cache_t *cache,
+                          const knot_rrset_t *covered,
+                          const knot_rrset_t *rrsigs, size_t pos,
+                          const knot_dnssec_key_t *key,
+                          knot_dnssec_sign_context_t *ctx,
+                          const knot_dnssec_policy_t *policy)
+{
+	if (cache == NULL || cache->entries == NULL) {
+		return knot_is_valid_signature(covered, rrsigs, pos, key, ctx,
+		                               policy);
+	}
+
+	if (knot_rrset_empty(covered) ||
+	    knot_rrset_empty(rrsigs) || !key || !ctx || !policy) {
+		return KNOT_EINVAL;
+	}
+
+	// expired signatures are never taken from the cache
+	uint32_t expiration = knot_rrsig_sig_expiration(&rrsigs->rrs, pos);
+	if (expiration <= policy->refresh_before) {
+		return KNOT_DNSSEC_EINVALID_SIGNATURE;
+	}
+
+	uint8_t digest[SIG_DIGEST_LEN];
+	if (sig_digest(covered, rrsigs, pos, key, digest) != KNOT_EOK) {
+		cache->misses += 1;
+		return knot_is_valid_signature(covered, rrsigs, pos, key, ctx,
+		                               policy);
+	}
+
+	if (hattrie_tryget(cache->entries, (char *)digest, sizeof(digest))) {
+		cache->hits += 1;
+		return KNOT_EOK;
+	}
+
+	cache->misses += 1;
+	int ret = knot_is_valid_signature(covered, rrsigs, pos, key, ctx, policy);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	value_t *slot = hattrie_get(cache->entries, (char *)digest, sizeof(digest));
+	if (slot != NULL) {
+		*slot = (value_t)(uintptr_t)expiration;
+	}
+
+	return KNOT_EOK;
+}
@@ -0,0 +1,98 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file sig-cache.h
+ *
+ * \brief Cache of verified signatures.
+ *
+ * Signatures are identified by a digest of the signing key, the RRSIG RDATA
+ * and the covered RR set. A signature found in the cache was verified before
+ * and does not have to be verified again, only its expiration is checked.
+ *
+ * \addtogroup dnssec
+ * @{
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libknot/internal/trie/hat-trie.h"
+#include "libknot/dnssec/policy.h"
+#include "libknot/dnssec/sign.h"
+#include "libknot/rrset.h"
+
+/*!
+ * \brief Cache of verified signatures.
+ */
+typedef struct {
+	hattrie_t *entries;  //!< Signature digest -> signature expiration.
+	size_t hits;         //!< Verifications answered from the cache.
+	size_t misses;       //!< Verifications performed.
+} knot_sig_cache_t;
+
+/*!
+ * \brief Initialize signature cache.
+ *
+ * \param cache  Cache to be initialized.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_sig_cache_init(knot_sig_cache_t *cache);
+
+/*!
+ * \brief Free signature cache entries.
+ *
+ * \param cache  Cache to be deinitialized.
+ */
+void knot_sig_cache_deinit(knot_sig_cache_t *cache);
+
+/*!
+ * \brief Drop cached signatures expiring at or before given time.
+ *
+ * \param cache  Signature cache.
+ * \param limit  Expiration limit (typically policy refresh time).
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_sig_cache_sweep(knot_sig_cache_t *cache, uint32_t limit);
+
+/*!
+ * \brief Check if the signature is valid, consult the cache first.
+ *
+ * Same semantics as knot_is_valid_signature(). Signatures verified
+ * successfully are stored in the cache.
+ *
+ * \param cache    Signature cache (may be NULL, no caching then).
+ * \param covered  RR set covered by the signature.
+ * \param rrsigs   RR set with RRSIGs.
+ * \param pos      Number of RRSIG RR in 'rrsigs' to be validated.
+ * \param key      Key used for signing.
+ * \param ctx      Signing context.
+ * \param policy   DNSSEC policy.
+ *
+ * \return Error code, KNOT_EOK if successful and the signature is valid.
+ * \retval KNOT_DNSSEC_EINVALID_SIGNATURE  The signature is invalid.
+ */
+int knot_sig_cache_verify(knot_sig_cache_t *cache,
+                          const knot_rrset_t *covered,
+                          const knot_rrset_t *rrsigs, size_t pos,
+                          const knot_dnssec_key_t *key,
+                          knot_dnssec_sign_context_t *ctx,
+                          const knot_dnssec_policy_t *policy);
+
+/*! @} */
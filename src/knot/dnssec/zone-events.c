@@ -15,17 +15,36 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "libknot/internal/mem.h"
 #include "knot/conf/conf.h"
 #include "libknot/dnssec/policy.h"
+#include "knot/dnssec/sig-cache.h"
 #include "knot/dnssec/zone-events.h"
 #include "knot/dnssec/zone-keys.h"
 #include "knot/dnssec/zone-nsec.h"
 #include "knot/dnssec/zone-sign.h"
 #include "knot/common/debug.h"
 #include "knot/zone/zone.h"
+#include "libknot/rrtype/soa.h"
+
+static void init_dnssec_policy(const conf_zone_t *config,
+                               knot_dnssec_policy_t *policy,
+                               knot_update_serial_t soa_up, bool force)
+{
+	// Init sign policy
+	knot_dnssec_init_default_policy(policy);
+	policy->soa_up = soa_up;
+	policy->forced_sign = force;
+
+	// Override signature lifetime, if set in config
+	if (config->sig_lifetime > 0) {
+		knot_dnssec_policy_set_sign_lifetime(policy, config->sig_lifetime);
+	}
+}
 
 static int init_dnssec_structs(const zone_contents_t *zone,
                                const conf_zone_t *config,
@@ -50,22 +69,16 @@ static int init_dnssec_structs(const zone_contents_t *zone,
 		return result;
 	}
 
-	// Init sign policy
-	knot_dnssec_init_default_policy(policy);
-	policy->soa_up = soa_up;
-	policy->forced_sign = force;
-
-	// Override signature lifetime, if set in config
-	if (config->sig_lifetime > 0) {
-		knot_dnssec_policy_set_sign_lifetime(policy, config->sig_lifetime);
-	}
+	init_dnssec_policy(config, policy, soa_up, force);
 
 	return KNOT_EOK;
 }
 
 static int zone_sign(zone_contents_t *zone, const conf_zone_t *zone_config,
                      changeset_t *out_ch, bool force,
-                     knot_update_serial_t soa_up, uint32_t *refresh_at)
+                     knot_update_serial_t soa_up,
+                     knot_dnssec_state_t *state, unsigned threads,
+                     uint32_t *refresh_at)
 {
 	assert(zone);
 	assert(out_ch);
@@ -78,35 +91,51 @@ static int zone_sign(zone_contents_t *zone, const conf_zone_t *zone_config,
 	dbg_dnssec_verb("changeset empty before generating NSEC chain: %d\n",
 	                changeset_empty(out_ch));
 
-	// Init needed structs
-	knot_zone_keys_t zone_keys;
-	knot_init_zone_keys(&zone_keys);
+	// Init needed structs, keys from the signing state are already loaded
+	knot_zone_keys_t local_keys;
+	knot_init_zone_keys(&local_keys);
+	knot_zone_keys_t *zone_keys = &local_keys;
+	knot_zone_sign_index_t *index = NULL;
 	knot_dnssec_policy_t policy = { '\0' };
-	int result = init_dnssec_structs(zone, zone_config, &zone_keys, &policy,
-	                                 soa_up, force);
-	if (result != KNOT_EOK) {
-		return result;
+	int result = KNOT_EOK;
+	if (state != NULL) {
+		assert(state->loaded);
+		zone_keys = &state->zone_keys;
+		index = &state->index;
+		init_dnssec_policy(zone_config, &policy, soa_up, force);
+		knot_sig_cache_sweep(&state->sig_cache, policy.refresh_before);
+	} else {
+		result = init_dnssec_structs(zone, zone_config, &local_keys,
+		                             &policy, soa_up, force);
+		if (result != KNOT_EOK) {
+			return result;
+		}
 	}
 
 	// generate NSEC records
 	result = knot_zone_create_nsec_chain(zone, out_ch,
-	                                     &zone_keys, &policy);
+	                                     zone_keys, &policy);
 	if (result != KNOT_EOK) {
 		log_zone_error(zone_name, "DNSSEC, failed to create NSEC(3) chain (%s)",
 		               knot_strerror(result));
-		knot_free_zone_keys(&zone_keys);
+		knot_free_zone_keys(&local_keys);
 		return result;
 	}
 	dbg_dnssec_verb("changeset empty after generating NSEC chain: %d\n",
 	                changeset_empty(out_ch));
 
 	// add missing signatures
-	result = knot_zone_sign(zone, &zone_keys, &policy, out_ch,
-	                        refresh_at);
+	if (index == NULL && threads > 1) {
+		result = knot_zone_sign_parallel(zone, zone_keys, &policy,
+		                                 out_ch, threads, refresh_at);
+	} else {
+		result = knot_zone_sign(zone, zone_keys, &policy, out_ch, index,
+		                        refresh_at);
+	}
 	if (result != KNOT_EOK) {
 		log_zone_error(zone_name, "DNSSEC, failed to sign the zone (%s)",
 		               knot_strerror(result));
-		knot_free_zone_keys(&zone_keys);
+		knot_free_zone_keys(&local_keys);
 		return result;
 	}
 	dbg_dnssec_verb("changeset emtpy after signing: %d\n",
@@ -114,9 +143,9 @@ static int zone_sign(zone_contents_t *zone, const conf_zone_t *zone_config,
 
 	// Check if only SOA changed
 	if (changeset_empty(out_ch) &&
-	    !knot_zone_sign_soa_expired(zone, &zone_keys, &policy)) {
+	    !knot_zone_sign_soa_expired(zone, zone_keys, &policy)) {
 		log_zone_info(zone_name, "DNSSEC, no signing performed, zone is valid");
-		knot_free_zone_keys(&zone_keys);
+		knot_free_zone_keys(&local_keys);
 		assert(changeset_empty(out_ch));
 		return KNOT_EOK;
 	}
@@ -125,16 +154,16 @@ static int zone_sign(zone_contents_t *zone, const conf_zone_t *zone_config,
 	knot_rrset_t soa = node_rrset(zone->apex, KNOT_RRTYPE_SOA);
 	knot_rrset_t rrsigs = node_rrset(zone->apex, KNOT_RRTYPE_RRSIG);
 	assert(!knot_rrset_empty(&soa));
-	result = knot_zone_sign_update_soa(&soa, &rrsigs, &zone_keys, &policy,
+	result = knot_zone_sign_update_soa(&soa, &rrsigs, zone_keys, &policy,
 	                                   new_serial, out_ch);
 	if (result != KNOT_EOK) {
 		log_zone_error(zone_name, "DNSSEC, not signing, failed to update "
 		               "SOA record (%s)", knot_strerror(result));
-		knot_free_zone_keys(&zone_keys);
+		knot_free_zone_keys(&local_keys);
 		return result;
 	}
 
-	knot_free_zone_keys(&zone_keys);
+	knot_free_zone_keys(&local_keys);
 	dbg_dnssec_detail("zone signed: changes=%zu\n",
 	                  changeset_size(out_ch));
 
@@ -151,7 +180,8 @@ int knot_dnssec_zone_sign(zone_contents_t *zone, const conf_zone_t *zone_config,
 		return KNOT_EINVAL;
 	}
 
-	return zone_sign(zone, zone_config, out_ch, false, soa_up, refresh_at);
+	return zone_sign(zone, zone_config, out_ch, false, soa_up, NULL, 1,
+	                 refresh_at);
 }
 
 int knot_dnssec_zone_sign_force(zone_contents_t *zone, const conf_zone_t *zone_config,
@@ -162,11 +192,270 @@ int knot_dnssec_zone_sign_force(zone_contents_t *zone, const conf_zone_t *zone_c
 	}
 
 	return zone_sign(zone, zone_config, out_ch, true, KNOT_SOA_SERIAL_UPDATE,
-	                 refresh_at);
+	                 NULL, 1, refresh_at);
+}
+
+int knot_dnssec_zone_sign_parallel(zone_contents_t *zone,
+                                   const conf_zone_t *zone_config,
+                                   changeset_t *out_ch, bool force,
+                                   unsigned threads, uint32_t *refresh_at)
+{
+	if (zone == NULL || zone_config == NULL || out_ch == NULL ||
+	    threads == 0) {
+		return KNOT_EINVAL;
+	}
+
+	return zone_sign(zone, zone_config, out_ch, force,
+	                 KNOT_SOA_SERIAL_UPDATE, NULL, threads, refresh_at);
+}
+
+int knot_dnssec_zone_publish_keys(zone_contents_t *zone,
+                                  const conf_zone_t *zone_config,
+                                  changeset_t *out_ch, uint32_t *refresh_at)
+{
+	if (zone == NULL || zone_config == NULL || out_ch == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	const knot_dname_t *zone_name = zone->apex->owner;
+
+	knot_zone_keys_t zone_keys;
+	knot_init_zone_keys(&zone_keys);
+	knot_dnssec_policy_t policy = { '\0' };
+	int result = init_dnssec_structs(zone, zone_config, &zone_keys, &policy,
+	                                 KNOT_SOA_SERIAL_UPDATE, false);
+	if (result != KNOT_EOK) {
+		return result;
+	}
+
+	result = knot_zone_sign_publish_dnskeys(zone, &zone_keys, out_ch);
+	if (result == KNOT_EOK && !changeset_empty(out_ch)) {
+		// online signed zone carries no signatures, not even for SOA
+		knot_zone_keys_t no_keys;
+		knot_init_zone_keys(&no_keys);
+		uint32_t new_serial = zone_contents_next_serial(zone,
+		                                zone_config->serial_policy);
+		knot_rrset_t soa = node_rrset(zone->apex, KNOT_RRTYPE_SOA);
+		result = knot_zone_sign_update_soa(&soa, NULL, &no_keys,
+		                                   &policy, new_serial, out_ch);
+	}
+
+	if (result != KNOT_EOK) {
+		log_zone_error(zone_name, "DNSSEC, failed to publish keys (%s)",
+		               knot_strerror(result));
+	} else if (refresh_at) {
+		*refresh_at = knot_get_next_zone_key_event(&zone_keys);
+	}
+
+	knot_free_zone_keys(&zone_keys);
+
+	return result;
+}
+
+knot_dnssec_state_t *knot_dnssec_state_new(void)
+{
+	knot_dnssec_state_t *state = malloc(sizeof(knot_dnssec_state_t));
+	if (state == NULL) {
+		return NULL;
+	}
+
+	memset(state, 0, sizeof(knot_dnssec_state_t));
+	knot_init_zone_keys(&state->zone_keys);
+	state->signed_tree = hattrie_create();
+	if (state->signed_tree == NULL) {
+		free(state);
+		return NULL;
+	}
+
+	if (knot_zone_sign_index_init(&state->index) != KNOT_EOK) {
+		hattrie_free(state->signed_tree);
+		free(state);
+		return NULL;
+	}
+
+	if (knot_sig_cache_init(&state->sig_cache) != KNOT_EOK) {
+		knot_zone_sign_index_deinit(&state->index);
+		hattrie_free(state->signed_tree);
+		free(state);
+		return NULL;
+	}
+
+	return state;
+}
+
+void knot_dnssec_state_reset(knot_dnssec_state_t *state)
+{
+	if (state == NULL || !state->loaded) {
+		return;
+	}
+
+	knot_free_zone_keys(&state->zone_keys);
+	knot_init_zone_keys(&state->zone_keys);
+	state->loaded = false;
+}
+
+void knot_dnssec_state_free(knot_dnssec_state_t **state)
+{
+	if (state == NULL || *state == NULL) {
+		return;
+	}
+
+	knot_dnssec_state_reset(*state);
+	knot_zone_sign_index_deinit(&(*state)->index);
+	knot_sig_cache_deinit(&(*state)->sig_cache);
+	hattrie_free((*state)->signed_tree);
+	free(*state);
+	*state = NULL;
+}
+
+/*! \brief Load zone keys into the signing state unless still valid. */
+static int state_load_keys(knot_dnssec_state_t *state,
+                           const zone_contents_t *zone,
+                           const conf_zone_t *config)
+{
+	bool nsec3_enabled = knot_is_nsec3_enabled(zone);
+	if (state->loaded && state->nsec3_enabled == nsec3_enabled &&
+	    time(NULL) < state->valid_until) {
+		return KNOT_EOK;
+	}
+
+	knot_dnssec_state_reset(state);
+
+	int result = knot_load_zone_keys(config->dnssec_keydir,
+	                                 zone->apex->owner,
+	                                 nsec3_enabled, &state->zone_keys);
+	if (result != KNOT_EOK) {
+		log_zone_error(zone->apex->owner, "DNSSEC, failed to load keys (%s)",
+		               knot_strerror(result));
+		knot_free_zone_keys(&state->zone_keys);
+		knot_init_zone_keys(&state->zone_keys);
+		return result;
+	}
+
+	state->zone_keys.sig_cache = &state->sig_cache;
+	state->loaded = true;
+	state->nsec3_enabled = nsec3_enabled;
+	state->valid_until = knot_get_next_zone_key_event(&state->zone_keys);
+
+	return KNOT_EOK;
+}
+
+/*! \brief Fingerprint of the key set, changes when keys are added or retired. */
+static uint32_t keys_fingerprint(const knot_zone_keys_t *keys)
+{
+	uint32_t fingerprint = 0;
+
+	node_t *node = NULL;
+	WALK_LIST(node, keys->list) {
+		const knot_zone_key_t *key = (knot_zone_key_t *)node;
+		uint32_t value = key->dnssec_key.keytag << 2 |
+		                 key->is_public << 1 | key->is_active;
+		fingerprint = fingerprint * 31 + value;
+	}
+
+	return fingerprint;
+}
+
+/*! \brief Serial of the zone after applying the changeset. */
+static uint32_t changeset_serial(const zone_contents_t *zone,
+                                 const changeset_t *ch)
+{
+	if (ch->soa_to != NULL) {
+		return knot_soa_serial(&ch->soa_to->rrs);
+	}
+
+	return zone_contents_serial(zone);
+}
+
+static int zone_sign_slice(zone_contents_t *zone, const conf_zone_t *zone_config,
+                           knot_dnssec_state_t *state, changeset_t *out_ch,
+                           uint32_t *refresh_at)
+{
+	const knot_dname_t *zone_name = zone->apex->owner;
+	uint32_t new_serial = zone_contents_next_serial(zone, zone_config->serial_policy);
+
+	knot_dnssec_policy_t policy = { '\0' };
+	init_dnssec_policy(zone_config, &policy, KNOT_SOA_SERIAL_UPDATE, false);
+
+	int result = knot_zone_sign_slice(zone, &state->zone_keys, &policy,
+	                                  &state->index, out_ch, refresh_at);
+	if (result != KNOT_EOK) {
+		log_zone_error(zone_name, "DNSSEC, failed to sign the zone (%s)",
+		               knot_strerror(result));
+		return result;
+	}
+
+	if (changeset_empty(out_ch)) {
+		return KNOT_EOK;
+	}
+
+	knot_rrset_t soa = node_rrset(zone->apex, KNOT_RRTYPE_SOA);
+	knot_rrset_t rrsigs = node_rrset(zone->apex, KNOT_RRTYPE_RRSIG);
+	assert(!knot_rrset_empty(&soa));
+	result = knot_zone_sign_update_soa(&soa, &rrsigs, &state->zone_keys,
+	                                   &policy, new_serial, out_ch);
+	if (result != KNOT_EOK) {
+		log_zone_error(zone_name, "DNSSEC, not signing, failed to update "
+		               "SOA record (%s)", knot_strerror(result));
+		return result;
+	}
+
+	log_zone_info(zone_name, "DNSSEC, re-signed %zu records",
+	              changeset_size(out_ch));
+
+	return KNOT_EOK;
+}
+
+int knot_dnssec_zone_sign_rolling(zone_contents_t *zone,
+                                  const conf_zone_t *zone_config,
+                                  knot_dnssec_state_t *state,
+                                  changeset_t *out_ch, uint32_t *refresh_at)
+{
+	if (zone == NULL || zone_config == NULL || out_ch == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (state == NULL) {
+		return zone_sign(zone, zone_config, out_ch, false,
+		                 KNOT_SOA_SERIAL_UPDATE, NULL, 1, refresh_at);
+	}
+
+	int result = state_load_keys(state, zone, zone_config);
+	if (result != KNOT_EOK) {
+		return result;
+	}
+
+	uint32_t fingerprint = keys_fingerprint(&state->zone_keys);
+	bool rebuild = !state->index_valid ||
+	               state->index_serial != zone_contents_serial(zone) ||
+	               state->index_keys != fingerprint ||
+	               time(NULL) >= state->index_until;
+
+	// Index is updated in place, it is rebuilt if the change is not applied
+	state->index_valid = false;
+
+	if (rebuild) {
+		result = zone_sign(zone, zone_config, out_ch, false,
+		                   KNOT_SOA_SERIAL_UPDATE, state, 1, refresh_at);
+		state->index_until = state->valid_until;
+		state->index_keys = fingerprint;
+	} else {
+		result = zone_sign_slice(zone, zone_config, state, out_ch,
+		                         refresh_at);
+	}
+	if (result != KNOT_EOK) {
+		return result;
+	}
+
+	state->index_valid = true;
+	state->index_serial = changeset_serial(zone, out_ch);
+
+	return KNOT_EOK;
 }
 
 int knot_dnssec_sign_changeset(const zone_contents_t *zone,
                                conf_zone_t *zone_config,
+                               knot_dnssec_state_t *state,
                                const changeset_t *in_ch,
                                changeset_t *out_ch,
                                uint32_t *refresh_at)
@@ -181,58 +470,67 @@ int knot_dnssec_sign_changeset(const zone_contents_t *zone,
 	knot_update_serial_t soa_up = KNOT_SOA_SERIAL_KEEP;
 	uint32_t new_serial = zone_contents_serial(zone);
 
-	// Init needed structures
-	knot_zone_keys_t zone_keys;
-	knot_init_zone_keys(&zone_keys);
+	// Init needed structures, reuse keys from the signing state
+	knot_zone_keys_t local_keys;
+	knot_init_zone_keys(&local_keys);
+	knot_zone_keys_t *zone_keys = &local_keys;
 	knot_dnssec_policy_t policy = { '\0' };
-	int ret = init_dnssec_structs(zone, zone_config, &zone_keys, &policy,
-	                              soa_up, false);
+	int ret = KNOT_EOK;
+	if (state != NULL) {
+		ret = state_load_keys(state, zone, zone_config);
+		if (ret == KNOT_EOK) {
+			zone_keys = &state->zone_keys;
+			init_dnssec_policy(zone_config, &policy, soa_up, false);
+		}
+	} else {
+		ret = init_dnssec_structs(zone, zone_config, zone_keys, &policy,
+		                          soa_up, false);
+	}
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
 
 	// Sign added and removed RRSets in changeset
-	ret = knot_zone_sign_changeset(zone, in_ch, out_ch,
-	                               &zone_keys, &policy);
+	ret = knot_zone_sign_changeset(zone, in_ch, out_ch, zone_keys, &policy,
+	                               state ? state->signed_tree : NULL);
 	if (ret != KNOT_EOK) {
 		log_zone_error(zone_name, "DNSSEC, failed to sign changeset (%s)",
 		               knot_strerror(ret));
-		knot_free_zone_keys(&zone_keys);
+		knot_free_zone_keys(&local_keys);
 		return ret;
 	}
 
-	// Create NSEC(3) chain
-	ret = knot_zone_create_nsec_chain(zone, out_ch, &zone_keys, &policy);
+	// Update NSEC(3) chain for the changed names, new records are signed
+	ret = knot_zone_fix_nsec_chain(zone, in_ch, out_ch, zone_keys, &policy);
 	if (ret != KNOT_EOK) {
 		log_zone_error(zone_name, "DNSSEC, failed to create NSEC(3) chain (%s)",
 		               knot_strerror(ret));
-		knot_free_zone_keys(&zone_keys);
-		return ret;
-	}
-
-	// Sign added NSEC(3)
-	ret = knot_zone_sign_nsecs_in_changeset(&zone_keys, &policy,
-	                                        out_ch);
-	if (ret != KNOT_EOK) {
-		log_zone_error(zone_name, "DNSSEC, failed to sign changeset (%s)",
-		               knot_strerror(ret));
-		knot_free_zone_keys(&zone_keys);
+		knot_free_zone_keys(&local_keys);
 		return ret;
 	}
 
 	// Update SOA RRSIGs
 	knot_rrset_t soa = node_rrset(zone->apex, KNOT_RRTYPE_SOA);
 	knot_rrset_t rrsigs = node_rrset(zone->apex, KNOT_RRTYPE_RRSIG);
-	ret = knot_zone_sign_update_soa(&soa, &rrsigs, &zone_keys, &policy,
+	ret = knot_zone_sign_update_soa(&soa, &rrsigs, zone_keys, &policy,
 	                                new_serial, out_ch);
 	if (ret != KNOT_EOK) {
 		log_zone_error(zone_name, "DNSSEC, failed to sign SOA record (%s)",
 		               knot_strerror(ret));
-		knot_free_zone_keys(&zone_keys);
+		knot_free_zone_keys(&local_keys);
 		return ret;
 	}
 
-	knot_free_zone_keys(&zone_keys);
+	knot_free_zone_keys(&local_keys);
+
+	// Keep the signature expiration index in sync with the zone
+	if (state != NULL && state->index_valid && in_ch->soa_from != NULL &&
+	    state->index_serial == knot_soa_serial(&in_ch->soa_from->rrs)) {
+		ret = knot_zone_sign_index_note_changeset(&state->index, out_ch,
+		                                          &policy);
+		state->index_valid = (ret == KNOT_EOK);
+		state->index_serial = changeset_serial(zone, out_ch);
+	}
 
 	*refresh_at = policy.refresh_before; // only new signatures are made
 
@@ -29,7 +29,55 @@
 
 #include "knot/zone/zone.h"
 #include "knot/updates/changesets.h"
+#include "knot/dnssec/zone-keys.h"
+#include "knot/dnssec/zone-sign.h"
 #include "libknot/dnssec/policy.h"
+
+/*!
+ * \brief Signing state of a zone, kept between incremental updates.
+ *
+ * Loaded keys with their signing contexts are reused until the next key
+ * event or until the state is reset (e.g. after a full zone resign).
+ * Verified signatures are remembered across resets, the cache entries are
+ * bound to the key material and expire with the signatures.
+ */
+struct knot_dnssec_state {
+	knot_zone_keys_t zone_keys; /*!< Loaded zone keys. */
+	bool loaded;                /*!< Zone keys are loaded. */
+	bool nsec3_enabled;         /*!< Keys were loaded for NSEC3 zone. */
+	uint32_t valid_until;       /*!< Next key event, reload keys then. */
+	hattrie_t *signed_tree;     /*!< Helper trie for changeset signing. */
+	knot_zone_sign_index_t index; /*!< Signature expiration index. */
+	bool index_valid;           /*!< Index covers the zone. */
+	uint32_t index_serial;      /*!< Zone serial the index is valid for. */
+	uint32_t index_until;       /*!< Next key event when index was built. */
+	uint32_t index_keys;        /*!< Fingerprint of keys the index was built with. */
+	knot_sig_cache_t sig_cache; /*!< Signatures verified with the loaded keys. */
+};
+
+typedef struct knot_dnssec_state knot_dnssec_state_t;
+
+/*!
+ * \brief Create empty zone signing state.
+ *
+ * \return New signing state, NULL on error.
+ */
+knot_dnssec_state_t *knot_dnssec_state_new(void);
+
+/*!
+ * \brief Drop loaded keys from the signing state, reload them on next use.
+ *
+ * \param state  Signing state.
+ */
+void knot_dnssec_state_reset(knot_dnssec_state_t *state);
+
+/*!
+ * \brief Free zone signing state.
+ *
+ * \param state  Signing state to be freed.
+ */
+void knot_dnssec_state_free(knot_dnssec_state_t **state);
+
 /*!
  * \brief DNSSEC resign zone, store new records into changeset. Valid signatures
  *        and NSEC(3) records will not be changed.
@@ -46,6 +94,23 @@ int knot_dnssec_zone_sign(zone_contents_t *zone, const conf_zone_t *zone_config,
                           changeset_t *out_ch,
                           knot_update_serial_t soa_up, uint32_t *refresh_at);
 
+/*!
+ * \brief Update DNSKEY records of a zone signed online.
+ *
+ * Only the DNSKEY records and the SOA serial are updated, the zone is
+ * not signed.
+ *
+ * \param zone         Zone contents.
+ * \param zone_config  Zone/DNSSEC configuration.
+ * \param out_ch       New records will be added to this changeset.
+ * \param refresh_at   Time of the next key event.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_dnssec_zone_publish_keys(zone_contents_t *zone,
+                                  const conf_zone_t *zone_config,
+                                  changeset_t *out_ch, uint32_t *refresh_at);
+
 /*!
  * \brief DNSSEC sign zone, store new records into changeset. Even valid
  *        signatures will be dropped.
@@ -61,11 +126,57 @@ int knot_dnssec_zone_sign_force(zone_contents_t *zone, const conf_zone_t *zone_c
                                 changeset_t *out_ch,
                                 uint32_t *refresh_at);
 
+/*!
+ * \brief DNSSEC sign zone using multiple signing threads.
+ *
+ * Intended for offline signing, the zone is not expected to be served
+ * while being signed.
+ *
+ * \note The server doesn't persist the signature cache, signatures created
+ *       offline are verified once more on the first signing after reload.
+ *
+ * \param zone         Zone contents to be signed.
+ * \param zone_config  Zone/DNSSEC configuration.
+ * \param out_ch       New records will be added to this changeset.
+ * \param force        Drop even valid signatures.
+ * \param threads      Number of signing threads.
+ * \param refresh_at   Signature refresh time of the oldest signature in zone.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_dnssec_zone_sign_parallel(zone_contents_t *zone,
+                                   const conf_zone_t *zone_config,
+                                   changeset_t *out_ch, bool force,
+                                   unsigned threads, uint32_t *refresh_at);
+
+/*!
+ * \brief DNSSEC resign next slice of the zone, store new records into
+ *        changeset.
+ *
+ * The whole zone is signed and the signature expiration index rebuilt if
+ * the index is not valid for the current zone contents or a key event
+ * occured. Otherwise only a slice of the zone is re-signed, see
+ * knot_zone_sign_slice().
+ *
+ * \param zone         Zone contents to be signed.
+ * \param zone_config  Zone/DNSSEC configuration.
+ * \param state        Zone signing state with the index (full signing if NULL).
+ * \param out_ch       New records will be added to this changeset.
+ * \param refresh_at   Time of the next re-signing run.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_dnssec_zone_sign_rolling(zone_contents_t *zone,
+                                  const conf_zone_t *zone_config,
+                                  knot_dnssec_state_t *state,
+                                  changeset_t *out_ch, uint32_t *refresh_at);
+
 /*!
  * \brief Sign changeset created by DDNS or zone-diff.
  *
  * \param zone            Zone contents to be signed.
  * \param zone_config     Zone/DNSSEC configuration.
+ * \param state           Signing state reused between updates (optional).
  * \param in_ch           Changeset created bvy DDNS or zone-diff
  * \param out_ch          New records will be added to this changeset.
  * \param refresh_at      Signature refresh time of the new signatures.
@@ -74,6 +185,7 @@ int knot_dnssec_zone_sign_force(zone_contents_t *zone, const conf_zone_t *zone_c
  */
 int knot_dnssec_sign_changeset(const zone_contents_t *zone,
                                conf_zone_t *zone_config,
+                               knot_dnssec_state_t *state,
                                const changeset_t *in_ch,
                                changeset_t *out_ch,
                                uint32_t *refresh_at);
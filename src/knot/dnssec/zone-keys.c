@@ -16,12 +16,15 @@
 
 #include <assert.h>
 #include <dirent.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <inttypes.h>
+#include <sys/stat.h>
 
 #include "knot/common/debug.h"
 #include "libknot/internal/mem.h"
 #include "libknot/internal/macros.h"
+#include "libknot/internal/trie/hat-trie.h"
 #include "libknot/errcode.h"
 #include "libknot/dname.h"
 #include "libknot/consts.h"
@@ -29,6 +32,253 @@
 #include "libknot/dnssec/sign.h"
 #include "knot/dnssec/zone-keys.h"
 
+/*- process-wide key cache ---------------------------------------------------*/
+
+/*!
+ * \brief Key loaded from a key file, shared by all zones using the file.
+ *
+ * The entry is replaced once the key file changes. The replaced entry is
+ * freed when the last zone key referencing it is released.
+ */
+typedef struct key_cache_entry {
+	time_t mtime;                 //!< Key file modification time.
+	off_t size;                   //!< Key file size.
+	ino_t ino;                    //!< Key file inode.
+	unsigned refs;                //!< Number of zone keys using the entry.
+	bool stale;                   //!< Removed from the cache.
+	bool built;                   //!< DNSSEC key was created.
+	knot_key_params_t params;     //!< Parsed key file.
+	knot_dnssec_key_t dnssec_key; //!< DNSSEC key created from parameters.
+	knot_dnssec_sign_context_t **idle; //!< Idle signing contexts.
+	size_t idle_count;            //!< Number of idle signing contexts.
+	size_t idle_max;              //!< Capacity of idle contexts array.
+} key_cache_entry_t;
+
+/*! \brief Key file path -> key_cache_entry_t. */
+static hattrie_t *key_cache = NULL;
+static pthread_mutex_t key_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void key_cache_entry_free(key_cache_entry_t *entry)
+{
+	for (size_t i = 0; i < entry->idle_count; i++) {
+		knot_dnssec_sign_free(entry->idle[i]);
+	}
+	free(entry->idle);
+
+	if (entry->built) {
+		knot_dnssec_key_free(&entry->dnssec_key);
+	}
+	knot_free_key_params(&entry->params);
+	free(entry);
+}
+
+/*!
+ * \brief Drop reference to a cache entry. Call with the cache lock held.
+ */
+static void key_cache_release(key_cache_entry_t *entry)
+{
+	assert(entry->refs > 0);
+	entry->refs -= 1;
+
+	if (entry->stale && entry->refs == 0) {
+		key_cache_entry_free(entry);
+	}
+}
+
+/*!
+ * \brief Get referenced cache entry for a key file, parse the file if needed.
+ */
+static int key_cache_get(const char *path, key_cache_entry_t **result)
+{
+	struct stat st;
+	if (stat(path, &st) != 0) {
+		return knot_map_errno(EACCES, ENOENT);
+	}
+
+	pthread_mutex_lock(&key_cache_lock);
+
+	if (key_cache == NULL) {
+		key_cache = hattrie_create();
+		if (key_cache == NULL) {
+			pthread_mutex_unlock(&key_cache_lock);
+			return KNOT_ENOMEM;
+		}
+	}
+
+	size_t path_len = strlen(path);
+	value_t *val = hattrie_get(key_cache, path, path_len);
+	if (val == NULL) {
+		pthread_mutex_unlock(&key_cache_lock);
+		return KNOT_ENOMEM;
+	}
+
+	key_cache_entry_t *entry = *val;
+	if (entry != NULL) {
+		if (entry->mtime == st.st_mtime && entry->size == st.st_size &&
+		    entry->ino == st.st_ino) {
+			entry->refs += 1;
+			*result = entry;
+			pthread_mutex_unlock(&key_cache_lock);
+			return KNOT_EOK;
+		}
+
+		// key file changed, drop the old version
+		*val = NULL;
+		entry->stale = true;
+		if (entry->refs == 0) {
+			key_cache_entry_free(entry);
+		}
+	}
+
+	entry = malloc(sizeof(*entry));
+	if (entry == NULL) {
+		hattrie_del(key_cache, path, path_len);
+		pthread_mutex_unlock(&key_cache_lock);
+		return KNOT_ENOMEM;
+	}
+	memset(entry, 0, sizeof(*entry));
+
+	int ret = knot_load_key_params(path, &entry->params);
+	if (ret != KNOT_EOK) {
+		hattrie_del(key_cache, path, path_len);
+		pthread_mutex_unlock(&key_cache_lock);
+		key_cache_entry_free(entry);
+		return ret;
+	}
+
+	entry->mtime = st.st_mtime;
+	entry->size = st.st_size;
+	entry->ino = st.st_ino;
+	entry->refs = 1;
+	*val = entry;
+	*result = entry;
+
+	pthread_mutex_unlock(&key_cache_lock);
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Create DNSSEC key for a cache entry, if not created yet.
+ */
+static int key_cache_build(key_cache_entry_t *entry)
+{
+	int ret = KNOT_EOK;
+
+	pthread_mutex_lock(&key_cache_lock);
+	if (!entry->built) {
+		ret = knot_dnssec_key_from_params(&entry->params,
+		                                  &entry->dnssec_key);
+		entry->built = (ret == KNOT_EOK);
+	}
+	pthread_mutex_unlock(&key_cache_lock);
+
+	return ret;
+}
+
+static void key_cache_put(key_cache_entry_t *entry)
+{
+	pthread_mutex_lock(&key_cache_lock);
+	key_cache_release(entry);
+	pthread_mutex_unlock(&key_cache_lock);
+}
+
+void knot_zone_keys_cache_clear(void)
+{
+	pthread_mutex_lock(&key_cache_lock);
+
+	if (key_cache == NULL) {
+		pthread_mutex_unlock(&key_cache_lock);
+		return;
+	}
+
+	hattrie_t *kept = hattrie_create();
+	hattrie_iter_t *it = hattrie_iter_begin(key_cache, false);
+	for (; it && !hattrie_iter_finished(it); hattrie_iter_next(it)) {
+		key_cache_entry_t *entry = *hattrie_iter_val(it);
+		if (entry == NULL) {
+			continue;
+		}
+
+		size_t len = 0;
+		const char *path = hattrie_iter_key(it, &len);
+		value_t *val = kept ? hattrie_get(kept, path, len) : NULL;
+		if (entry->refs > 0 && val != NULL) {
+			*val = entry;
+		} else if (entry->refs > 0) {
+			entry->stale = true;
+		} else {
+			key_cache_entry_free(entry);
+		}
+	}
+	hattrie_iter_free(it);
+
+	hattrie_free(key_cache);
+	key_cache = kept;
+
+	pthread_mutex_unlock(&key_cache_lock);
+}
+
+knot_dnssec_sign_context_t *knot_zone_key_context_get(const knot_zone_key_t *key)
+{
+	if (!key) {
+		return NULL;
+	}
+
+	key_cache_entry_t *entry = key->cached;
+	if (entry == NULL) {
+		return knot_dnssec_sign_init(&key->dnssec_key);
+	}
+
+	knot_dnssec_sign_context_t *context = NULL;
+
+	pthread_mutex_lock(&key_cache_lock);
+	if (entry->idle_count > 0) {
+		entry->idle_count -= 1;
+		context = entry->idle[entry->idle_count];
+	}
+	pthread_mutex_unlock(&key_cache_lock);
+
+	if (context == NULL) {
+		context = knot_dnssec_sign_init(&entry->dnssec_key);
+	}
+
+	return context;
+}
+
+void knot_zone_key_context_put(const knot_zone_key_t *key,
+                               knot_dnssec_sign_context_t *context)
+{
+	if (!key || !context) {
+		return;
+	}
+
+	key_cache_entry_t *entry = key->cached;
+	if (entry == NULL) {
+		knot_dnssec_sign_free(context);
+		return;
+	}
+
+	pthread_mutex_lock(&key_cache_lock);
+	if (entry->idle_count == entry->idle_max) {
+		size_t new_max = entry->idle_max > 0 ? 2 * entry->idle_max : 4;
+		void *idle = realloc(entry->idle, new_max * sizeof(*entry->idle));
+		if (idle != NULL) {
+			entry->idle = idle;
+			entry->idle_max = new_max;
+		}
+	}
+	if (entry->idle_count < entry->idle_max) {
+		entry->idle[entry->idle_count++] = context;
+		context = NULL;
+	}
+	pthread_mutex_unlock(&key_cache_lock);
+
+	knot_dnssec_sign_free(context);
+}
+
+/*- zone keys ----------------------------------------------------------------*/
+
 /*!
  * \brief Initialize DNSSEC signing context for each key.
  */
@@ -39,7 +289,7 @@ static int init_sign_contexts(knot_zone_keys_t *keys)
 	node_t *node = NULL;
 	WALK_LIST(node, keys->list) {
 		knot_zone_key_t *key = (knot_zone_key_t *)node;
-		key->context = knot_dnssec_sign_init(&key->dnssec_key);
+		key->context = knot_zone_key_context_get(key);
 		if (key->context == NULL) {
 			return KNOT_ENOMEM;
 		}
@@ -246,75 +496,79 @@ int knot_load_zone_keys(const char *keydir_name, const knot_dname_t *zone_name,
 		UNUSED(written);
 		assert(written == path_len);
 
-		knot_key_params_t params = { 0 };
-		int ret = knot_load_key_params(path, &params);
+		key_cache_entry_t *cached = NULL;
+		int ret = key_cache_get(path, &cached);
 		free(path);
 
 		if (ret != KNOT_EOK) {
 			log_zone_warning(zone_name, "DNSSEC, failed to load "
 			                 "key, file '%s' (%s)",
 			                 entry->d_name, knot_strerror(ret));
-			knot_free_key_params(&params);
 			continue;
 		}
 
-		if (!knot_dname_is_equal(zone_name, params.name)) {
-			knot_free_key_params(&params);
+		const knot_key_params_t *params = &cached->params;
+
+		if (!knot_dname_is_equal(zone_name, params->name)) {
+			key_cache_put(cached);
 			continue;
 		}
 
-		if (knot_get_key_type(&params) != KNOT_KEY_DNSSEC) {
-			knot_free_key_params(&params);
+		if (knot_get_key_type(params) != KNOT_KEY_DNSSEC) {
+			key_cache_put(cached);
 			continue;
 		}
 
 		knot_zone_key_t *key = malloc(sizeof(*key));
 		if (!key) {
+			key_cache_put(cached);
 			result = KNOT_ENOMEM;
 			break;
 		}
 		memset(key, '\0', sizeof(*key));
-		set_zone_key_flags(&params, key);
+		set_zone_key_flags(params, key);
 
-		if (!knot_dnssec_algorithm_is_zonesign(params.algorithm,
+		if (!knot_dnssec_algorithm_is_zonesign(params->algorithm,
 		                                       nsec3_enabled)
 		) {
 			log_zone_notice(zone_name, "DNSSEC, ignoring key %5d, "
 			                "file '%s' (incompatible algorithm)",
-			                params.keytag, entry->d_name);
-			knot_free_key_params(&params);
+			                params->keytag, entry->d_name);
+			key_cache_put(cached);
 			free(key);
 			continue;
 		}
 
-		if (knot_get_zone_key(keys, params.keytag) != NULL) {
+		if (knot_get_zone_key(keys, params->keytag) != NULL) {
 			log_zone_notice(zone_name, "DNSSEC, ignoring key %5d, "
 					"file '%s' (duplicate keytag)",
-					params.keytag, entry->d_name);
-			knot_free_key_params(&params);
+					params->keytag, entry->d_name);
+			key_cache_put(cached);
 			free(key);
 			continue;
 		}
 
-		ret = knot_dnssec_key_from_params(&params, &key->dnssec_key);
+		ret = key_cache_build(cached);
 		if (ret != KNOT_EOK) {
 			log_zone_error(zone_name, "DNSSEC, failed to process "
 				       "key %5d, file '%s' (%s)",
-				       params.keytag, entry->d_name,
+				       params->keytag, entry->d_name,
 			               knot_strerror(ret));
-			knot_free_key_params(&params);
+			key_cache_put(cached);
 			free(key);
 			continue;
 		}
 
+		// the DNSSEC key is owned by the cache entry
+		key->cached = cached;
+		key->dnssec_key = cached->dnssec_key;
+
 		log_zone_info(zone_name, "DNSSEC, loaded key %5d, file '%s', %s, %s, %s",
-		              params.keytag, entry->d_name,
+		              params->keytag, entry->d_name,
 		              key->is_ksk ? "KSK" : "ZSK",
 		              key->is_active ? "active" : "inactive",
 		              key->is_public ? "public" : "not-public");
 
-		knot_free_key_params(&params);
-
 		add_tail(&keys->list, &key->node);
 	}
 
@@ -358,8 +612,12 @@ void knot_free_zone_keys(knot_zone_keys_t *keys)
 	node_t *next = NULL;
 	WALK_LIST_DELSAFE(node, next, keys->list) {
 		knot_zone_key_t *key = (knot_zone_key_t *)node;
-		knot_dnssec_sign_free(key->context);
-		knot_dnssec_key_free(&key->dnssec_key);
+		knot_zone_key_context_put(key, key->context);
+		if (key->cached) {
+			key_cache_put(key->cached);
+		} else {
+			knot_dnssec_key_free(&key->dnssec_key);
+		}
 		free(key);
 	}
 
@@ -33,12 +33,16 @@
 #include "libknot/internal/lists.h"
 #include "libknot/dname.h"
 #include "libknot/dnssec/sign.h"
+#include "knot/dnssec/sig-cache.h"
+
+struct key_cache_entry;
 
 typedef struct {
 	node_t node;
 
 	knot_dnssec_key_t dnssec_key;
 	knot_dnssec_sign_context_t *context;
+	struct key_cache_entry *cached;      //!< Key cache entry owning the key.
 	uint32_t next_event;                 //!< Timestamp of next key event.
 	bool is_ksk;                         //!< Is key-signing.
 	bool is_zsk;                         //!< Is zone-signing.
@@ -51,6 +55,7 @@ typedef struct {
  */
 typedef struct {
 	list_t list;
+	knot_sig_cache_t *sig_cache; //!< Cache of verified signatures (optional).
 } knot_zone_keys_t;
 
 /*!
@@ -89,6 +94,35 @@ const knot_zone_key_t *knot_get_zone_key(const knot_zone_keys_t *keys,
  */
 void knot_free_zone_keys(knot_zone_keys_t *keys);
 
+/*!
+ * \brief Get signing context for a zone key.
+ *
+ * Contexts of keys loaded by knot_load_zone_keys() are taken from a pool
+ * shared by all zones using the same key file.
+ *
+ * \param key  Zone key.
+ *
+ * \return Signing context, NULL on error. Return with knot_zone_key_context_put().
+ */
+knot_dnssec_sign_context_t *knot_zone_key_context_get(const knot_zone_key_t *key);
+
+/*!
+ * \brief Return signing context obtained by knot_zone_key_context_get().
+ *
+ * \param key      Zone key.
+ * \param context  Signing context.
+ */
+void knot_zone_key_context_put(const knot_zone_key_t *key,
+                               knot_dnssec_sign_context_t *context);
+
+/*!
+ * \brief Drop cached keys not used by any zone.
+ *
+ * Keys are cached process-wide by key file path, a cached key is reused
+ * until the modification time, size or inode of the key file changes.
+ */
+void knot_zone_keys_cache_clear(void);
+
 /*!
  * \brief Get timestamp of next key event.
  *
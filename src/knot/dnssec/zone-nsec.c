@@ -294,3 +294,43 @@ int knot_zone_create_nsec_chain(const zone_contents_t *zone,
 	// Sign newly created records right away
 	return knot_zone_sign_nsecs_in_changeset(zone_keys, policy, changeset);
 }
+
+/*!
+ * \brief Update NSEC or NSEC3 chain for names touched by the changeset.
+ */
+int knot_zone_fix_nsec_chain(const zone_contents_t *zone,
+                             const changeset_t *in_ch,
+                             changeset_t *changeset,
+                             const knot_zone_keys_t *zone_keys,
+                             const knot_dnssec_policy_t *policy)
+{
+	if (!zone || !in_ch || !changeset) {
+		return KNOT_EINVAL;
+	}
+
+	uint32_t nsec_ttl = 0;
+	if (!get_zone_soa_min_ttl(zone, &nsec_ttl)) {
+		return KNOT_EINVAL;
+	}
+
+	int result;
+	if (knot_is_nsec3_enabled(zone)) {
+		result = knot_nsec3_fix_chain(zone, in_ch, nsec_ttl, changeset);
+	} else {
+		result = knot_nsec_fix_chain(zone, in_ch, nsec_ttl, changeset);
+		if (result == KNOT_EOK) {
+			result = delete_nsec3_chain(zone, changeset);
+		}
+	}
+
+	if (result == KNOT_EOK) {
+		result = mark_removed_nsec3(changeset, zone);
+	}
+
+	if (result != KNOT_EOK) {
+		return result;
+	}
+
+	// Sign newly created records right away
+	return knot_zone_sign_nsecs_in_changeset(zone_keys, policy, changeset);
+}
@@ -84,4 +84,24 @@ int knot_zone_create_nsec_chain(const zone_contents_t *zone,
                                 const knot_zone_keys_t *zone_keys,
                                 const knot_dnssec_policy_t *policy);
 
+/*!
+ * \brief Update NSEC or NSEC3 chain for names touched by the changeset.
+ *
+ * Only records of the changed names (with NSEC3 also their ancestors) and
+ * their predecessors in the chain are updated.
+ *
+ * \param zone       Zone with the changeset applied.
+ * \param in_ch      Changeset applied to the zone.
+ * \param changeset  Changeset into which the changes will be added.
+ * \param zone_keys  Zone keys used for NSEC(3) creation.
+ * \param policy     DNSSEC signing policy.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_zone_fix_nsec_chain(const zone_contents_t *zone,
+                             const changeset_t *in_ch,
+                             changeset_t *changeset,
+                             const knot_zone_keys_t *zone_keys,
+                             const knot_dnssec_policy_t *policy);
+
 /*! @} */
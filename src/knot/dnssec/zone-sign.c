@@ -15,8 +15,11 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <time.h>
 
@@ -34,6 +37,7 @@
 #include "libknot/rrtype/rdname.h"
 #include "libknot/rrtype/rrsig.h"
 #include "libknot/rrtype/soa.h"
+#include "knot/dnssec/sig-cache.h"
 #include "knot/dnssec/zone-keys.h"
 #include "knot/dnssec/zone-sign.h"
 #include "knot/updates/changesets.h"
@@ -58,11 +62,12 @@ static knot_rrset_t create_empty_rrsigs_for(const knot_rrset_t *covered)
 /*!
  * \brief Check if there is a valid signature for a given RR set and key.
  *
- * \param covered  RR set with covered records.
- * \param rrsigs   RR set with RRSIGs.
- * \param key      Signing key.
- * \param ctx      Signing context.
- * \param policy   DNSSEC policy.
+ * \param covered    RR set with covered records.
+ * \param rrsigs     RR set with RRSIGs.
+ * \param key        Signing key.
+ * \param ctx        Signing context.
+ * \param sig_cache  Cache of verified signatures (optional).
+ * \param policy     DNSSEC policy.
  *
  * \return The signature exists and is valid.
  */
@@ -70,6 +75,7 @@ static bool valid_signature_exists(const knot_rrset_t *covered,
 				   const knot_rrset_t *rrsigs,
 				   const knot_dnssec_key_t *key,
 				   knot_dnssec_sign_context_t *ctx,
+				   knot_sig_cache_t *sig_cache,
 				   const knot_dnssec_policy_t *policy)
 {
 	assert(key);
@@ -86,8 +92,8 @@ static bool valid_signature_exists(const knot_rrset_t *covered,
 			continue;
 		}
 
-		return knot_is_valid_signature(covered, rrsigs, i, key, ctx,
-		                               policy) == KNOT_EOK;
+		return knot_sig_cache_verify(sig_cache, covered, rrsigs, i, key,
+		                             ctx, policy) == KNOT_EOK;
 	}
 
 	return false;
@@ -142,7 +148,8 @@ static bool all_signatures_exist(const knot_rrset_t *covered,
 		}
 
 		if (!valid_signature_exists(covered, rrsigs, &key->dnssec_key,
-		                            key->context, policy)) {
+		                            key->context, zone_keys->sig_cache,
+		                            policy)) {
 			return false;
 		}
 	}
@@ -238,9 +245,10 @@ static int remove_expired_rrsigs(const knot_rrset_t *covered,
 		key = get_matching_zone_key(&synth_rrsig, i, zone_keys);
 
 		if (key && key->is_active && key->context) {
-			result = knot_is_valid_signature(covered, &synth_rrsig, i,
-			                                 &key->dnssec_key,
-			                                 key->context, policy);
+			result = knot_sig_cache_verify(zone_keys->sig_cache,
+			                               covered, &synth_rrsig, i,
+			                               &key->dnssec_key,
+			                               key->context, policy);
 			if (result == KNOT_EOK) {
 				// valid signature
 				note_earliest_expiration(&synth_rrsig, i, expires_at);
@@ -276,56 +284,73 @@ static int remove_expired_rrsigs(const knot_rrset_t *covered,
 /*!
  * \brief Add missing RRSIGs into the changeset for adding.
  *
- * \param covered    RR set with covered records.
- * \param rrsigs     RR set with RRSIGs.
+ * RR sets missing a signature by the same key are signed in one batch.
+ *
+ * \param covered    RR sets with covered records.
+ * \param count      Number of covered RR sets.
+ * \param rrsigs     RR set with RRSIGs (of the same owner as covered RR sets).
  * \param zone_keys  Zone keys.
  * \param policy     DNSSEC policy.
  * \param changeset  Changeset to be updated.
  *
  * \return Error code, KNOT_EOK if successful.
  */
-static int add_missing_rrsigs(const knot_rrset_t *covered,
+static int add_missing_rrsigs(const knot_rrset_t *covered, size_t count,
                               const knot_rrset_t *rrsigs,
                               const knot_zone_keys_t *zone_keys,
                               const knot_dnssec_policy_t *policy,
                               changeset_t *changeset)
 {
-	assert(!knot_rrset_empty(covered));
+	assert(covered);
 	assert(zone_keys);
 	assert(changeset);
 
+	knot_rrset_t *batch = malloc(count * sizeof(knot_rrset_t));
+	knot_rrset_t *to_add = malloc(count * sizeof(knot_rrset_t));
+	if (batch == NULL || to_add == NULL) {
+		free(batch);
+		free(to_add);
+		return KNOT_ENOMEM;
+	}
+
 	int result = KNOT_EOK;
-	knot_rrset_t to_add;
-	knot_rrset_init_empty(&to_add);
 
 	node_t *node = NULL;
 	WALK_LIST(node, zone_keys->list) {
 		const knot_zone_key_t *key = (knot_zone_key_t *)node;
-		if (!use_key(key, covered)) {
-			continue;
-		}
 
-		if (valid_signature_exists(covered, rrsigs, &key->dnssec_key,
-		                           key->context, policy)) {
-			continue;
+		size_t batch_size = 0;
+		for (size_t i = 0; i < count; i++) {
+			assert(!knot_rrset_empty(&covered[i]));
+			if (!use_key(key, &covered[i]) ||
+			    valid_signature_exists(&covered[i], rrsigs,
+			                           &key->dnssec_key, key->context,
+			                           zone_keys->sig_cache, policy)) {
+				continue;
+			}
+
+			batch[batch_size] = covered[i];
+			to_add[batch_size] = create_empty_rrsigs_for(&covered[i]);
+			batch_size += 1;
 		}
 
-		if (knot_rrset_empty(&to_add)) {
-			to_add = create_empty_rrsigs_for(covered);
+		result = knot_sign_rrsets(to_add, batch, batch_size,
+		                          &key->dnssec_key, key->context, policy);
+
+		for (size_t i = 0; i < batch_size; i++) {
+			if (result == KNOT_EOK) {
+				result = changeset_add_rrset(changeset, &to_add[i]);
+			}
+			knot_rdataset_clear(&to_add[i].rrs, NULL);
 		}
 
-		result = knot_sign_rrset(&to_add, covered, &key->dnssec_key,
-		                         key->context, policy);
 		if (result != KNOT_EOK) {
 			break;
 		}
 	}
 
-	if (!knot_rrset_empty(&to_add) && result == KNOT_EOK) {
-		result = changeset_add_rrset(changeset, &to_add);
-	}
-
-	knot_rdataset_clear(&to_add.rrs, NULL);
+	free(batch);
+	free(to_add);
 
 	return result;
 }
@@ -387,43 +412,7 @@ static int force_resign_rrset(const knot_rrset_t *covered,
 		}
 	}
 
-	return add_missing_rrsigs(covered, NULL, zone_keys, policy, changeset);
-}
-
-/*!
- * \brief Drop all expired and create new RRSIGs for covered records.
- *
- * \param covered     RR set with covered records.
- * \param zone_keys   Zone keys.
- * \param policy      DNSSEC policy.
- * \param changeset   Changeset to be updated.
- * \param expires_at  Current earliest expiration, will be updated.
- *
- * \return Error code, KNOT_EOK if successful.
- */
-static int resign_rrset(const knot_rrset_t *covered,
-                        const knot_rrset_t *rrsigs,
-                        const knot_zone_keys_t *zone_keys,
-                        const knot_dnssec_policy_t *policy,
-                        changeset_t *changeset,
-                        uint32_t *expires_at)
-{
-	assert(!knot_rrset_empty(covered));
-
-	// TODO this function creates some signatures twice (for checking)
-	// maybe merge the two functions into one
-	// jvcelak: Not really, maybe for RSA. The digest is computed twice,
-	// but the verification process can differ from signature computation.
-	// TODO reuse digest for RSA then, RSA is the most used algo family,
-	// and we create all the signatures twice, that is not cool I think.
-
-	int result = remove_expired_rrsigs(covered, rrsigs, zone_keys,
-	                                   policy, changeset, expires_at);
-	if (result != KNOT_EOK) {
-		return result;
-	}
-
-	return add_missing_rrsigs(covered, rrsigs, zone_keys, policy,
+	return add_missing_rrsigs(covered, 1, NULL, zone_keys, policy,
 	                          changeset);
 }
 
@@ -478,9 +467,17 @@ static int sign_node_rrsets(const zone_node_t *node,
 	assert(node);
 	assert(policy);
 
-	int result = KNOT_EOK;
 	knot_rrset_t rrsigs = node_rrset(node, KNOT_RRTYPE_RRSIG);
 
+	knot_rrset_t *covered = malloc(node->rrset_count * sizeof(knot_rrset_t));
+	if (covered == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	// drop stale signatures, collect RR sets to be signed in one batch
+
+	int result = KNOT_EOK;
+	size_t count = 0;
 	for (int i = 0; i < node->rrset_count; i++) {
 		knot_rrset_t rrset = node_rrset_at(node, i);
 		if (rrset.type == KNOT_RRTYPE_RRSIG) {
@@ -490,28 +487,207 @@ static int sign_node_rrsets(const zone_node_t *node,
 		result = knot_zone_sign_rr_should_be_signed(node, &rrset,
 		                                            &should_sign);
 		if (result != KNOT_EOK) {
-			return result;
+			break;
 		}
 		if (!should_sign) {
 			continue;
 		}
 
 		if (policy->forced_sign) {
-			result = force_resign_rrset(&rrset, &rrsigs, zone_keys, policy,
-			         changeset);
+			if (!knot_rrset_empty(&rrsigs)) {
+				result = remove_rrset_rrsigs(rrset.owner, rrset.type,
+				                             &rrsigs, changeset);
+			}
 		} else {
-			result = resign_rrset(&rrset, &rrsigs, zone_keys, policy,
-			                      changeset, expires_at);
+			result = remove_expired_rrsigs(&rrset, &rrsigs, zone_keys,
+			                               policy, changeset, expires_at);
 		}
-
 		if (result != KNOT_EOK) {
-			return result;
+			break;
 		}
+
+		covered[count++] = rrset;
+	}
+
+	if (result == KNOT_EOK && count > 0) {
+		result = add_missing_rrsigs(covered, count,
+		                            policy->forced_sign ? NULL : &rrsigs,
+		                            zone_keys, policy, changeset);
+	}
+
+	free(covered);
+
+	if (result != KNOT_EOK) {
+		return result;
 	}
 
 	return remove_standalone_rrsigs(node, &rrsigs, changeset);
 }
 
+/*- private API - signature expiration index --------------------------------*/
+
+/*!
+ * \brief Signature expiration of a single node.
+ */
+typedef struct {
+	uint32_t expires_at;  //!< Earliest signature expiration.
+	bool nsec3;           //!< Node is in the NSEC3 tree.
+	int pos;              //!< Position in the heap.
+	knot_dname_t *owner;  //!< Node owner.
+} index_entry_t;
+
+static int index_entry_cmp(void *a, void *b)
+{
+	const index_entry_t *e1 = a;
+	const index_entry_t *e2 = b;
+
+	if (e1->expires_at == e2->expires_at) {
+		return 0;
+	}
+
+	return e1->expires_at < e2->expires_at ? -1 : 1;
+}
+
+/*! \brief Keep position of the entry, so that it can be replaced. */
+static void index_entry_moved(void *e, int pos)
+{
+	index_entry_t *entry = e;
+	entry->pos = pos;
+}
+
+/*!
+ * \brief Write lookup key of the node, NSEC3 nodes are kept apart.
+ *
+ * \return Key length.
+ */
+static size_t index_key(uint8_t *key, const knot_dname_t *owner, bool nsec3)
+{
+	knot_dname_lf(key, owner, NULL);
+	size_t len = key[0];
+	key[0] = nsec3 ? 1 : 0;
+	return len + 1;
+}
+
+static void index_entry_free(index_entry_t *entry)
+{
+	knot_dname_free(&entry->owner, NULL);
+	free(entry);
+}
+
+/*!
+ * \brief Remove entry taken out of the heap from the index, free it.
+ */
+static void index_entry_forget(knot_zone_sign_index_t *index,
+                               index_entry_t *entry)
+{
+	uint8_t key[KNOT_DNAME_MAXLEN];
+	size_t key_len = index_key(key, entry->owner, entry->nsec3);
+	hattrie_del(index->names, (char *)key, key_len);
+	index_entry_free(entry);
+}
+
+/*!
+ * \brief Insert node signature expiration into the index or update
+ *        the existing entry of the node.
+ */
+static int index_note(knot_zone_sign_index_t *index, const knot_dname_t *owner,
+                      bool nsec3, uint32_t expires_at)
+{
+	assert(index);
+	assert(owner);
+
+	uint8_t key[KNOT_DNAME_MAXLEN];
+	size_t key_len = index_key(key, owner, nsec3);
+	value_t *val = hattrie_get(index->names, (char *)key, key_len);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	index_entry_t *entry = *val;
+	if (entry != NULL) {
+		entry->expires_at = expires_at;
+		heap_replace(&index->heap, entry->pos, entry);
+		return KNOT_EOK;
+	}
+
+	entry = malloc(sizeof(index_entry_t));
+	if (entry == NULL) {
+		hattrie_del(index->names, (char *)key, key_len);
+		return KNOT_ENOMEM;
+	}
+
+	entry->expires_at = expires_at;
+	entry->nsec3 = nsec3;
+	entry->owner = knot_dname_copy(owner, NULL);
+	if (entry->owner == NULL) {
+		free(entry);
+		hattrie_del(index->names, (char *)key, key_len);
+		return KNOT_ENOMEM;
+	}
+
+	if (!heap_insert(&index->heap, entry)) {
+		index_entry_forget(index, entry);
+		return KNOT_ENOMEM;
+	}
+	*val = entry;
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Note owners of all RRSIGs in a changeset tree.
+ */
+static int index_note_tree(knot_zone_sign_index_t *index, zone_tree_t *tree,
+                           bool nsec3, uint32_t expires_at)
+{
+	if (zone_tree_is_empty(tree)) {
+		return KNOT_EOK;
+	}
+
+	hattrie_iter_t *itt = hattrie_iter_begin(tree, false);
+	if (itt == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int result = KNOT_EOK;
+	for (; !hattrie_iter_finished(itt); hattrie_iter_next(itt)) {
+		const zone_node_t *node = *hattrie_iter_val(itt);
+		if (!node_rrtype_exists(node, KNOT_RRTYPE_RRSIG)) {
+			continue;
+		}
+
+		result = index_note(index, node->owner, nsec3, expires_at);
+		if (result != KNOT_EOK) {
+			break;
+		}
+	}
+
+	hattrie_iter_free(itt);
+
+	return result;
+}
+
+/*!
+ * \brief Get time of the next rolling re-sign run.
+ */
+static uint32_t index_refresh_time(const knot_zone_sign_index_t *index,
+                                   const knot_zone_keys_t *zone_keys,
+                                   const knot_dnssec_policy_t *policy)
+{
+	uint32_t safety = policy->sign_lifetime / 10;
+	uint32_t period = (policy->sign_lifetime - safety) / KNOT_DNSSEC_ROLL_SLICES;
+	uint32_t refresh_at = policy->now + MAX(period, 1);
+
+	if (!EMPTY_HEAP(&index->heap)) {
+		const index_entry_t *first = *HHEAD(&index->heap);
+		uint32_t due = knot_dnssec_policy_refresh_time(policy,
+		                                               first->expires_at);
+		refresh_at = MIN(refresh_at, MAX(due, policy->now));
+	}
+
+	return MIN(refresh_at, knot_get_next_zone_key_event(zone_keys));
+}
+
 /*!
  * \brief Struct to carry data for 'sign_data' callback function.
  */
@@ -520,6 +696,8 @@ typedef struct node_sign_args {
 	const knot_dnssec_policy_t *policy;
 	changeset_t *changeset;
 	uint32_t expires_at;
+	knot_zone_sign_index_t *index;
+	bool nsec3;
 } node_sign_args_t;
 
 /*!
@@ -543,9 +721,16 @@ static int sign_node(zone_node_t **node, void *data)
 		return KNOT_EOK;
 	}
 
+	uint32_t expires_at = args->policy->now + args->policy->sign_lifetime;
 	int result = sign_node_rrsets(*node, args->zone_keys, args->policy,
-	                              args->changeset, &args->expires_at);
+	                              args->changeset, &expires_at);
 	(*node)->flags &= ~NODE_FLAGS_REMOVED_NSEC;
+	args->expires_at = MIN(args->expires_at, expires_at);
+
+	if (result == KNOT_EOK && args->index != NULL) {
+		result = index_note(args->index, (*node)->owner, args->nsec3,
+		                    expires_at);
+	}
 
 	return result;
 }
@@ -557,6 +742,8 @@ static int sign_node(zone_node_t **node, void *data)
  * \param zone_keys   Zone keys.
  * \param policy      DNSSEC policy.
  * \param changeset   Changeset to be updated.
+ * \param index       Signature expiration index to be filled (optional).
+ * \param nsec3       Signed tree is the NSEC3 tree.
  * \param expires_at  Expiration time of the oldest signature in zone.
  *
  * \return Error code, KNOT_EOK if successful.
@@ -565,6 +752,7 @@ static int zone_tree_sign(zone_tree_t *tree,
                           const knot_zone_keys_t *zone_keys,
                           const knot_dnssec_policy_t *policy,
                           changeset_t *changeset,
+                          knot_zone_sign_index_t *index, bool nsec3,
                           uint32_t *expires_at)
 {
 	assert(zone_keys);
@@ -575,7 +763,9 @@ static int zone_tree_sign(zone_tree_t *tree,
 		.zone_keys = zone_keys,
 		.policy = policy,
 		.changeset = changeset,
-		.expires_at = time(NULL) + policy->sign_lifetime
+		.expires_at = time(NULL) + policy->sign_lifetime,
+		.index = index,
+		.nsec3 = nsec3
 	};
 
 	int result = zone_tree_apply(tree, sign_node, &args);
@@ -584,6 +774,224 @@ static int zone_tree_sign(zone_tree_t *tree,
 	return result;
 }
 
+/*- private API - parallel signing of in-zone nodes --------------------------*/
+
+/*!
+ * \brief Signing worker, signs a continuous range of zone nodes.
+ */
+typedef struct {
+	pthread_t thread;
+	zone_node_t **nodes;       //!< First node in the range.
+	size_t count;              //!< Number of nodes in the range.
+	knot_zone_keys_t keys;     //!< Keys with private signing contexts.
+	node_sign_args_t args;     //!< Signing parameters and results.
+	changeset_t changeset;     //!< Changes made by the worker.
+	int result;
+} sign_worker_t;
+
+/*!
+ * \brief Clone zone keys with new signing contexts.
+ *
+ * Key data are shared with the original keys, only the signing contexts
+ * (which are not thread-safe) are private. Free with free_worker_keys().
+ */
+static int clone_worker_keys(const knot_zone_keys_t *keys,
+                             knot_zone_keys_t *clone)
+{
+	knot_init_zone_keys(clone);
+
+	node_t *node = NULL;
+	WALK_LIST(node, keys->list) {
+		const knot_zone_key_t *key = (knot_zone_key_t *)node;
+		knot_zone_key_t *copy = malloc(sizeof(*copy));
+		if (!copy) {
+			return KNOT_ENOMEM;
+		}
+
+		memcpy(copy, key, sizeof(*copy));
+		copy->context = NULL;
+		add_tail(&clone->list, &copy->node);
+
+		if (key->context != NULL) {
+			copy->context = knot_zone_key_context_get(copy);
+			if (!copy->context) {
+				return KNOT_ENOMEM;
+			}
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Free keys created by clone_worker_keys().
+ */
+static void free_worker_keys(knot_zone_keys_t *keys)
+{
+	node_t *node = NULL;
+	node_t *next = NULL;
+	WALK_LIST_DELSAFE(node, next, keys->list) {
+		knot_zone_key_t *key = (knot_zone_key_t *)node;
+		knot_zone_key_context_put(key, key->context);
+		free(key);
+	}
+
+	init_list(&keys->list);
+}
+
+static void *sign_worker_run(void *data)
+{
+	sign_worker_t *worker = data;
+
+	for (size_t i = 0; i < worker->count; i++) {
+		worker->result = sign_node(&worker->nodes[i], &worker->args);
+		if (worker->result != KNOT_EOK) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static int collect_node(zone_node_t **node, void *data)
+{
+	zone_node_t ***write = data;
+	**write = *node;
+	*write += 1;
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Append changes from one changeset into another.
+ */
+static int changeset_append(changeset_t *to, const changeset_t *from)
+{
+	changeset_iter_t itt;
+	int ret = changeset_iter_rem(&itt, from, false);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	knot_rrset_t rrset = changeset_iter_next(&itt);
+	while (ret == KNOT_EOK && !knot_rrset_empty(&rrset)) {
+		ret = changeset_rem_rrset(to, &rrset);
+		rrset = changeset_iter_next(&itt);
+	}
+	changeset_iter_clear(&itt);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = changeset_iter_add(&itt, from, false);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	rrset = changeset_iter_next(&itt);
+	while (ret == KNOT_EOK && !knot_rrset_empty(&rrset)) {
+		ret = changeset_add_rrset(to, &rrset);
+		rrset = changeset_iter_next(&itt);
+	}
+	changeset_iter_clear(&itt);
+
+	return ret;
+}
+
+/*!
+ * \brief Update RRSIGs in a given zone tree using multiple threads.
+ *
+ * The tree is split into continuous ranges of nodes, each signed by a
+ * worker with its own signing contexts and changeset. The changesets are
+ * merged afterwards.
+ *
+ * \param tree        Zone tree to be signed.
+ * \param apex        Zone apex name.
+ * \param zone_keys   Zone keys.
+ * \param policy      DNSSEC policy.
+ * \param changeset   Changeset to be updated.
+ * \param threads     Number of signing threads.
+ * \param expires_at  Expiration time of the oldest signature in zone.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+static int zone_tree_sign_parallel(zone_tree_t *tree, const knot_dname_t *apex,
+                                   const knot_zone_keys_t *zone_keys,
+                                   const knot_dnssec_policy_t *policy,
+                                   changeset_t *changeset, unsigned threads,
+                                   uint32_t *expires_at)
+{
+	size_t count = zone_tree_weight(tree);
+	if (threads <= 1 || count < threads) {
+		return zone_tree_sign(tree, zone_keys, policy, changeset, NULL,
+		                      false, expires_at);
+	}
+
+	zone_node_t **nodes = malloc(count * sizeof(zone_node_t *));
+	sign_worker_t *workers = calloc(threads, sizeof(sign_worker_t));
+	if (!nodes || !workers) {
+		free(nodes);
+		free(workers);
+		return KNOT_ENOMEM;
+	}
+
+	zone_node_t **write = nodes;
+	zone_tree_apply(tree, collect_node, &write);
+	assert(write == nodes + count);
+
+	int result = KNOT_EOK;
+	unsigned started = 0;
+	size_t chunk = count / threads;
+	for (unsigned i = 0; i < threads; i++) {
+		sign_worker_t *worker = &workers[i];
+		worker->nodes = nodes + i * chunk;
+		worker->count = (i + 1 == threads) ? count - i * chunk : chunk;
+
+		result = clone_worker_keys(zone_keys, &worker->keys);
+		if (result == KNOT_EOK) {
+			result = changeset_init(&worker->changeset, apex);
+		}
+		if (result != KNOT_EOK) {
+			free_worker_keys(&worker->keys);
+			break;
+		}
+
+		worker->args.zone_keys = &worker->keys;
+		worker->args.policy = policy;
+		worker->args.changeset = &worker->changeset;
+		worker->args.expires_at = time(NULL) + policy->sign_lifetime;
+
+		if (pthread_create(&worker->thread, NULL, sign_worker_run,
+		                   worker) != 0) {
+			changeset_clear(&worker->changeset);
+			free_worker_keys(&worker->keys);
+			result = KNOT_ERROR;
+			break;
+		}
+		started += 1;
+	}
+
+	*expires_at = UINT32_MAX;
+	for (unsigned i = 0; i < started; i++) {
+		sign_worker_t *worker = &workers[i];
+		pthread_join(worker->thread, NULL);
+		if (result == KNOT_EOK) {
+			result = worker->result;
+		}
+		if (result == KNOT_EOK) {
+			result = changeset_append(changeset, &worker->changeset);
+		}
+		*expires_at = MIN(*expires_at, worker->args.expires_at);
+		changeset_clear(&worker->changeset);
+		free_worker_keys(&worker->keys);
+	}
+
+	free(workers);
+	free(nodes);
+
+	return result;
+}
+
 /*- private API - signing of NSEC(3) in changeset ----------------------------*/
 
 /*!
@@ -878,7 +1286,7 @@ static int update_dnskeys_rrsigs(const knot_rrset_t *dnskeys,
 		}
 	}
 
-	result = add_missing_rrsigs(&new_dnskeys, NULL, zone_keys, policy,
+	result = add_missing_rrsigs(&new_dnskeys, 1, NULL, zone_keys, policy,
 	                            changeset);
 	if (result != KNOT_EOK) {
 		goto fail;
@@ -1170,18 +1578,14 @@ static void knot_zone_clear_sorted_changes(hattrie_t *t)
 /*- public API ---------------------------------------------------------------*/
 
 /*!
- * \brief Update zone signatures and store performed changes in changeset.
+ * \brief Update zone signatures, sign the zone trees with given threads.
  */
-int knot_zone_sign(const zone_contents_t *zone,
-                   const knot_zone_keys_t *zone_keys,
-                   const knot_dnssec_policy_t *policy,
-                   changeset_t *changeset,
-                   uint32_t *refresh_at)
+static int zone_sign(const zone_contents_t *zone,
+                     const knot_zone_keys_t *zone_keys,
+                     const knot_dnssec_policy_t *policy,
+                     changeset_t *changeset, knot_zone_sign_index_t *index,
+                     unsigned threads, uint32_t *refresh_at)
 {
-	if (!zone || !zone_keys || !policy || !changeset || !refresh_at) {
-		return KNOT_EINVAL;
-	}
-
 	int result;
 
 	result = update_dnskeys(zone, zone_keys, policy, changeset);
@@ -1190,22 +1594,46 @@ int knot_zone_sign(const zone_contents_t *zone,
 		return result;
 	}
 
+	if (index != NULL) {
+		knot_zone_sign_index_clear(index);
+	}
+
 	uint32_t normal_tree_expiration = UINT32_MAX;
-	result = zone_tree_sign(zone->nodes, zone_keys, policy, changeset,
-	                        &normal_tree_expiration);
+	if (index == NULL) {
+		result = zone_tree_sign_parallel(zone->nodes, zone->apex->owner,
+		                                 zone_keys, policy, changeset,
+		                                 threads, &normal_tree_expiration);
+	} else {
+		result = zone_tree_sign(zone->nodes, zone_keys, policy, changeset,
+		                        index, false, &normal_tree_expiration);
+	}
 	if (result != KNOT_EOK) {
 		dbg_dnssec_detail("zone_tree_sign() on normal nodes failed\n");
 		return result;
 	}
 
 	uint32_t nsec3_tree_expiration = UINT32_MAX;
-	result = zone_tree_sign(zone->nsec3_nodes, zone_keys, policy,
-	                        changeset, &nsec3_tree_expiration);
+	if (index == NULL) {
+		result = zone_tree_sign_parallel(zone->nsec3_nodes,
+		                                 zone->apex->owner, zone_keys,
+		                                 policy, changeset, threads,
+		                                 &nsec3_tree_expiration);
+	} else {
+		result = zone_tree_sign(zone->nsec3_nodes, zone_keys, policy,
+		                        changeset, index, true,
+		                        &nsec3_tree_expiration);
+	}
 	if (result != KNOT_EOK) {
 		dbg_dnssec_detail("zone_tree_sign() on nsec3 nodes failed\n");
 		return result;
 	}
 
+	// Continue with rolling re-signing
+	if (index != NULL) {
+		*refresh_at = index_refresh_time(index, zone_keys, policy);
+		return KNOT_EOK;
+	}
+
 	// renew the signatures a little earlier
 	uint32_t expiration = MIN(normal_tree_expiration, nsec3_tree_expiration);
 
@@ -1222,6 +1650,196 @@ int knot_zone_sign(const zone_contents_t *zone,
 	return KNOT_EOK;
 }
 
+/*!
+ * \brief Update zone signatures and store performed changes in changeset.
+ */
+int knot_zone_sign(const zone_contents_t *zone,
+                   const knot_zone_keys_t *zone_keys,
+                   const knot_dnssec_policy_t *policy,
+                   changeset_t *changeset,
+                   knot_zone_sign_index_t *index,
+                   uint32_t *refresh_at)
+{
+	if (!zone || !zone_keys || !policy || !changeset || !refresh_at) {
+		return KNOT_EINVAL;
+	}
+
+	return zone_sign(zone, zone_keys, policy, changeset, index, 1,
+	                 refresh_at);
+}
+
+int knot_zone_sign_parallel(const zone_contents_t *zone,
+                            const knot_zone_keys_t *zone_keys,
+                            const knot_dnssec_policy_t *policy,
+                            changeset_t *changeset, unsigned threads,
+                            uint32_t *refresh_at)
+{
+	if (!zone || !zone_keys || !policy || !changeset || !refresh_at ||
+	    threads == 0) {
+		return KNOT_EINVAL;
+	}
+
+	return zone_sign(zone, zone_keys, policy, changeset, NULL, threads,
+	                 refresh_at);
+}
+
+int knot_zone_sign_index_init(knot_zone_sign_index_t *index)
+{
+	if (index == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	index->names = hattrie_create();
+	if (index->names == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	if (!heap_init(&index->heap, index_entry_cmp, 0)) {
+		hattrie_free(index->names);
+		index->names = NULL;
+		return KNOT_ENOMEM;
+	}
+	index->heap.moved = index_entry_moved;
+
+	return KNOT_EOK;
+}
+
+void knot_zone_sign_index_clear(knot_zone_sign_index_t *index)
+{
+	if (index == NULL || index->heap.data == NULL) {
+		return;
+	}
+
+	while (!EMPTY_HEAP(&index->heap)) {
+		index_entry_t *entry = *HHEAD(&index->heap);
+		heap_delmin(&index->heap);
+		index_entry_free(entry);
+	}
+	hattrie_clear(index->names);
+}
+
+void knot_zone_sign_index_deinit(knot_zone_sign_index_t *index)
+{
+	if (index == NULL) {
+		return;
+	}
+
+	knot_zone_sign_index_clear(index);
+	free(index->heap.data);
+	index->heap.data = NULL;
+	hattrie_free(index->names);
+	index->names = NULL;
+}
+
+int knot_zone_sign_index_note_changeset(knot_zone_sign_index_t *index,
+                                        const changeset_t *changeset,
+                                        const knot_dnssec_policy_t *policy)
+{
+	if (index == NULL || changeset == NULL || policy == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	uint32_t expires_at = policy->now + policy->sign_lifetime;
+	int result = index_note_tree(index, changeset->add->nodes, false,
+	                             expires_at);
+	if (result != KNOT_EOK) {
+		return result;
+	}
+
+	return index_note_tree(index, changeset->add->nsec3_nodes, true,
+	                       expires_at);
+}
+
+/*!
+ * \brief Refresh signatures of the next slice of the zone.
+ */
+int knot_zone_sign_slice(const zone_contents_t *zone,
+                         const knot_zone_keys_t *zone_keys,
+                         const knot_dnssec_policy_t *policy,
+                         knot_zone_sign_index_t *index,
+                         changeset_t *changeset, uint32_t *refresh_at)
+{
+	if (!zone || !zone_keys || !policy || !index || !changeset ||
+	    !refresh_at) {
+		return KNOT_EINVAL;
+	}
+
+	// Nodes in the slice get new signatures even if the old ones are valid
+	knot_dnssec_policy_t slice_policy = *policy;
+	slice_policy.forced_sign = true;
+
+	const uint32_t due = policy->now + policy->sign_lifetime / 10;
+	const uint32_t expires_at = policy->now + policy->sign_lifetime;
+	const int quota = index->heap.num / KNOT_DNSSEC_ROLL_SLICES + 1;
+
+	list_t resigned;
+	init_list(&resigned);
+
+	int result = KNOT_EOK;
+	int count = 0;
+	while (!EMPTY_HEAP(&index->heap)) {
+		index_entry_t *entry = *HHEAD(&index->heap);
+		if (entry->expires_at > due && count >= quota) {
+			break;
+		}
+		heap_delmin(&index->heap);
+
+		// Skip removed nodes
+		zone_node_t *node = NULL;
+		zone_tree_get(entry->nsec3 ? zone->nsec3_nodes : zone->nodes,
+		              entry->owner, &node);
+		if (node == NULL || node->rrset_count == 0 ||
+		    node->flags & NODE_FLAGS_NONAUTH) {
+			index_entry_forget(index, entry);
+			continue;
+		}
+
+		uint32_t unused = UINT32_MAX;
+		result = sign_node_rrsets(node, zone_keys, &slice_policy,
+		                          changeset, &unused);
+		if (result == KNOT_EOK && node == zone->apex) {
+			knot_rrset_t dnskeys = node_rrset(node, KNOT_RRTYPE_DNSKEY);
+			knot_rrset_t rrsigs = node_rrset(node, KNOT_RRTYPE_RRSIG);
+			knot_rrset_t soa = node_rrset(node, KNOT_RRTYPE_SOA);
+			if (!knot_rrset_empty(&dnskeys)) {
+				result = update_dnskeys_rrsigs(&dnskeys, &rrsigs, &soa,
+				                               zone_keys, &slice_policy,
+				                               changeset);
+			}
+		}
+
+		entry->expires_at = expires_at;
+		if (ptrlist_add(&resigned, entry, NULL) == NULL) {
+			index_entry_forget(index, entry);
+			result = KNOT_ENOMEM;
+		}
+		if (result != KNOT_EOK) {
+			break;
+		}
+		++count;
+	}
+
+	// Re-signed nodes go to the end of the index
+	ptrnode_t *n = NULL;
+	WALK_LIST(n, resigned) {
+		index_entry_t *entry = (index_entry_t *)n->d;
+		if (!heap_insert(&index->heap, entry)) {
+			index_entry_forget(index, entry);
+			result = KNOT_ENOMEM;
+		}
+	}
+	ptrlist_free(&resigned, NULL);
+
+	if (result != KNOT_EOK) {
+		return result;
+	}
+
+	dbg_dnssec_detail("re-signed slice of %d nodes\n", count);
+	*refresh_at = index_refresh_time(index, zone_keys, policy);
+
+	return KNOT_EOK;
+}
+
 /*!
  * \brief Check if zone SOA signatures are expired.
  */
@@ -1300,7 +1918,8 @@ int knot_zone_sign_update_soa(const knot_rrset_t *soa,
 
 	// add signatures for new SOA
 
-	result = add_missing_rrsigs(soa_to, NULL, zone_keys, policy, changeset);
+	result = add_missing_rrsigs(soa_to, 1, NULL, zone_keys, policy,
+	                            changeset);
 	if (result != KNOT_EOK) {
 		knot_rrset_free(&soa_from, NULL);
 		knot_rrset_free(&soa_to, NULL);
@@ -1325,7 +1944,8 @@ int knot_zone_sign_changeset(const zone_contents_t *zone,
                              const changeset_t *in_ch,
                              changeset_t *out_ch,
                              const knot_zone_keys_t *zone_keys,
-                             const knot_dnssec_policy_t *policy)
+                             const knot_dnssec_policy_t *policy,
+                             hattrie_t *signed_tree)
 {
 	if (zone == NULL || in_ch == NULL || out_ch == NULL) {
 		return KNOT_EINVAL;
@@ -1337,7 +1957,7 @@ int knot_zone_sign_changeset(const zone_contents_t *zone,
 		.zone_keys = zone_keys,
 		.policy = policy,
 		.changeset = out_ch,
-		.signed_tree = hattrie_create()
+		.signed_tree = signed_tree ? signed_tree : hattrie_create()
 	};
 
 	if (args.signed_tree == NULL) {
@@ -1347,21 +1967,26 @@ int knot_zone_sign_changeset(const zone_contents_t *zone,
 	changeset_iter_t itt;
 	changeset_iter_all(&itt, in_ch, false);
 
+	int ret = KNOT_EOK;
 	knot_rrset_t rr = changeset_iter_next(&itt);
 	while (!knot_rrset_empty(&rr)) {
-		int ret = sign_changeset_wrap(&rr, &args);
+		ret = sign_changeset_wrap(&rr, &args);
 		if (ret != KNOT_EOK) {
-			changeset_iter_clear(&itt);
-			return ret;
+			break;
 		}
 		rr = changeset_iter_next(&itt);
 	}
 	changeset_iter_clear(&itt);
 
 	knot_zone_clear_sorted_changes(args.signed_tree);
-	hattrie_free(args.signed_tree);
+	if (signed_tree == NULL) {
+		hattrie_free(args.signed_tree);
+	} else {
+		// Keep the trie for the next changeset
+		hattrie_clear(signed_tree);
+	}
 
-	return KNOT_EOK;
+	return ret;
 }
 
 /*!
@@ -1382,7 +2007,7 @@ int knot_zone_sign_nsecs_in_changeset(const knot_zone_keys_t *zone_keys,
 	while (!knot_rrset_empty(&rr)) {
 		if (rr.type == KNOT_RRTYPE_NSEC ||
 		    rr.type == KNOT_RRTYPE_NSEC3) {
-			int ret =  add_missing_rrsigs(&rr, NULL, zone_keys,
+			int ret =  add_missing_rrsigs(&rr, 1, NULL, zone_keys,
 			                              policy, changeset);
 			if (ret != KNOT_EOK) {
 				changeset_iter_clear(&itt);
@@ -1448,3 +2073,42 @@ int knot_zone_sign_rr_should_be_signed(const zone_node_t *node,
 	*should_sign = true;
 	return KNOT_EOK;
 }
+
+/*!
+ * \brief Check if the key should be used to sign the RR set.
+ */
+bool knot_zone_sign_use_key(const knot_zone_key_t *key,
+                            const knot_rrset_t *covered)
+{
+	if (!key || !covered) {
+		return false;
+	}
+
+	return use_key(key, covered);
+}
+
+/*!
+ * \brief Update DNSKEY records in the zone apex without signing them.
+ */
+int knot_zone_sign_publish_dnskeys(const zone_contents_t *zone,
+                                   const knot_zone_keys_t *zone_keys,
+                                   changeset_t *changeset)
+{
+	if (!zone || !zone->apex || !zone_keys || !changeset) {
+		return KNOT_EINVAL;
+	}
+
+	knot_rrset_t dnskeys = node_rrset(zone->apex, KNOT_RRTYPE_DNSKEY);
+	knot_rrset_t soa = node_rrset(zone->apex, KNOT_RRTYPE_SOA);
+	if (knot_rrset_empty(&soa)) {
+		return KNOT_EINVAL;
+	}
+
+	int result = remove_invalid_dnskeys(&soa, &dnskeys, zone_keys,
+	                                    changeset);
+	if (result != KNOT_EOK) {
+		return result;
+	}
+
+	return add_missing_dnskeys(&soa, &dnskeys, zone_keys, changeset);
+}
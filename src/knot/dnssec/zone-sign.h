@@ -32,8 +32,13 @@
 #include "knot/zone/zone.h"
 #include "knot/zone/contents.h"
 #include "knot/dnssec/zone-keys.h"
+#include "libknot/internal/heap.h"
+#include "libknot/internal/trie/hat-trie.h"
 #include "libknot/dnssec/policy.h"
 
+/*! \brief Number of runs to spread the zone re-signing over. */
+#define KNOT_DNSSEC_ROLL_SLICES 24
+
 typedef struct type_node {
 	node_t n;
 	uint16_t type;
@@ -45,6 +50,54 @@ typedef struct signed_info {
 	list_t *type_list;
 } signed_info_t;
 
+/*!
+ * \brief Index of zone nodes ordered by the earliest signature expiration.
+ *
+ * Used for rolling re-signing, each run refreshes a slice of the zone instead
+ * of the whole zone at once. Each node has at most one entry, noting a node
+ * again updates its entry.
+ */
+typedef struct {
+	struct heap heap;
+	hattrie_t *names;  /*!< Entries by node owner. */
+} knot_zone_sign_index_t;
+
+/*!
+ * \brief Initialize empty signature expiration index.
+ *
+ * \param index  Index to be initialized.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_zone_sign_index_init(knot_zone_sign_index_t *index);
+
+/*!
+ * \brief Remove all entries from the signature expiration index.
+ *
+ * \param index  Index to be cleared.
+ */
+void knot_zone_sign_index_clear(knot_zone_sign_index_t *index);
+
+/*!
+ * \brief Free signature expiration index.
+ *
+ * \param index  Index to be freed.
+ */
+void knot_zone_sign_index_deinit(knot_zone_sign_index_t *index);
+
+/*!
+ * \brief Note nodes with new signatures from the changeset in the index.
+ *
+ * \param index      Signature expiration index.
+ * \param changeset  Changeset with new signatures.
+ * \param policy     DNSSEC policy the signatures were created with.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_zone_sign_index_note_changeset(knot_zone_sign_index_t *index,
+                                        const changeset_t *changeset,
+                                        const knot_dnssec_policy_t *policy);
+
 /*!
  * \brief Update zone signatures and store performed changes in changeset.
  *
@@ -54,6 +107,7 @@ typedef struct signed_info {
  * \param zone_keys   Zone keys.
  * \param policy      DNSSEC policy.
  * \param changeset   Changeset to be updated.
+ * \param index       Signature expiration index to be rebuilt (optional).
  * \param refresh_at  Pointer to refresh time when the zone should be resigned.
  *
  * \return Error code, KNOT_EOK if successful.
@@ -61,7 +115,51 @@ typedef struct signed_info {
 int knot_zone_sign(const zone_contents_t *zone,
                    const knot_zone_keys_t *zone_keys,
                    const knot_dnssec_policy_t *policy,
-                   changeset_t *out_ch, uint32_t *refresh_at);
+                   changeset_t *out_ch, knot_zone_sign_index_t *index,
+                   uint32_t *refresh_at);
+
+/*!
+ * \brief Update zone signatures using multiple signing threads.
+ *
+ * Same as knot_zone_sign() without the expiration index. Nodes of the zone
+ * are split between the threads, each using its own signing contexts.
+ *
+ * \param zone        Zone to be signed.
+ * \param zone_keys   Zone keys.
+ * \param policy      DNSSEC policy.
+ * \param changeset   Changeset to be updated.
+ * \param threads     Number of signing threads.
+ * \param refresh_at  Pointer to refresh time when the zone should be resigned.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_zone_sign_parallel(const zone_contents_t *zone,
+                            const knot_zone_keys_t *zone_keys,
+                            const knot_dnssec_policy_t *policy,
+                            changeset_t *changeset, unsigned threads,
+                            uint32_t *refresh_at);
+
+/*!
+ * \brief Refresh signatures of the next slice of the zone.
+ *
+ * Nodes with signatures due for refresh are always re-signed, at least
+ * 1/KNOT_DNSSEC_ROLL_SLICES of the indexed nodes is re-signed on each run, so
+ * that the signature expirations spread evenly over the signature lifetime.
+ *
+ * \param zone        Zone to be signed.
+ * \param zone_keys   Zone keys.
+ * \param policy      DNSSEC policy.
+ * \param index       Signature expiration index.
+ * \param changeset   Changeset to be updated.
+ * \param refresh_at  Pointer to refresh time of the next slice.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_zone_sign_slice(const zone_contents_t *zone,
+                         const knot_zone_keys_t *zone_keys,
+                         const knot_dnssec_policy_t *policy,
+                         knot_zone_sign_index_t *index,
+                         changeset_t *changeset, uint32_t *refresh_at);
 
 /*!
  * \brief Update and sign SOA and store performed changes in changeset.
@@ -100,6 +198,7 @@ bool knot_zone_sign_soa_expired(const zone_contents_t *zone,
  * \param out_ch New records will be added to this changeset.
  * \param zone_keys Keys to use for signing.
  * \param policy DNSSEC signing policy.
+ * \param signed_tree Helper trie reused between calls (created if NULL).
  *
  * \return Error code, KNOT_EOK if successful.
  */
@@ -107,7 +206,8 @@ int knot_zone_sign_changeset(const zone_contents_t *zone,
                              const changeset_t *in_ch,
                              changeset_t *out_ch,
                              const knot_zone_keys_t *zone_keys,
-                             const knot_dnssec_policy_t *policy);
+                             const knot_dnssec_policy_t *policy,
+                             hattrie_t *signed_tree);
 
 /*!
  * \brief Sign NSEC/NSEC3 nodes in changeset and update the changeset.
@@ -138,4 +238,30 @@ int knot_zone_sign_rr_should_be_signed(const zone_node_t *node,
                                        const knot_rrset_t *rrset,
                                        bool *should_sign);
 
+/*!
+ * \brief Check if the key should be used to sign the RR set.
+ *
+ * \param key      Zone key.
+ * \param covered  RR set to be signed.
+ *
+ * \return The key is active and of the right type (KSK/ZSK) for the RR set.
+ */
+bool knot_zone_sign_use_key(const knot_zone_key_t *key,
+                            const knot_rrset_t *covered);
+
+/*!
+ * \brief Update DNSKEY records in the zone apex without signing them.
+ *
+ * Used for zones signed online, where the zone itself holds no signatures.
+ *
+ * \param zone       Zone contents.
+ * \param zone_keys  Zone keys.
+ * \param changeset  Changeset to be updated.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_zone_sign_publish_dnskeys(const zone_contents_t *zone,
+                                   const knot_zone_keys_t *zone_keys,
+                                   changeset_t *changeset);
+
 /*! @} */
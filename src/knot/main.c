@@ -36,6 +36,7 @@
 #include "knot/server/server.h"
 #include "knot/server/tcp-handler.h"
 #include "knot/zone/timers.h"
+#include "knot/dnssec/zone-keys.h"
 #include "libknot/dnssec/crypto.h"
 
 /* Signal flags. */
@@ -53,6 +54,7 @@ static void init_signal_started(void)
 /*! \brief atexit() handler for server code. */
 static void knot_crypto_deinit(void)
 {
+	knot_zone_keys_cache_clear();
 	knot_crypto_cleanup();
 	knot_crypto_cleanup_threads();
 }
@@ -337,6 +339,11 @@ int main(int argc, char **argv)
 	/* Now we're going multithreaded. */
 	rcu_register_thread();
 
+	/* Hand over log writes to a writer thread if configured. */
+	if (config->log_async && log_async_start() != KNOT_EOK) {
+		log_warning("failed to start log writer, logging synchronously");
+	}
+
 	/* Populate zone database and add reconfiguration hook. */
 	log_info("loading zones");
 	server_update_zones(config, &server);
@@ -14,17 +14,559 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "libknot/processing/requestor.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
 #include "knot/modules/dnsproxy.h"
-#include "knot/nameserver/capture.h"
 #include "knot/nameserver/process_query.h"
+#include "libknot/dnssec/random.h"
+#include "libknot/internal/lists.h"
+#include "libknot/internal/macros.h"
+#include "libknot/internal/net.h"
+#include "libknot/internal/utils.h"
 
 #define MODULE_ERR(msg...) log_error("module 'dnsproxy', " msg)
 
+/*! \brief Maximal number of requests in flight over UDP, each has own socket. */
+#define PROXY_MAX_UDP 1024
+
+/*! \brief Number of message IDs on the upstream TCP connection. */
+#define PROXY_IDS (UINT16_MAX + 1)
+
+/*! \brief Maximal number of requests in flight over TCP. */
+#define PROXY_MAX_TCP (PROXY_IDS / 2)
+
+/*! \brief DNS message length prefix used over TCP. */
+#define TCP_PREFIX sizeof(uint16_t)
+
+/*! \brief Growing byte buffer. */
+struct proxy_buf {
+	uint8_t *data;
+	size_t len;
+	size_t size;
+};
+
+/*! \brief Completion of a request forwarded for a TCP client. */
+struct proxy_wait {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool done;
+	int ret;
+	uint8_t *answer;      /*!< Answer buffer. */
+	size_t answer_len;    /*!< Answer length. */
+};
+
+/*! \brief Forwarded query. */
+struct proxy_req {
+	node_t n;                        /*!< Node in queue or in-flight list. */
+	bool sent;                       /*!< Request is in the in-flight list. */
+	struct proxy_wait *wait;         /*!< Completion, NULL for UDP clients. */
+	struct sockaddr_storage client;  /*!< UDP client address. */
+	int client_fd;                   /*!< UDP client socket. */
+	uint16_t client_id;              /*!< Message ID used by the client. */
+	int fd;                          /*!< Upstream UDP socket or -1. */
+	int64_t slot;                    /*!< Index in pending table or -1. */
+	uint64_t deadline;               /*!< Expiration time (ms). */
+	size_t qlen;                     /*!< Length of header and question. */
+	size_t len;                      /*!< Query length. */
+	uint8_t wire[];                  /*!< Forwarded query. */
+};
+
+/*!
+ * \brief Proxy context.
+ *
+ * I/O threads hand the queries over to the event loop thread of the module,
+ * which multiplexes all upstream requests and sends the answers to the
+ * clients. Queries received over UDP are answered directly by the event loop,
+ * queries received over TCP wait for the answer in the I/O thread.
+ */
 struct dnsproxy {
 	conf_iface_t remote;
+
+	/* Query hand-over. */
+	pthread_mutex_t lock;
+	list_t queue;                    /*!< Queries waiting for event loop. */
+	bool stop;                       /*!< Event loop shall stop. */
+	int wakeup[2];                   /*!< Event loop wake-up pipe. */
+	pthread_t thread;
+	bool running;
+
+	/* Event loop data. */
+	size_t udp_count;                /*!< Requests in flight over UDP. */
+	int tcp;                         /*!< Upstream TCP connection or -1. */
+	bool tcp_connected;              /*!< Connection is established. */
+	struct proxy_buf tcp_out;        /*!< Data waiting to be sent. */
+	struct proxy_buf tcp_in;         /*!< Partially received messages. */
+	size_t tcp_count;                /*!< Requests in flight over TCP. */
+	struct proxy_req **pending;      /*!< TCP requests indexed by message ID. */
+	list_t inflight;                 /*!< Sent requests, oldest first. */
+	struct pollfd pfd[PROXY_MAX_UDP + 2];
+	struct proxy_req *pfd_req[PROXY_MAX_UDP + 2];
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
 };
 
+/*! \brief Get monotonic time in milliseconds. */
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int buf_append(struct proxy_buf *buf, const uint8_t *data, size_t len)
+{
+	if (buf->len + len > buf->size) {
+		size_t size = MAX(2 * buf->size, buf->len + len);
+		uint8_t *mem = realloc(buf->data, size);
+		if (mem == NULL) {
+			return KNOT_ENOMEM;
+		}
+		buf->data = mem;
+		buf->size = size;
+	}
+
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+
+	return KNOT_EOK;
+}
+
+static void buf_consume(struct proxy_buf *buf, size_t len)
+{
+	memmove(buf->data, buf->data + len, buf->len - len);
+	buf->len -= len;
+}
+
+static void buf_free(struct proxy_buf *buf)
+{
+	free(buf->data);
+	memset(buf, 0, sizeof(*buf));
+}
+
+/*!
+ * \brief Send SERVFAIL answer to the UDP client.
+ *
+ * The answer is created from the query header and question.
+ */
+static void answer_servfail(struct proxy_req *req)
+{
+	uint8_t *wire = req->wire;
+	knot_wire_set_id(wire, req->client_id);
+	knot_wire_set_qr(wire);
+	knot_wire_clear_aa(wire);
+	knot_wire_set_ra(wire);
+	knot_wire_set_rcode(wire, KNOT_RCODE_SERVFAIL);
+	knot_wire_set_ancount(wire, 0);
+	knot_wire_set_nscount(wire, 0);
+	knot_wire_set_arcount(wire, 0);
+
+	const struct sockaddr *sa = (const struct sockaddr *)&req->client;
+	(void)sendto(req->client_fd, wire, req->qlen, 0, sa, sockaddr_len(sa));
+}
+
+/*!
+ * \brief Finish the request, pass the answer (or failure) to the client.
+ */
+static void req_finish(struct dnsproxy *proxy, struct proxy_req *req, int ret,
+                       uint8_t *answer, size_t len)
+{
+	if (req->sent) {
+		rem_node(&req->n);
+	}
+	if (req->fd >= 0) {
+		close(req->fd);
+		proxy->udp_count -= 1;
+	}
+	if (req->slot >= 0) {
+		proxy->pending[req->slot] = NULL;
+		proxy->tcp_count -= 1;
+	}
+
+	if (req->wait != NULL) {
+		struct proxy_wait *wait = req->wait;
+		if (ret == KNOT_EOK) {
+			knot_wire_set_id(answer, req->client_id);
+			memcpy(wait->answer, answer, len);
+			wait->answer_len = len;
+		}
+		pthread_mutex_lock(&wait->lock);
+		wait->ret = ret;
+		wait->done = true;
+		pthread_cond_signal(&wait->cond);
+		pthread_mutex_unlock(&wait->lock);
+	} else if (ret == KNOT_EOK) {
+		knot_wire_set_id(answer, req->client_id);
+		const struct sockaddr *sa = (const struct sockaddr *)&req->client;
+		(void)sendto(req->client_fd, answer, len, 0, sa, sockaddr_len(sa));
+	} else {
+		answer_servfail(req);
+	}
+
+	free(req);
+}
+
+/*! \brief Fail all requests sent over the upstream TCP connection. */
+static void tcp_reset(struct dnsproxy *proxy)
+{
+	if (proxy->tcp >= 0) {
+		close(proxy->tcp);
+	}
+	proxy->tcp = -1;
+	proxy->tcp_connected = false;
+	buf_free(&proxy->tcp_out);
+	buf_free(&proxy->tcp_in);
+
+	struct proxy_req *req = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(req, next, proxy->inflight) {
+		if (req->slot >= 0) {
+			req_finish(proxy, req, KNOT_ECONN, NULL, 0);
+		}
+	}
+}
+
+/*! \brief Send buffered data over the upstream TCP connection. */
+static void tcp_flush(struct dnsproxy *proxy)
+{
+	if (!proxy->tcp_connected || proxy->tcp_out.len == 0) {
+		return;
+	}
+
+	ssize_t sent = send(proxy->tcp, proxy->tcp_out.data, proxy->tcp_out.len,
+	                    MSG_NOSIGNAL);
+	if (sent < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+			tcp_reset(proxy);
+		}
+		return;
+	}
+
+	buf_consume(&proxy->tcp_out, sent);
+}
+
+/*!
+ * \brief Send the request upstream over UDP.
+ *
+ * Each request gets a fresh socket with an ephemeral source port, so that
+ * a spoofed answer has to guess the port as well as the message ID.
+ */
+static void udp_send(struct dnsproxy *proxy, struct proxy_req *req)
+{
+	if (proxy->udp_count >= PROXY_MAX_UDP) {
+		req_finish(proxy, req, KNOT_ELIMIT, NULL, 0);
+		return;
+	}
+
+	req->fd = net_connected_socket(SOCK_DGRAM, &proxy->remote.addr, NULL,
+	                               O_NONBLOCK);
+	if (req->fd < 0) {
+		req->fd = -1;
+		req_finish(proxy, req, KNOT_ECONN, NULL, 0);
+		return;
+	}
+	proxy->udp_count += 1;
+
+	knot_wire_set_id(req->wire, knot_random_uint16_t());
+	req->sent = true;
+	add_tail(&proxy->inflight, &req->n);
+
+	if (send(req->fd, req->wire, req->len, 0) < 0) {
+		req_finish(proxy, req, KNOT_ECONN, NULL, 0);
+	}
+}
+
+/*!
+ * \brief Assign unused message ID to the request and send it upstream over
+ *        the shared TCP connection.
+ */
+static void tcp_send(struct dnsproxy *proxy, struct proxy_req *req)
+{
+	if (proxy->tcp_count >= PROXY_MAX_TCP) {
+		req_finish(proxy, req, KNOT_ELIMIT, NULL, 0);
+		return;
+	}
+
+	/* Pick random unused message ID. */
+	uint16_t id = knot_random_uint16_t();
+	while (proxy->pending[id] != NULL) {
+		id += 1;
+	}
+
+	knot_wire_set_id(req->wire, id);
+	req->slot = id;
+	proxy->pending[id] = req;
+	proxy->tcp_count += 1;
+	req->sent = true;
+	add_tail(&proxy->inflight, &req->n);
+
+	/* Reuse the upstream connection, connect if closed. */
+	if (proxy->tcp < 0) {
+		proxy->tcp = net_connected_socket(SOCK_STREAM, &proxy->remote.addr,
+		                                  NULL, O_NONBLOCK);
+		if (proxy->tcp < 0) {
+			proxy->tcp = -1;
+			req_finish(proxy, req, KNOT_ECONN, NULL, 0);
+			return;
+		}
+	}
+
+	uint8_t prefix[TCP_PREFIX];
+	wire_write_u16(prefix, req->len);
+	if (buf_append(&proxy->tcp_out, prefix, sizeof(prefix)) != KNOT_EOK ||
+	    buf_append(&proxy->tcp_out, req->wire, req->len) != KNOT_EOK) {
+		tcp_reset(proxy);
+		return;
+	}
+
+	tcp_flush(proxy);
+}
+
+/*! \brief Check that the upstream answer belongs to the request. */
+static bool answer_matches(const struct proxy_req *req, const uint8_t *answer,
+                           size_t len)
+{
+	/* Answer must repeat the question. */
+	size_t qlen = req->qlen;
+	return len >= qlen && knot_wire_get_qr(answer) &&
+	       knot_wire_get_id(answer) == knot_wire_get_id(req->wire) &&
+	       knot_wire_get_qdcount(answer) == knot_wire_get_qdcount(req->wire) &&
+	       memcmp(answer + KNOT_WIRE_HEADER_SIZE,
+	              req->wire + KNOT_WIRE_HEADER_SIZE,
+	              qlen - KNOT_WIRE_HEADER_SIZE) == 0;
+}
+
+/*! \brief Receive answers to the request, ignore the mismatched ones. */
+static void udp_receive(struct dnsproxy *proxy, struct proxy_req *req)
+{
+	for (;;) {
+		ssize_t len = recv(req->fd, proxy->buf, sizeof(proxy->buf),
+		                   MSG_DONTWAIT);
+		if (len < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				req_finish(proxy, req, KNOT_ECONN, NULL, 0);
+			}
+			return;
+		}
+		if (answer_matches(req, proxy->buf, len)) {
+			req_finish(proxy, req, KNOT_EOK, proxy->buf, len);
+			return;
+		}
+	}
+}
+
+static void tcp_receive(struct dnsproxy *proxy)
+{
+	size_t free_space = TCP_PREFIX + KNOT_WIRE_MAX_PKTSIZE - proxy->tcp_in.len;
+	ssize_t len = recv(proxy->tcp, proxy->buf, MIN(free_space, sizeof(proxy->buf)),
+	                   MSG_DONTWAIT);
+	if (len <= 0) {
+		if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK &&
+		                 errno != EINTR)) {
+			tcp_reset(proxy);
+		}
+		return;
+	}
+
+	if (buf_append(&proxy->tcp_in, proxy->buf, len) != KNOT_EOK) {
+		tcp_reset(proxy);
+		return;
+	}
+
+	struct proxy_buf *in = &proxy->tcp_in;
+	while (in->len >= TCP_PREFIX) {
+		size_t msg_len = wire_read_u16(in->data);
+		if (in->len < TCP_PREFIX + msg_len) {
+			break;
+		}
+		uint8_t *answer = in->data + TCP_PREFIX;
+		if (msg_len >= KNOT_WIRE_HEADER_SIZE) {
+			struct proxy_req *req = proxy->pending[knot_wire_get_id(answer)];
+			if (req != NULL && answer_matches(req, answer, msg_len)) {
+				req_finish(proxy, req, KNOT_EOK, answer, msg_len);
+			}
+		}
+		buf_consume(in, TCP_PREFIX + msg_len);
+	}
+}
+
+static void tcp_connect_done(struct dnsproxy *proxy)
+{
+	int err = 0;
+	socklen_t len = sizeof(err);
+	if (getsockopt(proxy->tcp, SOL_SOCKET, SO_ERROR, &err, &len) < 0 ||
+	    err != 0) {
+		tcp_reset(proxy);
+		return;
+	}
+
+	proxy->tcp_connected = true;
+}
+
+/*! \brief Fail requests with expired deadline, return time to the next one. */
+static int expire_requests(struct dnsproxy *proxy)
+{
+	uint64_t now = now_ms();
+
+	struct proxy_req *req = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(req, next, proxy->inflight) {
+		if (req->deadline > now) {
+			return req->deadline - now;
+		}
+		req_finish(proxy, req, KNOT_ETIMEOUT, NULL, 0);
+	}
+
+	/* Drop connection stuck with unsent queries of expired requests. */
+	if (proxy->tcp >= 0 && proxy->tcp_count == 0 &&
+	    proxy->tcp_out.len > 0) {
+		tcp_reset(proxy);
+	}
+
+	return -1;
+}
+
+/*! \brief Take over the queries queued by I/O threads. */
+static bool take_queue(struct dnsproxy *proxy, list_t *queue)
+{
+	uint8_t drain[64];
+	while (read(proxy->wakeup[0], drain, sizeof(drain)) > 0);
+
+	pthread_mutex_lock(&proxy->lock);
+	bool stop = proxy->stop;
+	if (!EMPTY_LIST(proxy->queue)) {
+		add_tail_list(queue, &proxy->queue);
+		init_list(&proxy->queue);
+	}
+	pthread_mutex_unlock(&proxy->lock);
+
+	return !stop;
+}
+
+static void *proxy_run(void *data)
+{
+	struct dnsproxy *proxy = data;
+	struct pollfd *pfd = proxy->pfd;
+
+	/* Wake-up pipe, TCP connection, then UDP sockets of the requests. */
+	const int tcp_pos = 1, udp_pos = 2;
+
+	list_t queue;
+	init_list(&queue);
+
+	while (take_queue(proxy, &queue)) {
+		struct proxy_req *req = NULL, *next = NULL;
+		WALK_LIST_DELSAFE(req, next, queue) {
+			rem_node(&req->n);
+			if (req->wait == NULL) {
+				udp_send(proxy, req);
+			} else {
+				tcp_send(proxy, req);
+			}
+		}
+
+		int timeout = expire_requests(proxy);
+
+		pfd[0].fd = proxy->wakeup[0];
+		pfd[0].events = POLLIN;
+		pfd[tcp_pos].fd = proxy->tcp;
+		pfd[tcp_pos].events = POLLIN;
+		if (!proxy->tcp_connected || proxy->tcp_out.len > 0) {
+			pfd[tcp_pos].events |= POLLOUT;
+		}
+		int count = udp_pos;
+		WALK_LIST(req, proxy->inflight) {
+			if (req->fd >= 0) {
+				proxy->pfd_req[count] = req;
+				pfd[count].fd = req->fd;
+				pfd[count].events = POLLIN;
+				count += 1;
+			}
+		}
+		for (int i = 0; i < count; i++) {
+			pfd[i].revents = 0;
+		}
+
+		if (poll(pfd, count, timeout) <= 0) {
+			continue;
+		}
+
+		/* Each request has own socket, finishing it affects no other. */
+		for (int i = udp_pos; i < count; i++) {
+			if (pfd[i].revents != 0) {
+				udp_receive(proxy, proxy->pfd_req[i]);
+			}
+		}
+
+		short revents = pfd[tcp_pos].revents;
+		if (proxy->tcp >= 0 && revents != 0) {
+			if (!proxy->tcp_connected) {
+				tcp_connect_done(proxy);
+			}
+			if (proxy->tcp >= 0 && (revents & (POLLIN | POLLHUP | POLLERR))) {
+				tcp_receive(proxy);
+			}
+			if (proxy->tcp >= 0 && (revents & POLLOUT)) {
+				tcp_flush(proxy);
+			}
+		}
+	}
+
+	/* Fail everything left. */
+	struct proxy_req *req = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(req, next, queue) {
+		rem_node(&req->n);
+		req_finish(proxy, req, KNOT_ECONN, NULL, 0);
+	}
+	WALK_LIST_DELSAFE(req, next, proxy->inflight) {
+		req_finish(proxy, req, KNOT_ECONN, NULL, 0);
+	}
+
+	return NULL;
+}
+
+/*! \brief Hand the query over to the event loop. */
+static void proxy_enqueue(struct dnsproxy *proxy, struct proxy_req *req)
+{
+	pthread_mutex_lock(&proxy->lock);
+	bool wakeup = EMPTY_LIST(proxy->queue);
+	add_tail(&proxy->queue, &req->n);
+	pthread_mutex_unlock(&proxy->lock);
+
+	if (wakeup) {
+		uint8_t byte = 0;
+		(void)write(proxy->wakeup[1], &byte, sizeof(byte));
+	}
+}
+
+static struct proxy_req *req_create(struct query_data *qdata,
+                                    struct proxy_wait *wait)
+{
+	knot_pkt_t *query = qdata->query;
+
+	struct proxy_req *req = malloc(sizeof(*req) + query->size);
+	if (req == NULL) {
+		return NULL;
+	}
+	memset(req, 0, sizeof(*req));
+
+	memcpy(req->wire, query->wire, query->size);
+	req->len = query->size;
+	req->qlen = KNOT_WIRE_HEADER_SIZE + knot_pkt_question_size(query);
+	req->client_id = knot_wire_get_id(query->wire);
+	req->client_fd = qdata->param->socket;
+	memcpy(&req->client, qdata->param->remote, sizeof(req->client));
+	req->wait = wait;
+	req->fd = -1;
+	req->slot = -1;
+	req->deadline = now_ms() + 1000 * (uint64_t)conf()->max_conn_hs;
+
+	return req;
+}
+
 static int dnsproxy_fwd(int state, knot_pkt_t *pkt, struct query_data *qdata, void *ctx)
 {
 	if (pkt == NULL || qdata == NULL || ctx == NULL) {
@@ -38,33 +580,57 @@ static int dnsproxy_fwd(int state, knot_pkt_t *pkt, struct query_data *qdata, vo
 
 	struct dnsproxy *proxy = ctx;
 
-	/* Create a forwarding request. */
-	struct knot_requestor re;
-	knot_requestor_init(&re, qdata->mm);
-	struct capture_param param;
-	param.sink = pkt;
-	int ret = knot_requestor_overlay(&re, LAYER_CAPTURE, &param);
-	if (ret != KNOT_EOK) {
-		return KNOT_NS_PROC_FAIL;
+	/* Queries over UDP are answered by the event loop. */
+	bool is_tcp = net_is_connected(qdata->param->socket);
+	if (!is_tcp) {
+		struct proxy_req *req = req_create(qdata, NULL);
+		if (req == NULL) {
+			return state; /* Ignore, not enough memory. */
+		}
+		proxy_enqueue(proxy, req);
+		return KNOT_NS_PROC_NOOP;
 	}
 
-	bool is_tcp = net_is_connected(qdata->param->socket);
-	struct knot_request *req = knot_request_make(re.mm, (struct sockaddr *)&proxy->remote.addr,
-	                                             NULL, qdata->query, is_tcp ? 0 : KNOT_RQ_UDP);
+	/* Queries over TCP wait for the answer. */
+	struct proxy_wait wait;
+	memset(&wait, 0, sizeof(wait));
+	wait.answer = mm_alloc(qdata->mm, KNOT_WIRE_MAX_PKTSIZE);
+	if (wait.answer == NULL) {
+		return state; /* Ignore, not enough memory. */
+	}
+
+	struct proxy_req *req = req_create(qdata, &wait);
 	if (req == NULL) {
+		mm_free(qdata->mm, wait.answer);
 		return state; /* Ignore, not enough memory. */
 	}
 
-	/* Forward request. */
-	ret = knot_requestor_enqueue(&re, req);
-	if (ret == KNOT_EOK) {
-		struct timeval tv = { conf()->max_conn_hs, 0 };
-		ret = knot_requestor_exec(&re, &tv);
-	} else {
-		knot_request_free(re.mm, req);
+	pthread_mutex_init(&wait.lock, NULL);
+	pthread_cond_init(&wait.cond, NULL);
+
+	proxy_enqueue(proxy, req);
+
+	pthread_mutex_lock(&wait.lock);
+	while (!wait.done) {
+		pthread_cond_wait(&wait.cond, &wait.lock);
 	}
+	pthread_mutex_unlock(&wait.lock);
 
-	knot_requestor_clear(&re);
+	pthread_cond_destroy(&wait.cond);
+	pthread_mutex_destroy(&wait.lock);
+
+	/* Parse the answer into the response. */
+	int ret = wait.ret;
+	if (ret == KNOT_EOK) {
+		knot_pkt_t *answer = knot_pkt_new(wait.answer, wait.answer_len,
+		                                  qdata->mm);
+		ret = (answer != NULL) ? knot_pkt_parse(answer, 0) : KNOT_ENOMEM;
+		if (ret == KNOT_EOK) {
+			ret = knot_pkt_copy(pkt, answer);
+		}
+		knot_pkt_free(&answer);
+	}
+	mm_free(qdata->mm, wait.answer);
 
 	/* Check result. */
 	if (ret != KNOT_EOK) {
@@ -75,6 +641,52 @@ static int dnsproxy_fwd(int state, knot_pkt_t *pkt, struct query_data *qdata, vo
 	return KNOT_NS_PROC_DONE;
 }
 
+static void dnsproxy_free(struct dnsproxy *proxy, mm_ctx_t *mm)
+{
+	if (proxy->running) {
+		pthread_mutex_lock(&proxy->lock);
+		proxy->stop = true;
+		pthread_mutex_unlock(&proxy->lock);
+		uint8_t byte = 0;
+		(void)write(proxy->wakeup[1], &byte, sizeof(byte));
+		pthread_join(proxy->thread, NULL);
+	}
+
+	tcp_reset(proxy);
+	for (int i = 0; i < 2; i++) {
+		if (proxy->wakeup[i] >= 0) {
+			close(proxy->wakeup[i]);
+		}
+	}
+
+	pthread_mutex_destroy(&proxy->lock);
+	free(proxy->pending);
+	mm_free(mm, proxy);
+}
+
+static int dnsproxy_start(struct dnsproxy *proxy)
+{
+	proxy->pending = calloc(PROXY_IDS, sizeof(struct proxy_req *));
+	if (proxy->pending == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	if (pipe(proxy->wakeup) != 0) {
+		proxy->wakeup[0] = proxy->wakeup[1] = -1;
+		return knot_map_errno(EMFILE, ENFILE);
+	}
+	for (int i = 0; i < 2; i++) {
+		fcntl(proxy->wakeup[i], F_SETFL, O_NONBLOCK);
+	}
+
+	if (pthread_create(&proxy->thread, NULL, proxy_run, proxy) != 0) {
+		return KNOT_ERROR;
+	}
+	proxy->running = true;
+
+	return KNOT_EOK;
+}
+
 int dnsproxy_load(struct query_plan *plan, struct query_module *self)
 {
 	struct dnsproxy *proxy = mm_alloc(self->mm, sizeof(struct dnsproxy));
@@ -83,26 +695,59 @@ int dnsproxy_load(struct query_plan *plan, struct query_module *self)
 		return KNOT_ENOMEM;
 	}
 	memset(proxy, 0, sizeof(struct dnsproxy));
+	pthread_mutex_init(&proxy->lock, NULL);
+	init_list(&proxy->queue);
+	init_list(&proxy->inflight);
+	proxy->tcp = -1;
+	proxy->wakeup[0] = proxy->wakeup[1] = -1;
+
+	/* Split address and optional port, address@port. */
+	char addr[SOCKADDR_STRLEN] = { '\0' };
+	int port = 53;
+	const char *sep = strchr(self->param, '@');
+	size_t addr_len = (sep != NULL) ? sep - self->param : strlen(self->param);
+	if (addr_len < sizeof(addr)) {
+		memcpy(addr, self->param, addr_len);
+	}
+	if (sep != NULL) {
+		char *end = NULL;
+		long num = strtol(sep + 1, &end, 10);
+		port = (*end == '\0' && num > 0 && num <= UINT16_MAX) ? num : -1;
+	}
 
 	/* Determine IPv4/IPv6 */
 	int family = AF_INET;
-	if (strchr(self->param, ':')) {
+	if (strchr(addr, ':')) {
 		family = AF_INET6;
 	}
 
-	int ret = sockaddr_set(&proxy->remote.addr, family, self->param, 53);
+	int ret = (port > 0) ?
+	          sockaddr_set(&proxy->remote.addr, family, addr, port) :
+	          KNOT_EINVAL;
 	if (ret != KNOT_EOK) {
 		MODULE_ERR("invalid proxy address: '%s'", self->param);
-		mm_free(self->mm, proxy);
+		dnsproxy_free(proxy, self->mm);
 		return KNOT_EINVAL;
 	}
 
+	ret = dnsproxy_start(proxy);
+	if (ret != KNOT_EOK) {
+		MODULE_ERR("failed to start forwarding (%s)", knot_strerror(ret));
+		dnsproxy_free(proxy, self->mm);
+		return ret;
+	}
+
+	self->ctx = proxy;
+
 	return query_plan_step(plan, QPLAN_BEGIN, dnsproxy_fwd, proxy);
 }
 
 int dnsproxy_unload(struct query_module *self)
 {
-	mm_free(self->mm, self->ctx);
+	if (self->ctx == NULL) {
+		return KNOT_EOK;
+	}
+
+	dnsproxy_free(self->ctx, self->mm);
 	return KNOT_EOK;
 }
-
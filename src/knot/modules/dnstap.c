@@ -19,29 +19,205 @@
 #include "knot/modules/dnstap.h"
 #include "knot/nameserver/query_module.h"
 #include "knot/nameserver/process_query.h"
+#include "dnstap/convert.h"
 #include "dnstap/dnstap.pb-c.h"
 #include "dnstap/writer.h"
-#include "dnstap/message.h"
 #include "dnstap/dnstap.h"
 #include "libknot/descriptor.h"
+#include "libknot/internal/utils.h"
 
 /* Defines. */
 #define MODULE_ERR(msg...) log_error("module 'dnstap', " msg)
 
-static int log_message(int state, const knot_pkt_t *pkt, struct query_data *qdata, void *ctx)
+/*! \brief Size of a preallocated frame. */
+#define FRAME_SIZE 4096
+
+/*! \brief Number of preallocated frames per server thread. */
+#define FRAME_COUNT 128
+
+/*! \brief Space for the Dnstap fields preceding the message. */
+#define FRAME_HDR_MAX 4
+
+/*! \brief Upper bound of encoded Dnstap fields other than the DNS message. */
+#define FRAME_OVERHEAD 128
+
+/*! \brief Protobuf wire types. */
+enum {
+	PB_VARINT  = 0,
+	PB_BYTES   = 2,
+	PB_FIXED32 = 5
+};
+
+/*! \brief Frame buffer, reused once the I/O thread has written it. */
+struct dt_frame {
+	int busy;
+	uint8_t data[FRAME_SIZE];
+};
+
+/*! \brief Frames owned by one server thread. */
+struct dt_ring {
+	struct dt_frame *frames;
+	unsigned next;
+};
+
+/*! \brief Module context. */
+struct dnstap_ctx {
+	struct fstrm_iothr *iothread;
+	struct dt_ring *rings;   /*!< Frame ring for each server thread. */
+	size_t ring_count;
+	unsigned sample;         /*!< Log one of 'sample' queries. */
+	uint16_t rcodes;         /*!< Logged response codes (bitmap, 0 = all). */
+};
+
+static uint8_t *pb_varint(uint8_t *p, uint64_t val)
 {
-	if (pkt == NULL || qdata == NULL || ctx == NULL) {
-		return KNOT_NS_PROC_FAIL;
+	while (val >= 0x80) {
+		*p++ = (val & 0x7f) | 0x80;
+		val >>= 7;
 	}
+	*p++ = val;
 
-	int ret = KNOT_ERROR;
-	struct fstrm_iothr* iothread = ctx;
-	struct fstrm_iothr_queue *ioq = fstrm_iothr_get_input_queue_idx(iothread, qdata->param->thread_id);
+	return p;
+}
 
-	/* Unless we want to measure the time it takes to process each query,
-	 * we can treat Q/R times the same. */
-	struct timeval tv;
-	gettimeofday(&tv, NULL);
+static uint8_t *pb_key(uint8_t *p, unsigned field, unsigned type)
+{
+	return pb_varint(p, field << 3 | type);
+}
+
+static uint8_t *pb_uint(uint8_t *p, unsigned field, uint64_t val)
+{
+	p = pb_key(p, field, PB_VARINT);
+	return pb_varint(p, val);
+}
+
+static uint8_t *pb_fixed32(uint8_t *p, unsigned field, uint32_t val)
+{
+	p = pb_key(p, field, PB_FIXED32);
+	for (int i = 0; i < 4; i++) {
+		*p++ = val >> (8 * i);
+	}
+
+	return p;
+}
+
+static uint8_t *pb_bytes(uint8_t *p, unsigned field, const void *data, size_t len)
+{
+	p = pb_key(p, field, PB_BYTES);
+	p = pb_varint(p, len);
+	memcpy(p, data, len);
+
+	return p + len;
+}
+
+/*!
+ * \brief Serialize Dnstap message with a DNS message into the buffer.
+ *
+ * Writes the same fields as dt_message_fill() and dt_pack() with field
+ * numbers from dnstap.proto. The buffer must have room for the DNS message
+ * and FRAME_HDR_MAX + FRAME_OVERHEAD bytes.
+ *
+ * \return Beginning of the frame, its size is stored in 'len'.
+ */
+static uint8_t *dt_encode(uint8_t *buf, Dnstap__Message__Type type,
+                          const struct sockaddr_storage *remote, int protocol,
+                          const knot_pkt_t *pkt, const struct timeval *tv,
+                          size_t *len)
+{
+	uint8_t *msg = buf + FRAME_HDR_MAX;
+	uint8_t *p = msg;
+
+	/* Message type, socket family and protocol. */
+	p = pb_uint(p, 1, type);
+	Dnstap__SocketFamily family = dt_family_encode(remote->ss_family);
+	if (family != 0) {
+		p = pb_uint(p, 2, family);
+	}
+	Dnstap__SocketProtocol proto = dt_protocol_encode(protocol);
+	if (proto != 0) {
+		p = pb_uint(p, 3, proto);
+	}
+
+	/* Query address and port. */
+	if (remote->ss_family == AF_INET) {
+		const struct sockaddr_in *sa = (const struct sockaddr_in *)remote;
+		p = pb_bytes(p, 4, &sa->sin_addr, sizeof(sa->sin_addr));
+		p = pb_uint(p, 6, ntohs(sa->sin_port));
+	} else if (remote->ss_family == AF_INET6) {
+		const struct sockaddr_in6 *sa = (const struct sockaddr_in6 *)remote;
+		p = pb_bytes(p, 4, &sa->sin6_addr, sizeof(sa->sin6_addr));
+		p = pb_uint(p, 6, ntohs(sa->sin6_port));
+	}
+
+	/* Query time, query message, response time, response message. */
+	p = pb_uint(p, 8, tv->tv_sec);
+	p = pb_fixed32(p, 9, tv->tv_usec * 1000);
+	if (dt_message_type_is_query(type)) {
+		p = pb_bytes(p, 10, pkt->wire, pkt->size);
+	}
+	p = pb_uint(p, 12, tv->tv_sec);
+	p = pb_fixed32(p, 13, tv->tv_usec * 1000);
+	if (dt_message_type_is_response(type)) {
+		p = pb_bytes(p, 14, pkt->wire, pkt->size);
+	}
+	size_t msg_len = p - msg;
+
+	/* Dnstap type follows the message. */
+	p = pb_uint(p, 15, DNSTAP__DNSTAP__TYPE__MESSAGE);
+
+	/* Dnstap message field precedes the message. */
+	uint8_t hdr[FRAME_HDR_MAX];
+	uint8_t *h = pb_key(hdr, 14, PB_BYTES);
+	h = pb_varint(h, msg_len);
+	size_t hdr_len = h - hdr;
+	memcpy(msg - hdr_len, hdr, hdr_len);
+
+	*len = p - (msg - hdr_len);
+	return msg - hdr_len;
+}
+
+/*! \brief Return written frame to its ring (called by the I/O thread). */
+static void frame_release(void *buf, void *free_data)
+{
+	struct dt_frame *frame = free_data;
+	__sync_lock_release(&frame->busy);
+}
+
+/*! \brief Take next free frame of the thread ring, NULL if none. */
+static struct dt_frame *frame_acquire(struct dt_ring *ring)
+{
+	if (ring->frames == NULL) {
+		ring->frames = calloc(FRAME_COUNT, sizeof(struct dt_frame));
+		if (ring->frames == NULL) {
+			return NULL;
+		}
+	}
+
+	struct dt_frame *frame = &ring->frames[ring->next];
+	if (!__sync_bool_compare_and_swap(&frame->busy, 0, 1)) {
+		return NULL;
+	}
+	ring->next = (ring->next + 1) % FRAME_COUNT;
+
+	return frame;
+}
+
+/*! \brief Check if the message is selected for logging. */
+static bool message_sampled(const struct dnstap_ctx *ctx, const knot_pkt_t *pkt)
+{
+	/* Query and its response share the message ID. */
+	if (ctx->sample > 1 && knot_wire_get_id(pkt->wire) % ctx->sample != 0) {
+		return false;
+	}
+
+	return true;
+}
+
+static int log_message(int state, const knot_pkt_t *pkt, struct query_data *qdata,
+                       struct dnstap_ctx *ctx, const struct timeval *tv)
+{
+	unsigned thread_id = qdata->param->thread_id;
+	struct fstrm_iothr_queue *ioq = fstrm_iothr_get_input_queue_idx(ctx->iothread, thread_id);
 
 	/* Determine query / response. */
 	Dnstap__Message__Type msgtype = DNSTAP__MESSAGE__TYPE__AUTH_QUERY;
@@ -55,33 +231,36 @@ static int log_message(int state, const knot_pkt_t *pkt, struct query_data *qdat
 		protocol = IPPROTO_UDP;
 	}
 
-	/* Create a dnstap message. */
-	Dnstap__Message msg;
-	ret = dt_message_fill(&msg, msgtype,
-	                      (const struct sockaddr *)qdata->param->remote,
-	                      NULL, /* todo: fill me! */
-	                      protocol,
-	                      pkt->wire, pkt->size, &tv, &tv);
-	if (ret != KNOT_EOK) {
-		return KNOT_NS_PROC_FAIL; 
+	/* Take a preallocated frame, allocate only for large messages. */
+	struct dt_frame *frame = NULL;
+	uint8_t *buf = NULL;
+	if (pkt->size + FRAME_HDR_MAX + FRAME_OVERHEAD <= FRAME_SIZE &&
+	    thread_id < ctx->ring_count) {
+		frame = frame_acquire(&ctx->rings[thread_id]);
+	}
+	if (frame != NULL) {
+		buf = frame->data;
+	} else {
+		buf = malloc(pkt->size + FRAME_HDR_MAX + FRAME_OVERHEAD);
+		if (buf == NULL) {
+			return KNOT_NS_PROC_FAIL;
+		}
 	}
-	Dnstap__Dnstap dnstap = DNSTAP__DNSTAP__INIT;
-	dnstap.type = DNSTAP__DNSTAP__TYPE__MESSAGE;
-	dnstap.message = (Dnstap__Message *)&msg;
 
-	/* Pack the message. */
-	uint8_t *frame = NULL;
 	size_t size = 0;
-	dt_pack(&dnstap, &frame, &size);
-	if (frame == NULL) {
-		return KNOT_NS_PROC_FAIL;
-	}
+	uint8_t *data = dt_encode(buf, msgtype, qdata->param->remote, protocol,
+	                          pkt, tv, &size);
 
 	/* Submit a request. */
-	fstrm_res res = fstrm_iothr_submit(iothread, ioq, frame, size,
-	                                   fstrm_free_wrapper, NULL);
+	fstrm_res res = fstrm_iothr_submit(ctx->iothread, ioq, data, size,
+	                                   frame ? frame_release : fstrm_free_wrapper,
+	                                   frame ? (void *)frame : buf);
 	if (res != fstrm_res_success) {
-		free(frame);
+		if (frame != NULL) {
+			frame_release(data, frame);
+		} else {
+			free(buf);
+		}
 		state = KNOT_NS_PROC_FAIL;
 	}
 
@@ -95,7 +274,40 @@ static int dnstap_message_log(int state, knot_pkt_t *pkt, struct query_data *qda
 		return KNOT_NS_PROC_FAIL;
 	}
 
-	return log_message(state, pkt, qdata, ctx);
+	struct dnstap_ctx *dctx = ctx;
+	if (!message_sampled(dctx, pkt)) {
+		return state;
+	}
+
+	/* Unless we want to measure the time it takes to process each query,
+	 * we can treat Q/R times the same. */
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+
+	return log_message(state, pkt, qdata, dctx, &tv);
+}
+
+/*! \brief Submit query and response if the response code is selected. */
+static int dnstap_response_log(int state, knot_pkt_t *pkt, struct query_data *qdata, void *ctx)
+{
+	if (pkt == NULL || qdata == NULL || ctx == NULL) {
+		return KNOT_NS_PROC_FAIL;
+	}
+
+	struct dnstap_ctx *dctx = ctx;
+	uint8_t rcode = knot_wire_get_rcode(pkt->wire);
+	if (!(dctx->rcodes & (1 << rcode)) || !message_sampled(dctx, pkt)) {
+		return state;
+	}
+
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+
+	if (qdata->query != NULL) {
+		log_message(state, qdata->query, qdata, dctx, &tv);
+	}
+
+	return log_message(state, pkt, qdata, dctx, &tv);
 }
 
 /*! \brief Create a UNIX socket sink. */
@@ -168,11 +380,79 @@ static struct fstrm_writer* dnstap_writer(const char *path)
 	return dnstap_file_writer(path);
 }
 
+/*!
+ * \brief Parse module options following the sink path.
+ *
+ * Syntax: [sample <N>] [rcode <name>[,<name>...]]
+ */
+static int dnstap_options(struct dnstap_ctx *ctx, char *saveptr)
+{
+	char *token = NULL;
+	while ((token = strtok_r(NULL, " ", &saveptr)) != NULL) {
+		char *arg = strtok_r(NULL, " ", &saveptr);
+		if (arg == NULL) {
+			return KNOT_EINVAL;
+		}
+
+		if (strcmp(token, "sample") == 0) {
+			char *end = NULL;
+			unsigned long sample = strtoul(arg, &end, 10);
+			if (*end != '\0' || sample == 0 || sample > UINT16_MAX) {
+				return KNOT_EINVAL;
+			}
+			ctx->sample = sample;
+		} else if (strcmp(token, "rcode") == 0) {
+			char *rsave = NULL;
+			for (char *name = strtok_r(arg, ",", &rsave); name != NULL;
+			     name = strtok_r(NULL, ",", &rsave)) {
+				lookup_table_t *rcode = lookup_by_name(knot_rcode_names, name);
+				if (rcode == NULL || rcode->id > KNOT_WIRE_RCODE_MASK) {
+					return KNOT_EINVAL;
+				}
+				ctx->rcodes |= 1 << rcode->id;
+			}
+		} else {
+			return KNOT_EINVAL;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static void dnstap_ctx_free(struct dnstap_ctx *ctx)
+{
+	if (ctx == NULL) {
+		return;
+	}
+
+	/* Pending frames are written or released on I/O thread exit. */
+	fstrm_iothr_destroy(&ctx->iothread);
+
+	for (size_t i = 0; i < ctx->ring_count; i++) {
+		free(ctx->rings[i].frames);
+	}
+	free(ctx->rings);
+	free(ctx);
+}
+
 int dnstap_load(struct query_plan *plan, struct query_module *self)
 {
 	/* Initialize the writer and the options. */
 	int ret = KNOT_ENOMEM;
-	struct fstrm_writer *writer = dnstap_writer(self->param);
+	struct dnstap_ctx *ctx = calloc(1, sizeof(struct dnstap_ctx));
+	if (ctx == NULL) {
+		goto fail;
+	}
+
+	/* Sink path is followed by the options. */
+	char *saveptr = NULL;
+	char *path = strtok_r(self->param, " ", &saveptr);
+	if (path == NULL || dnstap_options(ctx, saveptr) != KNOT_EOK) {
+		ret = KNOT_EINVAL;
+		goto fail;
+	}
+
+	struct fstrm_writer *writer = dnstap_writer(path);
 	if (writer == NULL) {
 		goto fail;
 	}
@@ -183,34 +463,46 @@ int dnstap_load(struct query_plan *plan, struct query_module *self)
 		goto fail;
 	}
 
-	/* Initialize queues. */
+	/* Initialize queues and frame rings, one for each server thread. */
 	size_t qcount = conf_udp_threads(self->config) + conf_tcp_threads(self->config);
 	fstrm_iothr_options_set_num_input_queues(opt, qcount);
 
+	ctx->rings = calloc(qcount, sizeof(struct dt_ring));
+	if (ctx->rings == NULL) {
+		fstrm_iothr_options_destroy(&opt);
+		fstrm_writer_destroy(&writer);
+		goto fail;
+	}
+	ctx->ring_count = qcount;
+
 	/* Create the I/O thread. */
-	struct fstrm_iothr* iothread = fstrm_iothr_init(opt, &writer);
+	ctx->iothread = fstrm_iothr_init(opt, &writer);
 	fstrm_iothr_options_destroy(&opt);
 
-	if (iothread == NULL) {
+	if (ctx->iothread == NULL) {
 		fstrm_writer_destroy(&writer);
 		goto fail;
 	}
-	self->ctx = iothread;
+	self->ctx = ctx;
 
 	/* Hook to the query plan. */
-	query_plan_step(plan, QPLAN_BEGIN, dnstap_message_log, self->ctx);
-	query_plan_step(plan, QPLAN_END, dnstap_message_log, self->ctx);
+	if (ctx->rcodes != 0) {
+		query_plan_step(plan, QPLAN_END, dnstap_response_log, self->ctx);
+	} else {
+		query_plan_step(plan, QPLAN_BEGIN, dnstap_message_log, self->ctx);
+		query_plan_step(plan, QPLAN_END, dnstap_message_log, self->ctx);
+	}
 
 	return KNOT_EOK;
 
 fail:
+	dnstap_ctx_free(ctx);
 	MODULE_ERR("init failed, params '%s' (%s)", self->param, knot_strerror(ret));
 	return ret;
 }
 
 int dnstap_unload(struct query_module *self)
 {
-	struct fstrm_iothr* iothread = self->ctx;
-	fstrm_iothr_destroy(&iothread);
+	dnstap_ctx_free(self->ctx);
 	return KNOT_EOK;
 }
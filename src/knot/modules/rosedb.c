@@ -15,6 +15,8 @@
  */
 
 #include <lmdb.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "knot/modules/rosedb.h"
 #include "knot/nameserver/process_query.h"
@@ -31,11 +33,40 @@
 
 #define LMDB_MAPSIZE (100 * 1024 * 1024)
 
+/*! \brief Default LMDB limit of reader slots. */
+#define LMDB_MAXREADERS 126
+
+/*! \brief Reader slots on top of the server threads (temporary readers,
+ *         other processes reading the database). */
+#define LMDB_READERS_MARGIN 16
+
+/*! \brief Readers are aligned to cache lines, each is written by one thread. */
+#define READER_ALIGN 64
+
+/*! \brief Read-only transaction and cursor kept by a server thread. */
+struct reader {
+	MDB_txn *txn;
+	MDB_cursor *cur;
+	volatile bool active;    /*!< Thread is in a transaction. */
+} __attribute__((aligned(READER_ALIGN)));
+
+/*!
+ * \brief Database and readers of the server threads.
+ *
+ * The map size grown by another process may be adopted only when no
+ * transaction is active in this process. Kept readers only announce their
+ * transactions in own flags and back off when resizing is set, temporary
+ * readers hold the resize lock for reading.
+ */
 struct cache
 {
 	MDB_dbi dbi;
 	MDB_env *env;
+	pthread_rwlock_t resize_lock; /*!< Held for writing to adopt map size. */
+	volatile bool resizing;       /*!< Map size is being adopted. */
 	mm_ctx_t *pool;
+	struct reader *readers;  /*!< Readers indexed by server thread. */
+	size_t reader_count;
 };
 
 struct rdentry {
@@ -54,11 +85,12 @@ struct iter {
 	MDB_cursor *cur;
 	MDB_val key;
 	MDB_val val;
+	uint8_t lf[KNOT_DNAME_MAXLEN];  /*!< Searched name in lookup format. */
 };
 
 /*                       MDB access                                           */
 
-static int dbase_open(struct cache *cache, const char *handle)
+static int dbase_open(struct cache *cache, const char *handle, size_t readers)
 {
 	long page_size = sysconf(_SC_PAGESIZE);
 	if (page_size <= 0) {
@@ -77,7 +109,18 @@ static int dbase_open(struct cache *cache, const char *handle)
 		return ret;
 	}
 
-	ret = mdb_env_open(cache->env, handle, 0, 0644);
+	/* Each server thread keeps its reader slot. */
+	unsigned max_readers = readers + LMDB_READERS_MARGIN;
+	if (max_readers > LMDB_MAXREADERS) {
+		ret = mdb_env_set_maxreaders(cache->env, max_readers);
+		if (ret != 0) {
+			mdb_env_close(cache->env);
+			return ret;
+		}
+	}
+
+	/* Read transactions are kept by server threads across queries. */
+	ret = mdb_env_open(cache->env, handle, MDB_NOTLS, 0644);
 	if (ret != 0) {
 		mdb_env_close(cache->env);
 		return ret;
@@ -162,12 +205,55 @@ static inline void *unpack_bin(char **stream, uint32_t *len) {
 	return ret;
 }
 
-static MDB_val pack_key(const knot_dname_t *name)
+/*!
+ * \brief Create database key from the name.
+ *
+ * Keys are names in the lookup format (reversed labels, each terminated by
+ * a zero byte), so the key of a name is prefixed by the keys of all its
+ * parent names except the root.
+ *
+ * \param name  Domain name.
+ * \param lf    Buffer for the lookup format of the name.
+ */
+static MDB_val pack_key(const knot_dname_t *name, uint8_t *lf)
 {
-	MDB_val key = { knot_dname_size(name), (void *)name };
+	knot_dname_lf(lf, name, NULL);
+	MDB_val key = { lf[0], lf + 1 };
 	return key;
 }
 
+/*! \brief Convert database key back to the domain name. */
+static int unpack_key(const MDB_val *key, knot_dname_t *name)
+{
+	const uint8_t *lf = key->mv_data;
+	size_t len = key->mv_size;
+
+	/* Root name. */
+	if (len == 1 && lf[0] == '\0') {
+		*name = '\0';
+		return KNOT_EOK;
+	}
+
+	if (len == 0 || len > KNOT_DNAME_MAXLEN - 1 || lf[len - 1] != '\0') {
+		return KNOT_EMALF;
+	}
+
+	/* Labels are stored from the last one. */
+	uint8_t *dst = name + len + 1;
+	*--dst = '\0';
+	size_t pos = 0;
+	while (pos < len) {
+		const uint8_t *label = lf + pos;
+		size_t label_len = strlen((const char *)label);
+		dst -= label_len + 1;
+		*dst = label_len;
+		memcpy(dst + 1, label, label_len);
+		pos += label_len + 1;
+	}
+
+	return KNOT_EOK;
+}
+
 static int pack_entry(MDB_val *data, struct entry *entry)
 {
 	char *stream = data->mv_data;
@@ -216,7 +302,8 @@ static int remove_entry(MDB_cursor *cur)
 
 /*                       database api                                   */
 
-struct cache *cache_open(const char *handle, unsigned flags, mm_ctx_t *mm)
+struct cache *cache_open(const char *handle, unsigned flags, size_t readers,
+                         mm_ctx_t *mm)
 {
 	struct cache *cache = mm_alloc(mm, sizeof(struct cache));
 	if (cache == NULL) {
@@ -224,12 +311,13 @@ struct cache *cache_open(const char *handle, unsigned flags, mm_ctx_t *mm)
 	}
 	memset(cache, 0, sizeof(struct cache));
 
-	int ret = dbase_open(cache, handle);
+	int ret = dbase_open(cache, handle, readers);
 	if (ret != 0) {
 		mm_free(mm, cache);
 		return NULL;
 	}
 
+	pthread_rwlock_init(&cache->resize_lock, NULL);
 	cache->pool = mm;
 	return cache;
 }
@@ -240,17 +328,239 @@ void cache_close(struct cache *cache)
 		return;
 	}
 
+	for (size_t i = 0; i < cache->reader_count; i++) {
+		struct reader *reader = &cache->readers[i];
+		if (reader->txn != NULL) {
+			mdb_cursor_close(reader->cur);
+			mdb_txn_abort(reader->txn);
+		}
+	}
+	free(cache->readers);
+
+	pthread_rwlock_destroy(&cache->resize_lock);
 	dbase_close(cache);
 	mm_free(cache->pool, cache);
 }
 
+/*! \brief Allocate readers for given number of threads. */
+static int cache_readers_init(struct cache *cache, size_t count)
+{
+	if (posix_memalign((void **)&cache->readers, READER_ALIGN,
+	                   count * sizeof(struct reader)) != 0) {
+		cache->readers = NULL;
+		return KNOT_ENOMEM;
+	}
+
+	memset(cache->readers, 0, count * sizeof(struct reader));
+	cache->reader_count = count;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Start new read transaction or renew the one kept by the reader. */
+static int reader_txn(struct cache *cache, struct reader *reader)
+{
+	if (reader->txn == NULL) {
+		int ret = mdb_txn_begin(cache->env, NULL, MDB_RDONLY, &reader->txn);
+		if (ret != 0) {
+			reader->txn = NULL;
+		}
+		return ret;
+	}
+
+	return mdb_txn_renew(reader->txn);
+}
+
+/*! \brief Announce the transaction, wait while the map size is adopted. */
+static void reader_enter(struct cache *cache, struct reader *reader, bool keep)
+{
+	if (!keep) {
+		pthread_rwlock_rdlock(&cache->resize_lock);
+		return;
+	}
+
+	for (;;) {
+		reader->active = true;
+		__sync_synchronize();
+		if (!cache->resizing) {
+			return;
+		}
+
+		/* Back off until the resize lock is released. */
+		reader->active = false;
+		pthread_rwlock_rdlock(&cache->resize_lock);
+		pthread_rwlock_unlock(&cache->resize_lock);
+	}
+}
+
+static void reader_leave(struct cache *cache, struct reader *reader, bool keep)
+{
+	if (!keep) {
+		pthread_rwlock_unlock(&cache->resize_lock);
+		return;
+	}
+
+	__sync_synchronize();
+	reader->active = false;
+}
+
+/*! \brief Adopt the map size grown by another process. */
+static int cache_adopt_mapsize(struct cache *cache)
+{
+	pthread_rwlock_wrlock(&cache->resize_lock);
+	cache->resizing = true;
+	__sync_synchronize();
+
+	/* Wait for kept readers in transactions. */
+	for (size_t i = 0; i < cache->reader_count; i++) {
+		while (cache->readers[i].active) {
+			sched_yield();
+		}
+	}
+
+	int ret = mdb_env_set_mapsize(cache->env, 0);
+
+	__sync_synchronize();
+	cache->resizing = false;
+	pthread_rwlock_unlock(&cache->resize_lock);
+
+	return ret;
+}
+
+/*!
+ * \brief Start read transaction, renew the one kept by the reader.
+ *
+ * Only a temporary reader (not kept) takes the resize lock, it is held
+ * for reading until reader_end().
+ */
+static MDB_cursor *reader_begin(struct cache *cache, struct reader *reader,
+                                bool keep)
+{
+	reader_enter(cache, reader, keep);
+
+	int ret = reader_txn(cache, reader);
+	if (ret == MDB_MAP_RESIZED) {
+		/* Map grown by another process, adopt its size and retry. */
+		reader_leave(cache, reader, keep);
+		ret = cache_adopt_mapsize(cache);
+		reader_enter(cache, reader, keep);
+		if (ret == 0) {
+			ret = reader_txn(cache, reader);
+		}
+	}
+	if (ret != 0) {
+		reader_leave(cache, reader, keep);
+		return NULL;
+	}
+
+	if (reader->cur == NULL) {
+		ret = mdb_cursor_open(reader->txn, cache->dbi, &reader->cur);
+		if (ret != 0) {
+			mdb_txn_abort(reader->txn);
+			reader->txn = NULL;
+			reader->cur = NULL;
+		}
+	} else {
+		ret = mdb_cursor_renew(reader->txn, reader->cur);
+		if (ret != 0) {
+			mdb_txn_reset(reader->txn);
+		}
+	}
+	if (ret != 0) {
+		reader_leave(cache, reader, keep);
+		return NULL;
+	}
+
+	return reader->cur;
+}
+
+/*! \brief Finish read transaction, keep it for renewal if requested. */
+static void reader_end(struct cache *cache, struct reader *reader, bool keep)
+{
+	if (keep) {
+		mdb_txn_reset(reader->txn);
+	} else {
+		mdb_cursor_close(reader->cur);
+		mdb_txn_abort(reader->txn);
+		reader->txn = NULL;
+		reader->cur = NULL;
+	}
+
+	reader_leave(cache, reader, keep);
+}
+
 static int cache_iter_begin(struct iter *it, const knot_dname_t *name)
 {
-	it->key = pack_key(name);
+	it->key = pack_key(name, it->lf);
 	it->val.mv_data = NULL;
 	it->val.mv_size = 0;
 
-	return mdb_cursor_get(it->cur, &it->key, &it->val, MDB_SET_KEY);
+	MDB_val key = it->key;
+	return mdb_cursor_get(it->cur, &key, &it->val, MDB_SET_KEY);
+}
+
+/*! \brief Move to the first entry of the matched name. */
+static int cache_iter_rewind(struct iter *it)
+{
+	MDB_val key = it->key;
+	return mdb_cursor_get(it->cur, &key, &it->val, MDB_SET_KEY);
+}
+
+/*!
+ * \brief Find entries of the closest name at or above the given name.
+ *
+ * All keys sorted between the closest name and the searched name belong
+ * to names below the closest name. Hence the key preceding the searched key
+ * shares its longest common label prefix with the searched key, and this
+ * prefix is the closest name unless there is a deeper name without entries.
+ * Usually a single MDB_SET_RANGE and one exact lookup resolve the search.
+ */
+static int cache_iter_closest(struct iter *it, const knot_dname_t *name)
+{
+	it->key = pack_key(name, it->lf);
+	uint8_t *lf = it->key.mv_data;
+	size_t len = it->key.mv_size;
+
+	MDB_val key = it->key;
+	int ret = mdb_cursor_get(it->cur, &key, &it->val, MDB_SET_RANGE);
+	while (ret == 0 || ret == MDB_NOTFOUND) {
+		/* Exact match, cursor at the first entry. */
+		if (ret == 0 && key.mv_size == len && memcmp(key.mv_data, lf, len) == 0) {
+			it->key.mv_size = len;
+			return 0;
+		}
+
+		/* Step to the preceding key. */
+		ret = mdb_cursor_get(it->cur, &key, &it->val,
+		                     ret == 0 ? MDB_PREV_NODUP : MDB_LAST);
+		if (ret != 0) {
+			return ret;
+		}
+
+		/* Longest common prefix of whole labels. */
+		size_t common = 0;
+		const uint8_t *prev = key.mv_data;
+		for (size_t i = 0; i < len && i < key.mv_size && prev[i] == lf[i]; i++) {
+			if (lf[i] == '\0') {
+				common = i + 1;
+			}
+		}
+
+		if (common == 0 || common >= len) {
+			break;
+		}
+
+		len = common;
+		key.mv_size = len;
+		key.mv_data = lf;
+		ret = mdb_cursor_get(it->cur, &key, &it->val, MDB_SET_RANGE);
+	}
+
+	/* Root name is not a prefix of other keys. */
+	static const uint8_t root = '\0';
+	it->key.mv_size = sizeof(root);
+	it->key.mv_data = (void *)&root;
+	return cache_iter_rewind(it);
 }
 
 static int cache_iter_next(struct iter *it)
@@ -292,7 +602,8 @@ int cache_insert(MDB_txn *txn, MDB_dbi dbi, const knot_dname_t *name, struct ent
 		return KNOT_ERROR;
 	}
 
-	MDB_val key = pack_key(name);
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	MDB_val key = pack_key(name, lf);
 	MDB_val data = { 0, malloc(ENTRY_MAXLEN) };
 
 	int ret = pack_entry(&data, entry);
@@ -479,8 +790,7 @@ static int rosedb_synth_rr(knot_pkt_t *pkt, struct entry *entry, uint16_t qtype)
 	return ret;
 }
 
-static int rosedb_synth(knot_pkt_t *pkt, const knot_dname_t *key, struct iter *it,
-                        struct query_data *qdata)
+static int rosedb_synth(knot_pkt_t *pkt, struct iter *it, struct query_data *qdata)
 {
 	struct entry entry;
 	int ret = KNOT_EOK;
@@ -500,7 +810,7 @@ static int rosedb_synth(knot_pkt_t *pkt, const knot_dname_t *key, struct iter *i
 	knot_pkt_begin(pkt, KNOT_AUTHORITY);
 	
 	/* Not found (zone cut if records exist). */
-	ret = cache_iter_begin(it, key);
+	ret = cache_iter_rewind(it);
 	while (ret == KNOT_EOK) {
 		if (cache_iter_val(it, &entry) == 0) {
 			ret = rosedb_synth_rr(pkt, &entry, KNOT_RRTYPE_NS);
@@ -533,32 +843,19 @@ static int rosedb_synth(knot_pkt_t *pkt, const knot_dname_t *key, struct iter *i
 	return ret;
 }
 
-static int rosedb_query_txn(MDB_txn *txn, MDB_dbi dbi, knot_pkt_t *pkt, struct query_data *qdata)
+static int rosedb_query_txn(MDB_cursor *cur, knot_pkt_t *pkt, struct query_data *qdata)
 {
 	struct iter it;
-	int ret = KNOT_EOK;
+	it.cur = cur;
 
-	/* Find suffix for QNAME. */
+	/* Find closest name at or above QNAME. */
 	const knot_dname_t *qname = knot_pkt_qname(qdata->query);
-	const knot_dname_t *key = qname;
-	while (key) {
-		ret = cache_query_fetch(txn, dbi, &it, key);
-		if (ret == 0) { /* Found */
-			break;
-		}
-
-		if (*key == '\0') { /* Last label, not found. */
-			return KNOT_ENOENT;
-		}
-
-		key = knot_wire_next_label(key, qdata->query->wire);
+	if (cache_iter_closest(&it, qname) != 0) {
+		return KNOT_ENOENT;
 	}
 
 	/* Synthetize record to response. */
-	ret = rosedb_synth(pkt, key, &it, qdata);
-
-	cache_iter_free(&it);
-	return ret;
+	return rosedb_synth(pkt, &it, qdata);
 }
 
 static int rosedb_query(int state, knot_pkt_t *pkt, struct query_data *qdata, void *ctx)
@@ -569,20 +866,25 @@ static int rosedb_query(int state, knot_pkt_t *pkt, struct query_data *qdata, vo
 
 	struct cache *cache = ctx;
 
-	MDB_txn *txn = NULL;
-	int ret = mdb_txn_begin(cache->env, NULL, MDB_RDONLY, &txn);
-	if (ret != 0) { /* Can't start transaction, ignore. */
+	/* Use the thread reader, a temporary one for unknown threads. */
+	struct reader tmp = { NULL, NULL, false };
+	struct reader *reader = &tmp;
+	if (qdata->param->thread_id < cache->reader_count) {
+		reader = &cache->readers[qdata->param->thread_id];
+	}
+	bool keep = (reader != &tmp);
+
+	MDB_cursor *cur = reader_begin(cache, reader, keep);
+	if (cur == NULL) { /* Can't start transaction, ignore. */
 		return state;
 	}
 
-	ret = rosedb_query_txn(txn, cache->dbi, pkt, qdata);
+	int ret = rosedb_query_txn(cur, pkt, qdata);
+	reader_end(cache, reader, keep);
 	if (ret != 0) { /* Can't find matching zone, ignore. */
-		mdb_txn_abort(txn);
 		return state;
 	}
 
-	mdb_txn_abort(txn);
-
 	return KNOT_NS_PROC_DONE;
 }
 
@@ -592,12 +894,18 @@ int rosedb_load(struct query_plan *plan, struct query_module *self)
 		return KNOT_EINVAL;
 	}
 	
-	struct cache *cache = cache_open(self->param, 0, self->mm);
+	size_t threads = conf_udp_threads(self->config) + conf_tcp_threads(self->config);
+	struct cache *cache = cache_open(self->param, 0, threads, self->mm);
 	if (cache == NULL) {
 		MODULE_ERR("couldn't open db '%s'", self->param);
 		return KNOT_ENOMEM;
 	}
 
+	if (cache_readers_init(cache, threads) != KNOT_EOK) {
+		cache_close(cache);
+		return KNOT_ENOMEM;
+	}
+
 	self->ctx = cache;
 
 	return query_plan_step(plan, QPLAN_BEGIN, rosedb_query, cache);
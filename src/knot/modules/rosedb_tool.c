@@ -1,5 +1,7 @@
+#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "knot/modules/rosedb.c"
 #include "zscanner/scanner.h"
@@ -11,21 +13,24 @@ static int rosedb_del(struct cache *cache, MDB_txn *txn, int argc, char *argv[])
 static int rosedb_get(struct cache *cache, MDB_txn *txn, int argc, char *argv[]);
 static int rosedb_list(struct cache *cache, MDB_txn *txn, int argc, char *argv[]);
 static int rosedb_import(struct cache *cache, MDB_txn *txn, int argc, char *argv[]);
+static int rosedb_bulk(struct cache *cache, MDB_txn *txn, int argc, char *argv[]);
 
 struct tool_action {
 	const char *name;
 	int (*func)(struct cache *, MDB_txn *, int, char *[]);
 	int min_args;
 	const char *info;
+	bool own_txn; /* Action manages transactions on its own. */
 };
 
 #define TOOL_ACTION_MAXARG 7
-#define TOOL_ACTION_COUNT 5
+#define TOOL_ACTION_COUNT 6
 static struct tool_action TOOL_ACTION[TOOL_ACTION_COUNT] = {
 { "add",    rosedb_add,    6, "<zone> <rrtype> <ttl> <rdata> <threat_code> <syslog_ip>" },
 { "del",    rosedb_del,    1, "<zone> [rrtype]" },
 { "get",    rosedb_get,    1, "<zone> [rrtype]" },
 { "import", rosedb_import, 1, "<file>" },
+{ "bulk",   rosedb_bulk,   1, "<file> [threads]", true },
 { "list",   rosedb_list,   0, "" }
 };
 
@@ -65,7 +70,7 @@ int main(int argc, char *argv[])
 	}
 
 	/* Open cache for operations. */
-	struct cache *cache = cache_open(dbdir, 0, NULL);
+	struct cache *cache = cache_open(dbdir, 0, 0, NULL);
 	if (cache == NULL) {
 		fprintf(stderr, "failed to open db '%s'\n", dbdir);
 		zs_scanner_free(g_scanner);
@@ -86,6 +91,15 @@ int main(int argc, char *argv[])
 			/* Now set as found. */
 			found = true;
 
+			/* Execute operation without transaction. */
+			if (ta->own_txn) {
+				ret = ta->func(cache, NULL, argc, argv);
+				if (ret != 0) {
+					fprintf(stderr, "'%s' failed\n", action);
+				}
+				break;
+			}
+
 			MDB_txn *txn = NULL;
 			int ret = mdb_txn_begin(cache->env, NULL, 0, &txn);
 			if (ret != MDB_SUCCESS) {
@@ -116,8 +130,8 @@ int main(int argc, char *argv[])
 	return ret;
 }
 
-static int parse_rdata(struct entry *entry, const char *owner, const char *rrtype, const char *rdata,
-		       int ttl, mm_ctx_t *mm)
+static int parse_rdata(zs_scanner_t *scanner, struct entry *entry, const char *owner,
+                       const char *rrtype, const char *rdata, int ttl, mm_ctx_t *mm)
 {
 	knot_rdataset_init(&entry->data.rrs);
 	int ret = knot_rrtype_from_string(rrtype, &entry->data.type);
@@ -127,13 +141,13 @@ static int parse_rdata(struct entry *entry, const char *owner, const char *rrtyp
 
 	/* Synthetize RR line */
 	char *rr_line = sprintf_alloc("%s %u IN %s %s\n", owner, ttl, rrtype, rdata);
-	ret = zs_scanner_parse(g_scanner, rr_line, rr_line + strlen(rr_line), true);
+	ret = zs_scanner_parse(scanner, rr_line, rr_line + strlen(rr_line), true);
 	free(rr_line);
 
 	/* Write parsed RDATA. */
 	if (ret == KNOT_EOK) {
-		knot_rdata_t rr[knot_rdata_array_size(g_scanner->r_data_length)];
-		knot_rdata_init(rr, g_scanner->r_data_length, g_scanner->r_data, ttl);
+		knot_rdata_t rr[knot_rdata_array_size(scanner->r_data_length)];
+		knot_rdata_init(rr, scanner->r_data_length, scanner->r_data, ttl);
 		ret = knot_rdataset_add(&entry->data.rrs, rr, mm);
 	}
 
@@ -149,7 +163,8 @@ static int rosedb_add(struct cache *cache, MDB_txn *txn, int argc, char *argv[])
 	knot_dname_to_lower(key);
 
 	struct entry entry;
-	int ret = parse_rdata(&entry, argv[0], argv[1], argv[3], atoi(argv[2]), cache->pool);
+	int ret = parse_rdata(g_scanner, &entry, argv[0], argv[1], argv[3], atoi(argv[2]),
+	                      cache->pool);
 	entry.threat_code = argv[4];
 	entry.syslog_ip   = argv[5];
 	if (ret != 0) {
@@ -219,7 +234,12 @@ static int rosedb_list(struct cache *cache, MDB_txn *txn, int argc, char *argv[]
 	while (ret == 0) {
 		struct entry entry;
 		unpack_entry(&data, &entry);
-		knot_dname_to_str(dname_str, key.mv_data, sizeof(dname_str));
+		knot_dname_t name[KNOT_DNAME_MAXLEN];
+		if (unpack_key(&key, name) != KNOT_EOK) {
+			ret = mdb_cursor_get(cursor, &key, &data, MDB_NEXT);
+			continue;
+		}
+		knot_dname_to_str(dname_str, name, sizeof(dname_str));
 		knot_rrtype_to_string(entry.data.type, type_str, sizeof(type_str));
 		printf("%s\t%s RDATA=%zuB\t%s\t%s\n", dname_str, type_str,
 		       knot_rdataset_size(&entry.data.rrs), entry.threat_code, entry.syslog_ip);
@@ -247,13 +267,10 @@ static char *trim(char *line)
 	return line;
 }
 
-static int rosedb_import_line(struct cache *cache, MDB_txn *txn, char *line, const char *file, int lineno)
+/*! \brief Split import line into command and parameters. */
+static int tokenize(char *line, char *argv[])
 {
-	int ret = 0;
 	int argc = 0;
-	char *argv[TOOL_ACTION_MAXARG];
-
-	/* Tokenize */
 	char *saveptr = line;
 	char *token = NULL;
 	while ((token = strtok_r(saveptr, ";\t", &saveptr)) != NULL) {
@@ -261,16 +278,30 @@ static int rosedb_import_line(struct cache *cache, MDB_txn *txn, char *line, con
 		if (*token == '\0') {
 			continue;
 		}
-		if (argc <= TOOL_ACTION_MAXARG) {
+		if (argc < TOOL_ACTION_MAXARG) {
 			argv[argc] = token;
 			argc += 1;
 		} else {
-			fprintf(stderr, "%s#%d command '%s' - too much parameters (%d)\n",
-			        file, lineno, line, argc);
-			return KNOT_EPARSEFAIL;
+			return -1;
 		}
 	}
 
+	return argc;
+}
+
+static int rosedb_import_line(struct cache *cache, MDB_txn *txn, char *line, const char *file, int lineno)
+{
+	int ret = 0;
+	char *argv[TOOL_ACTION_MAXARG];
+
+	/* Tokenize */
+	int argc = tokenize(line, argv);
+	if (argc < 0) {
+		fprintf(stderr, "%s#%d command '%s' - too much parameters\n",
+		        file, lineno, line);
+		return KNOT_EPARSEFAIL;
+	}
+
 	if (argc < 1) {
 		fprintf(stderr, "%s#%d command '%s' - command not recognized\n", file, lineno, line);
 		return KNOT_EOK; /* Ignore NOOP */
@@ -323,3 +354,409 @@ static int rosedb_import(struct cache *cache, MDB_txn *txn, int argc, char *argv
 
 	return ret;
 }
+
+/*                       bulk import                                          */
+
+/*! \brief Number of records written in one transaction. */
+#define BULK_BATCH 100000
+
+/*! \brief Packed record: key length (1B), value length (2B), key, value. */
+#define REC_HDR 3
+#define REC_KEY_LEN(rec) ((rec)[0])
+#define REC_VAL_LEN(rec) wire_read_u16((rec) + 1)
+#define REC_KEY(rec) ((rec) + REC_HDR)
+#define REC_VAL(rec) ((rec) + REC_HDR + REC_KEY_LEN(rec))
+
+/*! \brief Input part parsed by one thread. */
+struct bulk_worker {
+	pthread_t thread;
+	const char *file;
+	char *begin, *end;      /*!< Input lines. */
+	uint8_t *buf;           /*!< Packed records. */
+	size_t buf_len, buf_max;
+	const uint8_t **recs;   /*!< Sorted records. */
+	size_t count;
+	size_t pos;             /*!< Next record to be written. */
+	int ret;
+};
+
+/*! \brief Compare packed records the same way LMDB orders keys and values. */
+static int rec_cmp_data(const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len)
+{
+	int ret = memcmp(a, b, a_len < b_len ? a_len : b_len);
+	if (ret != 0) {
+		return ret;
+	}
+
+	return (a_len > b_len) - (a_len < b_len);
+}
+
+static int rec_cmp_key(const uint8_t *a, const uint8_t *b)
+{
+	return rec_cmp_data(REC_KEY(a), REC_KEY_LEN(a), REC_KEY(b), REC_KEY_LEN(b));
+}
+
+static int rec_cmp(const void *pa, const void *pb)
+{
+	const uint8_t *a = *(const uint8_t **)pa;
+	const uint8_t *b = *(const uint8_t **)pb;
+
+	int ret = rec_cmp_key(a, b);
+	if (ret != 0) {
+		return ret;
+	}
+
+	return rec_cmp_data(REC_VAL(a), REC_VAL_LEN(a), REC_VAL(b), REC_VAL_LEN(b));
+}
+
+/*! \brief Parse 'add' line and append packed record to the worker buffer. */
+static int bulk_pack_line(struct bulk_worker *w, zs_scanner_t *scanner,
+                          uint8_t *val_buf, char *line)
+{
+	char *argv[TOOL_ACTION_MAXARG];
+	int argc = tokenize(line, argv);
+	if (argc == 0) {
+		return KNOT_EOK;
+	}
+	if (argc < 7 || strcmp(argv[0], "add") != 0) {
+		fprintf(stderr, "%s: line '%s' - only 'add' is allowed in bulk import\n",
+		        w->file, argv[0]);
+		return KNOT_EPARSEFAIL;
+	}
+
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_t owner[KNOT_DNAME_MAXLEN] = { '\0' };
+	if (knot_dname_from_str(owner, argv[1], sizeof(owner)) == NULL) {
+		fprintf(stderr, "%s: invalid name '%s'\n", w->file, argv[1]);
+		return KNOT_EPARSEFAIL;
+	}
+	knot_dname_to_lower(owner);
+	MDB_val key = pack_key(owner, lf);
+
+	struct entry entry;
+	int ret = parse_rdata(scanner, &entry, argv[1], argv[2], argv[4], atoi(argv[3]), NULL);
+	if (ret != KNOT_EOK) {
+		fprintf(stderr, "%s: '%s' PARSE: %s\n", w->file, argv[1], knot_strerror(ret));
+		knot_rdataset_clear(&entry.data.rrs, NULL);
+		return ret;
+	}
+	entry.threat_code = argv[5];
+	entry.syslog_ip   = argv[6];
+
+	MDB_val val = { 0, val_buf };
+	pack_entry(&val, &entry);
+	knot_rdataset_clear(&entry.data.rrs, NULL);
+
+	/* Append packed record. */
+	size_t rec_len = REC_HDR + key.mv_size + val.mv_size;
+	if (w->buf_len + rec_len > w->buf_max) {
+		size_t max = (w->buf_max + rec_len) * 2;
+		uint8_t *buf = realloc(w->buf, max);
+		if (buf == NULL) {
+			return KNOT_ENOMEM;
+		}
+		w->buf = buf;
+		w->buf_max = max;
+	}
+
+	uint8_t *rec = w->buf + w->buf_len;
+	rec[0] = key.mv_size;
+	wire_write_u16(rec + 1, val.mv_size);
+	memcpy(REC_KEY(rec), key.mv_data, key.mv_size);
+	memcpy(REC_VAL(rec), val.mv_data, val.mv_size);
+	w->buf_len += rec_len;
+	w->count += 1;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Parse and sort a part of the input. */
+static void *bulk_worker_run(void *arg)
+{
+	struct bulk_worker *w = arg;
+
+	zs_scanner_t *scanner = zs_scanner_create(".", KNOT_CLASS_IN, 0, NULL,
+	                                          parse_err, NULL);
+	uint8_t *val_buf = malloc(ENTRY_MAXLEN);
+	if (scanner == NULL || val_buf == NULL) {
+		zs_scanner_free(scanner);
+		free(val_buf);
+		w->ret = KNOT_ENOMEM;
+		return NULL;
+	}
+
+	w->ret = KNOT_EOK;
+	char *line = w->begin;
+	while (line < w->end && w->ret == KNOT_EOK) {
+		char *eol = memchr(line, '\n', w->end - line);
+		if (eol == NULL) {
+			eol = w->end;
+		}
+		*eol = '\0';
+		if (eol > line) {
+			w->ret = bulk_pack_line(w, scanner, val_buf, line);
+		}
+		line = eol + 1;
+	}
+
+	zs_scanner_free(scanner);
+	free(val_buf);
+
+	if (w->ret != KNOT_EOK || w->count == 0) {
+		return NULL;
+	}
+
+	/* Index and sort records. */
+	w->recs = malloc(w->count * sizeof(*w->recs));
+	if (w->recs == NULL) {
+		w->ret = KNOT_ENOMEM;
+		return NULL;
+	}
+	const uint8_t *rec = w->buf;
+	for (size_t i = 0; i < w->count; i++) {
+		w->recs[i] = rec;
+		rec += REC_HDR + REC_KEY_LEN(rec) + REC_VAL_LEN(rec);
+	}
+	qsort(w->recs, w->count, sizeof(*w->recs), rec_cmp);
+
+	return NULL;
+}
+
+/*! \brief Take the smallest record from the sorted worker outputs. */
+static const uint8_t *bulk_next(struct bulk_worker *workers, unsigned count)
+{
+	struct bulk_worker *min = NULL;
+	for (unsigned i = 0; i < count; i++) {
+		struct bulk_worker *w = &workers[i];
+		if (w->pos < w->count &&
+		    (min == NULL || rec_cmp(&w->recs[w->pos], &min->recs[min->pos]) < 0)) {
+			min = w;
+		}
+	}
+
+	if (min == NULL) {
+		return NULL;
+	}
+
+	return min->recs[min->pos++];
+}
+
+static int bulk_txn_begin(struct cache *cache, MDB_txn **txn, MDB_cursor **cur)
+{
+	int ret = mdb_txn_begin(cache->env, NULL, 0, txn);
+	if (ret != MDB_SUCCESS) {
+		return ret;
+	}
+
+	ret = mdb_cursor_open(*txn, cache->dbi, cur);
+	if (ret != MDB_SUCCESS) {
+		mdb_txn_abort(*txn);
+	}
+
+	return ret;
+}
+
+/*!
+ * \brief Write merged records in batches.
+ *
+ * Records are written in the database order, so an empty database is filled
+ * in append mode without searching for the insert position.
+ */
+static int bulk_write(struct cache *cache, struct bulk_worker *workers,
+                      unsigned count, size_t *rows)
+{
+	MDB_txn *txn = NULL;
+	MDB_cursor *cur = NULL;
+	int ret = bulk_txn_begin(cache, &txn, &cur);
+	if (ret != MDB_SUCCESS) {
+		return ret;
+	}
+
+	/* Append mode requires an empty database. */
+	MDB_val key, val;
+	bool append = (mdb_cursor_get(cur, &key, &val, MDB_FIRST) == MDB_NOTFOUND);
+
+	size_t batch = 0;
+	const uint8_t *last = NULL;
+	const uint8_t *rec = NULL;
+	while ((rec = bulk_next(workers, count)) != NULL) {
+		/* Skip duplicate records. */
+		if (last != NULL && rec_cmp(&last, &rec) == 0) {
+			continue;
+		}
+
+		unsigned flags = 0;
+		if (append) {
+			flags = (last != NULL && rec_cmp_key(last, rec) == 0) ?
+			        MDB_APPENDDUP : MDB_APPEND;
+		}
+
+		key.mv_size = REC_KEY_LEN(rec);
+		key.mv_data = (void *)REC_KEY(rec);
+		val.mv_size = REC_VAL_LEN(rec);
+		val.mv_data = (void *)REC_VAL(rec);
+		ret = mdb_cursor_put(cur, &key, &val, flags);
+		if (ret == MDB_KEYEXIST && !append) {
+			ret = MDB_SUCCESS; /* Already present. */
+		}
+		if (ret != MDB_SUCCESS) {
+			mdb_txn_abort(txn);
+			return ret;
+		}
+
+		last = rec;
+		*rows += 1;
+
+		/* Commit batch and continue in a new transaction. */
+		if (++batch == BULK_BATCH) {
+			batch = 0;
+			ret = mdb_txn_commit(txn);
+			if (ret == MDB_SUCCESS) {
+				ret = bulk_txn_begin(cache, &txn, &cur);
+			}
+			if (ret != MDB_SUCCESS) {
+				return ret;
+			}
+		}
+	}
+
+	return mdb_txn_commit(txn);
+}
+
+/*!
+ * \brief Make room for the imported data in the memory map.
+ *
+ * The map is grown only if the data doesn't fit into the current one, e.g.
+ * the server map size. Server readers adopt the grown map on MDB_MAP_RESIZED.
+ */
+static int bulk_resize(struct cache *cache, size_t data_len)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0) {
+		return KNOT_EINVAL;
+	}
+
+	MDB_envinfo info;
+	int ret = mdb_env_info(cache->env, &info);
+	if (ret != MDB_SUCCESS) {
+		return ret;
+	}
+
+	/* Leave enough space for tree pages, fill factor is about a half. */
+	size_t used = (info.me_last_pgno + 1) * (size_t)page_size;
+	size_t map_size = used + 3 * data_len;
+	if (map_size <= info.me_mapsize) {
+		return MDB_SUCCESS;
+	}
+	map_size = (map_size / page_size + 1) * page_size;
+
+	return mdb_env_set_mapsize(cache->env, map_size);
+}
+
+/*! \brief Elapsed time in seconds. */
+static double elapsed(const struct timespec *begin)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - begin->tv_sec) + (end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+static int rosedb_bulk(struct cache *cache, MDB_txn *txn, int argc, char *argv[])
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned count = (argc > 1) ? atoi(argv[1]) : (cpus > 0 ? cpus : 1);
+	if (count == 0) {
+		fprintf(stderr, "invalid number of threads '%s'\n", argv[1]);
+		return KNOT_EINVAL;
+	}
+
+	printf("BULK %s (%u threads)\n", argv[0], count);
+
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	/* Read the whole input. */
+	FILE *fp = fopen(argv[0], "r");
+	if (fp == NULL) {
+		return KNOT_ENOENT;
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	char *data = (size >= 0) ? malloc(size + 1) : NULL;
+	if (data == NULL || fread(data, 1, size, fp) != (size_t)size) {
+		free(data);
+		fclose(fp);
+		return KNOT_ERROR;
+	}
+	fclose(fp);
+	data[size] = '\0';
+
+	struct bulk_worker *workers = calloc(count, sizeof(struct bulk_worker));
+	if (workers == NULL) {
+		free(data);
+		return KNOT_ENOMEM;
+	}
+
+	/* Split input at line boundaries and parse in parallel. */
+	char *pos = data;
+	for (unsigned i = 0; i < count; i++) {
+		struct bulk_worker *w = &workers[i];
+		w->file = argv[0];
+		w->begin = pos;
+		w->end = data + size * (i + 1) / count;
+		if (w->end < pos) {
+			w->end = pos;
+		}
+		char *eol = memchr(w->end, '\n', data + size - w->end);
+		w->end = (eol != NULL && i + 1 < count) ? eol + 1 : data + size;
+		pos = w->end;
+	}
+
+	int ret = KNOT_EOK;
+	unsigned started = 0;
+	for (; started < count; started++) {
+		struct bulk_worker *w = &workers[started];
+		if (pthread_create(&w->thread, NULL, bulk_worker_run, w) != 0) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
+	}
+
+	size_t total = 0;
+	for (unsigned i = 0; i < started; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (workers[i].ret != KNOT_EOK && ret == KNOT_EOK) {
+			ret = workers[i].ret;
+		}
+		total += workers[i].buf_len;
+	}
+
+	double parse_time = elapsed(&begin);
+
+	/* Merge sorted outputs into the database. */
+	size_t rows = 0;
+	if (ret == KNOT_EOK) {
+		ret = bulk_resize(cache, total);
+	}
+	if (ret == KNOT_EOK) {
+		ret = bulk_write(cache, workers, count, &rows);
+		if (ret != MDB_SUCCESS) {
+			fprintf(stderr, "%s\n", mdb_strerror(ret));
+		}
+	}
+
+	double total_time = elapsed(&begin);
+	printf("BULK %zu rows in %.2f s (parsed in %.2f s), %.0f rows/s\n",
+	       rows, total_time, parse_time,
+	       total_time > 0 ? rows / total_time : 0.0);
+
+	for (unsigned i = 0; i < count; i++) {
+		free(workers[i].buf);
+		free(workers[i].recs);
+	}
+	free(workers);
+	free(data);
+
+	return ret;
+}
@@ -18,6 +18,7 @@
 #include "knot/nameserver/query_module.h"
 #include "knot/nameserver/process_query.h"
 #include "knot/nameserver/internet.h"
+#include "knot/nameserver/nsec_proofs.h"
 #include "libknot/descriptor.h"
 #include "knot/conf/conf.h"
 
@@ -298,7 +299,14 @@ static int template_match(int state, synth_template_t *tpl, knot_pkt_t *pkt, str
 	}
 
 	/* Insert synthetic response into packet. */
-	if (knot_pkt_put(pkt, 0, rr, KNOT_PF_FREE) != KNOT_EOK) {
+	if (ns_put_rr(pkt, rr, NULL, KNOT_COMPR_HINT_NONE, KNOT_PF_FREE,
+	              qdata) != KNOT_EOK) {
+		return ERROR;
+	}
+
+	/* Signatures of zones signed online, answer RRSIGs were already
+	 * appended when the name was resolved. */
+	if (nsec_append_rrsigs(pkt, qdata, false) != KNOT_EOK) {
 		return ERROR;
 	}
 
@@ -19,6 +19,7 @@
 #include "libknot/rrtype/rdname.h"
 #include "libknot/rrtype/soa.h"
 #include "libknot/dnssec/rrset-sign.h"
+#include "knot/dnssec/online-sign.h"
 #include "knot/nameserver/internet.h"
 #include "knot/nameserver/nsec_proofs.h"
 #include "knot/nameserver/process_query.h"
@@ -120,7 +121,38 @@ static bool dname_cname_cannot_synth(const knot_rrset_t *rrset, const knot_dname
 static bool have_dnssec(struct query_data *qdata)
 {
 	return knot_pkt_has_dnssec(qdata->query) &&
-	       zone_contents_is_signed(qdata->zone->contents);
+	       (zone_contents_is_signed(qdata->zone->contents) ||
+	        qdata->zone->online_sign != NULL);
+}
+
+/*! \brief Store RRSIG records in 'qdata' for later use. */
+static int store_rrsig(const knot_dname_t *sig_owner, uint16_t rclass,
+                       knot_rdataset_t *synth_rrs,
+                       knot_rrinfo_t *rrinfo,
+                       struct query_data *qdata)
+{
+	/* Create rrsig info structure. */
+	struct rrsig_info *info = mm_alloc(qdata->mm, sizeof(struct rrsig_info));
+	if (info == NULL) {
+		knot_rdataset_clear(synth_rrs, qdata->mm);
+		return KNOT_ENOMEM;
+	}
+
+	/* Store RRSIG into info structure. */
+	knot_dname_t *owner_copy = knot_dname_copy(sig_owner, qdata->mm);
+	if (owner_copy == NULL) {
+		mm_free(qdata->mm, info);
+		knot_rdataset_clear(synth_rrs, qdata->mm);
+		return KNOT_ENOMEM;
+	}
+	knot_rrset_init(&info->synth_rrsig, owner_copy, KNOT_RRTYPE_RRSIG, rclass);
+	/* Store filtered signature. */
+	info->synth_rrsig.rrs = *synth_rrs;
+
+	info->rrinfo = rrinfo;
+	add_tail(&qdata->rrsigs, &info->n);
+
+	return KNOT_EOK;
 }
 
 /*! \brief Synthesize RRSIG for given parameters, store in 'qdata' for later use */
@@ -140,28 +172,54 @@ static int put_rrsig(const knot_dname_t *sig_owner, uint16_t type,
 		return ret;
 	}
 
-	/* Create rrsig info structure. */
-	struct rrsig_info *info = mm_alloc(qdata->mm, sizeof(struct rrsig_info));
-	if (info == NULL) {
-		knot_rdataset_clear(&synth_rrs, qdata->mm);
-		return KNOT_ENOMEM;
+	return store_rrsig(sig_owner, rrsigs->rclass, &synth_rrs, rrinfo, qdata);
+}
+
+/*! \brief Online signing context if the RR set is to be signed on demand. */
+static knot_online_sign_t *online_signing(const knot_pkt_t *pkt,
+                                          const knot_rrset_t *rr,
+                                          struct query_data *qdata)
+{
+	if (qdata->zone == NULL || !knot_pkt_has_dnssec(qdata->query)) {
+		return NULL;
 	}
 
-	/* Store RRSIG into info structure. */
-	knot_dname_t *owner_copy = knot_dname_copy(sig_owner, qdata->mm);
-	if (owner_copy == NULL) {
-		mm_free(qdata->mm, info);
-		knot_rdataset_clear(&synth_rrs, qdata->mm);
-		return KNOT_ENOMEM;
+	/* RRSIGs in ADDITIONAL are optional, glue is not signed at all. */
+	if (pkt->current == KNOT_ADDITIONAL) {
+		return NULL;
 	}
-	knot_rrset_init(&info->synth_rrsig, owner_copy, rrsigs->type, rrsigs->rclass);
-	/* Store filtered signature. */
-	info->synth_rrsig.rrs = synth_rrs;
 
-	info->rrinfo = rrinfo;
-	add_tail(&qdata->rrsigs, &info->n);
+	/* Delegation NS records are not authoritative. */
+	if (rr->type == KNOT_RRTYPE_NS &&
+	    !knot_dname_is_equal(rr->owner, qdata->zone->name)) {
+		return NULL;
+	}
 
-	return KNOT_EOK;
+	return qdata->zone->online_sign;
+}
+
+/*! \brief Sign RR set on demand, store RRSIG in 'qdata' for later use. */
+static int put_online_rrsig(knot_online_sign_t *online_sign,
+                            const knot_rrset_t *covered,
+                            knot_rrinfo_t *rrinfo,
+                            struct query_data *qdata)
+{
+	unsigned thread_id = qdata->param ? qdata->param->thread_id : 0;
+
+	knot_rdataset_t synth_rrs;
+	knot_rdataset_init(&synth_rrs);
+	int ret = knot_online_sign_rrset(online_sign, thread_id, covered,
+	                                 &synth_rrs, qdata->mm);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	if (synth_rrs.rr_count == 0) {
+		// No usable key
+		return KNOT_EOK;
+	}
+
+	return store_rrsig(covered->owner, covered->rclass, &synth_rrs, rrinfo,
+	                   qdata);
 }
 
 /*! \brief This is a wildcard-covered or any other terminal node for QNAME.
@@ -616,25 +674,31 @@ static int solve_authority_dnssec(int state, knot_pkt_t *pkt, struct query_data
 
 	int ret = KNOT_ERROR;
 
-	/* Authenticated denial of existence. */
-	switch (state) {
-	case HIT:    ret = KNOT_EOK; break;
-	case MISS:   ret = nsec_prove_nxdomain(pkt, qdata); break;
-	case NODATA: ret = nsec_prove_nodata(pkt, qdata); break;
-	case DELEG:  ret = nsec_prove_dp_security(pkt, qdata); break;
-	case TRUNC:  ret = KNOT_ESPACE; break;
-	case ERROR:  ret = KNOT_ERROR; break;
-	default:
-		assert(0);
-		break;
-	}
+	/* Zones signed online answer with minimally covering NSEC records,
+	 * expanded wildcards are signed as the QNAME. */
+	if (qdata->zone->online_sign != NULL) {
+		ret = nsec_prove_online(pkt, qdata, state);
+	} else {
+		/* Authenticated denial of existence. */
+		switch (state) {
+		case HIT:    ret = KNOT_EOK; break;
+		case MISS:   ret = nsec_prove_nxdomain(pkt, qdata); break;
+		case NODATA: ret = nsec_prove_nodata(pkt, qdata); break;
+		case DELEG:  ret = nsec_prove_dp_security(pkt, qdata); break;
+		case TRUNC:  ret = KNOT_ESPACE; break;
+		case ERROR:  ret = KNOT_ERROR; break;
+		default:
+			assert(0);
+			break;
+		}
 
-	/* RFC4035 3.1.3 Prove visited wildcards.
-	 * Wildcard expansion applies for Name Error, Wildcard Answer and
-	 * No Data proofs if at one point the search expanded a wildcard node.
-	 * \note Do not attempt to prove non-authoritative data. */
-	if (ret == KNOT_EOK && state != DELEG) {
-		ret = nsec_prove_wildcards(pkt, qdata);
+		/* RFC4035 3.1.3 Prove visited wildcards.
+		 * Wildcard expansion applies for Name Error, Wildcard Answer and
+		 * No Data proofs if at one point the search expanded a wildcard node.
+		 * \note Do not attempt to prove non-authoritative data. */
+		if (ret == KNOT_EOK && state != DELEG) {
+			ret = nsec_prove_wildcards(pkt, qdata);
+		}
 	}
 
 	/* RFC4035, section 3.1 RRSIGs for RRs in AUTHORITY are mandatory. */
@@ -736,10 +800,21 @@ int ns_put_rr(knot_pkt_t *pkt, const knot_rrset_t *rr,
 	}
 
 	const bool inserted = (prev_count != pkt->rrset_count);
-	if (inserted &&
-	    !knot_rrset_empty(rrsigs) && rr->type != KNOT_RRTYPE_RRSIG) {
-		// Get rrinfo of just inserted RR.
-		knot_rrinfo_t *rrinfo = &pkt->rr_info[pkt->rrset_count - 1];
+	if (!inserted || rr->type == KNOT_RRTYPE_RRSIG) {
+		return ret;
+	}
+
+	// Get rrinfo of just inserted RR.
+	knot_rrinfo_t *rrinfo = &pkt->rr_info[pkt->rrset_count - 1];
+	knot_online_sign_t *online_sign = online_signing(pkt, rr, qdata);
+	if (online_sign != NULL) {
+		/* Expanded wildcards are signed as the QNAME, no proof needed. */
+		knot_rrset_t covered = *rr;
+		if (expand) {
+			covered.owner = (knot_dname_t *)qdata->name;
+		}
+		ret = put_online_rrsig(online_sign, &covered, rrinfo, qdata);
+	} else if (!knot_rrset_empty(rrsigs)) {
 		ret = put_rrsig(rr->owner, rr->type, rrsigs, rrinfo, qdata);
 	}
 
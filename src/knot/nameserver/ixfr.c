@@ -14,6 +14,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <urcu.h>
+
 #include "knot/nameserver/ixfr.h"
 #include "knot/nameserver/axfr.h"
 #include "knot/nameserver/internet.h"
@@ -47,6 +49,8 @@ struct ixfr_proc {
 	list_t changesets;             /* Processed changesets. */
 	size_t change_count;           /* Count of changesets received. */
 	zone_t *zone;                  /* Modified zone - for journal access. */
+	apply_ctx_t stage;             /* Zone copy with completed changesets. */
+	changeset_t *staged;           /* Last changeset applied to the copy. */
 	mm_ctx_t *mm;                  /* Memory context for RR allocations. */
 	struct query_data *qdata;
 	const knot_rrset_t *soa_from;
@@ -336,11 +340,52 @@ static bool ixfr_is_axfr(const knot_pkt_t *pkt)
 	       answer->rr[1].type != KNOT_RRTYPE_SOA;
 }
 
+/*! \brief Drops zone copy with already applied changesets. */
+static void ixfrin_stage_abort(struct ixfr_proc *proc)
+{
+	if (proc->stage.contents != NULL) {
+		updates_rollback(&proc->changesets);
+		apply_abort(&proc->stage);
+	}
+	proc->staged = NULL;
+}
+
+/*!
+ * \brief Applies completed changeset to the staging zone copy.
+ *
+ * Changesets are applied while the rest of the transfer is being received,
+ * so that only the final adjustment is left when the transfer is done.
+ */
+static int ixfrin_stage(struct ixfr_proc *proc, changeset_t *change)
+{
+	if (change == NULL || change == proc->staged) {
+		return KNOT_EOK;
+	}
+
+	if (proc->stage.contents == NULL) {
+		int ret = apply_begin(&proc->stage, proc->zone);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	int ret = apply_step(&proc->stage, change);
+	if (ret != KNOT_EOK) {
+		ixfrin_stage_abort(proc);
+		return ret;
+	}
+
+	proc->staged = change;
+
+	return KNOT_EOK;
+}
+
 /*! \brief Cleans up data allocated by IXFR-in processing. */
 static void ixfrin_cleanup(struct answer_data *data)
 {
 	struct ixfr_proc *proc = data->ext;
 	if (proc) {
+		ixfrin_stage_abort(proc);
 		changesets_free(&proc->changesets);
 		knot_rrset_free(&proc->final_soa, proc->mm);
 		mm_free(data->mm, proc);
@@ -376,21 +421,41 @@ static int ixfrin_finalize(struct answer_data *adata)
 	struct ixfr_proc *ixfr = adata->ext;
 	assert(ixfr->state == IXFR_DONE);
 
-	zone_contents_t *new_contents;
-	int ret = apply_changesets(ixfr->zone, &ixfr->changesets, &new_contents);
-	if (ret != KNOT_EOK) {
-		IXFRIN_LOG(LOG_WARNING, "failed to apply changes to zone (%s)",
-		           knot_strerror(ret));
-		return ret;
+	/* Zone changed during the transfer, staged copy is outdated. */
+	if (ixfr->stage.base != ixfr->zone->contents) {
+		ixfrin_stage_abort(ixfr);
+	}
+
+	/* Apply the last changeset (or all of them if the copy was dropped). */
+	int ret = KNOT_EOK;
+	changeset_t *change = HEAD(ixfr->changesets);
+	if (ixfr->staged != NULL) {
+		change = (changeset_t *)ixfr->staged->n.next;
+	}
+	for (; change->n.next != NULL; change = (changeset_t *)change->n.next) {
+		ret = ixfrin_stage(ixfr, change);
+		if (ret != KNOT_EOK) {
+			IXFRIN_LOG(LOG_WARNING, "failed to apply changes to zone (%s)",
+			           knot_strerror(ret));
+			return ret;
+		}
 	}
 
-	/* Write changes to journal. */
-	ret = zone_changes_store(ixfr->zone, &ixfr->changesets);
+	/* Adjust the new zone, write changes to journal only if it succeeded. */
+	zone_contents_t *new_contents = NULL;
+	bool applied = false;
+	ret = apply_commit(&ixfr->stage, ixfr->zone, &ixfr->changesets,
+	                   &new_contents, &applied);
+	ixfr->staged = NULL;
 	if (ret != KNOT_EOK) {
-		IXFRIN_LOG(LOG_WARNING, "failed to write changes to journal (%s)",
-		           knot_strerror(ret));
-		updates_rollback(&ixfr->changesets);
-		update_free_zone(&new_contents);
+		if (applied) {
+			IXFRIN_LOG(LOG_WARNING, "failed to write changes to journal (%s)",
+			           knot_strerror(ret));
+		} else {
+			IXFRIN_LOG(LOG_WARNING, "failed to apply changes to zone (%s)",
+			           knot_strerror(ret));
+			ixfrin_stage_abort(ixfr);
+		}
 		return ret;
 	}
 
@@ -534,6 +599,13 @@ static int ixfrin_step(const knot_rrset_t *rr, struct ixfr_proc *proc)
 	case IXFR_START:
 		return solve_start(rr, proc);
 	case IXFR_SOA_DEL:
+		/* Previous changeset is complete, apply it meanwhile. */
+		if (!EMPTY_LIST(proc->changesets)) {
+			int ret = ixfrin_stage(proc, change);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+		}
 		return solve_soa_del(rr, proc);
 	case IXFR_DEL:
 		return solve_del(rr, change, proc->mm);
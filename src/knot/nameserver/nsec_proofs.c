@@ -2,6 +2,8 @@
 #include "knot/nameserver/process_query.h"
 #include "knot/nameserver/internet.h"
 #include "knot/dnssec/zone-nsec.h"
+#include "knot/dnssec/nsec-chain.h"
+#include "libknot/rrtype/soa.h"
 
 #include "knot/common/debug.h"
 
@@ -774,6 +776,99 @@ int nsec_prove_dp_security(knot_pkt_t *pkt, struct query_data *qdata)
 	                                qdata->name, qdata, pkt);
 }
 
+/*!
+ * \brief Puts minimally covering NSEC record for the name.
+ *
+ * The next owner is the immediate successor of the name (\000.name), so the
+ * record denies nothing but the name itself. The bitmap lists types present
+ * at the node, node may be NULL for a non-existent name.
+ */
+static int ns_put_nsec_online(const knot_dname_t *owner,
+                              const zone_node_t *node,
+                              struct query_data *qdata, knot_pkt_t *resp)
+{
+	/* Successor would exceed maximal name length, leave unproven. */
+	size_t owner_size = knot_dname_size(owner);
+	size_t next_size = owner_size + 2;
+	if (next_size > KNOT_DNAME_MAXLEN) {
+		return KNOT_EOK;
+	}
+
+	bitmap_t rr_types = { 0 };
+	if (node != NULL) {
+		bitmap_add_node_rrsets(&rr_types, node);
+	}
+	knot_bitmap_add_type(&rr_types, KNOT_RRTYPE_NSEC);
+	knot_bitmap_add_type(&rr_types, KNOT_RRTYPE_RRSIG);
+
+	size_t rdata_size = next_size + knot_bitmap_size(&rr_types);
+	uint8_t rdata[rdata_size];
+	rdata[0] = 1;
+	rdata[1] = 0;
+	memcpy(rdata + 2, owner, owner_size);
+	knot_bitmap_write(&rr_types, rdata + next_size);
+
+	const zone_contents_t *zone = qdata->zone->contents;
+	const knot_rdataset_t *soa = node_rdataset(zone->apex, KNOT_RRTYPE_SOA);
+	uint32_t ttl = knot_soa_minimum(soa);
+
+	knot_dname_t *owner_copy = knot_dname_copy(owner, &resp->mm);
+	if (owner_copy == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	knot_rrset_t nsec;
+	knot_rrset_init(&nsec, owner_copy, KNOT_RRTYPE_NSEC, KNOT_CLASS_IN);
+	int ret = knot_rrset_add_rdata(&nsec, rdata, rdata_size, ttl, &resp->mm);
+	if (ret != KNOT_EOK) {
+		knot_dname_free(&owner_copy, &resp->mm);
+		return ret;
+	}
+
+	ret = ns_put_rr(resp, &nsec, NULL, KNOT_COMPR_HINT_NONE, KNOT_PF_FREE,
+	                qdata);
+	if (ret != KNOT_EOK) {
+		knot_rrset_clear(&nsec, &resp->mm);
+	}
+
+	return ret;
+}
+
+int nsec_prove_online(knot_pkt_t *pkt, struct query_data *qdata, int state)
+{
+	dbg_ns("%s(%p, %p, %d)\n", __func__, pkt, qdata, state);
+	if (qdata->zone->contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	knot_rrset_t rrset;
+	switch (state) {
+	case HIT:
+		return KNOT_EOK;
+	case MISS:
+		/* The name is claimed to exist, with no data. */
+		qdata->rcode = KNOT_RCODE_NOERROR;
+		return ns_put_nsec_online(qdata->name, NULL, qdata, pkt);
+	case NODATA:
+		return ns_put_nsec_online(qdata->name, qdata->node, qdata, pkt);
+	case DELEG:
+		if (qdata->node == NULL) {
+			return KNOT_EINVAL;
+		}
+		rrset = node_rrset(qdata->node, KNOT_RRTYPE_DS);
+		if (!knot_rrset_empty(&rrset)) {
+			return ns_put_rr(pkt, &rrset, NULL, KNOT_COMPR_HINT_NONE,
+			                 0, qdata);
+		}
+		return ns_put_nsec_online(qdata->node->owner, qdata->node,
+		                          qdata, pkt);
+	case TRUNC:
+		return KNOT_ESPACE;
+	default:
+		return KNOT_ERROR;
+	}
+}
+
 int nsec_append_rrsigs(knot_pkt_t *pkt, struct query_data *qdata, bool optional)
 {
 	dbg_ns("%s(%p, optional=%d)\n", __func__, pkt, optional);
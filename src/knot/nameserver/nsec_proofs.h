@@ -44,6 +44,14 @@ int nsec_prove_nodata(knot_pkt_t *pkt, struct query_data *qdata);
 /*! \brief Prove delegation point security. */
 int nsec_prove_dp_security(knot_pkt_t *pkt, struct query_data *qdata);
 
+/*!
+ * \brief Prove answer of a zone signed online.
+ *
+ * Non-existent names and empty answers are denied with a minimally covering
+ * NSEC record at the name ("black lies"), NXDOMAIN is turned into NODATA.
+ */
+int nsec_prove_online(knot_pkt_t *pkt, struct query_data *qdata, int state);
+
 /*! \brief Append missing RRSIGs for current processing section. */
 int nsec_append_rrsigs(knot_pkt_t *pkt, struct query_data *qdata, bool optional);
 
@@ -22,6 +22,17 @@
 /*! \brief Accessor to query-specific data. */
 #define QUERY_DATA(ctx) ((struct query_data *)(ctx)->data)
 
+/*! \brief Get statistics counters of the processing thread. */
+static stats_data_t *query_stats(struct query_data *qdata)
+{
+	server_t *server = qdata->param->server;
+	if (server == NULL) {
+		return NULL;
+	}
+
+	return stats_thread(&server->stats, qdata->param->thread_id);
+}
+
 /*! \brief Reinitialize query data structure. */
 static void query_data_init(knot_layer_t *ctx, void *module_param)
 {
@@ -101,6 +112,8 @@ static int process_query_in(knot_layer_t *ctx, knot_pkt_t *pkt)
 	qdata->query = pkt;
 	qdata->packet_type = knot_pkt_type(pkt);
 
+	stats_qtype(query_stats(qdata), knot_pkt_qtype(pkt));
+
 	/* Declare having response. */
 	return KNOT_NS_PROC_FULL;
 }
@@ -412,12 +425,14 @@ static int ratelimit_apply(int state, knot_pkt_t *pkt, knot_layer_t *ctx)
 	/* Now it is slip or drop. */
 	if (rrl_slip_roll(conf()->rrl_slip)) {
 		/* Answer slips. */
+		stats_inc(query_stats(qdata), STATS_RRL_SLIPS);
 		if (process_query_err(ctx, pkt) != KNOT_EOK) {
 			return KNOT_NS_PROC_FAIL;
 		}
 		knot_wire_set_tc(pkt->wire);
 	} else {
 		/* Drop answer. */
+		stats_inc(query_stats(qdata), STATS_RRL_DROPS);
 		pkt->size = 0;
 	}
 
@@ -458,9 +473,19 @@ static int process_query_out(knot_layer_t *ctx, knot_pkt_t *pkt)
 	if (plan) {
 		WALK_LIST(step, plan->stage[QPLAN_BEGIN]) {
 			next_state = step->process(next_state, pkt, qdata, step->ctx);
+			if (next_state == KNOT_NS_PROC_NOOP) {
+				break;
+			}
 		}
 	}
 
+	/* Query was taken over by a module, which answers it later. */
+	if (next_state == KNOT_NS_PROC_NOOP) {
+		pkt->size = 0;
+		rcu_read_unlock();
+		return KNOT_NS_PROC_DONE;
+	}
+
 	/* Answer based on qclass. */
 	if (next_state != KNOT_NS_PROC_DONE) {
 		switch (knot_pkt_qclass(pkt)) {
@@ -519,6 +544,8 @@ finish:
 	}
 	/* In case of NS_PROC_FAIL, RCODE is set in the error-processing function. */
 
+	stats_rcode(query_stats(qdata), qdata->rcode);
+
 	/* Rate limits (if applicable). */
 	if (qdata->param->proc_flags & NS_QUERY_LIMIT_RATE) {
 		next_state = ratelimit_apply(next_state, pkt, ctx);
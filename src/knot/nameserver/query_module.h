@@ -83,7 +83,12 @@ struct query_module {
 	qmodule_unload_t unload;
 };
 
-/*! \brief Single processing step in query processing. */
+/*!
+ * \brief Single processing step in query processing.
+ *
+ * \note A server-wide QPLAN_BEGIN step may return KNOT_NS_PROC_NOOP to take
+ *       the query over, the answer is then sent by the module itself.
+ */
 struct query_step {
 	node_t node;
 	void *ctx;
@@ -77,12 +77,17 @@ static int sign_update(zone_t *zone, const zone_contents_t *old_contents,
 	uint32_t refresh_at = 0;
 	if (apex_rr_changed(old_contents, new_contents, KNOT_RRTYPE_DNSKEY) ||
 	    apex_rr_changed(old_contents, new_contents, KNOT_RRTYPE_NSEC3PARAM)) {
+		knot_dnssec_state_reset(zone->dnssec_state);
 		ret = knot_dnssec_zone_sign(new_contents, zone->conf,
 		                            sec_ch, KNOT_SOA_SERIAL_KEEP,
 		                            &refresh_at);
 	} else {
-		// Sign the created changeset
+		// Sign the created changeset, keys are kept for next updates
+		if (zone->dnssec_state == NULL) {
+			zone->dnssec_state = knot_dnssec_state_new();
+		}
 		ret = knot_dnssec_sign_changeset(new_contents, zone->conf,
+		                                 zone->dnssec_state,
 		                                 ddns_ch, sec_ch,
 		                                 &refresh_at);
 	}
@@ -236,9 +241,10 @@ static int process_normal(zone_t *zone, list_t *requests)
 	}
 	assert(new_contents);
 
-	// Sign the update.
+	// Sign the update (zones signed online keep no signatures).
+	const bool dnssec = zone->conf->dnssec_enable && !zone->conf->dnssec_online;
 	changeset_t sec_ch;
-	if (zone->conf->dnssec_enable) {
+	if (dnssec) {
 		ret = changeset_init(&sec_ch, zone->name);
 		if (ret != KNOT_EOK) {
 			set_rcodes(requests, KNOT_RCODE_SERVFAIL);
@@ -261,7 +267,7 @@ static int process_normal(zone_t *zone, list_t *requests)
 		update_rollback(&ddns_ch);
 		update_free_zone(&new_contents);
 		changeset_clear(&ddns_ch);
-		if (zone->conf->dnssec_enable) {
+		if (dnssec) {
 			changeset_clear(&sec_ch);
 		}
 		set_rcodes(requests, KNOT_RCODE_SERVFAIL);
@@ -273,7 +279,7 @@ static int process_normal(zone_t *zone, list_t *requests)
 	synchronize_rcu();
 
 	// Clear DNSSEC changes
-	if (zone->conf->dnssec_enable) {
+	if (dnssec) {
 		update_cleanup(&sec_ch);
 		changeset_clear(&sec_ch);
 	}
@@ -334,6 +340,7 @@ static int forward_request(zone_t *zone, struct knot_request *request)
 	/* Create requestor instance. */
 	struct knot_requestor re;
 	knot_requestor_init(&re, NULL);
+	re.pool = zone->events.conn_pool;
 
 	/* Fetch primary master. */
 	const conf_iface_t *master = zone_master(zone);
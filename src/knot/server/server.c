@@ -34,6 +34,39 @@
 #include "libknot/dnssec/crypto.h"
 #include "libknot/dnssec/random.h"
 
+/*! \brief Maximal number of idle outgoing TCP connections. */
+#define CONN_POOL_SIZE 128
+
+/*! \brief Idle outgoing TCP connections are closed after (seconds). */
+#define CONN_POOL_IDLE 10
+
+/*! \brief Interval of writing modified zone timers (seconds). */
+#define TIMERS_SYNC_INTERVAL 60
+
+/*! \brief Write modified zone timers, run by a background worker. */
+static void timers_sync_run(task_t *task)
+{
+	server_t *server = task->ctx;
+
+	rcu_read_lock();
+	int ret = write_timer_db(server->timers_db, server->zone_db);
+	rcu_read_unlock();
+	if (ret != KNOT_EOK) {
+		log_warning("cannot write zone timers (%s)", knot_strerror(ret));
+	}
+}
+
+/*! \brief Periodically hand over writing of zone timers to workers. */
+static int timers_sync_event(event_t *event)
+{
+	server_t *server = event->data;
+
+	worker_pool_assign(server->workers, &server->timers_task);
+	evsched_schedule(event, TIMERS_SYNC_INTERVAL * 1000);
+
+	return KNOT_EOK;
+}
+
 /*! \brief Event scheduler loop. */
 static int evsched_run(dthread_t *thread)
 {
@@ -299,6 +332,14 @@ int server_init(server_t *server, int bg_workers)
 		return KNOT_ENOMEM;
 	}
 
+	server->conn_pool = knot_conn_pool_new(CONN_POOL_SIZE, CONN_POOL_IDLE);
+	if (server->conn_pool == NULL) {
+		worker_pool_destroy(server->workers);
+		dt_delete(&server->iosched);
+		evsched_deinit(&server->sched);
+		return KNOT_ENOMEM;
+	}
+
 	return KNOT_EOK;
 }
 
@@ -325,12 +366,21 @@ void server_deinit(server_t *server)
 	/* Free rate limits. */
 	rrl_destroy(server->rrl);
 
+	/* Free statistics counters. */
+	stats_deinit(&server->stats);
+
+	/* Write modified zone timers. */
+	write_timer_db(server->timers_db, server->zone_db);
+
 	/* Free zone database. */
 	knot_zonedb_deep_free(&server->zone_db);
 
 	/* Free remaining events. */
 	evsched_deinit(&server->sched);
 
+	/* Close idle outgoing connections. */
+	knot_conn_pool_free(server->conn_pool);
+
 	/* Close persistent timers database. */
 	close_timers_db(server->timers_db);
 
@@ -403,6 +453,15 @@ int server_start(server_t *s, bool async)
 	/* Start evsched handler. */
 	dt_start(s->iosched);
 
+	/* Plan periodic writing of zone timers. */
+	s->timers_task.ctx = s;
+	s->timers_task.run = timers_sync_run;
+	s->timers_task.prio = TASK_PRIO_LOW;
+	s->timers_ev = evsched_event_create(&s->sched, timers_sync_event, s);
+	if (s->timers_ev != NULL) {
+		evsched_schedule(s->timers_ev, TIMERS_SYNC_INTERVAL * 1000);
+	}
+
 	/* Start I/O handlers. */
 	int ret = KNOT_EOK;
 	s->state |= ServerRunning;
@@ -507,6 +566,15 @@ static int reconfigure_threads(const struct conf *conf, server_t *server)
 			return ret;
 		}
 
+		/* Counters for each UDP and TCP thread. */
+		ret = stats_reset_threads(&server->stats, conf_udp_threads(conf) +
+		                                          conf_tcp_threads(conf));
+		if (ret != KNOT_EOK) {
+			log_error("failed to create statistics counters (%s)",
+			          knot_strerror(ret));
+			return ret;
+		}
+
 		/* Start if server is running. */
 		if (server->state & ServerRunning) {
 			for (unsigned i = 0; i < IO_COUNT; ++i) {
@@ -609,7 +677,8 @@ int server_update_zones(const conf_t *conf, void *data)
 	worker_pool_clear(server->workers);
 	worker_pool_wait(server->workers);
 
-	/* Reload zone database and free old zones. */
+	/* Write modified timers, reload zone database and free old zones. */
+	write_timer_db(server->timers_db, server->zone_db);
 	reopen_timers_database(conf, server);
 	int ret = zonedb_reload(conf, server);
 
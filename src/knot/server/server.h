@@ -34,8 +34,10 @@
 #include "knot/common/fdset.h"
 #include "libknot/internal/net.h"
 #include "libknot/internal/namedb/namedb.h"
+#include "libknot/processing/connpool.h"
 #include "knot/server/dthreads.h"
 #include "knot/server/rrl.h"
+#include "knot/server/stats.h"
 #include "knot/worker/pool.h"
 #include "knot/zone/zonedb.h"
 
@@ -105,16 +107,26 @@ typedef struct server {
 	/*! \brief Background jobs. */
 	worker_pool_t *workers;
 
+	/*! \brief Idle outgoing TCP connections. */
+	struct knot_conn_pool *conn_pool;
+
 	/*! \brief Event scheduler. */
 	dt_unit_t *iosched;
 	evsched_t sched;
 
+	/*! \brief Periodic writing of zone timers. */
+	event_t *timers_ev;
+	task_t timers_task;
+
 	/*! \brief List of interfaces. */
 	ifacelist_t* ifaces;
 
 	/*! \brief Rate limiting. */
 	rrl_table_t *rrl;
 
+	/*! \brief Query processing statistics. */
+	server_stats_t stats;
+
 } server_t;
 
 /*!
@@ -0,0 +1,102 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "knot/server/stats.h"
+#include "libknot/errcode.h"
+
+/*! \brief Number of 64-bit counters in a block. */
+#define STATS_WORDS (sizeof(stats_data_t) / sizeof(uint64_t))
+
+/*! \brief Names of general counters. */
+static const char *COUNTER_NAMES[STATS_COUNTERS] = {
+	[STATS_UDP_QUERIES]   = "udp-queries",
+	[STATS_TCP_QUERIES]   = "tcp-queries",
+	[STATS_UDP_RESPONSES] = "udp-responses",
+	[STATS_TCP_RESPONSES] = "tcp-responses",
+	[STATS_TCP_ACCEPTED]  = "tcp-accepted",
+	[STATS_RRL_SLIPS]     = "rrl-slipped",
+	[STATS_RRL_DROPS]     = "rrl-dropped"
+};
+
+/*! \brief Add all counters of the block to the totals. */
+static void stats_add(stats_data_t *total, const stats_data_t *data)
+{
+	uint64_t *dst = (uint64_t *)total;
+	const volatile uint64_t *src = (const volatile uint64_t *)data;
+	for (size_t i = 0; i < STATS_WORDS; i++) {
+		dst[i] += src[i];
+	}
+}
+
+const char *stats_counter_name(stats_counter_t counter)
+{
+	if (counter >= STATS_COUNTERS) {
+		return NULL;
+	}
+
+	return COUNTER_NAMES[counter];
+}
+
+int stats_reset_threads(server_stats_t *stats, unsigned thread_count)
+{
+	if (stats == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	stats_data_t *threads = NULL;
+	if (thread_count > 0) {
+		size_t size = thread_count * sizeof(stats_data_t);
+		if (posix_memalign((void **)&threads, STATS_CACHELINE, size) != 0) {
+			return KNOT_ENOMEM;
+		}
+		memset(threads, 0, size);
+	}
+
+	for (unsigned i = 0; i < stats->thread_count; i++) {
+		stats_add(&stats->retired, &stats->threads[i]);
+	}
+	free(stats->threads);
+
+	stats->threads = threads;
+	stats->thread_count = thread_count;
+
+	return KNOT_EOK;
+}
+
+void stats_deinit(server_stats_t *stats)
+{
+	if (stats == NULL) {
+		return;
+	}
+
+	free(stats->threads);
+	memset(stats, 0, sizeof(*stats));
+}
+
+void stats_sum(const server_stats_t *stats, stats_data_t *total)
+{
+	if (stats == NULL || total == NULL) {
+		return;
+	}
+
+	memcpy(total, &stats->retired, sizeof(*total));
+	for (unsigned i = 0; i < stats->thread_count; i++) {
+		stats_add(total, &stats->threads[i]);
+	}
+}
@@ -0,0 +1,161 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file stats.h
+ *
+ * \brief Server statistics counters.
+ *
+ * Each query processing thread owns one block of counters, the block is
+ * only ever written by its thread. Blocks are aligned to cache lines so
+ * the threads don't share them. Counters are summed on demand without
+ * locking, the sum may miss increments in progress.
+ *
+ * \addtogroup server
+ * @{
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*! \brief Assumed size of a cache line. */
+#define STATS_CACHELINE 64
+
+/*! \brief RCODEs above this value are counted together. */
+#define STATS_RCODE_OTHER 23
+
+/*! \brief QTYPEs above this value are counted together. */
+#define STATS_QTYPE_OTHER 255
+
+/*! \brief Response sizes are counted in power of two ranges. */
+#define STATS_SIZES 17
+
+/*! \brief General counters. */
+typedef enum {
+	STATS_UDP_QUERIES = 0, /*!< Queries received over UDP. */
+	STATS_TCP_QUERIES,     /*!< Queries received over TCP. */
+	STATS_UDP_RESPONSES,   /*!< Responses sent over UDP. */
+	STATS_TCP_RESPONSES,   /*!< Responses sent over TCP. */
+	STATS_TCP_ACCEPTED,    /*!< Accepted TCP connections. */
+	STATS_RRL_SLIPS,       /*!< Rate limited responses with TC bit. */
+	STATS_RRL_DROPS,       /*!< Rate limited responses not sent. */
+	STATS_COUNTERS
+} stats_counter_t;
+
+/*! \brief Counters of one thread. */
+typedef struct {
+	uint64_t counter[STATS_COUNTERS];
+	uint64_t rcode[STATS_RCODE_OTHER + 1];
+	uint64_t qtype[STATS_QTYPE_OTHER + 1];
+	uint64_t resp_size[STATS_SIZES]; /*!< Index is log2 of the size. */
+} __attribute__((aligned(STATS_CACHELINE))) stats_data_t;
+
+/*! \brief Server statistics. */
+typedef struct server_stats {
+	unsigned thread_count;
+	stats_data_t *threads;    /*!< Counters indexed by thread identifier. */
+	stats_data_t retired;     /*!< Counters of replaced threads. */
+} server_stats_t;
+
+/*!
+ * \brief Set number of counter blocks.
+ *
+ * Counters of the current blocks are kept in the totals. Must not be called
+ * while the query processing threads are running.
+ *
+ * \param stats         Server statistics.
+ * \param thread_count  Number of query processing threads.
+ *
+ * \retval KNOT_EOK on success.
+ * \retval KNOT_ENOMEM if out of memory.
+ */
+int stats_reset_threads(server_stats_t *stats, unsigned thread_count);
+
+/*!
+ * \brief Free counter blocks.
+ *
+ * \param stats  Server statistics.
+ */
+void stats_deinit(server_stats_t *stats);
+
+/*!
+ * \brief Sum counters of all threads.
+ *
+ * \param stats  Server statistics.
+ * \param total  Output totals.
+ */
+void stats_sum(const server_stats_t *stats, stats_data_t *total);
+
+/*!
+ * \brief Get name of the general counter.
+ */
+const char *stats_counter_name(stats_counter_t counter);
+
+/*!
+ * \brief Get counters of the thread.
+ *
+ * \return Counters or NULL if the thread has none.
+ */
+static inline stats_data_t *stats_thread(server_stats_t *stats, unsigned thread_id)
+{
+	if (stats == NULL || thread_id >= stats->thread_count) {
+		return NULL;
+	}
+
+	return &stats->threads[thread_id];
+}
+
+/*! \brief Increment general counter. */
+static inline void stats_inc(stats_data_t *data, stats_counter_t counter)
+{
+	if (data != NULL) {
+		data->counter[counter] += 1;
+	}
+}
+
+/*! \brief Count response RCODE. */
+static inline void stats_rcode(stats_data_t *data, uint16_t rcode)
+{
+	if (data != NULL) {
+		data->rcode[rcode < STATS_RCODE_OTHER ? rcode : STATS_RCODE_OTHER] += 1;
+	}
+}
+
+/*! \brief Count query QTYPE. */
+static inline void stats_qtype(stats_data_t *data, uint16_t qtype)
+{
+	if (data != NULL) {
+		data->qtype[qtype < STATS_QTYPE_OTHER ? qtype : STATS_QTYPE_OTHER] += 1;
+	}
+}
+
+/*! \brief Count size of a sent response. */
+static inline void stats_resp_size(stats_data_t *data, size_t size)
+{
+	if (data == NULL || size == 0) {
+		return;
+	}
+
+	unsigned bucket = 0;
+	while (size > 1 && bucket < STATS_SIZES - 1) {
+		size >>= 1;
+		bucket += 1;
+	}
+	data->resp_size[bucket] += 1;
+}
+
+/*! @} */
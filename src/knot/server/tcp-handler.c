@@ -147,6 +147,9 @@ static int tcp_handle(tcp_context_t *tcp, int fd,
 	/* Input packet. */
 	int state = knot_overlay_in(&tcp->overlay, query);
 
+	stats_data_t *stats = stats_thread(&tcp->server->stats, tcp->thread_id);
+	stats_inc(stats, STATS_TCP_QUERIES);
+
 	/* Resolve until NOOP or finished. */
 	ret = KNOT_EOK;
 	while (state & (KNOT_NS_PROC_FULL|KNOT_NS_PROC_FAIL)) {
@@ -158,6 +161,8 @@ static int tcp_handle(tcp_context_t *tcp, int fd,
 				ret = KNOT_ECONNREFUSED;
 				break;
 			}
+			stats_inc(stats, STATS_TCP_RESPONSES);
+			stats_resp_size(stats, ans->size);
 		}
 	}
 
@@ -224,6 +229,9 @@ static int tcp_event_accept(tcp_context_t *tcp, unsigned i)
 			return next_id; /* Contains errno. */
 		}
 
+		stats_inc(stats_thread(&tcp->server->stats, tcp->thread_id),
+		          STATS_TCP_ACCEPTED);
+
 		/* Update watchdog timer. */
 		rcu_read_lock();
 		fdset_set_watchdog(&tcp->set, next_id, conf()->max_conn_hs);
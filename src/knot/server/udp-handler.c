@@ -148,6 +148,14 @@ void udp_handle(udp_context_t *udp, int fd, struct sockaddr_storage *ss,
 		tx->iov_len = 0;
 	}
 
+	/* Update statistics. */
+	stats_data_t *stats = stats_thread(&udp->server->stats, udp->thread_id);
+	stats_inc(stats, STATS_UDP_QUERIES);
+	if (tx->iov_len > 0) {
+		stats_inc(stats, STATS_UDP_RESPONSES);
+		stats_resp_size(stats, tx->iov_len);
+	}
+
 	/* Reset after processing. */
 	knot_overlay_finish(&udp->overlay);
 	knot_overlay_deinit(&udp->overlay);
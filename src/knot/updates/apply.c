@@ -120,8 +120,9 @@ static int replace_rdataset_with_copy(zone_node_t *node, uint16_t type)
 
 	memcpy(copy, rrs->data, knot_rdataset_size(rrs));
 
-	// Store new data into node RRS.
+	// Store new data into node RRS, the copy is about to be modified.
 	rrs->data = copy;
+	node_invalidate_hash(node, type);
 
 	return KNOT_EOK;
 }
@@ -230,6 +231,7 @@ static int remove_rr(zone_tree_t *tree, zone_node_t *node,
 		}
 	} else {
 		// RRSet is empty now, remove it from node, all data freed.
+		free(removed_rrset.additional);
 		node_remove_rdataset(node, rr->type);
 		// If node is empty now, delete it from zone tree.
 		if (node->rrset_count == 0) {
@@ -416,36 +418,150 @@ static int prepare_zone_copy(zone_contents_t *old_contents,
 	return KNOT_EOK;
 }
 
-/*! \brief Removes empty nodes from updated zone a does zone adjusting. */
+/*! \brief Notes names touched by the changeset before it is applied. */
+static int note_touched(zone_touched_t *touched, const zone_contents_t *contents,
+                        const changeset_t *ch)
+{
+	int ret = zone_touched_note(touched, contents, ch->remove);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	return zone_touched_note(touched, contents, ch->add);
+}
+
+/*! \brief Notes names touched by all the changesets. */
+static int note_all_touched(zone_touched_t *touched,
+                            const zone_contents_t *contents, list_t *chsets)
+{
+	changeset_t *set = NULL;
+	WALK_LIST(set, *chsets) {
+		int ret = note_touched(touched, contents, set);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Adjusts updated zone, only touched nodes are relinked. */
 static int finalize_updated_zone(zone_contents_t *contents_copy,
-                                 bool set_nsec3_names)
+                                 const zone_touched_t *touched)
 {
 	if (contents_copy == NULL) {
 		return KNOT_EINVAL;
 	}
 
-	if (set_nsec3_names) {
-		return zone_contents_adjust_full(contents_copy, NULL, NULL);
-	} else {
-		return zone_contents_adjust_pointers(contents_copy);
-	}
+	return zone_contents_adjust_touched(contents_copy, touched);
 }
 
 /* ------------------------------- API -------------------------------------- */
 
-int apply_changesets(zone_t *zone, list_t *chsets, zone_contents_t **new_contents)
+int apply_begin(apply_ctx_t *ctx, zone_t *zone)
 {
-	if (zone == NULL || chsets == NULL || EMPTY_LIST(*chsets) || new_contents == NULL) {
+	if (ctx == NULL || zone == NULL || zone->contents == NULL) {
 		return KNOT_EINVAL;
 	}
 
-	zone_contents_t *old_contents = zone->contents;
-	if (!old_contents) {
+	memset(ctx, 0, sizeof(*ctx));
+	int ret = zone_touched_init(&ctx->touched);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = prepare_zone_copy(zone->contents, &ctx->contents);
+	if (ret != KNOT_EOK) {
+		zone_touched_clear(&ctx->touched);
+		return ret;
+	}
+
+	ctx->base = zone->contents;
+	ctx->master = (zone_master(zone) == NULL);
+
+	return KNOT_EOK;
+}
+
+int apply_step(apply_ctx_t *ctx, changeset_t *ch)
+{
+	if (ctx == NULL || ctx->contents == NULL || ch == NULL) {
 		return KNOT_EINVAL;
 	}
 
-	zone_contents_t *contents_copy = NULL;
-	int ret = prepare_zone_copy(old_contents, &contents_copy);
+	int ret = note_touched(&ctx->touched, ctx->contents, ch);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	return apply_single(ctx->contents, ch, ctx->master);
+}
+
+int apply_finish(apply_ctx_t *ctx, zone_contents_t **new_contents)
+{
+	if (ctx == NULL || ctx->contents == NULL || new_contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	assert(ctx->contents->apex != NULL);
+
+	int ret = finalize_updated_zone(ctx->contents, &ctx->touched);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	zone_touched_clear(&ctx->touched);
+	*new_contents = ctx->contents;
+	ctx->contents = NULL;
+	ctx->base = NULL;
+
+	return KNOT_EOK;
+}
+
+int apply_commit(apply_ctx_t *ctx, zone_t *zone, list_t *chsets,
+                 zone_contents_t **new_contents, bool *applied)
+{
+	if (zone == NULL || chsets == NULL || applied == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	*applied = false;
+	int ret = apply_finish(ctx, new_contents);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	*applied = true;
+
+	ret = zone_changes_store(zone, chsets);
+	if (ret != KNOT_EOK) {
+		updates_rollback(chsets);
+		update_free_zone(new_contents);
+		return ret;
+	}
+
+	return KNOT_EOK;
+}
+
+void apply_abort(apply_ctx_t *ctx)
+{
+	if (ctx == NULL) {
+		return;
+	}
+
+	if (ctx->contents != NULL) {
+		update_free_zone(&ctx->contents);
+	}
+	zone_touched_clear(&ctx->touched);
+	ctx->base = NULL;
+}
+
+int apply_changesets(zone_t *zone, list_t *chsets, zone_contents_t **new_contents)
+{
+	if (zone == NULL || chsets == NULL || EMPTY_LIST(*chsets) || new_contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	apply_ctx_t ctx;
+	int ret = apply_begin(&ctx, zone);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -454,27 +570,22 @@ int apply_changesets(zone_t *zone, list_t *chsets, zone_contents_t **new_content
 	 * Apply the changesets.
 	 */
 	changeset_t *set = NULL;
-	const bool master = (zone_master(zone) == NULL);
 	WALK_LIST(set, *chsets) {
-		ret = apply_single(contents_copy, set, master);
+		ret = apply_step(&ctx, set);
 		if (ret != KNOT_EOK) {
 			updates_rollback(chsets);
-			update_free_zone(&contents_copy);
+			apply_abort(&ctx);
 			return ret;
 		}
 	}
 
-	assert(contents_copy->apex != NULL);
-
-	ret = finalize_updated_zone(contents_copy, true);
+	ret = apply_finish(&ctx, new_contents);
 	if (ret != KNOT_EOK) {
 		updates_rollback(chsets);
-		update_free_zone(&contents_copy);
+		apply_abort(&ctx);
 		return ret;
 	}
 
-	*new_contents = contents_copy;
-
 	return KNOT_EOK;
 }
 
@@ -495,15 +606,31 @@ int apply_changeset(zone_t *zone, changeset_t *change, zone_contents_t **new_con
 		return ret;
 	}
 
+	zone_touched_t touched;
+	ret = zone_touched_init(&touched);
+	if (ret != KNOT_EOK) {
+		update_free_zone(&contents_copy);
+		return ret;
+	}
+
+	ret = note_touched(&touched, contents_copy, change);
+	if (ret != KNOT_EOK) {
+		zone_touched_clear(&touched);
+		update_free_zone(&contents_copy);
+		return ret;
+	}
+
 	const bool master = (zone_master(zone) == NULL);
 	ret = apply_single(contents_copy, change, master);
 	if (ret != KNOT_EOK) {
+		zone_touched_clear(&touched);
 		update_rollback(change);
 		update_free_zone(&contents_copy);
 		return ret;
 	}
 
-	ret = finalize_updated_zone(contents_copy, true);
+	ret = finalize_updated_zone(contents_copy, &touched);
+	zone_touched_clear(&touched);
 	if (ret != KNOT_EOK) {
 		update_rollback(change);
 		update_free_zone(&contents_copy);
@@ -521,17 +648,31 @@ int apply_changesets_directly(zone_contents_t *contents, list_t *chsets)
 		return KNOT_EINVAL;
 	}
 
+	zone_touched_t touched;
+	int ret = zone_touched_init(&touched);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = note_all_touched(&touched, contents, chsets);
+	if (ret != KNOT_EOK) {
+		zone_touched_clear(&touched);
+		return ret;
+	}
+
 	changeset_t *set = NULL;
 	WALK_LIST(set, *chsets) {
 		const bool master = true; // Only DNSSEC changesets are applied directly.
-		int ret = apply_single(contents, set, master);
+		ret = apply_single(contents, set, master);
 		if (ret != KNOT_EOK) {
+			zone_touched_clear(&touched);
 			updates_cleanup(chsets);
 			return ret;
 		}
 	}
 
-	int ret = finalize_updated_zone(contents, true);
+	ret = finalize_updated_zone(contents, &touched);
+	zone_touched_clear(&touched);
 	if (ret != KNOT_EOK) {
 		updates_cleanup(chsets);
 	}
@@ -545,14 +686,28 @@ int apply_changeset_directly(zone_contents_t *contents, changeset_t *ch)
 		return KNOT_EINVAL;
 	}
 
+	zone_touched_t touched;
+	int ret = zone_touched_init(&touched);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = note_touched(&touched, contents, ch);
+	if (ret != KNOT_EOK) {
+		zone_touched_clear(&touched);
+		return ret;
+	}
+
 	const bool master = true; // Only DNSSEC changesets are applied directly.
-	int ret = apply_single(contents, ch, master);
+	ret = apply_single(contents, ch, master);
 	if (ret != KNOT_EOK) {
+		zone_touched_clear(&touched);
 		update_cleanup(ch);
 		return ret;
 	}
 
-	ret = finalize_updated_zone(contents, true);
+	ret = finalize_updated_zone(contents, &touched);
+	zone_touched_clear(&touched);
 	if (ret != KNOT_EOK) {
 		update_cleanup(ch);
 		return ret;
@@ -614,6 +769,7 @@ void update_free_zone(zone_contents_t **contents)
 	zone_tree_deep_free(&(*contents)->nsec3_nodes);
 
 	knot_nsec3param_free(&(*contents)->nsec3_params);
+	nsec3_cache_free((*contents)->nsec3_cache);
 
 	free(*contents);
 	*contents = NULL;
@@ -34,6 +34,73 @@
 #include "knot/zone/zone.h"
 #include "knot/updates/changesets.h"
 
+/*! \brief Zone update staged in a shallow copy, changesets applied one by one. */
+typedef struct apply_ctx {
+	zone_contents_t *base;     /*!< Contents the copy was made from. */
+	zone_contents_t *contents; /*!< Updated shallow copy. */
+	zone_touched_t touched;    /*!< Names touched by applied changesets. */
+	bool master;               /*!< Zone is a master for the changes. */
+} apply_ctx_t;
+
+/*!
+ * \brief Starts staged update, creates shallow copy of current zone contents.
+ *
+ * \param ctx   Staged update context.
+ * \param zone  Zone to be updated.
+ *
+ * \return KNOT_E*
+ */
+int apply_begin(apply_ctx_t *ctx, zone_t *zone);
+
+/*!
+ * \brief Applies single changeset to the staged copy, without adjusting it.
+ *
+ * \note On failure, the staged copy is no longer consistent and the update
+ *       must be aborted.
+ *
+ * \param ctx  Staged update context.
+ * \param ch   Change to be made.
+ *
+ * \return KNOT_E*
+ */
+int apply_step(apply_ctx_t *ctx, changeset_t *ch);
+
+/*!
+ * \brief Adjusts the staged copy and returns it as new zone contents.
+ *
+ * \param ctx           Staged update context.
+ * \param new_contents  New zone will be returned using this arg.
+ *
+ * \return KNOT_E*
+ */
+int apply_finish(apply_ctx_t *ctx, zone_contents_t **new_contents);
+
+/*!
+ * \brief Adjusts the staged copy, then stores the changesets in the journal.
+ *
+ * The journal is written only after the staged copy was adjusted, so it
+ * never holds changes that were not applied. If the journal write fails,
+ * the changesets are rolled back and the new contents freed.
+ *
+ * \param ctx           Staged update context.
+ * \param zone          Updated zone (journal owner).
+ * \param chsets        Applied changesets.
+ * \param new_contents  New zone will be returned using this arg.
+ * \param applied       Set to true if the staged copy was adjusted.
+ *
+ * \return KNOT_E*
+ */
+int apply_commit(apply_ctx_t *ctx, zone_t *zone, list_t *chsets,
+                 zone_contents_t **new_contents, bool *applied);
+
+/*!
+ * \brief Frees staged copy and context, changesets must be rolled back
+ *        by the caller.
+ *
+ * \param ctx  Staged update context.
+ */
+void apply_abort(apply_ctx_t *ctx);
+
 /*!
  * \brief Applies changesets *with* zone shallow copy.
  *
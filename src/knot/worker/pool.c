@@ -25,26 +25,94 @@
 #include "knot/worker/pool.h"
 #include "libknot/dnssec/crypto.h"
 
+/*!
+ * \brief Task queues owned by one worker thread, one lane per priority.
+ *
+ * Tasks are assigned to the queues in round-robin fashion. The owner takes
+ * tasks from its own queues first, idle workers steal from the others.
+ */
+struct worker_queues {
+	pthread_mutex_t lock;
+	volatile unsigned count[TASK_PRIO_COUNT];	/*!< Lane sizes (hint). */
+	worker_queue_t lanes[TASK_PRIO_COUNT];
+};
+
 /*!
  * \brief Worker pool state.
  */
 struct worker_pool {
 	dt_unit_t *threads;
+	unsigned thread_count;
+	struct worker_queues *queues;	/*!< Queues for each thread. */
+	unsigned next_queue;		/*!< Round-robin assignment. */
+
+	pthread_mutex_t lock;		/*!< Protects parking of idle threads. */
+	pthread_cond_t wake;		/*!< Signalled for idle threads. */
+	pthread_cond_t done;		/*!< Signalled when all tasks are done. */
+	unsigned idle;			/*!< Number of parked threads. */
+
+	volatile bool terminating;	/*!< Is the pool terminating? .*/
+	volatile bool suspended;	/*!< Is execution temporarily suspended? .*/
+	volatile unsigned pending;	/*!< Number of enqueued tasks. */
+	volatile unsigned running;	/*!< Number of running threads. */
+};
 
-	pthread_mutex_t lock;
-	pthread_cond_t wake;
+/*! \brief Take a task from given lane of the queues. */
+static task_t *queues_take(worker_pool_t *pool, struct worker_queues *q, int prio)
+{
+	if (q->count[prio] == 0) {
+		return NULL;
+	}
 
-	bool terminating;	/*!< Is the pool terminating? .*/
-	bool suspended;		/*!< Is execution temporarily suspended? .*/
-	int running;		/*!< Number of running threads. */
-	worker_queue_t tasks;
-};
+	pthread_mutex_lock(&q->lock);
+	task_t *task = worker_queue_dequeue(&q->lanes[prio]);
+	if (task != NULL) {
+		q->count[prio] -= 1;
+		__sync_add_and_fetch(&pool->running, 1);
+		__sync_sub_and_fetch(&pool->pending, 1);
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	return task;
+}
+
+/*!
+ * \brief Take the task with the highest priority.
+ *
+ * The own queue is preferred within a priority class, a task with higher
+ * priority is stolen from other threads before a lower priority one is taken.
+ */
+static task_t *pool_take(worker_pool_t *pool, unsigned id)
+{
+	for (int prio = 0; prio < TASK_PRIO_COUNT; prio++) {
+		for (unsigned i = 0; i < pool->thread_count; i++) {
+			struct worker_queues *q = &pool->queues[(id + i) % pool->thread_count];
+			task_t *task = queues_take(pool, q, prio);
+			if (task != NULL) {
+				return task;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*! \brief Notify waiting threads if there is no work left. */
+static void pool_check_done(worker_pool_t *pool)
+{
+	if (pool->pending == 0 && pool->running == 0) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_broadcast(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
 
 /*!
  * \brief Worker thread.
  *
- * The thread takes a task from the tasks queue and runs it, while checking
- * if the dispatching of new tasks is allowed by the thread pool.
+ * The thread takes a task from the task queues and runs it, while checking
+ * if the dispatching of new tasks is allowed by the thread pool. The thread
+ * is parked if there is nothing to do.
  *
  * An execution of a running thread cannot be enforced.
  *
@@ -54,37 +122,36 @@ static int worker_main(dthread_t *thread)
 	assert(thread);
 
 	worker_pool_t *pool = thread->data;
-
-	pthread_mutex_lock(&pool->lock);
+	unsigned id = dt_get_id(thread);
 
 	for (;;) {
-		if (pool->terminating) {
-			break;
-		}
-
 		task_t *task = NULL;
-		if (!pool->suspended) {
-			task = worker_queue_dequeue(&pool->tasks);
+		if (!pool->suspended && !pool->terminating) {
+			task = pool_take(pool, id);
 		}
 
-		if (task == NULL) {
-			pthread_cond_wait(&pool->wake, &pool->lock);
+		if (task != NULL) {
+			assert(task->run);
+			task->run(task);
+			__sync_sub_and_fetch(&pool->running, 1);
+			pool_check_done(pool);
 			continue;
 		}
 
-		assert(task->run);
-		pool->running += 1;
-
-		pthread_mutex_unlock(&pool->lock);
-		task->run(task);
 		pthread_mutex_lock(&pool->lock);
+		while (!pool->terminating && (pool->suspended || pool->pending == 0)) {
+			pool->idle += 1;
+			pthread_cond_wait(&pool->wake, &pool->lock);
+			pool->idle -= 1;
+		}
+		bool terminating = pool->terminating;
+		pthread_mutex_unlock(&pool->lock);
 
-		pool->running -= 1;
-		pthread_cond_broadcast(&pool->wake);
+		if (terminating) {
+			break;
+		}
 	}
 
-	pthread_mutex_unlock(&pool->lock);
-
 	return KNOT_EOK;
 }
 
@@ -95,16 +162,44 @@ static int worker_cleanup(dthread_t *thread)
 	return KNOT_EOK;
 }
 
+/*! \brief Remove all enqueued tasks. */
+static void pool_drain(worker_pool_t *pool)
+{
+	for (unsigned i = 0; i < pool->thread_count; i++) {
+		struct worker_queues *q = &pool->queues[i];
+		pthread_mutex_lock(&q->lock);
+		for (int prio = 0; prio < TASK_PRIO_COUNT; prio++) {
+			__sync_sub_and_fetch(&pool->pending, q->count[prio]);
+			q->count[prio] = 0;
+			worker_queue_deinit(&q->lanes[prio]);
+			worker_queue_init(&q->lanes[prio]);
+		}
+		pthread_mutex_unlock(&q->lock);
+	}
+}
+
 /* -- public API ------------------------------------------------------------ */
 
 worker_pool_t *worker_pool_create(unsigned threads)
 {
+	if (threads == 0) {
+		return NULL;
+	}
+
 	worker_pool_t *pool = malloc(sizeof(worker_pool_t));
 	if (pool == NULL) {
 		return NULL;
 	}
 
 	memset(pool, 0, sizeof(worker_pool_t));
+	pool->thread_count = threads;
+
+	pool->queues = calloc(threads, sizeof(struct worker_queues));
+	if (pool->queues == NULL) {
+		free(pool);
+		return NULL;
+	}
+
 	pool->threads = dt_create(threads, worker_main, worker_cleanup, pool);
 	if (pool->threads == NULL) {
 		goto fail;
@@ -114,16 +209,24 @@ worker_pool_t *worker_pool_create(unsigned threads)
 		goto fail;
 	}
 
-	if (pthread_cond_init(&pool->wake, NULL) != 0) {
+	if (pthread_cond_init(&pool->wake, NULL) != 0 ||
+	    pthread_cond_init(&pool->done, NULL) != 0) {
 		goto fail;
 	}
 
-	worker_queue_init(&pool->tasks);
+	for (unsigned i = 0; i < threads; i++) {
+		struct worker_queues *q = &pool->queues[i];
+		pthread_mutex_init(&q->lock, NULL);
+		for (int prio = 0; prio < TASK_PRIO_COUNT; prio++) {
+			worker_queue_init(&q->lanes[prio]);
+		}
+	}
 
 	return pool;
 
 fail:
 	dt_delete(&pool->threads);
+	free(pool->queues);
 	free(pool);
 	return NULL;
 }
@@ -138,9 +241,17 @@ void worker_pool_destroy(worker_pool_t *pool)
 
 	pthread_mutex_destroy(&pool->lock);
 	pthread_cond_destroy(&pool->wake);
+	pthread_cond_destroy(&pool->done);
 
-	worker_queue_deinit(&pool->tasks);
+	for (unsigned i = 0; i < pool->thread_count; i++) {
+		struct worker_queues *q = &pool->queues[i];
+		for (int prio = 0; prio < TASK_PRIO_COUNT; prio++) {
+			worker_queue_deinit(&q->lanes[prio]);
+		}
+		pthread_mutex_destroy(&q->lock);
+	}
 
+	free(pool->queues);
 	free(pool);
 }
 
@@ -206,8 +317,8 @@ void worker_pool_wait(worker_pool_t *pool)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	while (!EMPTY_LIST(pool->tasks.list) || pool->running > 0) {
-		pthread_cond_wait(&pool->wake, &pool->lock);
+	while (pool->pending > 0 || pool->running > 0) {
+		pthread_cond_wait(&pool->done, &pool->lock);
 	}
 	pthread_mutex_unlock(&pool->lock);
 }
@@ -218,9 +329,25 @@ void worker_pool_assign(worker_pool_t *pool, struct task *task)
 		return;
 	}
 
+	int prio = task->prio;
+	if (prio < 0 || prio >= TASK_PRIO_COUNT) {
+		prio = TASK_PRIO_NORMAL;
+	}
+
+	unsigned id = __sync_fetch_and_add(&pool->next_queue, 1) % pool->thread_count;
+	struct worker_queues *q = &pool->queues[id];
+
+	pthread_mutex_lock(&q->lock);
+	worker_queue_enqueue(&q->lanes[prio], task);
+	q->count[prio] += 1;
+	__sync_add_and_fetch(&pool->pending, 1);
+	pthread_mutex_unlock(&q->lock);
+
+	/* Wake up a single parked thread, the others may steal the task. */
 	pthread_mutex_lock(&pool->lock);
-	worker_queue_enqueue(&pool->tasks, task);
-	pthread_cond_signal(&pool->wake);
+	if (pool->idle > 0) {
+		pthread_cond_signal(&pool->wake);
+	}
 	pthread_mutex_unlock(&pool->lock);
 }
 
@@ -230,8 +357,6 @@ void worker_pool_clear(worker_pool_t *pool)
 		return;
 	}
 
-	pthread_mutex_lock(&pool->lock);
-	worker_queue_deinit(&pool->tasks);
-	worker_queue_init(&pool->tasks);
-	pthread_mutex_unlock(&pool->lock);
+	pool_drain(pool);
+	pool_check_done(pool);
 }
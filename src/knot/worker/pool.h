@@ -68,6 +68,9 @@ void worker_pool_wait(worker_pool_t *pool);
 
 /*!
  * \brief Assign a task to be performed by a worker in the pool.
+ *
+ * Tasks are executed in the order of their priority class. A task is queued
+ * at one of the workers, idle workers steal tasks queued at busy ones.
  */
 void worker_pool_assign(worker_pool_t *pool, struct task *task);
 
@@ -21,12 +21,23 @@
 struct task;
 typedef void (*task_cb)(struct task *);
 
+/*!
+ * \brief Task priority class, tasks of higher class are executed first.
+ */
+typedef enum task_prio {
+	TASK_PRIO_HIGH = 0,	/*!< Short latency sensitive tasks. */
+	TASK_PRIO_NORMAL,	/*!< Common tasks. */
+	TASK_PRIO_LOW,		/*!< Long running maintenance tasks. */
+	TASK_PRIO_COUNT
+} task_prio_t;
+
 /*!
  * \brief Task executable by a worker.
  */
 typedef struct task {
 	void *ctx;
 	task_cb run;
+	task_prio_t prio;
 } task_t;
 
 /*!
@@ -716,6 +716,88 @@ static int recreate_nsec3_tree(const zone_contents_t *z, zone_contents_t *out)
 	return KNOT_EOK;
 }
 
+/*! \brief Returns copy of the given original node, NULL if there is none. */
+static zone_node_t *copied_node(zone_tree_t *tree, const zone_node_t *orig)
+{
+	zone_node_t *copy = NULL;
+	if (orig != NULL) {
+		zone_tree_get(tree, orig->owner, &copy);
+	}
+
+	return copy;
+}
+
+/*!
+ * \brief Carries NSEC3 and additional links of an adjusted node into its copy.
+ *
+ * The links are resolved by owner in the copied trees, so the copy stays
+ * adjusted without recomputing the NSEC3 hashes or redoing the lookups.
+ */
+static int relink_node_copy(const zone_node_t *from, zone_contents_t *out)
+{
+	zone_node_t *to = copied_node(out->nodes, from);
+	if (to == NULL) {
+		return KNOT_ENOENT;
+	}
+
+	to->nsec3_node = copied_node(out->nsec3_nodes, from->nsec3_node);
+
+	for (uint16_t i = 0; i < from->rrset_count; ++i) {
+		const struct rr_data *from_data = &from->rrs[i];
+		if (from_data->additional == NULL) {
+			continue;
+		}
+
+		uint16_t rdcount = from_data->rrs.rr_count;
+		zone_node_t **additional = malloc(rdcount * sizeof(zone_node_t *));
+		if (additional == NULL) {
+			return KNOT_ENOMEM;
+		}
+
+		for (uint16_t j = 0; j < rdcount; ++j) {
+			additional[j] = copied_node(out->nodes,
+			                            from_data->additional[j]);
+		}
+		to->rrs[i].additional = additional;
+	}
+
+	return KNOT_EOK;
+}
+
+static int relink_normal_tree(const zone_contents_t *z, zone_contents_t *out)
+{
+	hattrie_iter_t *itt = hattrie_iter_begin(z->nodes, false);
+	if (itt == NULL) {
+		return KNOT_ENOMEM;
+	}
+	while (!hattrie_iter_finished(itt)) {
+		const zone_node_t *from = (zone_node_t *)*hattrie_iter_val(itt);
+		int ret = relink_node_copy(from, out);
+		if (ret != KNOT_EOK) {
+			hattrie_iter_free(itt);
+			return ret;
+		}
+		hattrie_iter_next(itt);
+	}
+
+	hattrie_iter_free(itt);
+
+	return KNOT_EOK;
+}
+
+/*! \brief Frees additional data from single node. */
+static int free_additional(zone_node_t **tnode, void *data)
+{
+	UNUSED(data);
+	zone_node_t *node = *tnode;
+	for (uint16_t i = 0; i < node->rrset_count; ++i) {
+		free(node->rrs[i].additional);
+		node->rrs[i].additional = NULL;
+	}
+
+	return KNOT_EOK;
+}
+
 static bool rrset_is_nsec3rel(const knot_rrset_t *rr)
 {
 	if (rr == NULL) {
@@ -913,10 +995,13 @@ const zone_node_t *zone_contents_find_nsec3_node(const zone_contents_t *zone,
 
 /*----------------------------------------------------------------------------*/
 
-int zone_contents_find_nsec3_for_name(const zone_contents_t *zone,
-                                      const knot_dname_t *name,
-                                      const zone_node_t **nsec3_node,
-                                      const zone_node_t **nsec3_previous)
+/*!
+ * \brief Finds NSEC3 node and previous NSEC3 node for the name, not cached.
+ */
+static int find_nsec3_for_name(const zone_contents_t *zone,
+                               const knot_dname_t *name,
+                               const zone_node_t **nsec3_node,
+                               const zone_node_t **nsec3_previous)
 {
 	if (zone == NULL || name == NULL
 	    || nsec3_node == NULL || nsec3_previous == NULL) {
@@ -1020,9 +1105,52 @@ dbg_zone_exec_detail(
 		}
 	}
 
-	return (exact_match)
-	       ? ZONE_NAME_FOUND
-	       : ZONE_NAME_NOT_FOUND;
+	return (exact_match) ? ZONE_NAME_FOUND : ZONE_NAME_NOT_FOUND;
+}
+
+int zone_contents_find_nsec3_for_name(const zone_contents_t *zone,
+                                      const knot_dname_t *name,
+                                      const zone_node_t **nsec3_node,
+                                      const zone_node_t **nsec3_previous)
+{
+	if (zone == NULL || name == NULL
+	    || nsec3_node == NULL || nsec3_previous == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	// only wildcard names repeat across queries, other names (next closer
+	// names of random subdomains) would just churn the cache
+	if (!knot_dname_is_wildcard(name)) {
+		return find_nsec3_for_name(zone, name, nsec3_node, nsec3_previous);
+	}
+
+	// repeated lookups skip hashing and the NSEC3 tree search
+	nsec3_cache_result_t cached;
+	if (nsec3_cache_get(zone->nsec3_cache, name, &cached)) {
+		*nsec3_node = cached.node;
+		*nsec3_previous = cached.previous;
+		return cached.match;
+	}
+
+	int ret = find_nsec3_for_name(zone, name, nsec3_node, nsec3_previous);
+	if (ret < 0) {
+		return ret;
+	}
+
+	cached.node = *nsec3_node;
+	cached.previous = *nsec3_previous;
+	cached.match = ret;
+	nsec3_cache_put(zone->nsec3_cache, name, &cached);
+
+	return ret;
+}
+
+int zone_contents_find_nsec3_for_name_uncached(const zone_contents_t *zone,
+                                               const knot_dname_t *name,
+                                               const zone_node_t **nsec3_node,
+                                               const zone_node_t **nsec3_previous)
+{
+	return find_nsec3_for_name(zone, name, nsec3_node, nsec3_previous);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -1171,6 +1299,402 @@ int zone_contents_adjust_full(zone_contents_t *zone,
 
 /*----------------------------------------------------------------------------*/
 
+typedef struct {
+	zone_adjust_arg_t adjust;        /*!< Must be first, used by callbacks. */
+	const zone_touched_t *touched;   /*!< Names touched by the update. */
+	hattrie_t *removed;              /*!< Pointers to removed nodes. */
+	hattrie_t *nsec3_added;          /*!< Owners of added NSEC3 nodes. */
+	list_t relink;                   /*!< Nodes with outdated links. */
+	bool added;                      /*!< Some names were added. */
+	bool added_wildcard;             /*!< Some wildcard names were added. */
+} zone_adjust_touched_arg_t;
+
+static bool node_was_removed(hattrie_t *removed, const zone_node_t *node)
+{
+	return node != NULL && hattrie_weight(removed) > 0 &&
+	       hattrie_tryget(removed, (char *)&node, sizeof(node)) != NULL;
+}
+
+/*! \brief Checks if some of the additional links may point to changed names. */
+static bool additionals_changed(const zone_node_t *node,
+                                zone_adjust_touched_arg_t *args)
+{
+	const knot_dname_t *apex = args->adjust.zone->apex->owner;
+	for (uint16_t i = 0; i < node->rrset_count; ++i) {
+		const struct rr_data *rr_data = &node->rrs[i];
+		if (rr_data->additional == NULL) {
+			continue;
+		}
+
+		for (uint16_t j = 0; j < rr_data->rrs.rr_count; ++j) {
+			const zone_node_t *glue = rr_data->additional[j];
+			if (node_was_removed(args->removed, glue)) {
+				return true;
+			}
+
+			/* Only missing or wildcard glue may resolve to added names. */
+			if (!args->added || (glue != NULL &&
+			    !knot_dname_is_wildcard(glue->owner))) {
+				continue;
+			}
+
+			const knot_dname_t *dname = knot_rdata_name(&rr_data->rrs, j,
+			                                            rr_data->type);
+			if (!knot_dname_is_sub(dname, apex)) {
+				continue;
+			}
+			if (args->added_wildcard) {
+				return true;
+			}
+
+			uint8_t lf[KNOT_DNAME_MAXLEN];
+			knot_dname_lf(lf, dname, NULL);
+			if (hattrie_tryget(args->touched->nodes, (char *)lf + 1, *lf)) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/*! \brief Sets pointers and flags, remembers nodes with outdated links. */
+static int adjust_changed_node(zone_node_t **tnode, void *data)
+{
+	zone_adjust_touched_arg_t *args = (zone_adjust_touched_arg_t *)data;
+	zone_node_t *node = *tnode;
+
+	const uint8_t auth_flags = NODE_FLAGS_DELEG | NODE_FLAGS_NONAUTH;
+	const uint8_t old_flags = node->flags & auth_flags;
+
+	int ret = adjust_pointers(tnode, &args->adjust);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	if ((node->flags & auth_flags) != old_flags ||
+	    node_was_removed(args->removed, node->nsec3_node) ||
+	    additionals_changed(node, args)) {
+		if (ptrlist_add(&args->relink, node, NULL) == NULL) {
+			return KNOT_ENOMEM;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Compares state of touched names before and after the update.
+ *
+ * Nodes that still exist are queued for relinking, nodes that disappeared
+ * are remembered so that links pointing to them can be found.
+ */
+static int resolve_touched(hattrie_t *before, zone_tree_t *tree,
+                           zone_adjust_touched_arg_t *args, bool nsec3)
+{
+	if (hattrie_weight(before) == 0) {
+		return KNOT_EOK;
+	}
+
+	hattrie_iter_t *itt = hattrie_iter_begin(before, false);
+	if (itt == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	for (; !hattrie_iter_finished(itt); hattrie_iter_next(itt)) {
+		size_t len = 0;
+		const char *key = hattrie_iter_key(itt, &len);
+		zone_node_t *old_node = *hattrie_iter_val(itt);
+		value_t *val = hattrie_weight(tree) > 0 ?
+		               hattrie_tryget(tree, key, len) : NULL;
+		zone_node_t *new_node = val ? *val : NULL;
+
+		if (old_node != NULL && old_node != new_node) {
+			*hattrie_get(args->removed, (char *)&old_node,
+			             sizeof(old_node)) = old_node;
+		}
+
+		if (new_node == NULL) {
+			continue;
+		}
+
+		if (nsec3) {
+			if (old_node == NULL) {
+				*hattrie_get(args->nsec3_added, key, len) = new_node;
+			}
+			continue;
+		}
+
+		if (old_node == NULL) {
+			args->added = true;
+			if (knot_dname_is_wildcard(new_node->owner)) {
+				args->added_wildcard = true;
+			}
+		}
+
+		/* Stale additionals, the node will be rediscovered anyway. */
+		free_additional(&new_node, NULL);
+		if (ptrlist_add(&args->relink, new_node, NULL) == NULL) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
+	}
+
+	hattrie_iter_free(itt);
+
+	return ret;
+}
+
+/*! \brief Relinks NSEC3 nodes and additionals of nodes affected by update. */
+static int relink_changed_nodes(zone_adjust_touched_arg_t *args)
+{
+	ptrnode_t *n = NULL;
+	WALK_LIST(n, args->relink) {
+		zone_node_t *node = (zone_node_t *)n->d;
+		int ret = adjust_nsec3_pointers(&node, &args->adjust);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		ret = adjust_additional(&node, &args->adjust);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		if (node->nsec3_node && hattrie_weight(args->nsec3_added) > 0) {
+			uint8_t lf[KNOT_DNAME_MAXLEN];
+			knot_dname_lf(lf, node->nsec3_node->owner, NULL);
+			hattrie_del(args->nsec3_added, (char *)lf + 1, *lf);
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static int adjust_touched(zone_contents_t *zone, zone_adjust_touched_arg_t *args)
+{
+	int ret = resolve_touched(args->touched->nodes, zone->nodes, args, false);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = resolve_touched(args->touched->nsec3_nodes, zone->nsec3_nodes,
+	                      args, true);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	/* Cheap linear pass, no hashing or lookups unless something changed. */
+	ret = zone_contents_adjust_nodes(zone->nodes, &args->adjust,
+	                                 adjust_changed_node);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	assert(zone->apex == args->adjust.first_node);
+
+	ret = zone_contents_adjust_nodes(zone->nsec3_nodes, &args->adjust,
+	                                 zone_contents_adjust_nsec3_node);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = relink_changed_nodes(args);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	/* Added NSEC3 node not claimed by any touched node, relink all. */
+	if (hattrie_weight(args->nsec3_added) > 0) {
+		return zone_tree_apply(zone->nodes, adjust_nsec3_pointers,
+		                       &args->adjust);
+	}
+
+	return KNOT_EOK;
+}
+
+int zone_contents_adjust_touched(zone_contents_t *zone,
+                                 const zone_touched_t *touched)
+{
+	if (zone == NULL || touched == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (touched->full) {
+		return zone_contents_adjust_full(zone, NULL, NULL);
+	}
+
+	int ret = zone_contents_load_nsec3param(zone);
+	if (ret != KNOT_EOK) {
+		log_zone_error(zone->apex->owner,
+			       "failed to load NSEC3 parameters (%s)",
+			       knot_strerror(ret));
+		return ret;
+	}
+
+	zone_adjust_touched_arg_t args = {
+		.adjust = { .zone = zone },
+		.touched = touched,
+		.removed = hattrie_create(),
+		.nsec3_added = hattrie_create()
+	};
+	init_list(&args.relink);
+
+	if (args.removed == NULL || args.nsec3_added == NULL) {
+		ret = KNOT_ENOMEM;
+	} else {
+		ret = adjust_touched(zone, &args);
+	}
+
+	ptrlist_free(&args.relink, NULL);
+	hattrie_free(args.removed);
+	hattrie_free(args.nsec3_added);
+
+	return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+static int note_name(hattrie_t *names, zone_tree_t *tree,
+                     const knot_dname_t *name)
+{
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, name, NULL);
+
+	if (hattrie_tryget(names, (char *)lf + 1, *lf) != NULL) {
+		/* Noted already, ancestors as well. */
+		return KNOT_EEXIST;
+	}
+
+	value_t *val = hattrie_get(names, (char *)lf + 1, *lf);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	zone_node_t *node = NULL;
+	zone_tree_get(tree, name, &node);
+	*val = node;
+
+	return KNOT_EOK;
+}
+
+static int note_tree(zone_touched_t *touched, const zone_contents_t *zone,
+                     zone_tree_t *diff, bool nsec3)
+{
+	if (zone_tree_is_empty(diff)) {
+		return KNOT_EOK;
+	}
+
+	const knot_dname_t *apex = zone->apex->owner;
+
+	hattrie_iter_t *itt = hattrie_iter_begin(diff, false);
+	if (itt == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	for (; !hattrie_iter_finished(itt); hattrie_iter_next(itt)) {
+		const zone_node_t *diff_node = *hattrie_iter_val(itt);
+		if (nsec3) {
+			ret = note_name(touched->nsec3_nodes, zone->nsec3_nodes,
+			                diff_node->owner);
+			if (ret == KNOT_EEXIST) {
+				ret = KNOT_EOK;
+			}
+		} else {
+			/* Touched name and all its ancestors up to apex. */
+			const knot_dname_t *name = diff_node->owner;
+			while (name != NULL && (ret = note_name(touched->nodes,
+			       zone->nodes, name)) == KNOT_EOK) {
+				if (knot_dname_is_equal(name, apex)) {
+					break;
+				}
+				name = knot_wire_next_label(name, NULL);
+			}
+			if (ret == KNOT_EEXIST) {
+				ret = KNOT_EOK;
+			}
+		}
+
+		if (ret != KNOT_EOK) {
+			break;
+		}
+	}
+
+	hattrie_iter_free(itt);
+
+	return ret;
+}
+
+int zone_touched_init(zone_touched_t *touched)
+{
+	if (touched == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	memset(touched, 0, sizeof(*touched));
+	touched->nodes = hattrie_create();
+	touched->nsec3_nodes = hattrie_create();
+	if (touched->nodes == NULL || touched->nsec3_nodes == NULL) {
+		zone_touched_clear(touched);
+		return KNOT_ENOMEM;
+	}
+
+	return KNOT_EOK;
+}
+
+int zone_touched_note(zone_touched_t *touched, const zone_contents_t *zone,
+                      const zone_contents_t *diff)
+{
+	if (touched == NULL || zone == NULL || diff == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (touched->full) {
+		return KNOT_EOK;
+	}
+
+	/* Different NSEC3 parameters change links of all nodes. */
+	if (node_rrtype_exists(diff->apex, KNOT_RRTYPE_NSEC3PARAM)) {
+		touched->full = true;
+		return KNOT_EOK;
+	}
+
+	int ret = note_tree(touched, zone, diff->nodes, false);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	return note_tree(touched, zone, diff->nsec3_nodes, true);
+}
+
+void zone_touched_clear(zone_touched_t *touched)
+{
+	if (touched == NULL) {
+		return;
+	}
+
+	hattrie_free(touched->nodes);
+	hattrie_free(touched->nsec3_nodes);
+	memset(touched, 0, sizeof(*touched));
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*!
+ * \brief Get size of the NSEC3 lookup cache for the zone.
+ *
+ * Proofs are built for names derived from the existing names (closest
+ * enclosers, next closer names and their wildcards), the cache is thus
+ * bounded by the zone size.
+ */
+static size_t nsec3_cache_size(const zone_contents_t *zone)
+{
+	size_t size = 2 * zone_tree_weight(zone->nodes);
+	return (size < NSEC3_CACHE_MAX_SIZE) ? size : NSEC3_CACHE_MAX_SIZE;
+}
+
 int zone_contents_load_nsec3param(zone_contents_t *zone)
 {
 	if (zone == NULL || zone->apex == NULL) {
@@ -1187,6 +1711,19 @@ int zone_contents_load_nsec3param(zone_contents_t *zone)
 		}
 	} else {
 		memset(&zone->nsec3_params, 0, sizeof(knot_nsec3_params_t));
+		nsec3_cache_free(zone->nsec3_cache);
+		zone->nsec3_cache = NULL;
+		return KNOT_EOK;
+	}
+
+	if (zone->nsec3_cache == NULL) {
+		zone->nsec3_cache = nsec3_cache_new(nsec3_cache_size(zone));
+		if (zone->nsec3_cache == NULL) {
+			return KNOT_ENOMEM;
+		}
+	} else {
+		// contents adjusted again, the NSEC3 tree may have changed
+		nsec3_cache_flush(zone->nsec3_cache);
 	}
 
 	return KNOT_EOK;
@@ -1277,6 +1814,15 @@ int zone_contents_shallow_copy(const zone_contents_t *from, zone_contents_t **to
 		contents->nsec3_nodes = NULL;
 	}
 
+	ret = relink_normal_tree(from, contents);
+	if (ret != KNOT_EOK) {
+		zone_tree_apply(contents->nodes, free_additional, NULL);
+		zone_tree_deep_free(&contents->nodes);
+		zone_tree_deep_free(&contents->nsec3_nodes);
+		free(contents);
+		return ret;
+	}
+
 	*to = contents;
 	return KNOT_EOK;
 }
@@ -1296,6 +1842,7 @@ void zone_contents_free(zone_contents_t **contents)
 	zone_tree_free(&(*contents)->nsec3_nodes);
 
 	knot_nsec3param_free(&(*contents)->nsec3_params);
+	nsec3_cache_free((*contents)->nsec3_cache);
 
 	free(*contents);
 	*contents = NULL;
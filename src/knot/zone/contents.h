@@ -29,6 +29,7 @@
 #include "libknot/internal/lists.h"
 #include "libknot/rrtype/nsec3param.h"
 #include "knot/zone/node.h"
+#include "knot/zone/nsec3-cache.h"
 #include "knot/zone/zone-tree.h"
 
 struct zone;
@@ -47,8 +48,21 @@ typedef struct zone_contents {
 	zone_tree_t *nsec3_nodes;
 
 	knot_nsec3_params_t nsec3_params;
+	nsec3_cache_t *nsec3_cache; /*!< Cached NSEC3 lookups, NULL without NSEC3PARAM. */
 } zone_contents_t;
 
+/*!
+ * \brief Names touched by an update, used to adjust only affected nodes.
+ *
+ * Maps touched names (and their ancestors) to the nodes they had in the zone
+ * contents before the update, NULL for names that did not exist.
+ */
+typedef struct zone_touched {
+	hattrie_t *nodes;        /*!< Touched normal names. */
+	hattrie_t *nsec3_nodes;  /*!< Touched NSEC3 names. */
+	bool full;               /*!< Full adjusting needed (NSEC3PARAM change). */
+} zone_touched_t;
+
 /*!
  * \brief Signature of callback for zone contents apply functions.
  */
@@ -130,7 +144,8 @@ const zone_node_t *zone_contents_find_nsec3_node(const zone_contents_t *contents
  *        corresponding to the given domain name.
  *
  * This functions creates a NSEC3 hash of \a name and tries to find NSEC3 node
- * with the hashed domain name as owner.
+ * with the hashed domain name as owner. Results for wildcard names are kept
+ * in the NSEC3 lookup cache of the zone, other names are looked up directly.
  *
  * \param[in] zone Zone to search in.
  * \param[in] name Domain name to get the corresponding NSEC3 nodes for.
@@ -151,6 +166,20 @@ int zone_contents_find_nsec3_for_name(const zone_contents_t *contents,
                                       const zone_node_t **nsec3_node,
                                       const zone_node_t **nsec3_previous);
 
+/*!
+ * \brief Finds NSEC3 node and previous NSEC3 node for the domain name,
+ *        bypassing the NSEC3 lookup cache.
+ *
+ * Meant for bulk lookups of many different names (e.g. semantic checks),
+ * which would only evict the names repeated in answers from the cache.
+ *
+ * \see zone_contents_find_nsec3_for_name()
+ */
+int zone_contents_find_nsec3_for_name_uncached(const zone_contents_t *contents,
+                                               const knot_dname_t *name,
+                                               const zone_node_t **nsec3_node,
+                                               const zone_node_t **nsec3_previous);
+
 const zone_node_t *zone_contents_find_wildcard_child(const zone_contents_t *contents,
                                                      const zone_node_t *parent);
 
@@ -174,6 +203,49 @@ int zone_contents_adjust_full(zone_contents_t *contents,
                               zone_node_t **first_nsec3_node,
                               zone_node_t **last_nsec3_node);
 
+/*!
+ * \brief Adjusts zone contents after an update, recomputing NSEC3 links and
+ *        additionals only for the nodes affected by the update.
+ *
+ * Pointers and flags are still set in a single (cheap) pass over the zone.
+ * The contents must have been adjusted before the update was applied.
+ *
+ * \note Only the adjusting is incremental. Applying an update to a shallow
+ *       copy of the zone and relinking its nodes is still linear in the zone
+ *       size.
+ *
+ * \param contents  Updated zone contents.
+ * \param touched   Names touched by the update, noted before it was applied.
+ *
+ * \return KNOT_E*
+ */
+int zone_contents_adjust_touched(zone_contents_t *contents,
+                                 const zone_touched_t *touched);
+
+/*!
+ * \brief Initializes structure for tracking names touched by an update.
+ */
+int zone_touched_init(zone_touched_t *touched);
+
+/*!
+ * \brief Notes names from update part \a diff, as present in \a contents.
+ *
+ * \note Has to be called before the update is applied to \a contents.
+ *
+ * \param touched   Touched names.
+ * \param contents  Zone contents to be updated.
+ * \param diff      Update part (changeset additions or removals).
+ *
+ * \return KNOT_E*
+ */
+int zone_touched_note(zone_touched_t *touched, const zone_contents_t *contents,
+                      const zone_contents_t *diff);
+
+/*!
+ * \brief Frees structure for tracking names touched by an update.
+ */
+void zone_touched_clear(zone_touched_t *touched);
+
 /*!
  * \brief Parses the NSEC3PARAM record stored in the zone.
  *
@@ -246,7 +318,8 @@ int zone_contents_nsec3_apply_inorder(zone_contents_t *zone,
  * regular nodes and for NSEC3 nodes, creates new hash table and a new domain
  * table. It also fills these structures with the exact same data as the
  * original zone is - no copying of stored data is done, just pointers are
- * copied.
+ * copied. NSEC3 and additional links are carried over into the copied trees,
+ * so that the copy can be adjusted incrementally after an update.
  *
  * \param from Original zone.
  * \param to Copy of the zone.
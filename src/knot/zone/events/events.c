@@ -39,17 +39,18 @@ typedef struct event_info {
 	zone_event_type_t type;
 	const zone_event_cb callback;
 	const char *name;
+	task_prio_t prio;
 } event_info_t;
 
 static const event_info_t EVENT_INFO[] = {
-        { ZONE_EVENT_RELOAD,  event_reload,  "reload" },
-        { ZONE_EVENT_REFRESH, event_refresh, "refresh" },
-        { ZONE_EVENT_XFER,    event_xfer,    "transfer" },
-        { ZONE_EVENT_UPDATE,  event_update,  "update" },
-        { ZONE_EVENT_EXPIRE,  event_expire,  "expiration" },
-        { ZONE_EVENT_FLUSH,   event_flush,   "journal flush" },
-        { ZONE_EVENT_NOTIFY,  event_notify,  "notify" },
-        { ZONE_EVENT_DNSSEC,  event_dnssec,  "DNSSEC resign" },
+        { ZONE_EVENT_RELOAD,  event_reload,  "reload",        TASK_PRIO_NORMAL },
+        { ZONE_EVENT_REFRESH, event_refresh, "refresh",       TASK_PRIO_NORMAL },
+        { ZONE_EVENT_XFER,    event_xfer,    "transfer",      TASK_PRIO_NORMAL },
+        { ZONE_EVENT_UPDATE,  event_update,  "update",        TASK_PRIO_HIGH },
+        { ZONE_EVENT_EXPIRE,  event_expire,  "expiration",    TASK_PRIO_NORMAL },
+        { ZONE_EVENT_FLUSH,   event_flush,   "journal flush", TASK_PRIO_LOW },
+        { ZONE_EVENT_NOTIFY,  event_notify,  "notify",        TASK_PRIO_HIGH },
+        { ZONE_EVENT_DNSSEC,  event_dnssec,  "DNSSEC resign", TASK_PRIO_LOW },
         { 0 }
 };
 
@@ -155,6 +156,19 @@ static void reschedule(zone_events_t *events)
 	evsched_schedule(events->event, diff * 1000);
 }
 
+/*!
+ * \brief Assign the event task to a worker with the priority of the next event.
+ *
+ * The events mutex must be locked when calling this function.
+ */
+static void assign_task(zone_events_t *events)
+{
+	zone_event_type_t type = get_next_event(events);
+	events->task.prio = valid_event(type) ? get_event_info(type)->prio :
+	                                        TASK_PRIO_NORMAL;
+	worker_pool_assign(events->pool, &events->task);
+}
+
 /* -- callbacks control ----------------------------------------------------- */
 
 /*!
@@ -209,7 +223,7 @@ static int event_dispatch(event_t *event)
 	pthread_mutex_lock(&events->mx);
 	if (!events->running && !events->frozen) {
 		events->running = true;
-		worker_pool_assign(events->pool, &events->task);
+		assign_task(events);
 	}
 	pthread_mutex_unlock(&events->mx);
 
@@ -235,7 +249,8 @@ int zone_events_init(zone_t *zone)
 }
 
 int zone_events_setup(struct zone *zone, worker_pool_t *workers,
-                      evsched_t *scheduler, namedb_t *timers_db)
+                      evsched_t *scheduler, namedb_t *timers_db,
+                      struct knot_conn_pool *conn_pool)
 {
 	if (!zone || !workers || !scheduler) {
 		return KNOT_EINVAL;
@@ -250,6 +265,7 @@ int zone_events_setup(struct zone *zone, worker_pool_t *workers,
 	zone->events.event = event;
 	zone->events.pool = workers;
 	zone->events.timers_db = timers_db;
+	zone->events.conn_pool = conn_pool;
 
 	return KNOT_EOK;
 }
@@ -301,7 +317,7 @@ void zone_events_enqueue(zone_t *zone, zone_event_type_t type)
 	if (!events->running && !events->frozen) {
 		events->running = true;
 		event_set_time(events, type, ZONE_EVENT_IMMEDIATE);
-		worker_pool_assign(events->pool, &events->task);
+		assign_task(events);
 		pthread_mutex_unlock(&events->mx);
 		return;
 	}
@@ -429,5 +445,9 @@ int zone_events_write_persistent(zone_t *zone)
 		return KNOT_EOK;
 	}
 
-	return write_zone_timers(zone->events.timers_db, zone);
+	pthread_mutex_lock(&zone->events.mx);
+	zone->events.timers_dirty = true;
+	pthread_mutex_unlock(&zone->events.mx);
+
+	return KNOT_EOK;
 }
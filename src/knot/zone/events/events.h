@@ -49,10 +49,12 @@ typedef struct zone_events {
 	pthread_mutex_t mx;		//!< Mutex protecting the struct.
 	bool running;			//!< Some zone event is being run.
 	bool frozen;			//!< Terminated, don't schedule new events.
+	bool timers_dirty;		//!< Persistent timers not written yet.
 
 	event_t *event;			//!< Scheduler event.
 	worker_pool_t *pool;		//!< Server worker pool.
 	namedb_t *timers_db;		//!< Persistent zone timers database.
+	struct knot_conn_pool *conn_pool; //!< Outgoing TCP connections.
 
 	task_t task;			//!< Event execution context.
 	time_t time[ZONE_EVENT_COUNT];	//!< Event execution times.
@@ -77,11 +79,13 @@ int zone_events_init(struct zone *zone);
  * \param workers    Worker thread pool.
  * \param scheduler  Event scheduler.
  * \param timers_db  Persistent timers database. Can be NULL.
+ * \param conn_pool  Pool of outgoing TCP connections. Can be NULL.
  *
  * \return KNOT_E*
  */
 int zone_events_setup(struct zone *zone, worker_pool_t *workers,
-                      evsched_t *scheduler, namedb_t *timers_db);
+                      evsched_t *scheduler, namedb_t *timers_db,
+                      struct knot_conn_pool *conn_pool);
 
 /*!
  * \brief Deinitialize zone events.
@@ -198,7 +202,10 @@ void zone_events_update(struct zone *zone, struct zone *old_zone);
 void zone_events_replan_ddns(struct zone *zone, const struct zone *old_zone);
 
 /*!
- * \brief Write persistent timers to timers database.
+ * \brief Mark persistent timers to be written to timers database.
+ *
+ * The timers are written later in a batch with timers of other zones,
+ * see \ref write_timer_db.
  *
  * \return KNOT_E*
  */
@@ -25,6 +25,7 @@
 #include "knot/server/udp-handler.h"
 #include "knot/server/tcp-handler.h"
 #include "knot/updates/changesets.h"
+#include "knot/dnssec/online-sign.h"
 #include "knot/dnssec/zone-events.h"
 #include "knot/zone/timers.h"
 #include "knot/zone/zone-load.h"
@@ -40,6 +41,23 @@
 
 #define BOOTSTRAP_RETRY (30) /*!< Interval between AXFR bootstrap retries. */
 #define BOOTSTRAP_MAXTIME (24*60*60) /*!< Maximum AXFR retry cap of 24 hours. */
+#define REFRESH_JITTER (10) /*!< Maximum refresh jitter (percent of interval). */
+
+/*!
+ * \brief Schedule zone refresh, moved earlier by a random jitter.
+ *
+ * Refreshes of zones loaded at once with the same SOA timers would otherwise
+ * stay synchronized forever.
+ */
+static void schedule_refresh(zone_t *zone, uint32_t interval)
+{
+	uint32_t jitter = (uint64_t)interval * REFRESH_JITTER / 100;
+	if (jitter > 0) {
+		interval -= knot_random_uint32_t() % (jitter + 1);
+	}
+
+	zone_events_schedule(zone, ZONE_EVENT_REFRESH, interval);
+}
 
 /* ------------------------- zone query requesting -------------------------- */
 
@@ -85,62 +103,92 @@ static knot_pkt_t *zone_query(const zone_t *zone, uint16_t pkt_type, mm_ctx_t *m
 }
 
 /*!
- * \brief Create a zone event query, send it, wait for the response and process it.
+ * \brief Create a zone event request with own answer processing.
  *
- * \note Everything in this function is executed synchronously, returns when
- *       the query processing is either complete or an error occurs.
+ * \note Answer processing parameters must outlive the request, the TSIG
+ *       context in the parameters is to be cleaned up by the caller.
  */
-static int zone_query_execute(zone_t *zone, uint16_t pkt_type, const conf_iface_t *remote)
+static struct knot_request *zone_query_request(zone_t *zone, uint16_t pkt_type,
+                                               const conf_iface_t *remote,
+                                               struct process_answer_param *param,
+                                               mm_ctx_t *mm)
 {
-	/* Create a memory pool for this task. */
-	int ret = KNOT_EOK;
-	mm_ctx_t mm;
-	mm_ctx_mempool(&mm, MM_DEFAULT_BLKSIZE);
-
 	/* Create a query message. */
-	knot_pkt_t *query = zone_query(zone, pkt_type, &mm);
+	knot_pkt_t *query = zone_query(zone, pkt_type, mm);
 	if (query == NULL) {
-		return KNOT_ENOMEM;
+		return NULL;
 	}
 
 	/* Answer processing parameters. */
-	struct process_answer_param param = { 0 };
-	param.zone = zone;
-	param.query = query;
-	param.remote = &remote->addr;
-
-	/* Create requestor instance. */
-	struct knot_requestor re;
-	knot_requestor_init(&re, &mm);
-	knot_requestor_overlay(&re, KNOT_NS_PROC_ANSWER, &param);
+	memset(param, 0, sizeof(*param));
+	param->zone = zone;
+	param->query = query;
+	param->remote = &remote->addr;
 
-	tsig_init(&param.tsig_ctx, remote->key);
+	tsig_init(&param->tsig_ctx, remote->key);
 
-	ret = tsig_sign_packet(&param.tsig_ctx, query);
-	if (ret != KNOT_EOK) {
-		goto fail;
+	if (tsig_sign_packet(&param->tsig_ctx, query) != KNOT_EOK) {
+		tsig_cleanup(&param->tsig_ctx);
+		knot_pkt_free(&query);
+		return NULL;
 	}
 
 	/* Create a request. */
 	const struct sockaddr *dst = (const struct sockaddr *)&remote->addr;
 	const struct sockaddr *src = (const struct sockaddr *)&remote->via;
-	struct knot_request *req = knot_request_make(re.mm, dst, src, query, 0);
+	struct knot_request *req = knot_request_make(mm, dst, src, query, 0);
 	if (req == NULL) {
-		ret = KNOT_ENOMEM;
-		goto fail;
+		tsig_cleanup(&param->tsig_ctx);
+		knot_pkt_free(&query);
+		return NULL;
+	}
+
+	if (knot_request_overlay(req, KNOT_NS_PROC_ANSWER, param) != KNOT_EOK) {
+		tsig_cleanup(&param->tsig_ctx);
+		knot_pkt_free(&query);
+		mm_free(mm, req);
+		return NULL;
+	}
+
+	return req;
+}
+
+/*!
+ * \brief Create a zone event query, send it, wait for the response and process it.
+ *
+ * \note Everything in this function is executed synchronously, returns when
+ *       the query processing is either complete or an error occurs.
+ */
+static int zone_query_execute(zone_t *zone, uint16_t pkt_type, const conf_iface_t *remote)
+{
+	/* Create a memory pool for this task. */
+	mm_ctx_t mm;
+	mm_ctx_mempool(&mm, MM_DEFAULT_BLKSIZE);
+
+	/* Create requestor instance, reuse connections to the remote. */
+	struct knot_requestor re;
+	knot_requestor_init(&re, &mm);
+	re.pool = zone->events.conn_pool;
+
+	struct process_answer_param param;
+	struct knot_request *req = zone_query_request(zone, pkt_type, remote,
+	                                              &param, &mm);
+	if (req == NULL) {
+		knot_requestor_clear(&re);
+		mp_delete(mm.ctx);
+		return KNOT_ENOMEM;
 	}
 
 	/* Send the queries and process responses. */
-	ret = knot_requestor_enqueue(&re, req);
+	int ret = knot_requestor_enqueue(&re, req);
 	if (ret == KNOT_EOK) {
 		struct timeval tv = { conf()->max_conn_reply, 0 };
 		ret = knot_requestor_exec(&re, &tv);
 	}
 
-fail:
 	/* Cleanup. */
-	tsig_cleanup(&param.tsig_ctx);
 	knot_requestor_clear(&re);
+	tsig_cleanup(&param.tsig_ctx);
 	mp_delete(mm.ctx);
 
 	return ret;
@@ -203,6 +251,22 @@ static void schedule_dnssec(zone_t *zone, time_t refresh_at)
 	zone_events_schedule_at(zone, ZONE_EVENT_DNSSEC, refresh_at);
 }
 
+/*! \brief Load keys for online signing, replace the previous ones. */
+static int reload_online_sign(zone_t *zone)
+{
+	knot_online_sign_t *online_sign = knot_online_sign_new(zone->contents,
+	                                                       zone->conf);
+	if (online_sign == NULL) {
+		return KNOT_ERROR;
+	}
+
+	knot_online_sign_t *old = zone_switch_online_sign(zone, online_sign);
+	synchronize_rcu();
+	knot_online_sign_free(old);
+
+	return KNOT_EOK;
+}
+
 /*! \brief Get SOA from zone. */
 static const knot_rdataset_t *zone_soa(zone_t *zone)
 {
@@ -292,6 +356,11 @@ int event_reload(zone_t *zone)
 		schedule_dnssec(zone, dnssec_refresh);
 	}
 
+	/* Keys for answers signed on demand. */
+	if (zone->conf->dnssec_online) {
+		reload_online_sign(zone);
+	}
+
 	/* Periodic execution. */
 	zone_events_schedule(zone, ZONE_EVENT_FLUSH, zone_config->dbsync_timeout);
 
@@ -331,11 +400,11 @@ int event_refresh(zone_t *zone)
 		/* Rotate masters if current failed. */
 		zone_master_rotate(zone);
 		/* Schedule next retry. */
-		zone_events_schedule(zone, ZONE_EVENT_REFRESH, knot_soa_retry(soa));
+		schedule_refresh(zone, knot_soa_retry(soa));
 		start_expire_timer(zone, soa);
 	} else {
 		/* SOA query answered, reschedule refresh timer. */
-		zone_events_schedule(zone, ZONE_EVENT_REFRESH, knot_soa_refresh(soa));
+		schedule_refresh(zone, knot_soa_refresh(soa));
 	}
 
 	return zone_events_write_persistent(zone);
@@ -379,7 +448,7 @@ int event_xfer(zone_t *zone)
 	const knot_rdataset_t *soa = zone_soa(zone);
 
 	/* Rechedule events. */
-	zone_events_schedule(zone, ZONE_EVENT_REFRESH, knot_soa_refresh(soa));
+	schedule_refresh(zone, knot_soa_refresh(soa));
 	zone_events_schedule(zone, ZONE_EVENT_NOTIFY,  ZONE_EVENT_NOW);
 	zone_events_cancel(zone, ZONE_EVENT_EXPIRE);
 	if (zone->conf->dbsync_timeout == 0) {
@@ -463,6 +532,14 @@ int event_flush(zone_t *zone)
 	return zone_flush_journal(zone);
 }
 
+/*! \brief Outgoing NOTIFY message. */
+struct notify_query {
+	const conf_iface_t *remote;
+	struct process_answer_param param;
+	struct knot_request *req;
+	int ret;
+};
+
 int event_notify(zone_t *zone)
 {
 	assert(zone);
@@ -472,22 +549,72 @@ int event_notify(zone_t *zone)
 		return KNOT_EOK;
 	}
 
-	/* Walk through configured remotes and send messages. */
-	conf_remote_t *remote = 0;
+	size_t count = list_size(&zone->conf->acl.notify_out);
+	if (count == 0) {
+		return KNOT_EOK;
+	}
+
+	mm_ctx_t mm;
+	mm_ctx_mempool(&mm, MM_DEFAULT_BLKSIZE);
+
+	struct notify_query *queries = mm_alloc(&mm, count * sizeof(*queries));
+	if (queries == NULL) {
+		mp_delete(mm.ctx);
+		return KNOT_ENOMEM;
+	}
+
+	struct knot_requestor re;
+	knot_requestor_init(&re, &mm);
+	re.pool = zone->events.conn_pool;
+
+	/* Walk through configured remotes and prepare messages. */
+	size_t i = 0;
+	conf_remote_t *remote = NULL;
 	WALK_LIST(remote, zone->conf->acl.notify_out) {
-		conf_iface_t *iface = remote->remote;
+		struct notify_query *q = &queries[i++];
+		q->remote = remote->remote;
+		q->req = zone_query_request(zone, KNOT_QUERY_NOTIFY, q->remote,
+		                            &q->param, &mm);
+		if (q->req == NULL) {
+			q->ret = KNOT_ENOMEM;
+			continue;
+		}
+
+		q->ret = knot_requestor_enqueue(&re, q->req);
+		if (q->ret != KNOT_EOK) {
+			tsig_cleanup(&q->param.tsig_ctx);
+			q->req = NULL;
+		}
+	}
 
-		int ret = zone_query_execute(zone, KNOT_QUERY_NOTIFY, iface);
+	/* Send all messages at once and wait for the responses. */
+	if (!knot_requestor_finished(&re)) {
+		struct timeval tv = { conf()->max_conn_reply, 0 };
+		knot_requestor_exec_all(&re, &tv);
+	}
+
+	for (i = 0; i < count; i++) {
+		struct notify_query *q = &queries[i];
+		int ret = (q->req != NULL) ? q->req->ret : q->ret;
 		if (ret == KNOT_EOK) {
-			ZONE_QUERY_LOG(LOG_INFO, zone, iface, "NOTIFY, outgoing",
+			ZONE_QUERY_LOG(LOG_INFO, zone, q->remote, "NOTIFY, outgoing",
 			               "serial %u",
 			               zone_contents_serial(zone->contents));
 		} else {
-			ZONE_QUERY_LOG(LOG_WARNING, zone, iface, "NOTIFY, outgoing",
+			ZONE_QUERY_LOG(LOG_WARNING, zone, q->remote, "NOTIFY, outgoing",
 			               "failed (%s)", knot_strerror(ret));
 		}
 	}
 
+	/* Cleanup. */
+	knot_requestor_clear(&re);
+	for (i = 0; i < count; i++) {
+		if (queries[i].req != NULL) {
+			tsig_cleanup(&queries[i].param.tsig_ctx);
+		}
+	}
+	mp_delete(mm.ctx);
+
 	return KNOT_EOK;
 }
 
@@ -501,8 +628,18 @@ int event_dnssec(zone_t *zone)
 		goto done;
 	}
 
+	/* Keys may have changed, reload them for next incremental signing. */
+	knot_dnssec_state_reset(zone->dnssec_state);
+
 	uint32_t refresh_at = time(NULL);
-	if (zone->flags & ZONE_FORCE_RESIGN) {
+	if (zone->conf->dnssec_online) {
+		log_zone_info(zone->name, "DNSSEC, updating keys for online signing");
+
+		/* Forced resign only drops the cached signatures. */
+		zone->flags &= ~ZONE_FORCE_RESIGN;
+		ret = knot_dnssec_zone_publish_keys(zone->contents, zone->conf,
+		                                    &ch, &refresh_at);
+	} else if (zone->flags & ZONE_FORCE_RESIGN) {
 		log_zone_info(zone->name, "DNSSEC, dropping previous "
 		              "signatures, resigning zone");
 
@@ -511,9 +648,12 @@ int event_dnssec(zone_t *zone)
 		                                  &ch, &refresh_at);
 	} else {
 		log_zone_info(zone->name, "DNSSEC, signing zone");
-		ret = knot_dnssec_zone_sign(zone->contents, zone->conf,
-		                            &ch, KNOT_SOA_SERIAL_UPDATE,
-		                            &refresh_at);
+		if (zone->dnssec_state == NULL) {
+			zone->dnssec_state = knot_dnssec_state_new();
+		}
+		ret = knot_dnssec_zone_sign_rolling(zone->contents, zone->conf,
+		                                    zone->dnssec_state, &ch,
+		                                    &refresh_at);
 	}
 	if (ret != KNOT_EOK) {
 		goto done;
@@ -547,6 +687,13 @@ int event_dnssec(zone_t *zone)
 		update_cleanup(&ch);
 	}
 
+	if (zone->conf->dnssec_online) {
+		ret = reload_online_sign(zone);
+		if (ret != KNOT_EOK) {
+			goto done;
+		}
+	}
+
 	// Schedule dependent events.
 
 	schedule_dnssec(zone, refresh_at);
@@ -24,6 +24,7 @@
 #include "libknot/rrtype/rrsig.h"
 #include "libknot/descriptor.h"
 #include "libknot/internal/mempattern.h"
+#include "libknot/internal/utils.h"
 
 /*! \brief Clears allocated data in RRSet entry. */
 static void rr_data_clear(struct rr_data *data, mm_ctx_t *mm)
@@ -41,6 +42,7 @@ static int rr_data_from(const knot_rrset_t *rrset, struct rr_data *data, mm_ctx_
 	}
 	data->type = rrset->type;
 	data->additional = NULL;
+	data->hash = 0;
 
 	return KNOT_EOK;
 }
@@ -65,6 +67,7 @@ static int add_rrset_no_merge(zone_node_t *node, const knot_rrset_t *rrset,
 		return ret;
 	}
 	++node->rrset_count;
+	node->hash = 0;
 
 	return KNOT_EOK;
 }
@@ -148,6 +151,7 @@ zone_node_t *node_shallow_copy(const zone_node_t *src, mm_ctx_t *mm)
 	}
 
 	dst->flags = src->flags;
+	dst->hash = src->hash;
 
 	// copy RRSets
 	dst->rrset_count = src->rrset_count;
@@ -177,6 +181,8 @@ int node_add_rrset(zone_node_t *node, const knot_rrset_t *rrset, mm_ctx_t *mm)
 		if (node->rrs[i].type == rrset->type) {
 			struct rr_data *node_data = &node->rrs[i];
 			const bool ttl_err = ttl_error(node_data, rrset);
+			node_data->hash = 0;
+			node->hash = 0;
 			int ret = knot_rdataset_merge(&node_data->rrs,
 			                              &rrset->rrs, mm);
 			if (ret != KNOT_EOK) {
@@ -202,6 +208,7 @@ void node_remove_rdataset(zone_node_t *node, uint16_t type)
 			memmove(node->rrs + i, node->rrs + i + 1,
 			        (node->rrset_count - i - 1) * sizeof(struct rr_data));
 			--node->rrset_count;
+			node->hash = 0;
 			return;
 		}
 	}
@@ -238,6 +245,78 @@ knot_rdataset_t *node_rdataset(const zone_node_t *node, uint16_t type)
 	return NULL;
 }
 
+/*! \brief Update FNV-1a hash with a buffer. */
+static uint64_t hash_update(uint64_t hash, const uint8_t *data, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		hash = (hash ^ data[i]) * 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+/*! \brief Computes fingerprint of RRSet data (type, TTLs and RDATA). */
+static uint64_t rr_data_hash(const struct rr_data *data)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	uint8_t header[2];
+	wire_write_u16(header, data->type);
+	hash = hash_update(hash, header, sizeof(header));
+
+	for (uint16_t i = 0; i < data->rrs.rr_count; i++) {
+		const knot_rdata_t *rr = knot_rdataset_at(&data->rrs, i);
+		uint8_t rr_header[6];
+		wire_write_u32(rr_header, knot_rdata_ttl(rr));
+		wire_write_u16(rr_header + 4, knot_rdata_rdlen(rr));
+		hash = hash_update(hash, rr_header, sizeof(rr_header));
+		hash = hash_update(hash, knot_rdata_data(rr), knot_rdata_rdlen(rr));
+	}
+
+	// zero is reserved for unknown fingerprint
+	return hash != 0 ? hash : 1;
+}
+
+uint64_t node_hash(zone_node_t *node)
+{
+	if (node == NULL) {
+		return 0;
+	}
+
+	if (node->hash != 0) {
+		return node->hash;
+	}
+
+	// RRSet order in node is not defined, combine commutatively
+	uint64_t hash = node->rrset_count;
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		struct rr_data *data = &node->rrs[i];
+		if (data->hash == 0) {
+			data->hash = rr_data_hash(data);
+		}
+		hash += data->hash;
+	}
+
+	node->hash = hash != 0 ? hash : 1;
+
+	return node->hash;
+}
+
+void node_invalidate_hash(zone_node_t *node, uint16_t type)
+{
+	if (node == NULL) {
+		return;
+	}
+
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		if (node->rrs[i].type == type) {
+			node->rrs[i].hash = 0;
+		}
+	}
+
+	node->hash = 0;
+}
+
 void node_set_parent(zone_node_t *node, zone_node_t *parent)
 {
 	if (node == NULL || node->parent == parent) {
@@ -52,6 +52,7 @@ typedef struct zone_node {
 	 */
 	struct zone_node *prev;
 	struct zone_node *nsec3_node; /*! NSEC3 node corresponding to this node. */
+	uint64_t hash; /*!< Fingerprint of RR data in the node, 0 if unknown. */
 	uint32_t children; /*!< Count of children nodes in DNS hierarchy. */
 	uint16_t rrset_count; /*!< Number of RRSets stored in the node. */
 	uint8_t flags; /*!< \ref node_flags enum. */
@@ -61,6 +62,7 @@ typedef struct zone_node {
 struct rr_data {
 	uint16_t type; /*!< \brief RR type of data. */
 	knot_rdataset_t rrs; /*!< \brief Data of given type. */
+	uint64_t hash; /*!< \brief Fingerprint of the data, 0 if unknown. */
 	zone_node_t **additional; /*!< \brief Additional nodes with glues. */
 };
 
@@ -166,6 +168,32 @@ knot_rrset_t *node_create_rrset(const zone_node_t *node, uint16_t type);
  */
 knot_rdataset_t *node_rdataset(const zone_node_t *node, uint16_t type);
 
+/* ----------------------------- Fingerprints ------------------------------- */
+
+/*!
+ * \brief Returns fingerprint of RR data in the node, computes missing ones.
+ *
+ * The fingerprint covers types, TTLs and RDATA of all RRSets in the node.
+ * Nodes with different fingerprints have different data, equal fingerprints
+ * may collide and must be confirmed by comparing the data.
+ * Functions modifying RR data in the node invalidate the fingerprint.
+ *
+ * \param node  Node to get the fingerprint of.
+ *
+ * \return Node fingerprint.
+ */
+uint64_t node_hash(zone_node_t *node);
+
+/*!
+ * \brief Invalidates fingerprint of RRSet of given type and of the node.
+ *
+ * Must be called when RR data are modified outside of the node functions.
+ *
+ * \param node  Node with modified data.
+ * \param type  Type of the modified RRSet.
+ */
+void node_invalidate_hash(zone_node_t *node, uint16_t type);
+
 /* ---------------------------- Parent setter ------------------------------- */
 
 /*!
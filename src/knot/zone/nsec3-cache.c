@@ -0,0 +1,243 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "knot/zone/nsec3-cache.h"
+#include "libknot/internal/lists.h"
+#include "libknot/internal/trie/hat-trie.h"
+
+/*! \brief Number of independently locked parts of the cache. */
+#define NSEC3_CACHE_STRIPES 16
+
+
+typedef struct {
+	node_t n;                     //!< Node in the LRU list.
+	char *key;                    //!< Cached name (key in the index).
+	size_t key_len;
+	nsec3_cache_result_t result;
+} cache_entry_t;
+
+typedef struct {
+	pthread_mutex_t lock;
+	hattrie_t *index;             //!< Name -> cache_entry_t.
+	list_t lru;                   //!< Entries, most recently used first.
+	size_t count;
+	uint64_t hits;
+	uint64_t misses;
+} cache_stripe_t;
+
+struct nsec3_cache {
+	size_t stripe_size;           //!< Maximal number of names per stripe.
+	cache_stripe_t stripes[NSEC3_CACHE_STRIPES];
+};
+
+/*! \brief Pick stripe for the name (FNV-1a of the wire format). */
+static cache_stripe_t *stripe_for(nsec3_cache_t *cache, const knot_dname_t *name,
+                                  size_t len)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		hash = (hash ^ name[i]) * 16777619u;
+	}
+
+	return &cache->stripes[hash % NSEC3_CACHE_STRIPES];
+}
+
+static void entry_free(cache_stripe_t *stripe, cache_entry_t *entry)
+{
+	hattrie_del(stripe->index, entry->key, entry->key_len);
+	rem_node(&entry->n);
+	free(entry->key);
+	free(entry);
+	stripe->count -= 1;
+}
+
+/*! \brief Drop all entries of the stripe. Call with stripe lock held. */
+static void stripe_clear(cache_stripe_t *stripe)
+{
+	cache_entry_t *entry = NULL;
+	cache_entry_t *next = NULL;
+	WALK_LIST_DELSAFE(entry, next, stripe->lru) {
+		free(entry->key);
+		free(entry);
+	}
+	init_list(&stripe->lru);
+	hattrie_clear(stripe->index);
+	stripe->count = 0;
+}
+
+nsec3_cache_t *nsec3_cache_new(size_t max_names)
+{
+	nsec3_cache_t *cache = malloc(sizeof(*cache));
+	if (cache == NULL) {
+		return NULL;
+	}
+	memset(cache, 0, sizeof(*cache));
+
+	cache->stripe_size = max_names / NSEC3_CACHE_STRIPES;
+	if (cache->stripe_size == 0) {
+		cache->stripe_size = 1;
+	}
+
+	for (int i = 0; i < NSEC3_CACHE_STRIPES; i++) {
+		cache_stripe_t *stripe = &cache->stripes[i];
+		stripe->index = hattrie_create();
+		if (stripe->index == NULL) {
+			for (int j = 0; j < i; j++) {
+				hattrie_free(cache->stripes[j].index);
+				pthread_mutex_destroy(&cache->stripes[j].lock);
+			}
+			free(cache);
+			return NULL;
+		}
+		pthread_mutex_init(&stripe->lock, NULL);
+		init_list(&stripe->lru);
+	}
+
+	return cache;
+}
+
+void nsec3_cache_free(nsec3_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < NSEC3_CACHE_STRIPES; i++) {
+		cache_stripe_t *stripe = &cache->stripes[i];
+		stripe_clear(stripe);
+		hattrie_free(stripe->index);
+		pthread_mutex_destroy(&stripe->lock);
+	}
+
+	free(cache);
+}
+
+void nsec3_cache_flush(nsec3_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < NSEC3_CACHE_STRIPES; i++) {
+		cache_stripe_t *stripe = &cache->stripes[i];
+		pthread_mutex_lock(&stripe->lock);
+		stripe_clear(stripe);
+		pthread_mutex_unlock(&stripe->lock);
+	}
+}
+
+bool nsec3_cache_get(nsec3_cache_t *cache, const knot_dname_t *name,
+                     nsec3_cache_result_t *result)
+{
+	if (cache == NULL || name == NULL || result == NULL) {
+		return false;
+	}
+
+	size_t len = knot_dname_size(name);
+	cache_stripe_t *stripe = stripe_for(cache, name, len);
+
+	pthread_mutex_lock(&stripe->lock);
+
+	value_t *val = hattrie_tryget(stripe->index, (const char *)name, len);
+	if (val == NULL) {
+		stripe->misses += 1;
+		pthread_mutex_unlock(&stripe->lock);
+		return false;
+	}
+
+	cache_entry_t *entry = *val;
+	rem_node(&entry->n);
+	add_head(&stripe->lru, &entry->n);
+	*result = entry->result;
+	stripe->hits += 1;
+
+	pthread_mutex_unlock(&stripe->lock);
+
+	return true;
+}
+
+void nsec3_cache_put(nsec3_cache_t *cache, const knot_dname_t *name,
+                     const nsec3_cache_result_t *result)
+{
+	if (cache == NULL || name == NULL || result == NULL) {
+		return;
+	}
+
+	size_t len = knot_dname_size(name);
+	cache_stripe_t *stripe = stripe_for(cache, name, len);
+
+	cache_entry_t *entry = malloc(sizeof(*entry));
+	if (entry == NULL) {
+		return;
+	}
+	entry->key = malloc(len);
+	if (entry->key == NULL) {
+		free(entry);
+		return;
+	}
+	memcpy(entry->key, name, len);
+	entry->key_len = len;
+	entry->result = *result;
+
+	pthread_mutex_lock(&stripe->lock);
+
+	value_t *val = hattrie_get(stripe->index, entry->key, len);
+	if (val == NULL || *val != NULL) {
+		// out of memory or stored concurrently
+		pthread_mutex_unlock(&stripe->lock);
+		free(entry->key);
+		free(entry);
+		return;
+	}
+
+	*val = entry;
+	add_head(&stripe->lru, &entry->n);
+	stripe->count += 1;
+
+	// evict least recently used names
+	if (stripe->count > cache->stripe_size) {
+		entry_free(stripe, TAIL(stripe->lru));
+	}
+
+	pthread_mutex_unlock(&stripe->lock);
+}
+
+void nsec3_cache_stats(nsec3_cache_t *cache, uint64_t *hits, uint64_t *misses)
+{
+	uint64_t total_hits = 0;
+	uint64_t total_misses = 0;
+
+	if (cache != NULL) {
+		for (int i = 0; i < NSEC3_CACHE_STRIPES; i++) {
+			cache_stripe_t *stripe = &cache->stripes[i];
+			pthread_mutex_lock(&stripe->lock);
+			total_hits += stripe->hits;
+			total_misses += stripe->misses;
+			pthread_mutex_unlock(&stripe->lock);
+		}
+	}
+
+	if (hits != NULL) {
+		*hits = total_hits;
+	}
+	if (misses != NULL) {
+		*misses = total_misses;
+	}
+}
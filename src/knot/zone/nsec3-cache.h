@@ -0,0 +1,105 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file nsec3-cache.h
+ *
+ * \brief Cache of NSEC3 lookups for denial of existence proofs.
+ *
+ * Maps a domain name to the NSEC3 node matching its hash and the previous
+ * (covering) NSEC3 node, so that repeated proofs for the same names (wildcard
+ * children of the closest encloser) skip both the NSEC3 hash computation and
+ * the NSEC3 tree lookup. Next closer names are not cached, they are mostly
+ * unique under random subdomain queries and would only evict the useful
+ * entries. Existing names keep their NSEC3 node in the node. The cache is
+ * bounded, least recently used names are evicted. The cache belongs to a single
+ * version of zone contents and must be flushed when the NSEC3 tree changes.
+ *
+ * \addtogroup libknot
+ * @{
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libknot/dname.h"
+#include "knot/zone/node.h"
+
+struct nsec3_cache;
+typedef struct nsec3_cache nsec3_cache_t;
+
+/*!
+ * \brief Result of NSEC3 lookup for a name.
+ */
+typedef struct {
+	const zone_node_t *node;      //!< NSEC3 node matching the name hash.
+	const zone_node_t *previous;  //!< Previous NSEC3 node in the chain.
+	int match;                    //!< Lookup result (ZONE_NAME_*).
+} nsec3_cache_result_t;
+
+/*! \brief Upper bound of the number of cached names. */
+#define NSEC3_CACHE_MAX_SIZE 16384
+
+/*!
+ * \brief Create empty NSEC3 lookup cache.
+ *
+ * \param max_names  Maximal number of cached names (rounded down to
+ *                   a multiple of the number of cache stripes).
+ *
+ * \return New cache, NULL on error.
+ */
+nsec3_cache_t *nsec3_cache_new(size_t max_names);
+
+/*!
+ * \brief Free NSEC3 lookup cache.
+ */
+void nsec3_cache_free(nsec3_cache_t *cache);
+
+/*!
+ * \brief Remove all cached lookups (counters are kept).
+ */
+void nsec3_cache_flush(nsec3_cache_t *cache);
+
+/*!
+ * \brief Look up cached NSEC3 lookup result for the name.
+ *
+ * \param cache   NSEC3 lookup cache.
+ * \param name    Looked up name.
+ * \param result  Cached result (output).
+ *
+ * \retval true if the name was found in the cache.
+ */
+bool nsec3_cache_get(nsec3_cache_t *cache, const knot_dname_t *name,
+                     nsec3_cache_result_t *result);
+
+/*!
+ * \brief Store NSEC3 lookup result for the name.
+ *
+ * \param cache   NSEC3 lookup cache.
+ * \param name    Looked up name.
+ * \param result  Lookup result.
+ */
+void nsec3_cache_put(nsec3_cache_t *cache, const knot_dname_t *name,
+                     const nsec3_cache_result_t *result);
+
+/*!
+ * \brief Get cache hit and miss counters.
+ */
+void nsec3_cache_stats(nsec3_cache_t *cache, uint64_t *hits, uint64_t *misses);
+
+/*! @} */
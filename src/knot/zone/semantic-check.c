@@ -14,6 +14,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <assert.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <sys/types.h>
@@ -24,6 +26,7 @@
 #include "knot/zone/semantic-check.h"
 #include "knot/common/debug.h"
 #include "knot/dnssec/zone-nsec.h"
+#include "knot/server/dthreads.h"
 #include "libknot/libknot.h"
 #include "libknot/dnssec/key.h"
 #include "libknot/dnssec/rrset-sign.h"
@@ -583,10 +586,10 @@ static int check_nsec3_node_in_zone(zone_contents_t *zone, zone_node_t *node,
 			const zone_node_t *nsec3_previous;
 			const zone_node_t *nsec3_node;
 
-			if (zone_contents_find_nsec3_for_name(zone,
-			                                      node->owner,
-			                                      &nsec3_node,
-			                                      &nsec3_previous) != 0) {
+			/* Uncached, checked names are not used in answers. */
+			if (zone_contents_find_nsec3_for_name_uncached(zone,
+			                node->owner, &nsec3_node,
+			                &nsec3_previous) != 0) {
 				err_handler_handle_error(handler, zone, node,
 				                         ZC_ERR_NSEC3_NOT_FOUND, NULL);
 				return KNOT_EOK;
@@ -846,6 +849,7 @@ int sem_check_node_plain(const zone_contents_t *zone,
  * \param last_node Last node in canonical order.
  * \param handler Error handler.
  * \param nsec3 NSEC3 used.
+ * \param check_rrsigs Check RRSIGs of the node.
  *
  * \retval KNOT_EOK if no error was found.
  *
@@ -855,7 +859,7 @@ static int semantic_checks_dnssec(zone_contents_t *zone,
                                   zone_node_t *node,
                                   zone_node_t **last_node,
                                   err_handler_t *handler,
-                                  char nsec3)
+                                  char nsec3, bool check_rrsigs)
 {
 	assert(handler);
 	assert(node);
@@ -868,7 +872,8 @@ static int semantic_checks_dnssec(zone_contents_t *zone,
 
 	for (int i = 0; i < rrset_count; i++) {
 		knot_rrset_t rrset = node_rrset_at(node, i);
-		if (auth && !deleg && rrset.type != KNOT_RRTYPE_RRSIG &&
+		if (auth && !deleg && check_rrsigs &&
+		    rrset.type != KNOT_RRTYPE_RRSIG &&
 		    (ret = check_rrsig_in_rrset(handler, zone, node,
 		                                &rrset, &dnskey_rrset)) != 0) {
 			err_handler_handle_error(handler, zone, node, ret, NULL);
@@ -954,68 +959,204 @@ static int semantic_checks_dnssec(zone_contents_t *zone,
 	return KNOT_EOK;
 }
 
+/*! \brief Minimal number of nodes checked by one thread. */
+#define SEM_CHECK_MIN_NODES 4096
+
+/*!
+ * \brief Continuous range of zone nodes checked by one thread.
+ */
+typedef struct {
+	pthread_t thread;
+	bool started;             //!< Range is checked by its own thread.
+	zone_contents_t *zone;
+	zone_node_t **nodes;      //!< First node of the range.
+	size_t count;             //!< Number of nodes in the range.
+	size_t offset;            //!< Position of the first node in the zone.
+	int check_level;
+	unsigned rrsig_sample;    //!< Nodes with checked RRSIGs (%).
+	err_handler_t handler;    //!< Errors found in the range.
+	zone_node_t *last_node;   //!< Last node in NSEC chain, if in range.
+	bool fatal_error;
+} sem_check_part_t;
+
 /*!
- * \brief Function called by zone traversal function. Used to call
- *        knot_zone_save_enclosers.
+ * \brief Check whether RRSIGs in the n-th node are to be checked.
  *
- * \param node Node to be searched.
- * \param data Arguments.
+ * The sampled nodes are spread evenly over the zone.
  */
-static int do_checks_in_tree(zone_node_t *node, void *data)
+static bool rrsig_sampled(size_t index, unsigned sample)
 {
-	arg_t *args = (arg_t *)data;
-
-	zone_contents_t *zone = (zone_contents_t *)args->arg1;
+	if (sample >= 100) {
+		return true;
+	}
 
-	zone_node_t **last_node = (zone_node_t **)args->arg5;
+	return (index * sample) % 100 < sample;
+}
 
-	err_handler_t *handler = (err_handler_t *)args->arg6;
+/*!
+ * \brief Run semantic checks for a range of nodes.
+ */
+static void *sem_check_part_run(void *data)
+{
+	sem_check_part_t *part = data;
+	err_handler_t *handler = &part->handler;
 
-	char do_checks = *((char *)(args->arg3));
+	for (size_t i = 0; i < part->count; i++) {
+		zone_node_t *node = part->nodes[i];
+		bool fatal_error = false;
 
-	if (do_checks) {
-		sem_check_node_plain(zone, node, handler, false,
-		                      (bool *)args->arg7);
-	} else {
-		assert(handler);
-		/* All CNAME/DNAME checks are mandatory. */
-		handler->options.log_cname = 1;
-		sem_check_node_plain(zone, node, handler, true,
-		                      (bool *)args->arg7);
-		return KNOT_EOK;
+		if (part->check_level) {
+			sem_check_node_plain(part->zone, node, handler, false,
+			                     &fatal_error);
+		} else {
+			/* All CNAME/DNAME checks are mandatory. */
+			handler->options.log_cname = 1;
+			sem_check_node_plain(part->zone, node, handler, true,
+			                     &fatal_error);
+		}
+		part->fatal_error |= fatal_error;
+
+		if (part->check_level == SEM_CHECK_NSEC ||
+		    part->check_level == SEM_CHECK_NSEC3) {
+			bool check_rrsigs = rrsig_sampled(part->offset + i,
+			                                  part->rrsig_sample);
+			semantic_checks_dnssec(part->zone, node, &part->last_node,
+			                       handler,
+			                       part->check_level == SEM_CHECK_NSEC3,
+			                       check_rrsigs);
+		}
 	}
 
-	if (do_checks == SEM_CHECK_NSEC || do_checks == SEM_CHECK_NSEC3) {
-		semantic_checks_dnssec(zone, node, last_node,
-				       handler, do_checks == SEM_CHECK_NSEC3);
-	}
+	return NULL;
+}
+
+static int collect_node(zone_node_t *node, void *data)
+{
+	zone_node_t ***write = data;
+	**write = node;
+	*write += 1;
 
 	return KNOT_EOK;
 }
 
+/*!
+ * \brief Check whether only the first error of the type is logged.
+ *
+ * \see err_handler_handle_error()
+ */
+static bool log_first_only(const err_handler_t *handler, int error)
+{
+	if (error < ZC_ERR_GENERIC_GENERAL_ERROR) {
+		return false;
+	} else if (error < ZC_ERR_RRSIG_GENERAL_ERROR) {
+		return !handler->options.log_rrsigs;
+	} else if (error < ZC_ERR_NSEC_GENERAL_ERROR) {
+		return !handler->options.log_nsec;
+	} else if (error < ZC_ERR_NSEC3_GENERAL_ERROR) {
+		return !handler->options.log_nsec3;
+	} else if (error < ZC_ERR_CNAME_GENERAL_ERROR) {
+		return !handler->options.log_cname;
+	}
+
+	return false;
+}
+
+/*!
+ * \brief Add errors found in one range to the zone error handler.
+ *
+ * Each range logs the first error of a type, the error is counted once
+ * for the zone as in a single threaded check.
+ */
+static void merge_handler(err_handler_t *to, const err_handler_t *from)
+{
+	unsigned logged_again = 0;
+	for (int i = 0; i <= -ZC_ERR_UNKNOWN; i++) {
+		if (to->errors[i] > 0 && from->errors[i] > 0 &&
+		    log_first_only(from, -i)) {
+			logged_again += 1;
+		}
+		to->errors[i] += from->errors[i];
+	}
+	to->error_count += from->error_count - logged_again;
+}
+
 int zone_do_sem_checks(zone_contents_t *zone, int do_checks,
                        err_handler_t *handler, zone_node_t *first_nsec3_node,
-                       zone_node_t *last_nsec3_node)
+                       zone_node_t *last_nsec3_node, unsigned rrsig_sample,
+                       unsigned max_threads)
 {
 	if (!zone || !handler) {
 		return KNOT_EINVAL;
 	}
-	zone_node_t *last_node = NULL;
-	arg_t arguments;
-	arguments.arg1 = zone;
-	arguments.arg3 = &do_checks;
-	arguments.arg4 = NULL; // UNUSED
-	arguments.arg5 = &last_node;
-	arguments.arg6 = handler;
-	int fatal_error = 0;
-	arguments.arg7 = (void *)&fatal_error;
-
-	int ret = zone_contents_tree_apply_inorder(zone,
-	                                                do_checks_in_tree,
-	                                                &arguments);
+
+	size_t count = zone_tree_weight(zone->nodes);
+	size_t threads = (max_threads > 0) ? max_threads : dt_optimal_size();
+	if (threads > count / SEM_CHECK_MIN_NODES) {
+		threads = count / SEM_CHECK_MIN_NODES;
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+
+	zone_node_t **nodes = malloc(count * sizeof(zone_node_t *));
+	sem_check_part_t *parts = calloc(threads, sizeof(sem_check_part_t));
+	if ((!nodes && count > 0) || !parts) {
+		free(nodes);
+		free(parts);
+		return KNOT_ENOMEM;
+	}
+
+	zone_node_t **write = nodes;
+	int ret = zone_contents_tree_apply_inorder(zone, collect_node, &write);
 	if (ret != KNOT_EOK) {
+		free(nodes);
+		free(parts);
 		return ret;
 	}
+	assert(write == nodes + count);
+
+	/* Split the zone into continuous ranges, each checked by a thread
+	 * with its own error handler. The first range is checked by the
+	 * calling thread, as are ranges of threads that failed to start. */
+	size_t chunk = count / threads;
+	for (size_t i = 0; i < threads; i++) {
+		sem_check_part_t *part = &parts[i];
+		part->zone = zone;
+		part->offset = i * chunk;
+		part->nodes = nodes + part->offset;
+		part->count = (i + 1 == threads) ? count - part->offset : chunk;
+		part->check_level = do_checks;
+		part->rrsig_sample = rrsig_sample;
+		err_handler_init(&part->handler);
+		part->handler.options = handler->options;
+
+		if (i > 0) {
+			part->started = (pthread_create(&part->thread, NULL,
+			                                sem_check_part_run,
+			                                part) == 0);
+		}
+	}
+
+	zone_node_t *last_node = NULL;
+	bool fatal_error = false;
+	for (size_t i = 0; i < threads; i++) {
+		sem_check_part_t *part = &parts[i];
+		if (part->started) {
+			pthread_join(part->thread, NULL);
+		} else {
+			sem_check_part_run(part);
+		}
+
+		merge_handler(handler, &part->handler);
+		if (part->last_node != NULL) {
+			last_node = part->last_node;
+		}
+		fatal_error |= part->fatal_error;
+	}
+
+	free(nodes);
+	free(parts);
+
 	if (fatal_error) {
 		return KNOT_ERROR;
 	}
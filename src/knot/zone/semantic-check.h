@@ -189,17 +189,24 @@ void log_cyclic_errors_in_zone(err_handler_t *handler,
                                char do_checks);
 
 /*!
- * \brief Helper function - wraps its arguments into arg_t structure and
- *        calls function that does the actual work.
+ * \brief Runs semantic checks of the whole zone.
+ *
+ * Large zones are split into continuous ranges of nodes checked by multiple
+ * threads, errors found by the threads are summed in \a handler.
  *
  * \param zone Zone to be searched / checked
  * \param check_level Level of semantic checks.
  * \param handler Semantic error handler.
- * \param last_node Last checked node, that is a part of NSEC(3) chain.
+ * \param first_nsec3_node First node of the NSEC3 chain.
+ * \param last_nsec3_node Last node of the NSEC3 chain.
+ * \param rrsig_sample Share of nodes with checked RRSIGs (%), 100 for all.
+ * \param max_threads Maximal number of checking threads, 0 for the number
+ *                    of CPUs.
  */
 int zone_do_sem_checks(zone_contents_t *zone, int check_level,
                        err_handler_t *handler, zone_node_t *first_nsec3_node,
-                       zone_node_t *last_nsec3_node);
+                       zone_node_t *last_nsec3_node, unsigned rrsig_sample,
+                       unsigned max_threads);
 
 /*!
  * \brief Does a non-DNSSEC semantic node check. Logs errors via error handler.
@@ -18,6 +18,7 @@
 #include "libknot/internal/namedb/namedb.h"
 #include "libknot/internal/namedb/namedb_lmdb.h"
 #include "libknot/internal/mem.h"
+#include "libknot/internal/mempool.h"
 #include "knot/zone/timers.h"
 #include "knot/zone/zonedb.h"
 
@@ -51,6 +52,9 @@ static bool known_event_key(uint8_t key)
 
 #define EVENT_KEY_PAIR_SIZE (sizeof(uint8_t) + sizeof(int64_t))
 
+/*! \brief Maximal number of zones written in one transaction. */
+#define TIMERS_BATCH 10000
+
 static bool event_persistent(size_t event)
 {
 	return event_id_to_key[event] != 0;
@@ -89,6 +93,25 @@ static int store_timers(namedb_txn_t *txn, zone_t *zone)
 	return namedb_lmdb_api()->insert(txn, &key, &val, 0);
 }
 
+/*! \brief Unpacks stored timers for persistent events. */
+static void unpack_timers(const namedb_val_t *val, time_t *timers)
+{
+	clear_timers(timers);
+
+	const size_t stored_event_count = val->len / EVENT_KEY_PAIR_SIZE;
+	size_t offset = 0;
+	for (size_t i = 0; i < stored_event_count; ++i) {
+		const uint8_t db_key = ((uint8_t *)val->data)[offset];
+		offset += 1;
+		if (known_event_key(db_key)) {
+			const zone_event_type_t event = key_to_event_id[db_key];
+			timers[event] =
+				(time_t)wire_read_u64((uint8_t *)val->data + offset);
+		}
+		offset += sizeof(uint64_t);
+	}
+}
+
 /*! \brief Reads timers for persistent events. */
 static int read_timers(namedb_txn_t *txn, const zone_t *zone, time_t *timers)
 {
@@ -108,20 +131,53 @@ static int read_timers(namedb_txn_t *txn, const zone_t *zone, time_t *timers)
 		return KNOT_EOK;
 	}
 
-	const size_t stored_event_count = val.len / EVENT_KEY_PAIR_SIZE;
-	size_t offset = 0;
-	for (size_t i = 0; i < stored_event_count; ++i) {
-		const uint8_t db_key = ((uint8_t *)val.data)[offset];
-		offset += 1;
-		if (known_event_key(db_key)) {
-			const zone_event_type_t event = key_to_event_id[db_key];
-			timers[event] =
-				(time_t)wire_read_u64((uint8_t *)val.data + offset);
+	unpack_timers(&val, timers);
+
+	return KNOT_EOK;
+}
+
+/*! \brief Stores timers of zones with modified timers in one transaction. */
+static int store_batch(namedb_t *timer_db, zone_t **zones, size_t count)
+{
+	const namedb_api_t *db_api = namedb_lmdb_api();
+	assert(db_api);
+
+	namedb_txn_t txn;
+	int ret = db_api->txn_begin(timer_db, &txn, 0);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		ret = store_timers(&txn, zones[i]);
+		if (ret != KNOT_EOK) {
+			db_api->txn_abort(&txn);
+			return ret;
 		}
-		offset += sizeof(uint64_t);
 	}
 
-	return KNOT_EOK;
+	return db_api->txn_commit(&txn);
+}
+
+/*! \brief Take the zone for writing if its timers were modified. */
+static bool take_dirty(zone_t *zone)
+{
+	pthread_mutex_lock(&zone->events.mx);
+	bool dirty = zone->events.timers_dirty;
+	zone->events.timers_dirty = false;
+	pthread_mutex_unlock(&zone->events.mx);
+
+	return dirty;
+}
+
+/*! \brief Mark zones back as modified after failed write. */
+static void mark_dirty(zone_t **zones, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		pthread_mutex_lock(&zones[i]->events.mx);
+		zones[i]->events.timers_dirty = true;
+		pthread_mutex_unlock(&zones[i]->events.mx);
+	}
 }
 
 /* -------- API ------------------------------------------------------------- */
@@ -256,3 +312,140 @@ int sweep_timer_db(namedb_t *timer_db, knot_zonedb_t *zone_db)
 
 	return db_api->txn_commit(&txn);
 }
+
+int write_timer_db(namedb_t *timer_db, knot_zonedb_t *zone_db)
+{
+	if (timer_db == NULL || zone_db == NULL) {
+		return KNOT_EOK;
+	}
+
+	zone_t **batch = malloc(TIMERS_BATCH * sizeof(zone_t *));
+	if (batch == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	size_t count = 0;
+
+	knot_zonedb_iter_t it;
+	knot_zonedb_iter_begin(zone_db, &it);
+	while (!knot_zonedb_iter_finished(&it)) {
+		zone_t *zone = knot_zonedb_iter_val(&it);
+		knot_zonedb_iter_next(&it);
+
+		if (!take_dirty(zone)) {
+			continue;
+		}
+
+		batch[count++] = zone;
+		if (count == TIMERS_BATCH) {
+			int batch_ret = store_batch(timer_db, batch, count);
+			if (batch_ret != KNOT_EOK) {
+				mark_dirty(batch, count);
+				ret = batch_ret;
+			}
+			count = 0;
+		}
+	}
+
+	if (count > 0) {
+		int batch_ret = store_batch(timer_db, batch, count);
+		if (batch_ret != KNOT_EOK) {
+			mark_dirty(batch, count);
+			ret = batch_ret;
+		}
+	}
+
+	free(batch);
+
+	return ret;
+}
+
+int read_timer_db(namedb_t *timer_db, timer_map_t *map)
+{
+	if (map == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	memset(map, 0, sizeof(*map));
+	if (timer_db == NULL) {
+		return KNOT_EOK;
+	}
+
+	const namedb_api_t *db_api = namedb_lmdb_api();
+	assert(db_api);
+
+	map->zones = hattrie_create();
+	if (map->zones == NULL) {
+		return KNOT_ENOMEM;
+	}
+	mm_ctx_mempool(&map->mm, MM_DEFAULT_BLKSIZE);
+
+	namedb_txn_t txn;
+	int ret = db_api->txn_begin(timer_db, &txn, NAMEDB_RDONLY);
+	if (ret != KNOT_EOK) {
+		timer_map_free(map);
+		return ret;
+	}
+
+	if (db_api->count(&txn) <= 0) {
+		db_api->txn_abort(&txn);
+		return KNOT_EOK;
+	}
+
+	namedb_iter_t *it = db_api->iter_begin(&txn, 0);
+	while (it != NULL) {
+		namedb_val_t key, val;
+		ret = db_api->iter_key(it, &key);
+		if (ret == KNOT_EOK) {
+			ret = db_api->iter_val(it, &val);
+		}
+		if (ret != KNOT_EOK) {
+			break;
+		}
+
+		time_t *timers = mm_alloc(&map->mm, ZONE_EVENT_COUNT * sizeof(time_t));
+		value_t *slot = hattrie_get(map->zones, key.data, key.len);
+		if (timers == NULL || slot == NULL) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
+		unpack_timers(&val, timers);
+		*slot = timers;
+
+		it = db_api->iter_next(it);
+	}
+	db_api->iter_finish(it);
+	db_api->txn_abort(&txn);
+
+	if (ret != KNOT_EOK) {
+		timer_map_free(map);
+	}
+
+	return ret;
+}
+
+void timer_map_find(const timer_map_t *map, const zone_t *zone, time_t *timers)
+{
+	clear_timers(timers);
+	if (map == NULL || map->zones == NULL) {
+		return;
+	}
+
+	value_t *val = hattrie_tryget(map->zones, (const char *)zone->name,
+	                              knot_dname_size(zone->name));
+	if (val != NULL) {
+		memcpy(timers, *val, ZONE_EVENT_COUNT * sizeof(time_t));
+	}
+}
+
+void timer_map_free(timer_map_t *map)
+{
+	if (map == NULL || map->zones == NULL) {
+		return;
+	}
+
+	hattrie_free(map->zones);
+	mp_delete(map->mm.ctx);
+	memset(map, 0, sizeof(*map));
+}
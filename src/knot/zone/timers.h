@@ -17,6 +17,7 @@
 #pragma once
 
 #include "libknot/internal/namedb/namedb.h"
+#include "libknot/internal/trie/hat-trie.h"
 #include "knot/zone/zone.h"
 #include "knot/zone/zonedb.h"
 
@@ -62,6 +63,53 @@ int read_zone_timers(namedb_t *timer_db, const zone_t *zone, time_t *timers);
  */
 int write_zone_timers(namedb_t *timer_db, zone_t *zone);
 
+/*!
+ * \brief Writes timers of zones with modified timers to timers db.
+ *
+ * Timers are written in large transactions, a single transaction covers
+ * many zones.
+ *
+ * \param timer_db  Timer database.
+ * \param zone_db   Zone database.
+ *
+ * \return KNOT_E*
+ */
+int write_timer_db(namedb_t *timer_db, knot_zonedb_t *zone_db);
+
+/*!
+ * \brief Timers of all zones loaded from timers db.
+ */
+typedef struct timer_map {
+	mm_ctx_t mm;        //!< Memory context for the timers.
+	hattrie_t *zones;   //!< Zone name -> array of timers.
+} timer_map_t;
+
+/*!
+ * \brief Reads timers of all zones from timers db in a single pass.
+ *
+ * \param timer_db  Timer database.
+ * \param map       Output map of timers, free with \ref timer_map_free.
+ *
+ * \return KNOT_E*
+ */
+int read_timer_db(namedb_t *timer_db, timer_map_t *map);
+
+/*!
+ * \brief Gets zone timers from the map of loaded timers.
+ *
+ * \param map     Map of timers.
+ * \param zone    Zone to get timers for.
+ * \param timers  Output array with timers (size must be ZONE_EVENT_COUNT).
+ */
+void timer_map_find(const timer_map_t *map, const zone_t *zone, time_t *timers);
+
+/*!
+ * \brief Frees the map of loaded timers.
+ *
+ * \param map  Map of timers.
+ */
+void timer_map_free(timer_map_t *map);
+
 /*!
  * \brief Removes stale zones info from timers db.
  *
@@ -25,11 +25,6 @@
 #include "libknot/internal/utils.h"
 #include "libknot/rrtype/soa.h"
 
-struct zone_diff_param {
-	zone_tree_t *nodes;
-	changeset_t *changeset;
-};
-
 // forward declaration
 static int knot_zone_diff_rdata(const knot_rrset_t *rrset1,
                                 const knot_rrset_t *rrset2,
@@ -230,34 +225,78 @@ static int knot_zone_diff_rrsets(const knot_rrset_t *rrset1,
 	return knot_zone_diff_rdata(rrset1, rrset2, changeset);
 }
 
-/*!< \todo this could be generic function for adding / removing. */
-static int knot_zone_diff_node(zone_node_t **node_ptr, void *data)
+/*! \brief Checks if two RR data sets are identical, including TTLs. */
+static bool rdataset_same(const knot_rdataset_t *rrs1,
+                          const knot_rdataset_t *rrs2)
 {
-	if (node_ptr == NULL || *node_ptr == NULL || data == NULL) {
-		return KNOT_EINVAL;
+	if (knot_rdataset_size(rrs1) != knot_rdataset_size(rrs2) ||
+	    !knot_rdataset_eq(rrs1, rrs2)) {
+		return false;
+	}
+
+	for (uint16_t i = 0; i < rrs1->rr_count; i++) {
+		if (knot_rdata_ttl(knot_rdataset_at(rrs1, i)) !=
+		    knot_rdata_ttl(knot_rdataset_at(rrs2, i))) {
+			return false;
+		}
 	}
 
-	zone_node_t *node = *node_ptr;
+	return true;
+}
 
-	struct zone_diff_param *param = (struct zone_diff_param *)data;
-	if (param->changeset == NULL) {
-		return KNOT_EINVAL;
+/*!
+ * \brief Checks if RRSet data are the same as RRSet of the given type in the
+ *        other node.
+ *
+ * Different fingerprints rule out the match quickly, equal fingerprints are
+ * confirmed by comparing the records.
+ */
+static bool rr_data_same(const struct rr_data *data, const zone_node_t *node,
+                         uint16_t type)
+{
+	if (data->hash == 0) {
+		return false;
 	}
 
-	/*
-	 * First, we have to search the second tree to see if there's according
-	 * node, if not, the whole node has been removed.
-	 */
-	const zone_node_t *node_in_second_tree = NULL;
-	const knot_dname_t *node_owner = node->owner;
-	assert(node_owner);
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		if (node->rrs[i].type == type) {
+			return node->rrs[i].hash == data->hash &&
+			       rdataset_same(&data->rrs, &node->rrs[i].rrs);
+		}
+	}
 
-	zone_tree_find(param->nodes, node_owner, &node_in_second_tree);
+	return false;
+}
 
-	if (node_in_second_tree == NULL) {
-		return knot_zone_diff_remove_node(param->changeset, node);
+/*!
+ * \brief Checks if two nodes with the same owner have the same RR data.
+ *
+ * Different fingerprints rule out the match quickly, equal fingerprints are
+ * confirmed by comparing the records.
+ */
+static bool node_same(zone_node_t *node1, zone_node_t *node2)
+{
+	if (node_hash(node1) != node_hash(node2) ||
+	    node1->rrset_count != node2->rrset_count) {
+		return false;
 	}
 
+	for (uint16_t i = 0; i < node1->rrset_count; i++) {
+		const struct rr_data *data = &node1->rrs[i];
+		const knot_rdataset_t *rrs2 = node_rdataset(node2, data->type);
+		if (rrs2 == NULL || !rdataset_same(&data->rrs, rrs2)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*! \brief Diffs RRSets of two nodes with the same owner. */
+static int knot_zone_diff_node(const zone_node_t *node,
+                               const zone_node_t *node_in_second_tree,
+                               changeset_t *changeset)
+{
 	assert(node_in_second_tree != node);
 
 	/* The nodes are in both trees, we have to diff each RRSet. */
@@ -266,8 +305,7 @@ static int knot_zone_diff_node(zone_node_t **node_ptr, void *data)
 		 * If there are no RRs in the first tree, all of the RRs
 		 * in the second tree will have to be inserted to ADD section.
 		 */
-		return knot_zone_diff_add_node(node_in_second_tree,
-		                               param->changeset);
+		return knot_zone_diff_add_node(node_in_second_tree, changeset);
 	}
 
 	for (unsigned i = 0; i < node->rrset_count; i++) {
@@ -283,16 +321,16 @@ static int knot_zone_diff_node(zone_node_t **node_ptr, void *data)
 			node_rrset(node_in_second_tree, rrset.type);
 		if (knot_rrset_empty(&rrset_from_second_node)) {
 			/* RRSet has been removed. Make a copy and remove. */
-			int ret = changeset_rem_rrset(
-				param->changeset, &rrset);
+			int ret = changeset_rem_rrset(changeset, &rrset);
 			if (ret != KNOT_EOK) {
 				return ret;
 			}
-		} else {
+		} else if (!rr_data_same(&node->rrs[i],
+		                         node_in_second_tree, rrset.type)) {
 			/* Diff RRSets. */
 			int ret = knot_zone_diff_rrsets(&rrset,
 			                                &rrset_from_second_node,
-			                                param->changeset);
+			                                changeset);
 			if (ret != KNOT_EOK) {
 				return ret;
 			}
@@ -311,8 +349,7 @@ static int knot_zone_diff_node(zone_node_t **node_ptr, void *data)
 		knot_rrset_t rrset_from_first_node = node_rrset(node, rrset.type);
 		if (knot_rrset_empty(&rrset_from_first_node)) {
 			/* RRSet has been added. Make a copy and add. */
-			int ret = changeset_add_rrset(
-				param->changeset, &rrset);
+			int ret = changeset_add_rrset(changeset, &rrset);
 			if (ret != KNOT_EOK) {
 				return ret;
 			}
@@ -322,75 +359,83 @@ static int knot_zone_diff_node(zone_node_t **node_ptr, void *data)
 	return KNOT_EOK;
 }
 
-/*!< \todo possibly not needed! */
-static int knot_zone_diff_add_new_nodes(zone_node_t **node_ptr, void *data)
+/*! \brief Returns current node of a zone tree iterator, NULL at the end. */
+static zone_node_t *iter_node(hattrie_iter_t *it)
 {
-	if (node_ptr == NULL || *node_ptr == NULL || data == NULL) {
-		dbg_zonediff("zone_diff: add_new_nodes: NULL arguments.\n");
-		return KNOT_EINVAL;
+	if (it == NULL || hattrie_iter_finished(it)) {
+		return NULL;
 	}
 
-	zone_node_t *node = *node_ptr;
-
-	struct zone_diff_param *param = (struct zone_diff_param *)data;
-	if (param->changeset == NULL) {
-		dbg_zonediff("zone_diff: add_new_nodes: NULL arguments.\n");
-		return KNOT_EINVAL;
-	}
-
-	/*
-	* If a node is not present in the second zone, it is a new node
-	* and has to be added to changeset. Differencies on the RRSet level are
-	* already handled.
-	*/
-
-	const knot_dname_t *node_owner = node->owner;
-	/*
-	 * Node should definitely have an owner, otherwise it would not be in
-	 * the tree.
-	 */
-	assert(node_owner);
-
-	zone_node_t *new_node = NULL;
-	zone_tree_get(param->nodes, node_owner, &new_node);
-
-	int ret = KNOT_EOK;
-
-	if (!new_node) {
-		assert(node);
-		ret = knot_zone_diff_add_node(node, param->changeset);
-		if (ret != KNOT_EOK) {
-			dbg_zonediff("zone_diff: add_new_nodes: Cannot add "
-			             "node: %p to changeset. Reason: %s.\n",
-			             node->owner,
-			             knot_strerror(ret));
-		}
-	}
-
-	return ret;
+	return (zone_node_t *)*hattrie_iter_val(it);
 }
 
+/*!
+ * \brief Diffs two zone trees.
+ *
+ * Both trees are walked in canonical order at once (merge-join), so each
+ * node is looked at only once. Nodes with different fingerprints of their
+ * RR data are diffed RRSet by RRSet, nodes with equal fingerprints are only
+ * checked for identical records.
+ */
 static int knot_zone_diff_load_trees(zone_tree_t *nodes1,
                                      zone_tree_t *nodes2,
                                      changeset_t *changeset)
 {
 	assert(changeset);
 
-	struct zone_diff_param param = { 0 };
-	param.changeset = changeset;
+	hattrie_iter_t *it1 = NULL;
+	hattrie_iter_t *it2 = NULL;
+	if (!zone_tree_is_empty(nodes1)) {
+		it1 = hattrie_iter_begin(nodes1, true);
+		if (it1 == NULL) {
+			return KNOT_ENOMEM;
+		}
+	}
+	if (!zone_tree_is_empty(nodes2)) {
+		it2 = hattrie_iter_begin(nodes2, true);
+		if (it2 == NULL) {
+			hattrie_iter_free(it1);
+			return KNOT_ENOMEM;
+		}
+	}
+
+	int ret = KNOT_EOK;
+	zone_node_t *node1 = iter_node(it1);
+	zone_node_t *node2 = iter_node(it2);
+	while (ret == KNOT_EOK && (node1 != NULL || node2 != NULL)) {
+		int cmp = 0;
+		if (node1 == NULL) {
+			cmp = 1;
+		} else if (node2 == NULL) {
+			cmp = -1;
+		} else {
+			cmp = knot_dname_cmp(node1->owner, node2->owner);
+		}
+
+		if (cmp < 0) {
+			/* Node is not in the second tree, it has been removed. */
+			ret = knot_zone_diff_remove_node(changeset, node1);
+			hattrie_iter_next(it1);
+		} else if (cmp > 0) {
+			/* Node is not in the first tree, it has been added. */
+			ret = knot_zone_diff_add_node(node2, changeset);
+			hattrie_iter_next(it2);
+		} else {
+			if (!node_same(node1, node2)) {
+				ret = knot_zone_diff_node(node1, node2, changeset);
+			}
+			hattrie_iter_next(it1);
+			hattrie_iter_next(it2);
+		}
 
-	// Traverse one tree, compare every node, each RRSet with its rdata.
-	param.nodes = nodes2;
-	int result = zone_tree_apply(nodes1, knot_zone_diff_node, &param);
-	if (result != KNOT_EOK) {
-		return result;
+		node1 = iter_node(it1);
+		node2 = iter_node(it2);
 	}
 
-	// Some nodes may have been added. Add missing nodes to changeset.
-	param.nodes = nodes1;
-	result = zone_tree_apply(nodes2, knot_zone_diff_add_new_nodes, &param);
+	hattrie_iter_free(it1);
+	hattrie_iter_free(it2);
 
-	return result;
+	return ret;
 }
 
 static int knot_zone_diff_load_content(const zone_contents_t *zone1,
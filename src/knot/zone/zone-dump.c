@@ -14,20 +14,40 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
+#include <errno.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
 
 #include "knot/zone/zone-dump.h"
 #include "libknot/descriptor.h"
 #include "knot/conf/conf.h"
 #include "libknot/libknot.h"
+#include "libknot/internal/macros.h"
+#include "libknot/internal/utils.h"
 #include "knot/dnssec/zone-nsec.h"
+#include "knot/server/dthreads.h"
 
 /*! \brief Size of auxiliary buffer. */
 #define DUMP_BUF_LEN (70 * 1024)
 
+/*! \brief Number of nodes formatted as one chunk of output. */
+#define DUMP_CHUNK_NODES 1024
+
+/*! \brief Number of formatted chunks per thread waiting for the writer. */
+#define DUMP_CHUNKS_AHEAD 4
+
+/*! \brief Growing output buffer. */
+typedef struct {
+	uint8_t *data;
+	size_t   len;
+	size_t   size;
+} dump_out_t;
+
 /*! \brief Dump parameters. */
 typedef struct {
-	FILE     *file;
+	dump_out_t *out;
 	char     *buf;
 	size_t   buflen;
 	uint64_t rr_count;
@@ -37,6 +57,90 @@ typedef struct {
 	const knot_dump_style_t *style;
 } dump_params_t;
 
+/*! \brief Node formatting callback. */
+typedef int (*node_dump_cb)(zone_node_t *node, dump_params_t *params);
+
+/*! \brief Output of a continuous range of nodes. */
+typedef struct {
+	dump_out_t out;
+	uint64_t rr_count;
+	int ret;
+	bool done;
+} dump_chunk_t;
+
+/*!
+ * \brief Dump pipeline.
+ *
+ * Worker threads take chunks of nodes in order and format them into memory,
+ * the writer writes the formatted chunks into the file in the same order.
+ * Workers do not run more than \a ahead chunks in front of the writer.
+ * The workers are started once per dump and serve all its sections.
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t *threads;
+	size_t workers;   /*!< Number of running worker threads. */
+	size_t busy;      /*!< Number of workers formatting a chunk. */
+	bool stop;        /*!< Workers are to exit. */
+	char *buf;        /*!< Auxiliary buffer of the writer. */
+	/* Section being dumped. */
+	zone_node_t **nodes;
+	size_t count;
+	dump_chunk_t *chunks;
+	size_t chunk_count;
+	size_t next;      /*!< First chunk not taken by a formatter. */
+	size_t written;   /*!< Number of chunks written into the file. */
+	size_t ahead;     /*!< Maximal number of chunks waiting for writer. */
+	bool abort;
+	node_dump_cb dump;
+	const dump_params_t *params;
+} dump_pipeline_t;
+
+static int out_reserve(dump_out_t *out, size_t len)
+{
+	if (out->len + len <= out->size) {
+		return KNOT_EOK;
+	}
+
+	size_t size = MAX(2 * out->size, out->len + len);
+	uint8_t *data = realloc(out->data, size);
+	if (data == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	out->data = data;
+	out->size = size;
+
+	return KNOT_EOK;
+}
+
+static int out_append(dump_out_t *out, const void *data, size_t len)
+{
+	int ret = out_reserve(out, len);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	memcpy(out->data + out->len, data, len);
+	out->len += len;
+
+	return KNOT_EOK;
+}
+
+static int rrset_dump_text(const knot_rrset_t *rrset,
+                           const knot_dump_style_t *style,
+                           dump_params_t *params)
+{
+	int len = knot_rrset_txt_dump(rrset, params->buf, params->buflen, style);
+	if (len < 0) {
+		return KNOT_ENOMEM;
+	}
+	params->rr_count += rrset->rrs.rr_count;
+
+	return out_append(params->out, params->buf, len);
+}
+
 static int apex_node_dump_text(zone_node_t *node, dump_params_t *params)
 {
 	knot_rrset_t soa = node_rrset(node, KNOT_RRTYPE_SOA);
@@ -45,13 +149,10 @@ static int apex_node_dump_text(zone_node_t *node, dump_params_t *params)
 	// Dump SOA record as a first.
 	if (!params->dump_nsec) {
 		soa_style.show_class = true;
-		if (knot_rrset_txt_dump(&soa, params->buf, params->buflen,
-					&soa_style) < 0) {
-			return KNOT_ENOMEM;
+		int ret = rrset_dump_text(&soa, &soa_style, params);
+		if (ret != KNOT_EOK) {
+			return ret;
 		}
-		params->rr_count += soa.rrs.rr_count;
-		fprintf(params->file, "%s", params->buf);
-		params->buf[0] = '\0';
 	}
 
 	// Dump other records.
@@ -68,27 +169,21 @@ static int apex_node_dump_text(zone_node_t *node, dump_params_t *params)
 			break;
 		}
 
-		if (knot_rrset_txt_dump(&rrset, params->buf, params->buflen,
-		                        params->style) < 0) {
-			return KNOT_ENOMEM;
+		int ret = rrset_dump_text(&rrset, params->style, params);
+		if (ret != KNOT_EOK) {
+			return ret;
 		}
-		params->rr_count +=  rrset.rrs.rr_count;
-		fprintf(params->file, "%s", params->buf);
-		params->buf[0] = '\0';
 	}
 
 	return KNOT_EOK;
 }
 
-static int node_dump_text(zone_node_t *node, void *data)
+static int node_dump_text(zone_node_t *node, dump_params_t *params)
 {
-	dump_params_t *params = (dump_params_t *)data;
-
 	// Zone apex rrsets.
 	if (node->owner == params->origin && !params->dump_rrsig &&
 	    !params->dump_nsec) {
-		apex_node_dump_text(node, params);
-		return KNOT_EOK;
+		return apex_node_dump_text(node, params);
 	}
 
 	// Dump non-apex rrsets.
@@ -117,48 +212,334 @@ static int node_dump_text(zone_node_t *node, void *data)
 			break;
 		}
 
-		if (knot_rrset_txt_dump(&rrset, params->buf, params->buflen,
-		                        params->style) < 0) {
-			return KNOT_ENOMEM;
+		int ret = rrset_dump_text(&rrset, params->style, params);
+		if (ret != KNOT_EOK) {
+			return ret;
 		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Dump all RR sets of the node in binary format.
+ *
+ * RR set: owner length (1 B), owner, type (2 B), class (2 B), count (2 B),
+ * followed by records: TTL (4 B), RDATA length (2 B), RDATA.
+ */
+static int node_dump_binary(zone_node_t *node, dump_params_t *params)
+{
+	size_t owner_len = knot_dname_size(node->owner);
+
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		knot_rrset_t rrset = node_rrset_at(node, i);
+
+		size_t size = 1 + owner_len + 3 * sizeof(uint16_t);
+		for (uint16_t j = 0; j < rrset.rrs.rr_count; j++) {
+			const knot_rdata_t *rr = knot_rdataset_at(&rrset.rrs, j);
+			size += sizeof(uint32_t) + sizeof(uint16_t) +
+			        knot_rdata_rdlen(rr);
+		}
+
+		int ret = out_reserve(params->out, size);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		uint8_t *pos = params->out->data + params->out->len;
+		*pos++ = owner_len;
+		memcpy(pos, node->owner, owner_len);
+		pos += owner_len;
+		wire_write_u16(pos, rrset.type);
+		wire_write_u16(pos + 2, rrset.rclass);
+		wire_write_u16(pos + 4, rrset.rrs.rr_count);
+		pos += 3 * sizeof(uint16_t);
+
+		for (uint16_t j = 0; j < rrset.rrs.rr_count; j++) {
+			const knot_rdata_t *rr = knot_rdataset_at(&rrset.rrs, j);
+			uint16_t rdlen = knot_rdata_rdlen(rr);
+			wire_write_u32(pos, knot_rdata_ttl(rr));
+			wire_write_u16(pos + 4, rdlen);
+			pos += sizeof(uint32_t) + sizeof(uint16_t);
+			memcpy(pos, knot_rdata_data(rr), rdlen);
+			pos += rdlen;
+		}
+
+		params->out->len += size;
 		params->rr_count += rrset.rrs.rr_count;
-		fprintf(params->file, "%s", params->buf);
-		params->buf[0] = '\0';
 	}
 
 	return KNOT_EOK;
 }
 
-int zone_dump_text(zone_contents_t *zone, const struct sockaddr_storage *from, FILE *file)
+/*! \brief Take next chunk for formatting. Call with pipeline lock held. */
+static bool take_chunk(dump_pipeline_t *pl, size_t *index)
 {
-	if (zone == NULL || file == NULL) {
-		return KNOT_EINVAL;
+	if (pl->abort || pl->next >= pl->chunk_count ||
+	    pl->next >= pl->written + pl->ahead) {
+		return false;
 	}
 
-	// Allocate auxiliary buffer for dumping operations.
+	*index = pl->next;
+	pl->next += 1;
+
+	return true;
+}
+
+/*! \brief Format one chunk of nodes. Call without pipeline lock held. */
+static void format_chunk(dump_pipeline_t *pl, size_t index, char *buf)
+{
+	dump_chunk_t *chunk = &pl->chunks[index];
+
+	dump_params_t params = *pl->params;
+	params.out = &chunk->out;
+	params.buf = buf;
+	params.buflen = DUMP_BUF_LEN;
+	params.rr_count = 0;
+
+	size_t first = index * DUMP_CHUNK_NODES;
+	size_t last = MIN(first + DUMP_CHUNK_NODES, pl->count);
+
+	int ret = KNOT_EOK;
+	for (size_t i = first; i < last && ret == KNOT_EOK; i++) {
+		ret = pl->dump(pl->nodes[i], &params);
+	}
+
+	pthread_mutex_lock(&pl->lock);
+	chunk->ret = ret;
+	chunk->rr_count = params.rr_count;
+	chunk->done = true;
+	pthread_cond_broadcast(&pl->cond);
+	pthread_mutex_unlock(&pl->lock);
+}
+
+static void *dump_worker_run(void *data)
+{
+	dump_pipeline_t *pl = data;
+
 	char *buf = malloc(DUMP_BUF_LEN);
 	if (buf == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&pl->lock);
+	while (!pl->stop) {
+		size_t index = 0;
+		if (take_chunk(pl, &index)) {
+			pl->busy += 1;
+			pthread_mutex_unlock(&pl->lock);
+			format_chunk(pl, index, buf);
+			pthread_mutex_lock(&pl->lock);
+			pl->busy -= 1;
+			pthread_cond_broadcast(&pl->cond);
+		} else {
+			pthread_cond_wait(&pl->cond, &pl->lock);
+		}
+	}
+	pthread_mutex_unlock(&pl->lock);
+
+	free(buf);
+	return NULL;
+}
+
+/*!
+ * \brief Write chunks into the file in order as they get formatted.
+ *
+ * The writer formats the chunk it waits for itself if no worker took it.
+ */
+static int write_chunks(dump_pipeline_t *pl, FILE *file, char *buf,
+                        uint64_t *rr_count)
+{
+	int ret = KNOT_EOK;
+
+	pthread_mutex_lock(&pl->lock);
+	for (size_t i = 0; i < pl->chunk_count && ret == KNOT_EOK; i++) {
+		dump_chunk_t *chunk = &pl->chunks[i];
+		while (!chunk->done) {
+			size_t index = 0;
+			if (take_chunk(pl, &index)) {
+				pthread_mutex_unlock(&pl->lock);
+				format_chunk(pl, index, buf);
+				pthread_mutex_lock(&pl->lock);
+			} else {
+				pthread_cond_wait(&pl->cond, &pl->lock);
+			}
+		}
+		pthread_mutex_unlock(&pl->lock);
+
+		ret = chunk->ret;
+		if (ret == KNOT_EOK && chunk->out.len > 0 &&
+		    fwrite(chunk->out.data, 1, chunk->out.len, file) != chunk->out.len) {
+			ret = knot_errno_to_error(errno);
+		}
+		*rr_count += chunk->rr_count;
+		free(chunk->out.data);
+		memset(&chunk->out, 0, sizeof(chunk->out));
+
+		pthread_mutex_lock(&pl->lock);
+		pl->written += 1;
+		pthread_cond_broadcast(&pl->cond);
+	}
+	pl->abort = true;
+	pthread_cond_broadcast(&pl->cond);
+	pthread_mutex_unlock(&pl->lock);
+
+	return ret;
+}
+
+/*!
+ * \brief Start dump workers.
+ *
+ * \param pl         Pipeline to be initialized.
+ * \param max_count  Maximal number of nodes in a dumped section.
+ */
+static int pipeline_init(dump_pipeline_t *pl, size_t max_count)
+{
+	memset(pl, 0, sizeof(*pl));
+
+	size_t chunks = (max_count + DUMP_CHUNK_NODES - 1) / DUMP_CHUNK_NODES;
+	size_t workers = MIN((size_t)dt_optimal_size(), MAX(chunks, 1) - 1);
+
+	pl->buf = malloc(DUMP_BUF_LEN);
+	pl->threads = calloc(MAX(workers, 1), sizeof(pthread_t));
+	if (pl->buf == NULL || pl->threads == NULL) {
+		free(pl->buf);
+		free(pl->threads);
 		return KNOT_ENOMEM;
 	}
 
-	fprintf(file, ";; Zone dump (Knot DNS %s)\n", PACKAGE_VERSION);
+	pthread_mutex_init(&pl->lock, NULL);
+	pthread_cond_init(&pl->cond, NULL);
 
-	// Set structure with parameters.
-	zone_node_t *apex = zone->apex;
-	dump_params_t params;
-	params.file = file;
-	params.buf = buf;
-	params.buflen = DUMP_BUF_LEN;
-	params.rr_count = 0;
-	params.origin = apex->owner;
-	params.style = &KNOT_DUMP_STYLE_DEFAULT;
+	for (; pl->workers < workers; pl->workers++) {
+		if (pthread_create(&pl->threads[pl->workers], NULL,
+		                   dump_worker_run, pl) != 0) {
+			break;
+		}
+	}
 
-	int ret;
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Stop dump workers.
+ */
+static void pipeline_deinit(dump_pipeline_t *pl)
+{
+	pthread_mutex_lock(&pl->lock);
+	pl->stop = true;
+	pthread_cond_broadcast(&pl->cond);
+	pthread_mutex_unlock(&pl->lock);
+
+	for (size_t i = 0; i < pl->workers; i++) {
+		pthread_join(pl->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pl->cond);
+	pthread_mutex_destroy(&pl->lock);
+	free(pl->threads);
+	free(pl->buf);
+}
+
+/*!
+ * \brief Format nodes in parallel and write them into the file in order.
+ */
+static int dump_nodes(dump_pipeline_t *pl, zone_node_t **nodes, size_t count,
+                      node_dump_cb dump, const dump_params_t *params,
+                      FILE *file, uint64_t *rr_count)
+{
+	if (count == 0) {
+		return KNOT_EOK;
+	}
+
+	size_t chunk_count = (count + DUMP_CHUNK_NODES - 1) / DUMP_CHUNK_NODES;
+	dump_chunk_t *chunks = calloc(chunk_count, sizeof(dump_chunk_t));
+	if (chunks == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	pthread_mutex_lock(&pl->lock);
+	pl->nodes = nodes;
+	pl->count = count;
+	pl->chunks = chunks;
+	pl->chunk_count = chunk_count;
+	pl->next = 0;
+	pl->written = 0;
+	pl->ahead = DUMP_CHUNKS_AHEAD * (pl->workers + 1);
+	pl->abort = false;
+	pl->dump = dump;
+	pl->params = params;
+	pthread_cond_broadcast(&pl->cond);
+	pthread_mutex_unlock(&pl->lock);
+
+	int ret = write_chunks(pl, file, pl->buf, rr_count);
+
+	// Wait for workers still formatting chunks of an aborted section.
+	pthread_mutex_lock(&pl->lock);
+	while (pl->busy > 0) {
+		pthread_cond_wait(&pl->cond, &pl->lock);
+	}
+	pl->chunks = NULL;
+	pl->chunk_count = 0;
+	pthread_mutex_unlock(&pl->lock);
+
+	for (size_t i = 0; i < chunk_count; i++) {
+		free(chunks[i].out.data);
+	}
+	free(chunks);
+
+	return ret;
+}
+
+static int collect_node(zone_node_t *node, void *data)
+{
+	zone_node_t ***write = data;
+	**write = node;
+	*write += 1;
+
+	return KNOT_EOK;
+}
 
+/*!
+ * \brief Collect nodes of the zone tree in canonical order.
+ */
+static int collect_nodes(zone_contents_t *zone, bool nsec3,
+                         zone_node_t ***nodes, size_t *count)
+{
+	*count = zone_tree_weight(nsec3 ? zone->nsec3_nodes : zone->nodes);
+	*nodes = malloc(MAX(*count, 1) * sizeof(zone_node_t *));
+	if (*nodes == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	zone_node_t **write = *nodes;
+	int ret = nsec3 ?
+	          zone_contents_nsec3_apply_inorder(zone, collect_node, &write) :
+	          zone_contents_tree_apply_inorder(zone, collect_node, &write);
+	if (ret != KNOT_EOK) {
+		free(*nodes);
+		*nodes = NULL;
+		return ret;
+	}
+	assert(write == *nodes + *count);
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Dump the zone text sections.
+ */
+static int dump_text_sections(dump_pipeline_t *pl, zone_contents_t *zone,
+                              zone_node_t **nodes, size_t count,
+                              zone_node_t **nsec3_nodes, size_t nsec3_count,
+                              dump_params_t *params, FILE *file,
+                              uint64_t *rr_count)
+{
 	// Dump standard zone records without rrsigs.
-	params.dump_rrsig = false;
-	params.dump_nsec = false;
-	ret = zone_contents_tree_apply_inorder(zone, node_dump_text, &params);
+	params->dump_rrsig = false;
+	params->dump_nsec = false;
+	int ret = dump_nodes(pl, nodes, count, node_dump_text, params, file,
+	                     rr_count);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -168,10 +549,10 @@ int zone_dump_text(zone_contents_t *zone, const struct sockaddr_storage *from, F
 		fprintf(file, ";; DNSSEC signatures\n");
 
 		// Dump rrsig records.
-		params.dump_rrsig = true;
-		params.dump_nsec = false;
-		ret = zone_contents_tree_apply_inorder(zone, node_dump_text,
-		                                       &params);
+		params->dump_rrsig = true;
+		params->dump_nsec = false;
+		ret = dump_nodes(pl, nodes, count, node_dump_text, params, file,
+		                 rr_count);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
@@ -181,20 +562,20 @@ int zone_dump_text(zone_contents_t *zone, const struct sockaddr_storage *from, F
 	if (knot_is_nsec3_enabled(zone)) {
 		fprintf(file, ";; DNSSEC NSEC3 chain\n");
 
-		params.dump_rrsig = false;
-		params.dump_nsec = true;
-		ret = zone_contents_nsec3_apply_inorder(zone, node_dump_text,
-		                                        &params);
+		params->dump_rrsig = false;
+		params->dump_nsec = true;
+		ret = dump_nodes(pl, nsec3_nodes, nsec3_count, node_dump_text,
+		                 params, file, rr_count);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
 
 		fprintf(file, ";; DNSSEC NSEC3 signatures\n");
 
-		params.dump_rrsig = true;
-		params.dump_nsec = false;
-		ret = zone_contents_nsec3_apply_inorder(zone, node_dump_text,
-		                                        &params);
+		params->dump_rrsig = true;
+		params->dump_nsec = false;
+		ret = dump_nodes(pl, nsec3_nodes, nsec3_count, node_dump_text,
+		                 params, file, rr_count);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
@@ -202,15 +583,60 @@ int zone_dump_text(zone_contents_t *zone, const struct sockaddr_storage *from, F
 		fprintf(file, ";; DNSSEC NSEC chain\n");
 
 		// Dump nsec records.
-		params.dump_rrsig = false;
-		params.dump_nsec = true;
-		ret = zone_contents_tree_apply_inorder(zone, node_dump_text,
-		                                       &params);
+		params->dump_rrsig = false;
+		params->dump_nsec = true;
+		ret = dump_nodes(pl, nodes, count, node_dump_text, params, file,
+		                 rr_count);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
 	}
 
+	return KNOT_EOK;
+}
+
+int zone_dump_text(zone_contents_t *zone, const struct sockaddr_storage *from, FILE *file)
+{
+	if (zone == NULL || file == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	// Collect nodes, the dump is split among threads by node ranges.
+	zone_node_t **nodes = NULL;
+	zone_node_t **nsec3_nodes = NULL;
+	size_t count = 0;
+	size_t nsec3_count = 0;
+	int ret = collect_nodes(zone, false, &nodes, &count);
+	if (ret == KNOT_EOK) {
+		ret = collect_nodes(zone, true, &nsec3_nodes, &nsec3_count);
+	}
+	if (ret != KNOT_EOK) {
+		free(nodes);
+		return ret;
+	}
+
+	fprintf(file, ";; Zone dump (Knot DNS %s)\n", PACKAGE_VERSION);
+
+	// Set structure with parameters.
+	dump_params_t params;
+	memset(&params, 0, sizeof(params));
+	params.origin = zone->apex->owner;
+	params.style = &KNOT_DUMP_STYLE_DEFAULT;
+
+	uint64_t rr_count = 0;
+	dump_pipeline_t pl;
+	ret = pipeline_init(&pl, MAX(count, nsec3_count));
+	if (ret == KNOT_EOK) {
+		ret = dump_text_sections(&pl, zone, nodes, count, nsec3_nodes,
+		                         nsec3_count, &params, file, &rr_count);
+		pipeline_deinit(&pl);
+	}
+	free(nodes);
+	free(nsec3_nodes);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
 	// Create formated date-time string.
 	time_t now = time(NULL);
 	struct tm tm;
@@ -221,7 +647,7 @@ int zone_dump_text(zone_contents_t *zone, const struct sockaddr_storage *from, F
 	// Dump trailing statistics.
 	fprintf(file, ";; Written %"PRIu64" records\n"
 	              ";; Time %s\n",
-	        params.rr_count, date);
+	        rr_count, date);
 
 	// If a master server is configured, dump info about it.
 	if (from) {
@@ -231,7 +657,67 @@ int zone_dump_text(zone_contents_t *zone, const struct sockaddr_storage *from, F
 		fprintf(file, ";; Transfered from %s\n", addr_str);
 	}
 
-	free(buf);
+	return KNOT_EOK;
+}
+
+int zone_dump_binary(zone_contents_t *zone, FILE *file)
+{
+	if (zone == NULL || file == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	// Header: magic, zone name and SOA serial of the dumped contents.
+	const knot_rdataset_t *soa = node_rdataset(zone->apex, KNOT_RRTYPE_SOA);
+	if (soa == NULL) {
+		return KNOT_EINVAL;
+	}
+	size_t origin_len = knot_dname_size(zone->apex->owner);
+	uint8_t header[ZONE_DUMP_BINARY_MAGIC_LEN + 1 + KNOT_DNAME_MAXLEN +
+	               sizeof(uint32_t)];
+	uint8_t *pos = header;
+	memcpy(pos, ZONE_DUMP_BINARY_MAGIC, ZONE_DUMP_BINARY_MAGIC_LEN);
+	pos += ZONE_DUMP_BINARY_MAGIC_LEN;
+	*pos++ = origin_len;
+	memcpy(pos, zone->apex->owner, origin_len);
+	pos += origin_len;
+	wire_write_u32(pos, knot_soa_serial(soa));
+	pos += sizeof(uint32_t);
+	if (fwrite(header, 1, pos - header, file) != pos - header) {
+		return knot_errno_to_error(errno);
+	}
+
+	dump_params_t params;
+	memset(&params, 0, sizeof(params));
+
+	dump_pipeline_t pl;
+	int ret = pipeline_init(&pl, MAX(zone_tree_weight(zone->nodes),
+	                                 zone_tree_weight(zone->nsec3_nodes)));
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	uint64_t rr_count = 0;
+	for (int nsec3 = 0; nsec3 <= 1 && ret == KNOT_EOK; nsec3++) {
+		zone_node_t **nodes = NULL;
+		size_t count = 0;
+		ret = collect_nodes(zone, nsec3, &nodes, &count);
+		if (ret == KNOT_EOK) {
+			ret = dump_nodes(&pl, nodes, count, node_dump_binary,
+			                 &params, file, &rr_count);
+			free(nodes);
+		}
+	}
+	pipeline_deinit(&pl);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	// Terminator (empty owner) and record count.
+	uint8_t trailer[1 + sizeof(uint64_t)] = { 0 };
+	wire_write_u64(trailer + 1, rr_count);
+	if (fwrite(trailer, 1, sizeof(trailer), file) != sizeof(trailer)) {
+		return knot_errno_to_error(errno);
+	}
 
 	return KNOT_EOK;
 }
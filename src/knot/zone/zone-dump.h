@@ -18,7 +18,7 @@
  *
  * \author Daniel Salzman <daniel.salzman@nic.cz>
  *
- * \brief Zone text dump facility.
+ * \brief Zone text and binary dump facility.
  *
  * \addtogroup zone-load-dump
  * @{
@@ -28,6 +28,12 @@
 
 #include "knot/zone/zone.h"
 
+/*! \brief Leading bytes of a binary zone dump. */
+#define ZONE_DUMP_BINARY_MAGIC "\0KNOTZB1"
+
+/*! \brief Length of the binary zone dump magic. */
+#define ZONE_DUMP_BINARY_MAGIC_LEN 8
+
 /*!
  * \brief Dumps given zone to text file.
  *
@@ -40,4 +46,20 @@
  */
 int zone_dump_text(zone_contents_t *zone, const struct sockaddr_storage *from, FILE *file);
 
+/*!
+ * \brief Dumps given zone to binary file.
+ *
+ * The binary dump contains records in wire format and is faster to load
+ * than the text dump. It is not meant to be edited or transferred between
+ * different server versions. The header holds the zone name and the SOA
+ * serial, the loader checks both against the loaded records.
+ *
+ * \param zone Zone to be saved.
+ * \param file File to write to.
+ *
+ * \retval KNOT_EOK on success.
+ * \retval < 0 if error.
+ */
+int zone_dump_binary(zone_contents_t *zone, FILE *file);
+
 /*! @} */
@@ -23,6 +23,15 @@
 #include "knot/dnssec/zone-events.h"
 #include "knot/updates/apply.h"
 #include "libknot/rdata.h"
+#include "libknot/internal/macros.h"
+
+/*! \brief Compute node fingerprint used by later zone diffs. */
+static int hash_node(zone_node_t *node, void *data)
+{
+	UNUSED(data);
+	node_hash(node);
+	return KNOT_EOK;
+}
 
 zone_contents_t *zone_load_contents(conf_zone_t *zone_config)
 {
@@ -40,6 +49,11 @@ zone_contents_t *zone_load_contents(conf_zone_t *zone_config)
 	 */
 	zl.creator->master = !zone_load_can_bootstrap(zone_config);
 
+	/* Fast checks verify RRSIGs only in a sample of nodes. */
+	if (zone_config->enable_checks == CONF_CHECKS_FAST) {
+		zl.checks_sample = zone_config->checks_sample;
+	}
+
 	zone_contents_t *zone_contents = zonefile_load(&zl);
 	zonefile_close(&zl);
 	if (zone_contents == NULL) {
@@ -140,8 +154,14 @@ int zone_load_post(zone_contents_t *contents, zone_t *zone, uint32_t *dnssec_ref
 	/* Sign zone using DNSSEC (if configured). */
 	if (conf->dnssec_enable) {
 		assert(conf->build_diffs);
-		ret = knot_dnssec_zone_sign(contents, conf, &change, KNOT_SOA_SERIAL_UPDATE,
-		                            dnssec_refresh);
+		if (conf->dnssec_online) {
+			ret = knot_dnssec_zone_publish_keys(contents, conf, &change,
+			                                    dnssec_refresh);
+		} else {
+			ret = knot_dnssec_zone_sign(contents, conf, &change,
+			                            KNOT_SOA_SERIAL_UPDATE,
+			                            dnssec_refresh);
+		}
 		if (ret != KNOT_EOK) {
 			changeset_clear(&change);
 			return ret;
@@ -160,6 +180,12 @@ int zone_load_post(zone_contents_t *contents, zone_t *zone, uint32_t *dnssec_ref
 		}
 	}
 
+	/* Fingerprint nodes, the next reload will skip unchanged nodes. */
+	if (conf->build_diffs) {
+		zone_contents_tree_apply_inorder(contents, hash_node, NULL);
+		zone_contents_nsec3_apply_inorder(contents, hash_node, NULL);
+	}
+
 	/* Calculate IXFR from differences (if configured). */
 	const bool contents_changed = zone->contents && (contents != zone->contents);
 	if (contents_changed && conf->build_diffs) {
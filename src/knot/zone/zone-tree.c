@@ -196,7 +196,7 @@ dbg_zone_exec_detail(
 zone_node_t *zone_tree_get_next(zone_tree_t *tree,
                                 const knot_dname_t *owner)
 {
-	if (tree == NULL || owner == NULL) {
+	if (zone_tree_is_empty(tree) || owner == NULL) {
 		return NULL;
 	}
 
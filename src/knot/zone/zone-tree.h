@@ -158,6 +158,19 @@ int zone_tree_get_less_or_equal(zone_tree_t *tree,
                                 zone_node_t **found,
                                 zone_node_t **previous);
 
+/*!
+ * \brief Finds the next non-empty authoritative node in canonical order.
+ *
+ * The search wraps around to the first node of the tree.
+ *
+ * \param tree   Zone tree to search in.
+ * \param owner  Owner of the node to start from (need not be in the tree).
+ *
+ * \return Next node, NULL if the tree is empty.
+ */
+zone_node_t *zone_tree_get_next(zone_tree_t *tree,
+                                const knot_dname_t *owner);
+
 /*!
  * \brief Removes node with the given owner from the zone tree and returns it.
  *
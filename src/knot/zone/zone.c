@@ -16,13 +16,17 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 
 #include "libknot/descriptor.h"
 #include "knot/common/evsched.h"
 #include "libknot/internal/lists.h"
 #include "knot/common/trim.h"
+#include "knot/dnssec/online-sign.h"
+#include "knot/dnssec/zone-events.h"
 #include "knot/zone/node.h"
 #include "knot/zone/zone.h"
 #include "knot/zone/zonefile.h"
@@ -92,6 +96,11 @@ void zone_free(zone_t **zone_ptr)
 
 	zone_t *zone = *zone_ptr;
 
+	if (zone->ddns_timer != NULL) {
+		evsched_cancel(zone->ddns_timer);
+		evsched_event_free(zone->ddns_timer);
+	}
+
 	zone_events_deinit(zone);
 
 	knot_dname_free(&zone->name, NULL);
@@ -100,6 +109,9 @@ void zone_free(zone_t **zone_ptr)
 	pthread_mutex_destroy(&zone->ddns_lock);
 	pthread_mutex_destroy(&zone->journal_lock);
 
+	knot_dnssec_state_free(&zone->dnssec_state);
+	knot_online_sign_free(zone->online_sign);
+
 	/* Free assigned config. */
 	conf_free_zone(zone->conf);
 
@@ -170,6 +182,16 @@ zone_contents_t *zone_switch_contents(zone_t *zone, zone_contents_t *new_content
 	return old_contents;
 }
 
+struct knot_online_sign *zone_switch_online_sign(zone_t *zone,
+                                                 struct knot_online_sign *online_sign)
+{
+	if (zone == NULL) {
+		return NULL;
+	}
+
+	return rcu_xchg_pointer(&zone->online_sign, online_sign);
+}
+
 const conf_iface_t *zone_master(const zone_t *zone)
 {
 	if (zone == NULL) {
@@ -219,7 +241,8 @@ int zone_flush_journal(zone_t *zone)
 
 	/* Synchronize journal. */
 	conf_zone_t *conf = zone->conf;
-	int ret = zonefile_write(conf->file, contents, from);
+	int ret = zonefile_write(conf->file, contents, from,
+	                         conf->zonefile_binary);
 	if (ret == KNOT_EOK) {
 		log_zone_info(zone->name, "zone file updated, serial %u -> %u",
 		              zone->zonefile_serial, serial_to);
@@ -248,6 +271,50 @@ int zone_flush_journal(zone_t *zone)
 	return ret;
 }
 
+/*! \brief Commit window expired, apply the queued updates. */
+static int ddns_window_expired(event_t *event)
+{
+	zone_events_enqueue(event->data, ZONE_EVENT_UPDATE);
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Open commit window for the first queued request.
+ *
+ * \return True if the UPDATE event is run when the window expires.
+ */
+static bool ddns_window_open(zone_t *zone)
+{
+	const int window = zone->conf->ddns_window;
+	const size_t batch = zone->conf->ddns_batch;
+	if (window <= 0 || zone_master(zone) != NULL) {
+		return false;
+	}
+
+	/* Batch is full, don't wait for the window. */
+	if (batch > 0 && zone->ddns_queue_size >= batch) {
+		return false;
+	}
+
+	if (zone->ddns_timer == NULL) {
+		if (zone->events.event == NULL) {
+			return false;
+		}
+		zone->ddns_timer = evsched_event_create(zone->events.event->sched,
+		                                        ddns_window_expired, zone);
+		if (zone->ddns_timer == NULL) {
+			return false;
+		}
+	}
+
+	/* Only the first request opens the window. */
+	if (zone->ddns_queue_size == 1) {
+		evsched_schedule(zone->ddns_timer, window);
+	}
+
+	return true;
+}
+
 int zone_update_enqueue(zone_t *zone, knot_pkt_t *pkt, struct process_query_param *param)
 {
 
@@ -276,10 +343,14 @@ int zone_update_enqueue(zone_t *zone, knot_pkt_t *pkt, struct process_query_para
 	add_tail(&zone->ddns_queue, (node_t *)req);
 	++zone->ddns_queue_size;
 
+	bool delayed = ddns_window_open(zone);
+
 	pthread_mutex_unlock(&zone->ddns_lock);
 
 	/* Schedule UPDATE event. */
-	zone_events_schedule(zone, ZONE_EVENT_UPDATE, ZONE_EVENT_NOW);
+	if (!delayed) {
+		zone_events_schedule(zone, ZONE_EVENT_UPDATE, ZONE_EVENT_NOW);
+	}
 
 	return KNOT_EOK;
 }
@@ -297,14 +368,28 @@ size_t zone_update_dequeue(zone_t *zone, list_t *updates)
 		return 0;
 	}
 
-	*updates = zone->ddns_queue;
-	size_t update_count = zone->ddns_queue_size;
-	init_list(&zone->ddns_queue);
-	zone->ddns_queue_size = 0;
+	/* Take all requests, or at most the batch size if not forwarding. */
+	size_t batch = zone->conf->ddns_batch;
+	if (batch == 0 || zone_master(zone) != NULL ||
+	    zone->ddns_queue_size <= batch) {
+		init_list(updates);
+		add_tail_list(updates, &zone->ddns_queue);
+		batch = zone->ddns_queue_size;
+		init_list(&zone->ddns_queue);
+		zone->ddns_queue_size = 0;
+	} else {
+		init_list(updates);
+		for (size_t i = 0; i < batch; i++) {
+			node_t *n = HEAD(zone->ddns_queue);
+			rem_node(n);
+			add_tail(updates, n);
+		}
+		zone->ddns_queue_size -= batch;
+	}
 
 	pthread_mutex_unlock(&zone->ddns_lock);
 
-	return update_count;
+	return batch;
 }
 
 bool zone_transfer_needed(const zone_t *zone, const knot_pkt_t *pkt)
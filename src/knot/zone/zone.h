@@ -38,6 +38,8 @@
 #include "libknot/dname.h"
 
 struct process_query_param;
+struct knot_dnssec_state;
+struct knot_online_sign;
 
 /*!
  * \brief Zone flags.
@@ -59,12 +61,19 @@ typedef struct zone
 
 	/*! \brief DDNS queue and lock. */
 	pthread_mutex_t ddns_lock;
+	event_t *ddns_timer;	/*!< Commit window expiration. */
 	size_t ddns_queue_size;
 	list_t ddns_queue;
 	
 	/*! \brief Journal access lock. */
 	pthread_mutex_t journal_lock;
 
+	/*! \brief DNSSEC signing state for incremental updates. */
+	struct knot_dnssec_state *dnssec_state;
+
+	/*! \brief Keys and signature caches for online signing (RCU). */
+	struct knot_online_sign *online_sign;
+
 	/*! \brief Zone events. */
 	zone_events_t events;     /*!< Zone events timers. */
 	uint32_t bootstrap_retry; /*!< AXFR/IN bootstrap retry. */
@@ -106,6 +115,14 @@ int zone_change_store(zone_t *zone, changeset_t *change);
 zone_contents_t *zone_switch_contents(zone_t *zone,
 					   zone_contents_t *new_contents);
 
+/*!
+ * \brief Atomically switch the online signing context of the zone.
+ *
+ * \return Previous context, free it after synchronize_rcu().
+ */
+struct knot_online_sign *zone_switch_online_sign(zone_t *zone,
+                                                 struct knot_online_sign *online_sign);
+
 /*! \brief Return zone master remote. */
 const conf_iface_t *zone_master(const zone_t *zone);
 
@@ -118,7 +135,11 @@ int zone_flush_journal(zone_t *zone);
 /*! \brief Enqueue UPDATE request for processing. */
 int zone_update_enqueue(zone_t *zone, knot_pkt_t *pkt, struct process_query_param *param);
 
-/*! \brief Dequeue UPDATE request. Returns number of queued updates. */
+/*!
+ * \brief Dequeue UPDATE requests, at most the zone commit size.
+ *
+ * \return Number of dequeued updates.
+ */
 size_t zone_update_dequeue(zone_t *zone, list_t *updates);
 
 /*! \brief Returns true if final SOA in transfer has newer serial than zone */
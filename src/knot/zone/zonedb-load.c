@@ -121,7 +121,7 @@ static zone_t *create_zone_from(conf_zone_t *zone_conf, server_t *server)
 	}
 
 	int result = zone_events_setup(zone, server->workers, &server->sched,
-	                               server->timers_db);
+	                               server->timers_db, server->conn_pool);
 	if (result != KNOT_EOK) {
 		zone->conf = NULL;
 		zone_free(&zone);
@@ -139,6 +139,9 @@ static zone_t *create_zone_reload(conf_zone_t *zone_conf, server_t *server,
 		return NULL;
 	}
 	zone->contents = old_zone->contents;
+	if (zone_conf->dnssec_online) {
+		zone->online_sign = old_zone->online_sign;
+	}
 	
 	const zone_status_t zstatus = zone_file_status(old_zone, zone_conf);
 	
@@ -191,25 +194,17 @@ static bool zone_expired(const time_t *timers)
 	return now <= timers[ZONE_EVENT_EXPIRE];
 }
 
-static zone_t *create_zone_new(conf_zone_t *zone_conf, server_t *server)
+static zone_t *create_zone_new(conf_zone_t *zone_conf, server_t *server,
+                               const timer_map_t *timer_map)
 {
 	zone_t *zone = create_zone_from(zone_conf, server);
 	if (!zone) {
 		return NULL;
 	}
 	
-	time_t timers[ZONE_EVENT_COUNT];
-	memset(timers, 0, sizeof(timers));
-	
 	// Get persistent timers
-	int ret = read_zone_timers(server->timers_db, zone, timers);
-	if (ret != KNOT_EOK) {
-		log_zone_error(zone->name, "cannot read zone timers (%s)",
-		               knot_strerror(ret));
-		zone->conf = NULL;
-		zone_free(&zone);
-		return NULL;
-	}
+	time_t timers[ZONE_EVENT_COUNT];
+	timer_map_find(timer_map, zone, timers);
 	
 	reuse_events(zone, timers);
 	
@@ -245,11 +240,12 @@ static zone_t *create_zone_new(conf_zone_t *zone_conf, server_t *server)
  * \param zone_conf  Zone configuration.
  * \param server     Server.
  * \param old_zone   Already loaded zone (can be NULL).
+ * \param timer_map  Persistent timers of all zones.
  *
  * \return Error code, KNOT_EOK if successful.
  */
 static zone_t *create_zone(conf_zone_t *zone_conf, server_t *server,
-                           zone_t *old_zone)
+                           zone_t *old_zone, const timer_map_t *timer_map)
 {
 	assert(zone_conf);
 	assert(server);
@@ -257,7 +253,7 @@ static zone_t *create_zone(conf_zone_t *zone_conf, server_t *server,
 	if (old_zone) {
 		return create_zone_reload(zone_conf, server, old_zone);
 	} else {
-		return create_zone_new(zone_conf, server);
+		return create_zone_new(zone_conf, server, timer_map);
 	}
 }
 
@@ -283,6 +279,13 @@ static knot_zonedb_t *create_zonedb(const conf_t *conf, server_t *server)
 		return NULL;
 	}
 
+	/* Read persistent timers of all zones at once. */
+	timer_map_t timer_map;
+	int ret = read_timer_db(server->timers_db, &timer_map);
+	if (ret != KNOT_EOK) {
+		log_warning("cannot read zone timers (%s)", knot_strerror(ret));
+	}
+
 	hattrie_iter_t *it = hattrie_iter_begin(conf->zones, false);
 	for (; !hattrie_iter_finished(it); hattrie_iter_next(it)) {
 
@@ -292,7 +295,7 @@ static knot_zonedb_t *create_zonedb(const conf_t *conf, server_t *server)
 		zone_t *old_zone = knot_zonedb_find(db_old, apex);
 		knot_dname_free(&apex, NULL);
 
-		zone_t *zone = create_zone(zone_config, server, old_zone);
+		zone_t *zone = create_zone(zone_config, server, old_zone, &timer_map);
 		if (!zone) {
 			log_zone_str_error(zone_config->name,
 					   "zone cannot be created");
@@ -304,6 +307,8 @@ static knot_zonedb_t *create_zonedb(const conf_t *conf, server_t *server)
 	}
 	hattrie_iter_free(it);
 
+	timer_map_free(&timer_map);
+
 	return db_new;
 }
 
@@ -331,6 +336,9 @@ static int remove_old_zonedb(const knot_zonedb_t *db_new, knot_zonedb_t *db_old)
 
 		if (old_zone) {
 			old_zone->contents = NULL;
+			if (old_zone->online_sign == new_zone->online_sign) {
+				old_zone->online_sign = NULL;
+			}
 		}
 
 		knot_zonedb_iter_next(&it);
@@ -37,6 +37,7 @@
 #include "libknot/rdata.h"
 #include "knot/zone/zone-dump.h"
 #include "libknot/rrtype/naptr.h"
+#include "libknot/rrtype/soa.h"
 
 #define ERROR(zone, fmt...) log_zone_error(zone, "zone loader, " fmt)
 #define WARNING(zone, fmt...) log_zone_warning(zone, "zone loader, " fmt)
@@ -103,12 +104,11 @@ void log_ttl_error(const zone_contents_t *zone, const zone_node_t *node,
 	                         ZC_ERR_TTL_MISMATCH, info_str);
 }
 
-int zcreator_step(zcreator_t *zc, const knot_rrset_t *rr)
+/*!
+ * \brief Add RR set into the zone, check the node it was added to.
+ */
+static int zcreator_add(zcreator_t *zc, const knot_rrset_t *rr)
 {
-	if (zc == NULL || rr == NULL || rr->rrs.rr_count != 1) {
-		return KNOT_EINVAL;
-	}
-
 	if (rr->type == KNOT_RRTYPE_SOA &&
 	    node_rrtype_exists(zc->z->apex, KNOT_RRTYPE_SOA)) {
 		// Ignore extra SOA
@@ -144,6 +144,15 @@ int zcreator_step(zcreator_t *zc, const knot_rrset_t *rr)
 	return sem_fatal_error ? KNOT_ESEMCHECK : KNOT_EOK;
 }
 
+int zcreator_step(zcreator_t *zc, const knot_rrset_t *rr)
+{
+	if (zc == NULL || rr == NULL || rr->rrs.rr_count != 1) {
+		return KNOT_EINVAL;
+	}
+
+	return zcreator_add(zc, rr);
+}
+
 /*! \brief Creates RR from parser input, passes it to handling function. */
 static void scanner_process(zs_scanner_t *scanner)
 {
@@ -186,6 +195,181 @@ static void scanner_process(zs_scanner_t *scanner)
 	knot_rdataset_clear(&rr.rrs, NULL);
 }
 
+/*! \brief Read exactly \a len bytes from the binary zone file. */
+static int read_binary(FILE *f, void *data, size_t len)
+{
+	if (fread(data, 1, len, f) != len) {
+		return ferror(f) ? knot_errno_to_error(errno) : KNOT_EMALF;
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Read one RR set from the binary zone file, see zone_dump_binary(). */
+static int read_binary_rrset(FILE *f, knot_dname_t *owner, size_t owner_len,
+                             uint8_t *rdata, knot_rrset_t *rr)
+{
+	int ret = read_binary(f, owner, owner_len);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	if (knot_dname_wire_check(owner, owner + owner_len, NULL) != owner_len) {
+		return KNOT_EMALF;
+	}
+
+	uint8_t header[3 * sizeof(uint16_t)];
+	ret = read_binary(f, header, sizeof(header));
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	knot_rrset_init(rr, owner, wire_read_u16(header),
+	                wire_read_u16(header + 2));
+
+	uint16_t count = wire_read_u16(header + 4);
+	for (uint16_t i = 0; i < count; i++) {
+		uint8_t rr_header[sizeof(uint32_t) + sizeof(uint16_t)];
+		ret = read_binary(f, rr_header, sizeof(rr_header));
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		uint16_t rdlen = wire_read_u16(rr_header + sizeof(uint32_t));
+		ret = read_binary(f, rdata, rdlen);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		ret = knot_rrset_add_rdata(rr, rdata, rdlen,
+		                           wire_read_u32(rr_header), NULL);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Read binary zone file header following the magic.
+ *
+ * \param zc      Zone creator, the dump must be of its zone.
+ * \param f       Binary zone file.
+ * \param serial  SOA serial of the dumped zone (output).
+ */
+static int read_binary_header(zcreator_t *zc, FILE *f, uint32_t *serial)
+{
+	uint8_t origin_len = 0;
+	int ret = read_binary(f, &origin_len, sizeof(origin_len));
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	knot_dname_t origin[KNOT_DNAME_MAXLEN];
+	ret = read_binary(f, origin, origin_len);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	if (knot_dname_wire_check(origin, origin + origin_len, NULL) != origin_len) {
+		return KNOT_EMALF;
+	}
+	if (!knot_dname_is_equal(origin, zc->z->apex->owner)) {
+		return KNOT_EZONEINVAL;
+	}
+
+	uint8_t serial_wire[sizeof(uint32_t)];
+	ret = read_binary(f, serial_wire, sizeof(serial_wire));
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	*serial = wire_read_u32(serial_wire);
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Load zone records from the binary zone file.
+ *
+ * Records were canonicalized when the dumped zone was loaded, so they are
+ * added into the zone as complete RR sets. Nodes get the same checks as
+ * records from a text zone file.
+ */
+static int load_binary(zcreator_t *zc, FILE *f)
+{
+	uint32_t serial = 0;
+	int ret = read_binary_header(zc, f, &serial);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	uint8_t *rdata = malloc(UINT16_MAX);
+	if (rdata == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	uint64_t rr_count = 0;
+	knot_dname_t owner[KNOT_DNAME_MAXLEN];
+	for (;;) {
+		uint8_t owner_len = 0;
+		ret = read_binary(f, &owner_len, sizeof(owner_len));
+		if (ret != KNOT_EOK || owner_len == 0) {
+			break;
+		}
+
+		knot_rrset_t rr;
+		knot_rrset_init_empty(&rr);
+		ret = read_binary_rrset(f, owner, owner_len, rdata, &rr);
+		if (ret == KNOT_EOK) {
+			rr_count += rr.rrs.rr_count;
+			ret = zcreator_add(zc, &rr);
+		}
+		knot_rdataset_clear(&rr.rrs, NULL);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+	}
+	free(rdata);
+
+	// Terminator is followed by the number of written records.
+	uint8_t trailer[sizeof(uint64_t)];
+	if (ret == KNOT_EOK) {
+		ret = read_binary(f, trailer, sizeof(trailer));
+	}
+	if (ret == KNOT_EOK && wire_read_u64(trailer) != rr_count) {
+		ret = KNOT_EMALF;
+	}
+
+	// The SOA must be the one the dump was made with.
+	const knot_rdataset_t *soa = node_rdataset(zc->z->apex, KNOT_RRTYPE_SOA);
+	if (ret == KNOT_EOK && (soa == NULL || knot_soa_serial(soa) != serial)) {
+		ret = KNOT_EMALF;
+	}
+
+	return ret;
+}
+
+/*!
+ * \brief Open the zone file if it contains a binary zone dump.
+ *
+ * \return Binary zone file positioned after the header, NULL otherwise.
+ */
+static FILE *open_binary(const char *source)
+{
+	FILE *f = fopen(source, "r");
+	if (f == NULL) {
+		return NULL;
+	}
+
+	char magic[ZONE_DUMP_BINARY_MAGIC_LEN];
+	if (fread(magic, 1, sizeof(magic), f) != sizeof(magic) ||
+	    memcmp(magic, ZONE_DUMP_BINARY_MAGIC, sizeof(magic)) != 0) {
+		fclose(f);
+		return NULL;
+	}
+
+	return f;
+}
+
 static zone_contents_t *create_zone_from_name(const char *origin)
 {
 	if (origin == NULL) {
@@ -240,38 +424,61 @@ int zonefile_open(zloader_t *loader, const char *source, const char *origin,
 	loader->origin = strdup(origin);
 	loader->creator = zc;
 	loader->semantic_checks = semantic_checks;
+	loader->checks_sample = 100;
 
 	return KNOT_EOK;
 }
 
-zone_contents_t *zonefile_load(zloader_t *loader)
+/*! \brief Parse the text zone file, log errors. */
+static bool load_text(zloader_t *loader)
 {
-	dbg_zload("zload: load: Loading zone, loader: %p.\n", loader);
-	if (!loader) {
-		dbg_zload("zload: load: NULL loader!\n");
-		return NULL;
-	}
-
 	zcreator_t *zc = loader->creator;
 	const knot_dname_t *zname = zc->z->apex->owner;
 
-	assert(zc);
 	int ret = zs_scanner_parse_file(loader->scanner, loader->source);
 	if (ret != 0 && loader->scanner->error_counter == 0) {
 		ERROR(zname, "failed to load zone, file '%s' (%s)",
 		      loader->source, zs_strerror(loader->scanner->error_code));
-		goto fail;
+		return false;
 	}
 
 	if (zc->ret != KNOT_EOK) {
 		ERROR(zname, "failed to load zone, file '%s' (%s)",
 		      loader->source, knot_strerror(zc->ret));
-		goto fail;
+		return false;
 	}
 
 	if (loader->scanner->error_counter > 0) {
 		ERROR(zname, "failed to load zone, file '%s', %"PRIu64" errors",
 		      loader->source, loader->scanner->error_counter);
+		return false;
+	}
+
+	return true;
+}
+
+zone_contents_t *zonefile_load(zloader_t *loader)
+{
+	dbg_zload("zload: load: Loading zone, loader: %p.\n", loader);
+	if (!loader) {
+		dbg_zload("zload: load: NULL loader!\n");
+		return NULL;
+	}
+
+	zcreator_t *zc = loader->creator;
+	const knot_dname_t *zname = zc->z->apex->owner;
+
+	assert(zc);
+	FILE *binary = open_binary(loader->source);
+	if (binary != NULL) {
+		int ret = load_binary(zc, binary);
+		fclose(binary);
+		if (ret != KNOT_EOK) {
+			ERROR(zname, "failed to load zone, binary file '%s' (%s)",
+			      loader->source, knot_strerror(ret));
+			goto fail;
+		}
+	} else if (!load_text(loader)) {
 		goto fail;
 	}
 
@@ -308,7 +515,7 @@ zone_contents_t *zonefile_load(zloader_t *loader)
 		err_handler_init(&err_handler);
 		zone_do_sem_checks(zc->z, check_level,
 		                   &err_handler, first_nsec3_node,
-		                   last_nsec3_node);
+		                   last_nsec3_node, loader->checks_sample, 0);
 		INFO(zname, "semantic check, completed");
 	}
 
@@ -355,7 +562,7 @@ static int zones_open_free_filename(const char *old_name, char **new_name)
 }
 
 int zonefile_write(const char *path, zone_contents_t *zone,
-                   const struct sockaddr_storage *from)
+                   const struct sockaddr_storage *from, bool binary)
 {
 	if (!zone || !path) {
 		return KNOT_EINVAL;
@@ -378,7 +585,9 @@ int zonefile_write(const char *path, zone_contents_t *zone,
 		return KNOT_ERROR;
 	}
 
-	if (zone_dump_text(zone, from, f) != KNOT_EOK) {
+	int ret = binary ? zone_dump_binary(zone, f) :
+	                   zone_dump_text(zone, from, f);
+	if (ret != KNOT_EOK) {
 		WARNING(zname, "failed to save zone, file '%s'", new_fname);
 		fclose(f);
 		unlink(new_fname);
@@ -392,7 +601,7 @@ int zonefile_write(const char *path, zone_contents_t *zone,
 	/* Swap temporary zonefile and new zonefile. */
 	fclose(f);
 
-	int ret = rename(new_fname, path);
+	ret = rename(new_fname, path);
 	if (ret < 0 && ret != EEXIST) {
 		WARNING(zname, "failed to swap zone files, old '%s', new '%s'",
 		        path, new_fname);
@@ -49,6 +49,7 @@ typedef struct zloader {
 	char *source;                /*!< Zone source file. */
 	char *origin;                /*!< Zone's origin string. */
 	bool semantic_checks;        /*!< Do semantic checks. */
+	unsigned checks_sample;      /*!< Nodes with checked RRSIGs (%). */
 	err_handler_t *err_handler;  /*!< Semantic checks error handler. */
 	zs_scanner_t *scanner;       /*!< Zone scanner. */
 	zcreator_t *creator;         /*!< Loader context. */
@@ -71,6 +72,8 @@ int zonefile_open(zloader_t *loader, const char *source, const char *origin,
 /*!
  * \brief Loads zone from a zone file.
  *
+ * Binary zone dumps are recognized and loaded without parsing.
+ *
  * \param loader Zone loader instance.
  *
  * \retval Loaded zone contents on success.
@@ -83,9 +86,14 @@ time_t zonefile_mtime(const char *path);
 
 /*!
  * \brief Write zone contents to zone file.
+ *
+ * \param path    Zone file path.
+ * \param zone    Zone contents.
+ * \param from    Address the zone was transferred from (or NULL).
+ * \param binary  Write binary zone dump instead of text.
  */
 int zonefile_write(const char *path, zone_contents_t *zone,
-                   const struct sockaddr_storage *from);
+                   const struct sockaddr_storage *from, bool binary);
 
 /*!
  * \brief Close zone file loader.
@@ -39,6 +39,7 @@
 #include "libknot/dname.h"
 #include "libknot/dnssec/sig0.h"
 #include "libknot/rrtype/tsig.h"
+#include "libknot/tsig-op.h"
 
 /*!
  * \brief Calculates keytag for RSA/MD5 algorithm.
@@ -539,6 +540,9 @@ int knot_tsig_create_key(const char *name, int algorithm,
 	key->algorithm = algorithm;
 	key->secret = secret;
 
+	/* Unknown algorithm is reported when signing. */
+	(void)knot_tsig_key_hmac_init(key);
+
 	return KNOT_EOK;
 }
 
@@ -559,6 +563,8 @@ int knot_tsig_key_from_params(const knot_key_params_t *params,
 
 	key->algorithm = params->algorithm;
 
+	(void)knot_tsig_key_hmac_init(key);
+
 	return KNOT_EOK;
 }
 
@@ -569,6 +575,7 @@ int knot_tsig_key_free(knot_tsig_key_t *key)
 		return KNOT_EINVAL;
 	}
 
+	knot_tsig_key_hmac_free(key);
 	knot_dname_free(&key->name, NULL);
 	knot_binary_free(&key->secret);
 	memset(key, '\0', sizeof(knot_tsig_key_t));
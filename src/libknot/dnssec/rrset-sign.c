@@ -18,6 +18,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "libknot/dnssec/rrset-sign.h"
 
@@ -103,77 +104,92 @@ int knot_rrsig_write_rdata(uint8_t *rdata, const knot_dnssec_key_t *key,
 /*- Computation of signatures ------------------------------------------------*/
 
 /*!
- * \brief Add RRSIG RDATA without signature to signing context.
+ * \brief Get size of uncompressed RR set in wire format.
  *
- * Requires signer name in RDATA in canonical form.
+ * \param rrset  RR set.
  *
- * \param ctx   Signing context.
- * \param rdata Pointer to RRSIG RDATA.
- *
- * \return Error code, KNOT_EOK if successful.
+ * \return Wire size, limited by maximal packet size.
  */
-static int sign_ctx_add_self(knot_dnssec_sign_context_t *ctx,
-                             const uint8_t *rdata)
+static size_t rrset_wire_size(const knot_rrset_t *rrset)
 {
-	assert(ctx);
-	assert(rdata);
-
-	int result;
+	assert(rrset);
 
-	// add static header
-	result = knot_dnssec_sign_add(ctx, rdata, RRSIG_RDATA_SIGNER_OFFSET);
-	if (result != KNOT_EOK) {
-		return result;
+	size_t rr_header = knot_dname_size(rrset->owner) + 10;
+	size_t size = 0;
+	for (uint16_t i = 0; i < rrset->rrs.rr_count; i++) {
+		const knot_rdata_t *rr = knot_rdataset_at(&rrset->rrs, i);
+		size += rr_header + knot_rdata_rdlen(rr);
 	}
 
-	// add signer name
-	const uint8_t *signer_ptr = rdata + RRSIG_RDATA_SIGNER_OFFSET;
-	knot_dname_t *signer = knot_dname_copy(signer_ptr, NULL);
-	knot_dname_to_lower(signer);
-	result = knot_dnssec_sign_add(ctx, signer, knot_dname_size(signer));
-	knot_dname_free(&signer, NULL);
+	return MIN(size, KNOT_WIRE_MAX_PKTSIZE);
+}
 
-	return result;
+/*!
+ * \brief Get size of the data covered by signature.
+ *
+ * \param rrsig_rdata  RRSIG RDATA with populated fields except signature.
+ * \param covered      Covered RRs.
+ *
+ * \return Size of the signed data.
+ */
+static size_t signed_data_size(const uint8_t *rrsig_rdata,
+                               const knot_rrset_t *covered)
+{
+	const uint8_t *signer = rrsig_rdata + RRSIG_RDATA_SIGNER_OFFSET;
+	return RRSIG_RDATA_SIGNER_OFFSET + knot_dname_size(signer) +
+	       rrset_wire_size(covered);
 }
 
 /*!
- * \brief Add covered RRs to signing context.
+ * \brief Write all data covered by signature.
+ *
+ * RFC 4034: The signature covers RRSIG RDATA field (excluding the signature)
+ * and all matching RR records, which are ordered canonically.
  *
  * Requires all DNAMEs in canonical form and all RRs ordered canonically.
+ * Used for both signing and verification, so that the signed data are
+ * always the same.
  *
- * \param ctx      Signing context.
- * \param covered  Covered RRs.
+ * \param data         Output buffer, see signed_data_size().
+ * \param max_size     Size of the output buffer.
+ * \param rrsig_rdata  RRSIG RDATA with populated fields except signature.
+ * \param covered      Covered RRs.
  *
- * \return Error code, KNOT_EOK if successful.
+ * \return Size of the written data, negative error code on failure.
  */
-static int sign_ctx_add_records(knot_dnssec_sign_context_t *ctx,
-                                const knot_rrset_t *covered)
+static int signed_data_write(uint8_t *data, size_t max_size,
+                             const uint8_t *rrsig_rdata,
+                             const knot_rrset_t *covered)
 {
-	// huge block of rrsets can be optionally created
-	uint8_t *rrwf = malloc(KNOT_WIRE_MAX_PKTSIZE);
-	if (!rrwf) {
-		return KNOT_ENOMEM;
+	assert(data);
+	assert(rrsig_rdata);
+	assert(covered);
+
+	const uint8_t *signer = rrsig_rdata + RRSIG_RDATA_SIGNER_OFFSET;
+	size_t signer_size = knot_dname_size(signer);
+	size_t header_size = RRSIG_RDATA_SIGNER_OFFSET + signer_size;
+	if (max_size < header_size) {
+		return KNOT_ESPACE;
 	}
 
-	int written = knot_rrset_to_wire(covered, rrwf, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	// static header and signer name in canonical form
+	memcpy(data, rrsig_rdata, header_size);
+	knot_dname_to_lower(data + RRSIG_RDATA_SIGNER_OFFSET);
+
+	int written = knot_rrset_to_wire(covered, data + header_size,
+	                                 MIN(max_size - header_size,
+	                                     KNOT_WIRE_MAX_PKTSIZE), NULL);
 	if (written < 0) {
-		free(rrwf);
 		return written;
 	}
 
-	int result = knot_dnssec_sign_add(ctx, rrwf, written);
-	free(rrwf);
-
-	return result;
+	return header_size + written;
 }
 
 /*!
  * \brief Add all data covered by signature into signing context.
  *
- * RFC 4034: The signature covers RRSIG RDATA field (excluding the signature)
- * and all matching RR records, which are ordered canonically.
- *
- * Requires all DNAMEs in canonical form and all RRs ordered canonically.
+ * \see signed_data_write()
  *
  * \param ctx          Signing context.
  * \param rrsig_rdata  RRSIG RDATA with populated fields except signature.
@@ -185,73 +201,143 @@ static int sign_ctx_add_data(knot_dnssec_sign_context_t *ctx,
                              const uint8_t *rrsig_rdata,
                              const knot_rrset_t *covered)
 {
-	int result = sign_ctx_add_self(ctx, rrsig_rdata);
-	if (result != KNOT_EOK) {
-		return result;
+	size_t size = signed_data_size(rrsig_rdata, covered);
+	uint8_t *data = malloc(size);
+	if (!data) {
+		return KNOT_ENOMEM;
+	}
+
+	int written = signed_data_write(data, size, rrsig_rdata, covered);
+	if (written < 0) {
+		free(data);
+		return written;
 	}
 
-	return sign_ctx_add_records(ctx, covered);
+	int result = knot_dnssec_sign_add(ctx, data, written);
+	free(data);
+
+	return result;
 }
 
 /*!
- * \brief Create RRSIG RDATA (all fields except signature are filled).
+ * \brief Write RRSIG RDATA for a covered RR set (except the signature).
  *
- * \param[in]  rrsigs        RR set with RRSIGS.
- * \param[in]  rrsigs        DNSSEC signing context.
- * \param[in]  covered       RR covered by the signature.
- * \param[in]  key           Key used for signing.
- * \param[in]  sig_incepted  Timestamp of signature inception.
- * \param[in]  sig_expires   Timestamp of signature expiration.
+ * \param rdata         Output RDATA.
+ * \param covered       RR set covered by the signature.
+ * \param key           Key used for signing.
+ * \param sig_incepted  Timestamp of signature inception.
+ * \param sig_expires   Timestamp of signature expiration.
  *
- * \return Error code, KNOT_EOK if succesful.
+ * \return Error code, KNOT_EOK if successful.
  */
-static int rrsigs_create_rdata(knot_rrset_t *rrsigs,
-                               knot_dnssec_sign_context_t *context,
-                               const knot_rrset_t *covered,
-                               const knot_dnssec_key_t *key,
-                               uint32_t sig_incepted, uint32_t sig_expires)
+static int rrsig_write_rdata_for(uint8_t *rdata, const knot_rrset_t *covered,
+                                 const knot_dnssec_key_t *key,
+                                 uint32_t sig_incepted, uint32_t sig_expires)
 {
-	assert(rrsigs);
-	assert(rrsigs->type == KNOT_RRTYPE_RRSIG);
-	assert(!knot_rrset_empty(covered));
-	assert(key);
-
-	size_t size = knot_rrsig_rdata_size(key);
-	assert(size != 0);
-
 	uint8_t owner_labels = knot_dname_labels(covered->owner, NULL);
 	if (knot_dname_is_wildcard(covered->owner)) {
 		owner_labels -= 1;
 	}
 
-	uint8_t result[size];
 	const knot_rdata_t *covered_data = knot_rdataset_at(&covered->rrs, 0);
-	int res = knot_rrsig_write_rdata(result, key, covered->type, owner_labels,
-	                                 knot_rdata_ttl(covered_data),
-	                                 sig_incepted, sig_expires);
-	assert(res == KNOT_EOK);
-
-	res = knot_dnssec_sign_new(context);
-	if (res != KNOT_EOK) {
-		return res;
+	return knot_rrsig_write_rdata(rdata, key, covered->type, owner_labels,
+	                              knot_rdata_ttl(covered_data),
+	                              sig_incepted, sig_expires);
+}
+
+_public_
+int knot_sign_rrsets(knot_rrset_t *rrsigs, const knot_rrset_t *covered,
+                     size_t count, const knot_dnssec_key_t *key,
+                     knot_dnssec_sign_context_t *sign_ctx,
+                     const knot_dnssec_policy_t *policy)
+{
+	if (!rrsigs || !covered || !key || !sign_ctx || !policy) {
+		return KNOT_EINVAL;
 	}
 
-	res = sign_ctx_add_data(context, result, covered);
-	if (res != KNOT_EOK) {
-		return res;
+	for (size_t i = 0; i < count; i++) {
+		if (knot_rrset_empty(&covered[i]) ||
+		    rrsigs[i].type != KNOT_RRTYPE_RRSIG ||
+		    !knot_dname_is_equal(rrsigs[i].owner, covered[i].owner)) {
+			return KNOT_EINVAL;
+		}
 	}
 
-	const size_t signature_offset = RRSIG_RDATA_SIGNER_OFFSET + knot_dname_size(key->name);
-	uint8_t *signature = result + signature_offset;
-	const size_t signature_size = size - signature_offset;
+	if (count == 0) {
+		return KNOT_EOK;
+	}
 
-	res = knot_dnssec_sign_write(context, signature, signature_size);
-	if (res != KNOT_EOK) {
-		return res;
+	uint32_t sig_incept = policy->now;
+	uint32_t sig_expire = sig_incept + policy->sign_lifetime;
+
+	const size_t rdata_size = knot_rrsig_rdata_size(key);
+	const size_t signature_offset = RRSIG_RDATA_SIGNER_OFFSET +
+	                                knot_dname_size(key->name);
+	assert(rdata_size > signature_offset);
+
+	knot_dnssec_sign_item_t *items = malloc(count * sizeof(*items));
+	uint8_t *rdatas = malloc(count * rdata_size);
+	if (!items || !rdatas) {
+		free(items);
+		free(rdatas);
+		return KNOT_ENOMEM;
 	}
 
-	return knot_rrset_add_rdata(rrsigs, result, size,
-	                            knot_rdata_ttl(covered_data), NULL);
+	int result = KNOT_EOK;
+	size_t data_size = 0;
+	for (size_t i = 0; i < count; i++) {
+		uint8_t *rdata = rdatas + i * rdata_size;
+		result = rrsig_write_rdata_for(rdata, &covered[i], key,
+		                               sig_incept, sig_expire);
+		if (result != KNOT_EOK) {
+			free(items);
+			free(rdatas);
+			return result;
+		}
+		data_size += signed_data_size(rdata, &covered[i]);
+	}
+
+	// signed data of all RR sets in one buffer
+	uint8_t *data = malloc(data_size);
+	if (!data) {
+		free(items);
+		free(rdatas);
+		return KNOT_ENOMEM;
+	}
+
+	uint8_t *write = data;
+	for (size_t i = 0; i < count; i++) {
+		uint8_t *rdata = rdatas + i * rdata_size;
+		int written = signed_data_write(write, data + data_size - write,
+		                                rdata, &covered[i]);
+		if (written < 0) {
+			result = written;
+			break;
+		}
+
+		items[i].data = write;
+		items[i].data_size = written;
+		items[i].signature = rdata + signature_offset;
+		items[i].signature_size = rdata_size - signature_offset;
+		write += written;
+	}
+
+	if (result == KNOT_EOK) {
+		result = knot_dnssec_sign_batch(sign_ctx, items, count);
+	}
+
+	for (size_t i = 0; result == KNOT_EOK && i < count; i++) {
+		const knot_rdata_t *covered_data = knot_rdataset_at(&covered[i].rrs, 0);
+		result = knot_rrset_add_rdata(&rrsigs[i], rdatas + i * rdata_size,
+		                              rdata_size,
+		                              knot_rdata_ttl(covered_data), NULL);
+	}
+
+	free(data);
+	free(rdatas);
+	free(items);
+
+	return result;
 }
 
 _public_
@@ -260,18 +346,11 @@ int knot_sign_rrset(knot_rrset_t *rrsigs, const knot_rrset_t *covered,
                     knot_dnssec_sign_context_t *sign_ctx,
                     const knot_dnssec_policy_t *policy)
 {
-	if (knot_rrset_empty(covered) || !key || !sign_ctx || !policy ||
-	    rrsigs->type != KNOT_RRTYPE_RRSIG ||
-	    !knot_dname_is_equal(rrsigs->owner, covered->owner)
-	) {
+	if (!rrsigs || knot_rrset_empty(covered)) {
 		return KNOT_EINVAL;
 	}
 
-	uint32_t sig_incept = policy->now;
-	uint32_t sig_expire = sig_incept + policy->sign_lifetime;
-
-	return rrsigs_create_rdata(rrsigs, sign_ctx, covered, key, sig_incept,
-	                           sig_expire);
+	return knot_sign_rrsets(rrsigs, covered, 1, key, sign_ctx, policy);
 }
 
 _public_
@@ -77,6 +77,25 @@ int knot_sign_rrset(knot_rrset_t *rrsigs,
                     knot_dnssec_sign_context_t *sign_ctx,
                     const knot_dnssec_policy_t *policy);
 
+/*!
+ * \brief Create RRSIG RRs for multiple RR sets using the same key.
+ *
+ * The signing context and temporary buffers are shared by all signatures.
+ *
+ * \param rrsigs    Array of RR sets with RRSIGs, one per covered RR set.
+ * \param covered   Array of RR sets to create new signatures for.
+ * \param count     Number of RR sets.
+ * \param key       Signing key.
+ * \param sign_ctx  Signing context.
+ * \param policy    DNSSEC policy.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_sign_rrsets(knot_rrset_t *rrsigs, const knot_rrset_t *covered,
+                     size_t count, const knot_dnssec_key_t *key,
+                     knot_dnssec_sign_context_t *sign_ctx,
+                     const knot_dnssec_policy_t *policy);
+
 /*!
  * \brief Creates new RRS using \a rrsig_rrs as a source. Only those RRs that
  *        cover given \a type are copied into \a out_sig
@@ -51,6 +51,8 @@ struct knot_dnssec_key_data {
 struct knot_dnssec_sign_context {
 	const knot_dnssec_key_t *key; //!< Associated key.
 	EVP_MD_CTX *digest_context;   //!< Digest computation context.
+	uint8_t *raw_signature;       //!< Buffer for signature before conversion.
+	size_t raw_size;              //!< Size of the raw signature buffer.
 };
 
 /*!
@@ -128,6 +130,9 @@ static int any_sign_add(const knot_dnssec_sign_context_t *context,
 /*!
  * \brief Finish the signing and write the signature while checking boundaries.
  *
+ * The signature never exceeds the private key size, so the output buffer is
+ * checked against it instead of finishing the signature twice.
+ *
  * \param context    DNSSEC signing context.
  * \param signature  Pointer to signature to be written.
  * \param max_size   Maximal size of the signature.
@@ -147,12 +152,7 @@ static int sign_safe_write(const knot_dnssec_sign_context_t *context,
 
 	// check target size
 
-	unsigned int max_write = 0;
-	int result = EVP_SignFinal(digest_ctx, NULL, &max_write, private_key);
-	if (!result) {
-		return KNOT_DNSSEC_ESIGN;
-	}
-
+	size_t max_write = (size_t)EVP_PKEY_size(private_key);
 	if (max_write > max_size) {
 		return KNOT_DNSSEC_EUNEXPECTED_SIGNATURE_SIZE;
 	}
@@ -160,7 +160,7 @@ static int sign_safe_write(const knot_dnssec_sign_context_t *context,
 	// write signature
 
 	unsigned int written = 0;
-	result = EVP_SignFinal(digest_ctx, signature, &written, private_key);
+	int result = EVP_SignFinal(digest_ctx, signature, &written, private_key);
 	if (!result) {
 		return KNOT_DNSSEC_ESIGN;
 	}
@@ -172,37 +172,30 @@ static int sign_safe_write(const knot_dnssec_sign_context_t *context,
 }
 
 /*!
- * \brief Allocate space for signature, finish signature, and write it.
+ * \brief Finish signature into the context buffer.
  *
  * \param context    DNSSEC signing context.
- * \param signature  Pointer to allocated signature.
+ * \param signature  Pointer to the written signature (owned by the context).
  * \param size       Size of the written signature.
  *
  * \return Error code, KNOT_EOK if successful.
  */
-static int sign_alloc_and_write(const knot_dnssec_sign_context_t *context,
-                                uint8_t **signature, size_t *size)
+static int sign_raw_write(const knot_dnssec_sign_context_t *context,
+                          const uint8_t **signature, size_t *size)
 {
 	assert(context);
+	assert(context->raw_signature);
 	assert(signature);
 	assert(size);
 
-	size_t buffer_size = EVP_PKEY_size(context->key->data->private_key);
-	uint8_t *buffer = malloc(buffer_size);
-	if (!buffer) {
-		return KNOT_ENOMEM;
-	}
-
 	size_t written = 0;
-	int result = sign_safe_write(context, buffer, buffer_size, &written);
+	int result = sign_safe_write(context, context->raw_signature,
+	                             context->raw_size, &written);
 	if (result != KNOT_EOK) {
-		free(buffer);
 		return result;
 	}
 
-	assert(written <= buffer_size);
-
-	*signature = buffer;
+	*signature = context->raw_signature;
 	*size = written;
 
 	return KNOT_EOK;
@@ -392,9 +385,9 @@ static int dsa_sign_write(const knot_dnssec_sign_context_t *context,
 
 	// create raw signature
 
-	uint8_t *raw_signature = NULL;
+	const uint8_t *raw_signature = NULL;
 	size_t raw_size = 0;
-	int result = sign_alloc_and_write(context, &raw_signature, &raw_size);
+	int result = sign_raw_write(context, &raw_signature, &raw_size);
 	if (result != KNOT_EOK) {
 		return result;
 	}
@@ -403,19 +396,15 @@ static int dsa_sign_write(const knot_dnssec_sign_context_t *context,
 
 	DSA_SIG *decoded = DSA_SIG_new();
 	if (!decoded) {
-		free(raw_signature);
 		return KNOT_ENOMEM;
 	}
 
 	const uint8_t *decode_scan = raw_signature;
 	if (!d2i_DSA_SIG(&decoded, &decode_scan, (long)raw_size)) {
 		DSA_SIG_free(decoded);
-		free(raw_signature);
 		return KNOT_DNSSEC_EDECODE_RAW_SIGNATURE;
 	}
 
-	free(raw_signature);
-
 	// convert to format defined by RFC 2536 (DSA keys and SIGs in DNS)
 
 	// T (1 byte), R (20 bytes), S (20 bytes)
@@ -461,26 +450,21 @@ static int dsa_sign_verify(const knot_dnssec_sign_context_t *context,
 	decoded->r = BN_bin2bn(signature_r, 20, decoded->r);
 	decoded->s = BN_bin2bn(signature_s, 20, decoded->s);
 
-	size_t max_size = EVP_PKEY_size(context->key->data->private_key);
-	uint8_t *raw_signature = malloc(max_size);
-	if (!raw_signature) {
+	// the raw signature buffer is sized for the largest DER encoding
+	uint8_t *raw_signature = context->raw_signature;
+	int raw_size = i2d_DSA_SIG(decoded, NULL);
+	if (raw_size < 0 || (size_t)raw_size > context->raw_size) {
 		DSA_SIG_free(decoded);
-		return KNOT_ENOMEM;
+		return KNOT_DNSSEC_EDECODE_RAW_SIGNATURE;
 	}
 
 	uint8_t *raw_write = raw_signature;
-	int raw_size = i2d_DSA_SIG(decoded, &raw_write);
-	if (raw_size < 0) {
-		free(raw_signature);
-		DSA_SIG_free(decoded);
-		return KNOT_DNSSEC_EDECODE_RAW_SIGNATURE;
-	}
+	i2d_DSA_SIG(decoded, &raw_write);
 	assert(raw_write == raw_signature + raw_size);
 
 	int result = any_sign_verify(context, raw_signature, raw_size);
 
 	DSA_SIG_free(decoded);
-	free(raw_signature);
 
 	return result;
 }
@@ -621,9 +605,9 @@ static int ecdsa_sign_write(const knot_dnssec_sign_context_t *context,
 
 	// create raw signature
 
-	uint8_t *raw_signature = NULL;
+	const uint8_t *raw_signature = NULL;
 	size_t raw_size = 0;
-	int result = sign_alloc_and_write(context, &raw_signature, &raw_size);
+	int result = sign_raw_write(context, &raw_signature, &raw_size);
 	if (result != KNOT_EOK) {
 		return result;
 	}
@@ -632,19 +616,15 @@ static int ecdsa_sign_write(const knot_dnssec_sign_context_t *context,
 
 	ECDSA_SIG *decoded = ECDSA_SIG_new();
 	if (!decoded) {
-		free(raw_signature);
 		return KNOT_ENOMEM;
 	}
 
 	const uint8_t *decode_scan = raw_signature;
 	if (!d2i_ECDSA_SIG(&decoded, &decode_scan, (long)raw_size)) {
 		ECDSA_SIG_free(decoded);
-		free(raw_signature);
 		return KNOT_DNSSEC_EDECODE_RAW_SIGNATURE;
 	}
 
-	free(raw_signature);
-
 	// convert to format defined by RFC 6605 (EC DSA for DNSSEC)
 	// R and S parameters are encoded in halves of the output signature
 
@@ -692,28 +672,22 @@ static int ecdsa_sign_verify(const knot_dnssec_sign_context_t *context,
 	decoded->r = BN_bin2bn(signature_r, parameter_size, decoded->r);
 	decoded->s = BN_bin2bn(signature_s, parameter_size, decoded->s);
 
-	size_t max_size = EVP_PKEY_size(context->key->data->private_key);
-	uint8_t *raw_signature = malloc(max_size);
-	if (!raw_signature) {
+	// the raw signature buffer is sized for the largest DER encoding
+	uint8_t *raw_signature = context->raw_signature;
+	int raw_size = i2d_ECDSA_SIG(decoded, NULL);
+	if (raw_size < 0 || (size_t)raw_size > context->raw_size) {
 		ECDSA_SIG_free(decoded);
-		return KNOT_ENOMEM;
+		return KNOT_DNSSEC_EDECODE_RAW_SIGNATURE;
 	}
 
 	uint8_t *raw_write = raw_signature;
-	int raw_size = i2d_ECDSA_SIG(decoded, &raw_write);
-	if (raw_size < 0) {
-		free(raw_signature);
-		ECDSA_SIG_free(decoded);
-		return KNOT_DNSSEC_EDECODE_RAW_SIGNATURE;
-	}
+	i2d_ECDSA_SIG(decoded, &raw_write);
 	assert(raw_write == raw_signature + raw_size);
 
 	int result = any_sign_verify(context, raw_signature, raw_size);
 
 	ECDSA_SIG_free(decoded);
 
-	free(raw_signature);
-
 	return result;
 }
 
@@ -1193,6 +1167,15 @@ knot_dnssec_sign_context_t *knot_dnssec_sign_init(const knot_dnssec_key_t *key)
 		return NULL;
 	}
 
+	// buffer for raw signatures, reused by all signatures in the context
+	context->raw_size = (size_t)EVP_PKEY_size(key->data->private_key);
+	context->raw_signature = malloc(context->raw_size);
+	if (!context->raw_signature) {
+		destroy_digest_context(&context->digest_context);
+		free(context);
+		return NULL;
+	}
+
 	return context;
 }
 
@@ -1205,6 +1188,7 @@ void knot_dnssec_sign_free(knot_dnssec_sign_context_t *context)
 
 	context->key = NULL;
 	destroy_digest_context(&context->digest_context);
+	free(context->raw_signature);
 	free(context);
 }
 
@@ -1225,8 +1209,17 @@ int knot_dnssec_sign_new(knot_dnssec_sign_context_t *context)
 		return KNOT_EINVAL;
 	}
 
-	destroy_digest_context(&context->digest_context);
-	return create_digest_context(context->key, &context->digest_context);
+	if (!context->digest_context) {
+		return create_digest_context(context->key, &context->digest_context);
+	}
+
+	// reinitialize the existing context, avoids reallocation
+	const EVP_MD *digest_type = get_digest_type(context->key->algorithm);
+	if (!EVP_DigestInit_ex(context->digest_context, digest_type, NULL)) {
+		return KNOT_DNSSEC_ECREATE_DIGEST_CONTEXT;
+	}
+
+	return KNOT_EOK;
 }
 
 _public_
@@ -1263,3 +1256,39 @@ int knot_dnssec_sign_verify(knot_dnssec_sign_context_t *context,
 	return context->key->data->functions->sign_verify(context, signature,
 	                                                  signature_size);
 }
+
+_public_
+int knot_dnssec_sign_batch(knot_dnssec_sign_context_t *context,
+                           knot_dnssec_sign_item_t *items, size_t count)
+{
+	if (!context || !context->key || (!items && count > 0)) {
+		return KNOT_EINVAL;
+	}
+
+	const algorithm_functions_t *functions = context->key->data->functions;
+
+	for (size_t i = 0; i < count; i++) {
+		knot_dnssec_sign_item_t *item = &items[i];
+		if (!item->data || !item->signature || item->signature_size == 0) {
+			return KNOT_EINVAL;
+		}
+
+		int result = knot_dnssec_sign_new(context);
+		if (result != KNOT_EOK) {
+			return result;
+		}
+
+		result = functions->sign_add(context, item->data, item->data_size);
+		if (result != KNOT_EOK) {
+			return result;
+		}
+
+		result = functions->sign_write(context, item->signature,
+		                               item->signature_size);
+		if (result != KNOT_EOK) {
+			return result;
+		}
+	}
+
+	return KNOT_EOK;
+}
@@ -53,6 +53,16 @@ typedef struct {
 	knot_binary_t dnskey_rdata;        //!< DNSKEY RDATA.
 } knot_dnssec_key_t;
 
+/*!
+ * \brief Data to be signed and signature output, see knot_dnssec_sign_batch().
+ */
+typedef struct {
+	const uint8_t *data;   //!< Data to be covered by the signature.
+	size_t data_size;      //!< Size of the data.
+	uint8_t *signature;    //!< Output buffer for the signature.
+	size_t signature_size; //!< Size of the signature (see knot_dnssec_sign_size).
+} knot_dnssec_sign_item_t;
+
 /*- DNSSEC private key manipulation ------------------------------------------*/
 
 /*!
@@ -153,4 +163,19 @@ int knot_dnssec_sign_write(knot_dnssec_sign_context_t *context,
 int knot_dnssec_sign_verify(knot_dnssec_sign_context_t *context,
                             const uint8_t *signature, size_t signature_size);
 
+/*!
+ * \brief Create signatures for multiple data blocks with a single context.
+ *
+ * The digest context and internal buffers are reused for all items, any
+ * data previously added to the context are discarded.
+ *
+ * \param context  DNSSEC signing context.
+ * \param items    Data to be signed and signature buffers.
+ * \param count    Number of items.
+ *
+ * \return Error code, KNOT_EOK if all signatures were written.
+ */
+int knot_dnssec_sign_batch(knot_dnssec_sign_context_t *context,
+                           knot_dnssec_sign_item_t *items, size_t count);
+
 /*! @} */
@@ -41,12 +41,19 @@
 #include <string.h>
 #include <stdlib.h>
 
-static inline void heap_swap(heap_val_t *e1, heap_val_t *e2)
+static inline void heap_moved(struct heap *h, int e)
+{
+	if (h->moved) h->moved(*HELEMENT(h, e), e);
+}
+
+static inline void heap_swap(struct heap *h, int e1, int e2)
 {
 	if (e1 == e2) return; /* Stack tmp should be faster than tmpelem. */
-	heap_val_t tmp = *e1; /* Even faster than 2-XOR nowadays. */
-	*e1 = *e2;
-	*e2 = tmp;
+	heap_val_t tmp = *HELEMENT(h, e1); /* Even faster than 2-XOR nowadays. */
+	*HELEMENT(h, e1) = *HELEMENT(h, e2);
+	*HELEMENT(h, e2) = tmp;
+	heap_moved(h, e1);
+	heap_moved(h, e2);
 }
 
 
@@ -57,6 +64,7 @@ int heap_init(struct heap *h, int (*cmp)(void *, void *), int init_size)
 	h->num = 0;
 	h->max_size = isize;
 	h->cmp = cmp;
+	h->moved = NULL;
 	h->data = malloc((isize + 1) * sizeof(heap_val_t)); /* Temp element unused. */
 
 	return h->data ? 1 : 0;
@@ -71,7 +79,7 @@ static inline void _heap_bubble_down(struct heap *h, int e)
 		if(e1 > h->num) break;
 		if((h->cmp(*HELEMENT(h, e),*HELEMENT(h,e1)) < 0) && (e1 == h->num || (h->cmp(*HELEMENT(h, e),*HELEMENT(h,e1+1)) < 0))) break;
 		if((e1 != h->num) && (h->cmp(*HELEMENT(h, e1+1), *HELEMENT(h,e1)) < 0)) e1++;
-		heap_swap(HELEMENT(h,e),HELEMENT(h,e1));
+		heap_swap(h, e, e1);
 		e = e1;
 	}
 }
@@ -83,7 +91,7 @@ static inline void _heap_bubble_up(struct heap *h, int e)
 	{
 		e1 = e/2;
 		if(h->cmp(*HELEMENT(h, e1),*HELEMENT(h,e)) < 0) break;
-		heap_swap(HELEMENT(h,e),HELEMENT(h,e1));
+		heap_swap(h, e, e1);
 		e = e1;
 	}
 
@@ -94,7 +102,7 @@ void heap_delmin(struct heap *h)
 	if(h->num == 0) return;
 	if(h->num > 1)
 	{
-		heap_swap(HHEAD(h),HELEMENT(h,h->num));
+		heap_swap(h, 1, h->num);
 	}
 	--h->num;
 	_heap_bubble_down(h, 1);
@@ -113,6 +121,7 @@ int heap_insert(struct heap *h, void *e)
 
 	h->num++;
 	*HELEMENT(h,h->num) = e;
+	heap_moved(h, h->num);
 	_heap_bubble_up(h,h->num);
 	return 1;
 }
@@ -131,7 +140,7 @@ int heap_find(struct heap *h, void *elm)	/* FIXME - very slow */
 
 void heap_delete(struct heap *h, int e)
 {
-	heap_swap(HELEMENT(h, e), HELEMENT(h, h->num));
+	heap_swap(h, e, h->num);
 	h->num--;
 	if(h->cmp(*HELEMENT(h, e), *HELEMENT(h, h->num + 1)) < 0) _heap_bubble_up(h, e);
 	else _heap_bubble_down(h, e);
@@ -142,3 +151,11 @@ void heap_delete(struct heap *h, int e)
 		h->data = realloc(h->data, (h->max_size + 1) * sizeof(heap_val_t));
 	}
 }
+
+void heap_replace(struct heap *h, int e, void *elm)
+{
+	*HELEMENT(h, e) = elm;
+	heap_moved(h, e);
+	_heap_bubble_up(h, e);
+	_heap_bubble_down(h, e);
+}
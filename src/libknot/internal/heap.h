@@ -33,6 +33,7 @@ struct heap {
    int num;		/* Number of elements */
    int max_size;	/* Size of allocated memory */
    int (*cmp)(void *, void *);
+   void (*moved)(void *, int); /* Optional, notified of new element position */
    heap_val_t *data;
 };		/* Array follows */
 
@@ -48,6 +49,7 @@ void heap_delmin(struct heap *);
 int heap_insert(struct heap *, void *);
 int heap_find(struct heap *, void *);
 void heap_delete(struct heap *, int);
+void heap_replace(struct heap *, int, void *);
 
 
 /*! @} */
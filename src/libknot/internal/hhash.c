@@ -438,10 +438,10 @@ int hhash_find_next(hhash_t* tbl, const char* key, uint16_t len, value_t** dst)
 		return 1;
 	}
 
+	/* First key greater than the searched one. */
 	int k = BIN_SEARCH_FIRST_GE_CMP(tbl, tbl->weight, CMP_LE, key, len);
-	/* Found prev or equal, we want next */
-	if (k + 1 < tbl->weight) {
-		hhelem_t *found = tbl->item + tbl->index[k + 1];
+	if (k < tbl->weight) {
+		hhelem_t *found = tbl->item + tbl->index[k];
 		*dst = (value_t *)KEY_VAL(found->d);
 		return 0;
 	} else {
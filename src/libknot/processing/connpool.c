@@ -0,0 +1,190 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libknot/processing/connpool.h"
+#include "libknot/internal/macros.h"
+#include "libknot/internal/sockaddr.h"
+
+/*! \brief Idle connection. */
+struct conn {
+	struct sockaddr_storage remote, origin;
+	int fd;
+	time_t last_use;
+};
+
+struct knot_conn_pool {
+	pthread_mutex_t lock;
+	time_t idle_timeout;
+	size_t capacity;
+	size_t count;
+	struct conn *conns;
+};
+
+/*! \brief Check if the idle connection was not closed or reset by peer. */
+static bool conn_alive(int fd)
+{
+	/* Nothing is expected on an idle connection, readable means EOF. */
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	return poll(&pfd, 1, 0) == 0;
+}
+
+/*! \brief Remove connection at given position. Call with the lock held. */
+static int conn_take(struct knot_conn_pool *pool, size_t pos)
+{
+	int fd = pool->conns[pos].fd;
+	pool->count -= 1;
+	pool->conns[pos] = pool->conns[pool->count];
+
+	return fd;
+}
+
+/*! \brief Close connections idle for too long. Call with the lock held. */
+static void conn_sweep(struct knot_conn_pool *pool, time_t now)
+{
+	size_t i = 0;
+	while (i < pool->count) {
+		if (now - pool->conns[i].last_use >= pool->idle_timeout) {
+			close(conn_take(pool, i));
+		} else {
+			i += 1;
+		}
+	}
+}
+
+_public_
+struct knot_conn_pool *knot_conn_pool_new(size_t capacity, int idle_timeout)
+{
+	if (capacity == 0 || idle_timeout <= 0) {
+		return NULL;
+	}
+
+	struct knot_conn_pool *pool = malloc(sizeof(*pool));
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	pool->conns = malloc(capacity * sizeof(struct conn));
+	if (pool->conns == NULL) {
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pool->idle_timeout = idle_timeout;
+	pool->capacity = capacity;
+	pool->count = 0;
+
+	return pool;
+}
+
+_public_
+void knot_conn_pool_free(struct knot_conn_pool *pool)
+{
+	if (pool == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < pool->count; i++) {
+		close(pool->conns[i].fd);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->conns);
+	free(pool);
+}
+
+_public_
+int knot_conn_pool_get(struct knot_conn_pool *pool,
+                       const struct sockaddr_storage *remote,
+                       const struct sockaddr_storage *origin)
+{
+	if (pool == NULL || remote == NULL || origin == NULL) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+
+	conn_sweep(pool, time(NULL));
+
+	int fd = -1;
+	size_t i = pool->count;
+	while (i-- > 0) {
+		struct conn *conn = &pool->conns[i];
+		if (sockaddr_cmp(&conn->remote, remote) != 0 ||
+		    sockaddr_cmp(&conn->origin, origin) != 0) {
+			continue;
+		}
+
+		fd = conn_take(pool, i);
+		if (conn_alive(fd)) {
+			break;
+		}
+
+		close(fd);
+		fd = -1;
+	}
+
+	pthread_mutex_unlock(&pool->lock);
+
+	return fd;
+}
+
+_public_
+void knot_conn_pool_put(struct knot_conn_pool *pool,
+                        const struct sockaddr_storage *remote,
+                        const struct sockaddr_storage *origin, int fd)
+{
+	if (pool == NULL || remote == NULL || origin == NULL || fd < 0) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		return;
+	}
+
+	time_t now = time(NULL);
+
+	pthread_mutex_lock(&pool->lock);
+
+	conn_sweep(pool, now);
+
+	/* Make room by closing the least recently used connection. */
+	if (pool->count == pool->capacity) {
+		size_t oldest = 0;
+		for (size_t i = 1; i < pool->count; i++) {
+			if (pool->conns[i].last_use < pool->conns[oldest].last_use) {
+				oldest = i;
+			}
+		}
+		close(conn_take(pool, oldest));
+	}
+
+	struct conn *conn = &pool->conns[pool->count];
+	memcpy(&conn->remote, remote, sizeof(*remote));
+	memcpy(&conn->origin, origin, sizeof(*origin));
+	conn->fd = fd;
+	conn->last_use = now;
+	pool->count += 1;
+
+	pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,81 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file connpool.h
+ *
+ * \brief Pool of idle outgoing TCP connections.
+ *
+ * Connections are keyed by the remote and the source address. A connection
+ * is taken out of the pool for the duration of one request and put back
+ * when the request completes successfully. Idle connections are closed
+ * after a timeout or when the peer closes them.
+ *
+ * \addtogroup query_processing
+ * @{
+ */
+
+#pragma once
+
+#include <sys/socket.h>
+
+struct knot_conn_pool;
+
+/*!
+ * \brief Create connection pool.
+ *
+ * \param capacity      Maximal number of idle connections.
+ * \param idle_timeout  Idle connections are closed after this many seconds.
+ *
+ * \return Connection pool or NULL on error.
+ */
+struct knot_conn_pool *knot_conn_pool_new(size_t capacity, int idle_timeout);
+
+/*!
+ * \brief Close all idle connections and free the pool.
+ *
+ * \param pool  Connection pool.
+ */
+void knot_conn_pool_free(struct knot_conn_pool *pool);
+
+/*!
+ * \brief Take an idle connection to the remote out of the pool.
+ *
+ * \param pool    Connection pool.
+ * \param remote  Remote address.
+ * \param origin  Source address.
+ *
+ * \return Connected socket or -1 if there is no usable connection.
+ */
+int knot_conn_pool_get(struct knot_conn_pool *pool,
+                       const struct sockaddr_storage *remote,
+                       const struct sockaddr_storage *origin);
+
+/*!
+ * \brief Put a connection into the pool.
+ *
+ * \note The socket is owned by the pool after the call, it is closed if the
+ *       pool has no room for it.
+ *
+ * \param pool    Connection pool.
+ * \param remote  Remote address.
+ * \param origin  Source address.
+ * \param fd      Connected socket.
+ */
+void knot_conn_pool_put(struct knot_conn_pool *pool,
+                        const struct sockaddr_storage *remote,
+                        const struct sockaddr_storage *origin, int fd);
+
+/*! @} */
@@ -15,12 +15,33 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/fcntl.h>
 
 #include "libknot/processing/requestor.h"
 #include "libknot/errcode.h"
 #include "libknot/internal/macros.h"
 #include "libknot/internal/net.h"
+#include "libknot/internal/utils.h"
+
+/*! \brief Resolution of the request timer wheel (milliseconds). */
+#define WHEEL_TICK 10
+
+/*! \brief Number of request timer wheel slots. */
+#define WHEEL_SLOTS 256
+
+/*!
+ * \brief Hashed timer wheel with request deadlines.
+ *
+ * Timers are hashed into slots by the deadline tick, a slot may hold timers
+ * from different rounds of the wheel.
+ */
+struct request_wheel {
+	list_t slots[WHEEL_SLOTS];
+	uint64_t tick;  /*!< Last processed tick. */
+};
 
 static bool use_tcp(struct knot_request *request)
 {
@@ -60,13 +81,15 @@ static int request_wait(int fd, int state, struct timeval *timeout)
 static int request_send(struct knot_request *request,
                         const struct timeval *timeout)
 {
-	/* Each request has unique timeout. */
-	struct timeval tv = { timeout->tv_sec, timeout->tv_usec };
-
-	/* Wait for writeability or error. */
-	int ret = request_wait(request->fd, KNOT_NS_PROC_FULL, &tv);
-	if (ret == 0) {
-		return KNOT_ETIMEOUT;
+	/* Wait for writeability or error (if not known to be ready). */
+	int ret = 0;
+	if (timeout != NULL) {
+		/* Each request has unique timeout. */
+		struct timeval tv = { timeout->tv_sec, timeout->tv_usec };
+		ret = request_wait(request->fd, KNOT_NS_PROC_FULL, &tv);
+		if (ret == 0) {
+			return KNOT_ETIMEOUT;
+		}
 	}
 
 	/* Check socket error. */
@@ -122,6 +145,192 @@ static int request_recv(struct knot_request *request,
 	return ret;
 }
 
+/*!
+ * \brief Receive available response data without blocking.
+ *
+ * \retval 1 if a complete message was received.
+ * \retval 0 if more data is needed.
+ * \retval KNOT_E* on error.
+ */
+static int request_recv_nonblock(struct knot_request *request)
+{
+	knot_pkt_t *resp = request->resp;
+	if (request->rx_have == 0) {
+		knot_pkt_clear(resp);
+	}
+
+	if (!use_tcp(request)) {
+		ssize_t ret = recv(request->fd, resp->wire, resp->max_size, 0);
+		if (ret < 0) {
+			return (errno == EAGAIN || errno == EINTR) ? 0 : KNOT_ECONN;
+		}
+		resp->size = ret;
+		return 1;
+	}
+
+	/* Message length prefix first. */
+	uint8_t *buf = request->rx_len + request->rx_have;
+	size_t len = sizeof(request->rx_len) - request->rx_have;
+	if (request->rx_have >= sizeof(request->rx_len)) {
+		size_t msg_len = wire_read_u16(request->rx_len);
+		size_t have = request->rx_have - sizeof(request->rx_len);
+		if (msg_len > resp->max_size) {
+			return KNOT_ESPACE;
+		}
+		buf = resp->wire + have;
+		len = msg_len - have;
+	}
+
+	ssize_t ret = recv(request->fd, buf, len, 0);
+	if (ret < 0) {
+		return (errno == EAGAIN || errno == EINTR) ? 0 : KNOT_ECONN;
+	}
+	if (ret == 0 && len > 0) {
+		return KNOT_ECONN;
+	}
+	request->rx_have += ret;
+
+	if (request->rx_have < sizeof(request->rx_len)) {
+		return 0;
+	}
+
+	size_t msg_len = wire_read_u16(request->rx_len);
+	if (request->rx_have - sizeof(request->rx_len) < msg_len) {
+		return 0;
+	}
+
+	request->rx_have = 0;
+	resp->size = msg_len;
+	return 1;
+}
+
+/*! \brief Put the connection of a completed request back to the pool. */
+static void request_release(struct knot_requestor *requestor,
+                            struct knot_request *request)
+{
+	if (requestor->pool == NULL || !use_tcp(request) || request->fd < 0) {
+		return;
+	}
+
+	knot_conn_pool_put(requestor->pool, &request->remote, &request->origin,
+	                   request->fd);
+	request->fd = -1;
+}
+
+/*! \brief Return processing overlay for the request. */
+static struct knot_overlay *request_overlay(struct knot_requestor *requestor,
+                                            struct knot_request *request)
+{
+	if (EMPTY_LIST(request->overlay.layers)) {
+		return &requestor->overlay;
+	}
+
+	return &request->overlay;
+}
+
+/*! \brief Finish request processing and release its connection. */
+static int request_finish(struct knot_requestor *requestor,
+                          struct knot_request *request, int ret)
+{
+	struct knot_overlay *overlay = request_overlay(requestor, request);
+
+	/* Expect complete request. */
+	if (ret == KNOT_EOK && overlay->state == KNOT_NS_PROC_FAIL) {
+		ret = KNOT_ERROR;
+	}
+
+	/* Only a connection with a completed exchange can be reused. */
+	if (ret == KNOT_EOK) {
+		request_release(requestor, request);
+	}
+
+	/* Finish current query processing. */
+	knot_overlay_reset(overlay);
+
+	return ret;
+}
+
+/*! \brief Current monotonic time in milliseconds. */
+static uint64_t time_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void wheel_init(struct request_wheel *wheel, uint64_t now)
+{
+	for (int i = 0; i < WHEEL_SLOTS; i++) {
+		init_list(&wheel->slots[i]);
+	}
+	wheel->tick = now / WHEEL_TICK;
+}
+
+static void wheel_disarm(struct knot_request *request)
+{
+	if (request->timer.deadline != 0) {
+		rem_node(&request->timer.node);
+		request->timer.deadline = 0;
+	}
+}
+
+/*! \brief Set request deadline, the previous deadline is replaced. */
+static void wheel_arm(struct request_wheel *wheel, struct knot_request *request,
+                      uint64_t deadline)
+{
+	wheel_disarm(request);
+
+	uint64_t tick = deadline / WHEEL_TICK;
+	if (tick <= wheel->tick) {
+		tick = wheel->tick + 1;
+	}
+
+	request->timer.request = request;
+	request->timer.deadline = deadline;
+	add_tail(&wheel->slots[tick % WHEEL_SLOTS], &request->timer.node);
+}
+
+/*! \brief Move timers with passed deadlines into the expired list. */
+static void wheel_expire(struct request_wheel *wheel, uint64_t now,
+                         list_t *expired)
+{
+	uint64_t until = now / WHEEL_TICK;
+	if (until <= wheel->tick) {
+		return;
+	}
+
+	/* Visit each slot at most once. */
+	uint64_t from = wheel->tick + 1;
+	if (until - wheel->tick > WHEEL_SLOTS) {
+		from = until - WHEEL_SLOTS + 1;
+	}
+
+	for (uint64_t tick = from; tick <= until; tick++) {
+		struct knot_request_timer *timer = NULL, *next = NULL;
+		WALK_LIST_DELSAFE(timer, next, wheel->slots[tick % WHEEL_SLOTS]) {
+			if (timer->deadline / WHEEL_TICK <= until) {
+				rem_node(&timer->node);
+				add_tail(expired, &timer->node);
+			}
+		}
+	}
+
+	wheel->tick = until;
+}
+
+/*! \brief Time until the next non-empty slot (milliseconds). */
+static int wheel_timeout(struct request_wheel *wheel, uint64_t now)
+{
+	uint64_t tick = now / WHEEL_TICK;
+	for (int i = 1; i <= WHEEL_SLOTS; i++) {
+		if (!EMPTY_LIST(wheel->slots[(tick + i) % WHEEL_SLOTS])) {
+			return (tick + i) * WHEEL_TICK - now;
+		}
+	}
+
+	return WHEEL_SLOTS * WHEEL_TICK;
+}
+
 _public_
 struct knot_request *knot_request_make(mm_ctx_t *mm,
                                        const struct sockaddr *dst,
@@ -148,12 +357,15 @@ struct knot_request *knot_request_make(mm_ctx_t *mm,
 	request->query = query;
 	request->resp  = NULL;
 	request->flags = flags;
+	knot_overlay_init(&request->overlay, mm);
 	return request;
 }
 
 _public_
 int knot_request_free(mm_ctx_t *mm, struct knot_request *request)
 {
+	knot_overlay_finish(&request->overlay);
+	knot_overlay_deinit(&request->overlay);
 	close(request->fd);
 	knot_pkt_free(&request->query);
 	knot_pkt_free(&request->resp);
@@ -164,6 +376,17 @@ int knot_request_free(mm_ctx_t *mm, struct knot_request *request)
 	return KNOT_EOK;
 }
 
+_public_
+int knot_request_overlay(struct knot_request *request,
+                         const knot_layer_api_t *proc, void *param)
+{
+	if (request == NULL || proc == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	return knot_overlay_add(&request->overlay, proc, param);
+}
+
 _public_
 void knot_requestor_init(struct knot_requestor *requestor, mm_ctx_t *mm)
 {
@@ -210,9 +433,16 @@ int knot_requestor_enqueue(struct knot_requestor *requestor,
 		sock_type = SOCK_STREAM;
 	}
 
-	/* Fetch a bound socket. */
-	request->fd = net_connected_socket(sock_type, &request->remote,
-	                                   &request->origin, O_NONBLOCK);
+	/* Reuse an idle connection or fetch a bound socket. */
+	request->fd = -1;
+	if (sock_type == SOCK_STREAM) {
+		request->fd = knot_conn_pool_get(requestor->pool, &request->remote,
+		                                 &request->origin);
+	}
+	if (request->fd < 0) {
+		request->fd = net_connected_socket(sock_type, &request->remote,
+		                                   &request->origin, O_NONBLOCK);
+	}
 	if (request->fd < 0) {
 		return KNOT_ECONN;
 	}
@@ -240,7 +470,7 @@ int knot_requestor_dequeue(struct knot_requestor *requestor)
 	return knot_request_free(requestor->mm, last);
 }
 
-static int request_io(struct knot_requestor *req, struct knot_request *last,
+static int request_io(struct knot_overlay *overlay, struct knot_request *last,
                       struct timeval *timeout)
 {
 	int ret = KNOT_EOK;
@@ -248,10 +478,10 @@ static int request_io(struct knot_requestor *req, struct knot_request *last,
 	knot_pkt_t *resp = last->resp;
 
 	/* Data to be sent. */
-	if (req->overlay.state == KNOT_NS_PROC_FULL) {
+	if (overlay->state == KNOT_NS_PROC_FULL) {
 
 		/* Process query and send it out. */
-		knot_overlay_out(&req->overlay, query);
+		knot_overlay_out(overlay, query);
 
 		ret = request_send(last, timeout);
 		if (ret != KNOT_EOK) {
@@ -260,14 +490,14 @@ static int request_io(struct knot_requestor *req, struct knot_request *last,
 	}
 
 	/* Data to be read. */
-	if (req->overlay.state == KNOT_NS_PROC_MORE) {
+	if (overlay->state == KNOT_NS_PROC_MORE) {
 		/* Read answer and process it. */
 		ret = request_recv(last, timeout);
 		if (ret < 0) {
 			return ret;
 		}
 
-		knot_overlay_in(&req->overlay, resp);
+		knot_overlay_in(overlay, resp);
 	}
 
 	return KNOT_EOK;
@@ -277,25 +507,18 @@ static int exec_request(struct knot_requestor *req, struct knot_request *last,
                         struct timeval *timeout)
 {
 	int ret = KNOT_EOK;
+	struct knot_overlay *overlay = request_overlay(req, last);
 
 	/* Do I/O until the processing is satisifed or fails. */
-	while (req->overlay.state & (KNOT_NS_PROC_FULL|KNOT_NS_PROC_MORE)) {
-		ret = request_io(req, last, timeout);
+	while (overlay->state & (KNOT_NS_PROC_FULL|KNOT_NS_PROC_MORE)) {
+		ret = request_io(overlay, last, timeout);
 		if (ret != KNOT_EOK) {
-			knot_overlay_reset(&req->overlay);
+			knot_overlay_reset(overlay);
 			return ret;
 		}
 	}
 
-	/* Expect complete request. */
-	if (req->overlay.state == KNOT_NS_PROC_FAIL) {
-		ret = KNOT_ERROR;
-	}
-
-	/* Finish current query processing. */
-	knot_overlay_reset(&req->overlay);
-
-	return ret;
+	return request_finish(req, last, KNOT_EOK);
 }
 
 _public_
@@ -314,3 +537,145 @@ int knot_requestor_exec(struct knot_requestor *requestor,
 
 	return ret;
 }
+
+/*!
+ * \brief Do one I/O step of the request on a ready socket.
+ *
+ * \return KNOT_EOK on progress, KNOT_EAGAIN if no data was ready or error.
+ */
+static int request_step(struct knot_request *request)
+{
+	struct knot_overlay *overlay = &request->overlay;
+
+	/* Process query and send it out. */
+	if (overlay->state == KNOT_NS_PROC_FULL) {
+		knot_overlay_out(overlay, request->query);
+		return request_send(request, NULL);
+	}
+
+	/* Read answer and process it when complete. */
+	int ret = request_recv_nonblock(request);
+	if (ret < 0) {
+		return ret;
+	} else if (ret == 0) {
+		return KNOT_EAGAIN;
+	}
+
+	knot_overlay_in(overlay, request->resp);
+
+	return KNOT_EOK;
+}
+
+/*! \brief Finish request executed by knot_requestor_exec_all(). */
+static void request_done(struct knot_requestor *requestor,
+                         struct knot_request *request, int ret)
+{
+	wheel_disarm(request);
+	request->ret = request_finish(requestor, request, ret);
+}
+
+_public_
+int knot_requestor_exec_all(struct knot_requestor *requestor,
+                            struct timeval *timeout)
+{
+	if (knot_requestor_finished(requestor)) {
+		return KNOT_ENOENT;
+	}
+	if (timeout == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	size_t count = list_size(&requestor->pending);
+	struct pollfd *fds = mm_alloc(requestor->mm, count * sizeof(*fds));
+	struct knot_request **active = mm_alloc(requestor->mm, count * sizeof(*active));
+	if (fds == NULL || active == NULL) {
+		mm_free(requestor->mm, fds);
+		mm_free(requestor->mm, active);
+		return KNOT_ENOMEM;
+	}
+
+	uint64_t wait = (uint64_t)timeout->tv_sec * 1000 + timeout->tv_usec / 1000;
+	uint64_t now = time_now();
+
+	struct request_wheel wheel;
+	wheel_init(&wheel, now);
+
+	/* Only requests with own processing can run concurrently. */
+	size_t nactive = 0;
+	struct knot_request *request = NULL;
+	WALK_LIST(request, requestor->pending) {
+		request->timer.deadline = 0;
+		request->rx_have = 0;
+		if (EMPTY_LIST(request->overlay.layers)) {
+			request->ret = KNOT_EINVAL;
+			continue;
+		}
+		request->ret = KNOT_EOK;
+		wheel_arm(&wheel, request, now + wait);
+		active[nactive++] = request;
+	}
+
+	int ret = KNOT_EOK;
+	while (nactive > 0) {
+		for (size_t i = 0; i < nactive; i++) {
+			struct knot_request *r = active[i];
+			fds[i].fd = r->fd;
+			fds[i].events = (r->overlay.state == KNOT_NS_PROC_FULL) ?
+			                POLLOUT : POLLIN;
+			fds[i].revents = 0;
+		}
+
+		int nready = poll(fds, nactive, wheel_timeout(&wheel, time_now()));
+		if (nready < 0 && errno != EINTR) {
+			ret = knot_map_errno(EINVAL, ENOMEM);
+			for (size_t i = 0; i < nactive; i++) {
+				request_done(requestor, active[i], ret);
+			}
+			break;
+		}
+
+		now = time_now();
+
+		/* Advance requests with ready sockets. */
+		for (size_t i = 0; nready > 0 && i < nactive; i++) {
+			if (fds[i].revents == 0) {
+				continue;
+			}
+
+			struct knot_request *r = active[i];
+			int io = request_step(r);
+			if (io == KNOT_EAGAIN) {
+				continue;
+			} else if (io != KNOT_EOK) {
+				request_done(requestor, r, io);
+			} else if (r->overlay.state & (KNOT_NS_PROC_FULL|KNOT_NS_PROC_MORE)) {
+				wheel_arm(&wheel, r, now + wait);
+			} else {
+				request_done(requestor, r, KNOT_EOK);
+			}
+		}
+
+		/* Time out requests without progress. */
+		list_t expired;
+		init_list(&expired);
+		wheel_expire(&wheel, now, &expired);
+		struct knot_request_timer *timer = NULL, *next = NULL;
+		WALK_LIST_DELSAFE(timer, next, expired) {
+			request_done(requestor, timer->request, KNOT_ETIMEOUT);
+		}
+
+		/* Keep only unfinished requests. */
+		size_t kept = 0;
+		for (size_t i = 0; i < nactive; i++) {
+			if (active[i]->timer.deadline != 0) {
+				active[kept++] = active[i];
+			}
+		}
+		nactive = kept;
+	}
+
+	mm_free(requestor->mm, fds);
+	mm_free(requestor->mm, active);
+
+	return ret;
+}
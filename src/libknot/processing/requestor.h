@@ -18,6 +18,7 @@
 
 #include <sys/time.h>
 
+#include "libknot/processing/connpool.h"
 #include "libknot/processing/overlay.h"
 #include "libknot/internal/lists.h"
 #include "libknot/internal/sockaddr.h"
@@ -38,6 +39,14 @@ struct knot_requestor {
 	mm_ctx_t *mm;            /*!< Memory context. */
 	list_t pending;               /*!< Pending requests (FIFO). */
 	struct knot_overlay overlay;  /*!< Response processing overlay. */
+	struct knot_conn_pool *pool;  /*!< TCP connection pool (or NULL). */
+};
+
+/*! \brief Request deadline in the requestor timer wheel. */
+struct knot_request_timer {
+	node_t node;
+	struct knot_request *request;
+	uint64_t deadline;
 };
 
 /*! \brief Request data (socket, payload, response, TSIG and endpoints). */
@@ -49,6 +58,11 @@ struct knot_request {
 	knot_sign_context_t sign;
 	knot_pkt_t *query;
 	knot_pkt_t *resp;
+	struct knot_overlay overlay;     /*!< Own processing overlay. */
+	int ret;                         /*!< Result of knot_requestor_exec_all(). */
+	struct knot_request_timer timer; /*!< Request timeout. */
+	uint8_t rx_len[2];               /*!< Received TCP message length. */
+	size_t rx_have;                  /*!< Received bytes of TCP message. */
 };
 
 /*!
@@ -78,6 +92,19 @@ struct knot_request *knot_request_make(mm_ctx_t *mm,
  */
 int knot_request_free(mm_ctx_t *mm, struct knot_request *request);
 
+/*!
+ * \brief Add a processing layer to the request.
+ *
+ * Requests with own processing layers don't share the requestor overlay and
+ * can be executed concurrently with \ref knot_requestor_exec_all.
+ *
+ * \param request Request.
+ * \param proc    Response processing module.
+ * \param param   Processing module parameters.
+ */
+int knot_request_overlay(struct knot_request *request,
+                         const knot_layer_api_t *proc, void *param);
+
 /*!
  * \brief Initialize requestor structure.
  *
@@ -114,7 +141,9 @@ int knot_requestor_overlay(struct knot_requestor *requestor,
  * \brief Enqueue a query for processing.
  *
  * \note This function asynchronously creates a new connection to remote, but
- *       it does not send any data until requestor_exec().
+ *       it does not send any data until requestor_exec(). If the requestor
+ *       has a connection pool, an idle TCP connection to the remote is
+ *       reused instead.
  *
  * \param requestor Requestor instance.
  * \param request   Prepared request.
@@ -143,3 +172,19 @@ int knot_requestor_dequeue(struct knot_requestor *requestor);
  */
 int knot_requestor_exec(struct knot_requestor *requestor,
                         struct timeval *timeout);
+
+/*!
+ * \brief Execute all pending queries concurrently.
+ *
+ * Queries are sent out and their responses processed as the sockets become
+ * ready. Each query must have own processing layers (see
+ * \ref knot_request_overlay), the result of each query is stored in its
+ * 'ret' field. Executed queries are kept pending until dequeued.
+ *
+ * \param requestor Requestor instance.
+ * \param timeout   Processing timeout, restarted on each query progress.
+ *
+ * \return KNOT_EOK or error
+ */
+int knot_requestor_exec_all(struct knot_requestor *requestor,
+                            struct timeval *timeout);
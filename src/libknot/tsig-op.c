@@ -18,8 +18,11 @@
 #include <inttypes.h>
 #include <openssl/hmac.h>
 #include <openssl/evp.h>
+#include <pthread.h>
 #include <time.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "libknot/tsig-op.h"
 #include "libknot/errcode.h"
@@ -34,6 +37,9 @@
 const int KNOT_TSIG_MAX_DIGEST_SIZE = 64;    // size of HMAC-SHA512 digest
 const uint16_t KNOT_TSIG_FUDGE_DEFAULT = 300;  // default Fudge value
 
+/*! \brief Maximal size of TSIG variables without the other data. */
+#define TSIG_VARIABLES_MAXLEN (2 * KNOT_DNAME_MAXLEN + KNOT_TSIG_VARIABLES_LENGTH)
+
 static int check_algorithm(const knot_rrset_t *tsig_rr)
 {
 	if (tsig_rr == NULL) {
@@ -66,80 +72,212 @@ static int check_key(const knot_rrset_t *tsig_rr,
 		return KNOT_EMALF;
 	}
 
-	char *name = knot_dname_to_str_alloc(tsig_name);
-	if (!name) {
-		return KNOT_EMALF;
-	}
-
 	if (knot_dname_cmp(tsig_name, tsig_key->name) != 0) {
 		/*!< \todo which error. */
-		free(name);
 		return KNOT_TSIG_EBADKEY;
 	}
 
-	free(name);
 	return KNOT_EOK;
 }
 
-static int compute_digest(const uint8_t *wire, size_t wire_len,
-                          uint8_t *digest, size_t *digest_len,
-                          const knot_tsig_key_t *key)
+/*!
+ * \brief Precomputed HMAC state of a TSIG secret.
+ *
+ * The states live in a table shared by all keys with the same algorithm and
+ * secret, so that the key structure stays plain data and keys built by hand
+ * (or copied) are always safe to use.
+ */
+typedef struct tsig_hmac {
+	struct tsig_hmac *next;
+	knot_tsig_algorithm_t algorithm;
+	knot_binary_t secret; /*!< Copy of the key secret. */
+	unsigned refs;        /*!< Number of knot_tsig_key_hmac_init() calls. */
+	HMAC_CTX ctx;         /*!< HMAC context with the key pads absorbed. */
+} tsig_hmac_t;
+
+static pthread_rwlock_t hmac_lock = PTHREAD_RWLOCK_INITIALIZER;
+static tsig_hmac_t *hmac_table = NULL;
+
+/*! \brief Find precomputed state for the key, requires hmac_lock held. */
+static tsig_hmac_t *hmac_find(const knot_tsig_key_t *key, tsig_hmac_t ***prev)
 {
-	if (!wire || !digest || !digest_len || !key) {
-		return KNOT_EINVAL;
+	tsig_hmac_t **it = &hmac_table;
+	for (; *it != NULL; it = &(*it)->next) {
+		const tsig_hmac_t *hmac = *it;
+		if (hmac->algorithm == key->algorithm &&
+		    hmac->secret.size == key->secret.size &&
+		    (key->secret.size == 0 ||
+		     memcmp(hmac->secret.data, key->secret.data,
+		            key->secret.size) == 0)) {
+			break;
+		}
 	}
 
+	if (prev) {
+		*prev = it;
+	}
+
+	return *it;
+}
+
+static const EVP_MD *get_digest_type(knot_tsig_algorithm_t tsig_alg)
+{
+	switch (tsig_alg) {
+	case KNOT_TSIG_ALG_HMAC_MD5:    return EVP_md5();
+	case KNOT_TSIG_ALG_HMAC_SHA1:   return EVP_sha1();
+	case KNOT_TSIG_ALG_HMAC_SHA224: return EVP_sha224();
+	case KNOT_TSIG_ALG_HMAC_SHA256: return EVP_sha256();
+	case KNOT_TSIG_ALG_HMAC_SHA384: return EVP_sha384();
+	case KNOT_TSIG_ALG_HMAC_SHA512: return EVP_sha512();
+	default:                        return NULL;
+	}
+}
+
+/*!
+ * \brief Start digest computation with given key.
+ *
+ * The precomputed key schedule is cloned if available, so that the key
+ * pads are not hashed for every message.
+ */
+static int digest_init(HMAC_CTX *ctx, const knot_tsig_key_t *key)
+{
 	if (!key->name) {
 		return KNOT_EMALF;
 	}
 
-	knot_tsig_algorithm_t tsig_alg = key->algorithm;
-	if (tsig_alg == 0) {
+	if (key->algorithm == 0) {
 		return KNOT_TSIG_EBADSIG;
 	}
 
-	/* Compute digest. */
-	HMAC_CTX ctx;
+	HMAC_CTX_init(ctx);
 
-	switch (tsig_alg) {
-		case KNOT_TSIG_ALG_HMAC_MD5:
-			HMAC_Init(&ctx, key->secret.data,
-			          key->secret.size, EVP_md5());
-			break;
-		case KNOT_TSIG_ALG_HMAC_SHA1:
-			HMAC_Init(&ctx, key->secret.data,
-			          key->secret.size, EVP_sha1());
-			break;
-		case KNOT_TSIG_ALG_HMAC_SHA224:
-			HMAC_Init(&ctx, key->secret.data,
-			          key->secret.size, EVP_sha224());
-			break;
-		case KNOT_TSIG_ALG_HMAC_SHA256:
-			HMAC_Init(&ctx, key->secret.data,
-			          key->secret.size, EVP_sha256());
-			break;
-		case KNOT_TSIG_ALG_HMAC_SHA384:
-			HMAC_Init(&ctx, key->secret.data,
-			          key->secret.size, EVP_sha384());
-			break;
-		case KNOT_TSIG_ALG_HMAC_SHA512:
-			HMAC_Init(&ctx, key->secret.data,
-			          key->secret.size, EVP_sha512());
-			break;
-		default:
-			return KNOT_ENOTSUP;
-	} /* switch */
+	pthread_rwlock_rdlock(&hmac_lock);
+	tsig_hmac_t *hmac = hmac_find(key, NULL);
+	int copied = (hmac != NULL) && HMAC_CTX_copy(ctx, &hmac->ctx);
+	pthread_rwlock_unlock(&hmac_lock);
+
+	if (hmac != NULL) {
+		if (!copied) {
+			HMAC_CTX_cleanup(ctx);
+			return KNOT_ENOMEM;
+		}
+		return KNOT_EOK;
+	}
+
+	const EVP_MD *digest_type = get_digest_type(key->algorithm);
+	if (digest_type == NULL) {
+		HMAC_CTX_cleanup(ctx);
+		return KNOT_ENOTSUP;
+	}
+
+	if (!HMAC_Init_ex(ctx, key->secret.data, key->secret.size,
+	                  digest_type, NULL)) {
+		HMAC_CTX_cleanup(ctx);
+		return KNOT_ERROR;
+	}
+
+	return KNOT_EOK;
+}
 
-	unsigned tmp_dig_len = *digest_len;
-	HMAC_Update(&ctx, (const unsigned char *)wire, wire_len);
-	HMAC_Final(&ctx, digest, &tmp_dig_len);
+static void digest_update(HMAC_CTX *ctx, const uint8_t *data, size_t size)
+{
+	if (size > 0) {
+		HMAC_Update(ctx, (const unsigned char *)data, size);
+	}
+}
+
+static void digest_update_u16(HMAC_CTX *ctx, uint16_t value)
+{
+	uint8_t wire[sizeof(uint16_t)];
+	wire_write_u16(wire, value);
+	HMAC_Update(ctx, wire, sizeof(wire));
+}
+
+static void digest_final(HMAC_CTX *ctx, uint8_t *digest, size_t *digest_len)
+{
+	unsigned tmp_dig_len = 0;
+	HMAC_Final(ctx, digest, &tmp_dig_len);
 	*digest_len = tmp_dig_len;
 
-	HMAC_CTX_cleanup(&ctx);
+	HMAC_CTX_cleanup(ctx);
+}
+
+_public_
+int knot_tsig_key_hmac_init(const knot_tsig_key_t *key)
+{
+	if (!key) {
+		return KNOT_EINVAL;
+	}
+
+	const EVP_MD *digest_type = get_digest_type(key->algorithm);
+	if (digest_type == NULL) {
+		return KNOT_ENOTSUP;
+	}
+
+	pthread_rwlock_wrlock(&hmac_lock);
+
+	tsig_hmac_t *hmac = hmac_find(key, NULL);
+	if (hmac != NULL) {
+		hmac->refs += 1;
+		pthread_rwlock_unlock(&hmac_lock);
+		return KNOT_EOK;
+	}
+
+	hmac = malloc(sizeof(*hmac));
+	if (!hmac) {
+		pthread_rwlock_unlock(&hmac_lock);
+		return KNOT_ENOMEM;
+	}
+
+	memset(hmac, 0, sizeof(*hmac));
+	hmac->algorithm = key->algorithm;
+	if (key->secret.size > 0 &&
+	    knot_binary_dup(&key->secret, &hmac->secret) != KNOT_EOK) {
+		free(hmac);
+		pthread_rwlock_unlock(&hmac_lock);
+		return KNOT_ENOMEM;
+	}
+
+	HMAC_CTX_init(&hmac->ctx);
+	if (!HMAC_Init_ex(&hmac->ctx, key->secret.data, key->secret.size,
+	                  digest_type, NULL)) {
+		HMAC_CTX_cleanup(&hmac->ctx);
+		knot_binary_free(&hmac->secret);
+		free(hmac);
+		pthread_rwlock_unlock(&hmac_lock);
+		return KNOT_ERROR;
+	}
+
+	hmac->refs = 1;
+	hmac->next = hmac_table;
+	hmac_table = hmac;
+
+	pthread_rwlock_unlock(&hmac_lock);
 
 	return KNOT_EOK;
 }
 
+_public_
+void knot_tsig_key_hmac_free(const knot_tsig_key_t *key)
+{
+	if (!key) {
+		return;
+	}
+
+	pthread_rwlock_wrlock(&hmac_lock);
+
+	tsig_hmac_t **prev = NULL;
+	tsig_hmac_t *hmac = hmac_find(key, &prev);
+	if (hmac != NULL && --hmac->refs == 0) {
+		*prev = hmac->next;
+		HMAC_CTX_cleanup(&hmac->ctx);
+		knot_binary_free(&hmac->secret);
+		free(hmac);
+	}
+
+	pthread_rwlock_unlock(&hmac_lock);
+}
+
 static int check_time_signed(const knot_rrset_t *tsig_rr,
                              uint64_t prev_time_signed)
 {
@@ -176,9 +314,17 @@ static int check_time_signed(const knot_rrset_t *tsig_rr,
 	return KNOT_EOK;
 }
 
-static int write_tsig_variables(uint8_t *wire, const knot_rrset_t *tsig_rr)
+/*!
+ * \brief Write TSIG variables except the other data field.
+ *
+ * \param wire     Output buffer (at least TSIG_VARIABLES_MAXLEN long).
+ * \param size     Written size.
+ * \param tsig_rr  TSIG RR.
+ */
+static int write_tsig_variables(uint8_t *wire, size_t *size,
+                                const knot_rrset_t *tsig_rr)
 {
-	if (wire == NULL || tsig_rr == NULL) {
+	if (wire == NULL || size == NULL || tsig_rr == NULL) {
 		return KNOT_EINVAL;
 	}
 
@@ -225,23 +371,12 @@ static int write_tsig_variables(uint8_t *wire, const knot_rrset_t *tsig_rr)
 	/* TSIG error. */
 	wire_write_u16(wire + offset, knot_tsig_rdata_error(tsig_rr));
 	offset += sizeof(uint16_t);
-	/* Get other data length. */
+	/* Other data length, the data are digested separately. */
 	uint16_t other_data_length = knot_tsig_rdata_other_data_length(tsig_rr);
-	/* Get other data. */
-	const uint8_t *other_data = knot_tsig_rdata_other_data(tsig_rr);
-	if (!other_data) {
-		return KNOT_EINVAL;
-	}
-
-	/*
-	 * We cannot write the whole other_data, as it contains its length in
-	 * machine order.
-	 */
 	wire_write_u16(wire + offset, other_data_length);
 	offset += sizeof(uint16_t);
 
-	/* Skip the length. */
-	memcpy(wire + offset, other_data, other_data_length);
+	*size = offset;
 
 	return KNOT_EOK;
 }
@@ -270,52 +405,38 @@ static int create_sign_wire(const uint8_t *msg, size_t msg_len,
 		return KNOT_EINVAL;
 	}
 
-	/* Create tmp TSIG. */
-	int ret = KNOT_EOK;
-
 	/*
-	 * Create tmp wire, it should contain message
-	 * plus request mac plus tsig varibles.
+	 * Digest the request MAC, the message and the TSIG variables
+	 * directly, without assembling them into a single buffer.
 	 */
-	size_t wire_len = sizeof(uint8_t) *
-			(msg_len + request_mac_len + ((request_mac_len > 0)
-			 ? 2 : 0) +
-			knot_tsig_rdata_tsig_variables_length(tmp_tsig));
-	uint8_t *wire = malloc(wire_len);
-	if (!wire) {
-		return KNOT_ENOMEM;
-	}
-
-	memset(wire, 0, wire_len);
-
-	uint8_t *pos = wire;
-
-	/* Copy the request MAC - should work even if NULL. */
-	if (request_mac_len > 0) {
-		wire_write_u16(pos, request_mac_len);
-		pos += 2;
-		memcpy(pos, request_mac, sizeof(uint8_t) * request_mac_len);
-	}
-	pos += request_mac_len;
-	/* Copy the original message. */
-	memcpy(pos, msg, msg_len);
-	pos += msg_len;
-	/* Copy TSIG variables. */
-	ret = write_tsig_variables(pos, tmp_tsig);
+	uint8_t variables[TSIG_VARIABLES_MAXLEN];
+	size_t variables_len = 0;
+	int ret = write_tsig_variables(variables, &variables_len, tmp_tsig);
 	if (ret != KNOT_EOK) {
-		free(wire);
 		return ret;
 	}
 
-	/* Compute digest. */
-	ret = compute_digest(wire, wire_len, digest, digest_len, key);
+	const uint8_t *other_data = knot_tsig_rdata_other_data(tmp_tsig);
+	if (!other_data) {
+		return KNOT_EINVAL;
+	}
+
+	HMAC_CTX ctx;
+	ret = digest_init(&ctx, key);
 	if (ret != KNOT_EOK) {
 		*digest_len = 0;
-		free(wire);
 		return ret;
 	}
 
-	free(wire);
+	if (request_mac_len > 0) {
+		digest_update_u16(&ctx, request_mac_len);
+		digest_update(&ctx, request_mac, request_mac_len);
+	}
+	digest_update(&ctx, msg, msg_len);
+	digest_update(&ctx, variables, variables_len);
+	digest_update(&ctx, other_data,
+	              knot_tsig_rdata_other_data_length(tmp_tsig));
+	digest_final(&ctx, digest, digest_len);
 
 	return KNOT_EOK;
 }
@@ -330,47 +451,24 @@ static int create_sign_wire_next(const uint8_t *msg, size_t msg_len,
 		return KNOT_EINVAL;
 	}
 
-	/* Create tmp TSIG. */
-	int ret = KNOT_EOK;
-
-	/*
-	 * Create tmp wire, it should contain message
-	 * plus request mac plus tsig varibles.
-	 */
-	size_t wire_len = sizeof(uint8_t) *
-	                (msg_len + prev_mac_len +
-			knot_tsig_rdata_tsig_timers_length() + 2);
-	uint8_t *wire = malloc(wire_len);
-	if (!wire) {
-		return KNOT_ENOMEM;
-	}
-
-	memset(wire, 0, wire_len);
-
-	/* Copy the request MAC - should work even if NULL. */
-	wire_write_u16(wire, prev_mac_len);
-	memcpy(wire + 2, prev_mac, sizeof(uint8_t) * prev_mac_len);
-	/* Copy the original message. */
-	memcpy(wire + prev_mac_len + 2, msg, msg_len);
-	/* Copy TSIG variables. */
-
-	ret = wire_write_timers(wire + prev_mac_len + msg_len + 2,
-	                                  tmp_tsig);
+	uint8_t timers[KNOT_TSIG_TIMERS_LENGTH];
+	int ret = wire_write_timers(timers, tmp_tsig);
 	if (ret != KNOT_EOK) {
-		free(wire);
 		return ret;
 	}
 
-	/* Compute digest. */
-	ret = compute_digest(wire, wire_len,
-	                               digest, digest_len, key);
+	HMAC_CTX ctx;
+	ret = digest_init(&ctx, key);
 	if (ret != KNOT_EOK) {
 		*digest_len = 0;
-		free(wire);
 		return ret;
 	}
 
-	free(wire);
+	digest_update_u16(&ctx, prev_mac_len);
+	digest_update(&ctx, prev_mac, prev_mac_len);
+	digest_update(&ctx, msg, msg_len);
+	digest_update(&ctx, timers, sizeof(timers));
+	digest_final(&ctx, digest, digest_len);
 
 	return KNOT_EOK;
 }
@@ -492,32 +590,10 @@ int knot_tsig_sign_next(uint8_t *msg, size_t *msg_len, size_t msg_max_len,
 	knot_tsig_rdata_store_current_time(tmp_tsig);
 	knot_tsig_rdata_set_fudge(tmp_tsig, KNOT_TSIG_FUDGE_DEFAULT);
 
-	/* Create wire to be signed. */
-	size_t wire_len = prev_digest_len + to_sign_len
-	                  + KNOT_TSIG_TIMERS_LENGTH + 2;
-	uint8_t *wire = malloc(wire_len);
-	if (!wire) {
-		knot_rrset_free(&tmp_tsig, NULL);
-		return KNOT_ENOMEM;
-	}
-	memset(wire, 0, wire_len);
-
-	/* Write previous digest length. */
-	wire_write_u16(wire, prev_digest_len);
-	/* Write previous digest. */
-	memcpy(wire + 2, prev_digest, sizeof(uint8_t) * prev_digest_len);
-	/* Write original message. */
-	memcpy(wire + prev_digest_len + 2, to_sign, to_sign_len);
-	/* Write timers. */
-	wire_write_timers(wire + prev_digest_len + to_sign_len + 2,
-	                            tmp_tsig);
-
-	int ret = KNOT_ERROR;
-	ret = compute_digest(wire, wire_len,
-	                               digest_tmp, &digest_tmp_len, key);
-
-	/* No matter how the function did, this data is no longer needed. */
-	free(wire);
+	int ret = create_sign_wire_next(to_sign, to_sign_len,
+	                                prev_digest, prev_digest_len,
+	                                digest_tmp, &digest_tmp_len,
+	                                tmp_tsig, key);
 	if (ret != KNOT_EOK) {
 		knot_rrset_free(&tmp_tsig, NULL);
 		*digest_len = 0;
@@ -594,33 +670,23 @@ static int check_digest(const knot_rrset_t *tsig_rr,
 		return ret;
 	}
 
-	uint8_t *wire_to_sign = malloc(sizeof(uint8_t) * size);
-	if (!wire_to_sign) {
-		return KNOT_ENOMEM;
-	}
-
-	memset(wire_to_sign, 0, sizeof(uint8_t) * size);
-	memcpy(wire_to_sign, wire, size);
-
 	uint8_t digest_tmp[KNOT_TSIG_MAX_DIGEST_SIZE];
 	size_t digest_tmp_len = 0;
 	assert(tsig_rr->rrs.rr_count > 0);
 
 	if (use_times) {
 		/* Wire is not a single packet, TSIG RRs must be stripped already. */
-		ret = create_sign_wire_next(wire_to_sign, size,
+		ret = create_sign_wire_next(wire, size,
 		                                 request_mac, request_mac_len,
 		                                 digest_tmp, &digest_tmp_len,
 		                                 tsig_rr, tsig_key);
 	} else {
-		ret = create_sign_wire(wire_to_sign, size,
+		ret = create_sign_wire(wire, size,
 		                            request_mac, request_mac_len,
 		                            digest_tmp, &digest_tmp_len,
 		                            tsig_rr, tsig_key);
 	}
 
-	assert(tsig_rr->rrs.rr_count > 0);
-	free(wire_to_sign);
 
 	if (ret != KNOT_EOK) {
 		return ret;
@@ -32,6 +32,32 @@
 #include "libknot/rrtype/tsig.h"
 #include "libknot/rrset.h"
 
+/*!
+ * \brief Precompute HMAC key schedule of the TSIG key.
+ *
+ * Signing and verification clone the precomputed state instead of hashing
+ * the key pads for each message. The state is kept in a library table
+ * looked up by the key algorithm and secret, the key structure itself is
+ * not modified. Keys created by knot_tsig_create_key() and
+ * knot_tsig_key_from_params() are precomputed already, other keys work
+ * without it.
+ *
+ * \note Each call must be paired with knot_tsig_key_hmac_free() (called by
+ *       knot_tsig_key_free()), before the secret or algorithm changes.
+ *
+ * \param key  TSIG key.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_tsig_key_hmac_init(const knot_tsig_key_t *key);
+
+/*!
+ * \brief Release precomputed HMAC state of the TSIG key.
+ *
+ * \param key  TSIG key.
+ */
+void knot_tsig_key_hmac_free(const knot_tsig_key_t *key);
+
 /*!
  * \brief Generate TSIG signature of a message.
  *
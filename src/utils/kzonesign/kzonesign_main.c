@@ -0,0 +1,321 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libknot/libknot.h"
+#include "libknot/dnssec/crypto.h"
+#include "libknot/rrset-dump.h"
+#include "utils/common/strtonum.h"
+#include "knot/common/log.h"
+#include "knot/conf/conf.h"
+#include "knot/dnssec/zone-events.h"
+#include "knot/dnssec/zone-keys.h"
+#include "knot/updates/apply.h"
+#include "knot/updates/changesets.h"
+#include "knot/zone/contents.h"
+#include "knot/zone/zonefile.h"
+
+#define PROGRAM_NAME "kzonesign"
+
+/*! \brief Maximal size of a dumped RR set. */
+#define DUMP_MAXLEN (1 << 20)
+
+/*!
+ * \brief Print program usage (and example).
+ */
+static void usage(FILE *stream)
+{
+	fprintf(stream, "usage:   " PROGRAM_NAME " [options] -o <origin> "
+	                "-k <keydir> <zonefile> <output>\n");
+	fprintf(stream, "\n"
+	        "options:\n"
+	        " -k, --keydir <dir>        Directory with DNSSEC keys.\n"
+	        " -o, --origin <name>       Zone origin.\n"
+	        " -l, --lifetime <seconds>  Signature lifetime.\n"
+	        " -j, --jobs <count>        Number of signing threads.\n"
+	        " -c, --changes <file>      Write added/removed records to file.\n"
+	        " -f, --force               Drop all existing signatures.\n"
+	        " -h, --help                Print help.\n"
+	        " -V, --version             Print program version.\n");
+	fprintf(stream, "\nexample: " PROGRAM_NAME " -o example.com -k keys -j 8 "
+	                "example.com.zone example.com.signed\n");
+}
+
+/*!
+ * \brief Dump all RR sets from changeset iterator.
+ */
+static int dump_iter(FILE *out, changeset_iter_t *it, char *buf)
+{
+	knot_rrset_t rrset = changeset_iter_next(it);
+	while (!knot_rrset_empty(&rrset)) {
+		if (knot_rrset_txt_dump(&rrset, buf, DUMP_MAXLEN,
+		                        &KNOT_DUMP_STYLE_DEFAULT) < 0) {
+			return KNOT_ESPACE;
+		}
+		fputs(buf, out);
+		rrset = changeset_iter_next(it);
+	}
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Dump single RR set if present.
+ */
+static int dump_rrset(FILE *out, const knot_rrset_t *rrset, char *buf)
+{
+	if (rrset == NULL) {
+		return KNOT_EOK;
+	}
+
+	if (knot_rrset_txt_dump(rrset, buf, DUMP_MAXLEN,
+	                        &KNOT_DUMP_STYLE_DEFAULT) < 0) {
+		return KNOT_ESPACE;
+	}
+	fputs(buf, out);
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Write records removed and added by signing into a text file.
+ */
+static int write_changes(const char *path, const changeset_t *ch)
+{
+	FILE *out = fopen(path, "w");
+	if (out == NULL) {
+		return knot_map_errno(EACCES);
+	}
+
+	char *buf = malloc(DUMP_MAXLEN);
+	if (buf == NULL) {
+		fclose(out);
+		return KNOT_ENOMEM;
+	}
+
+	changeset_iter_t it;
+	fprintf(out, ";; removed\n");
+	int ret = dump_rrset(out, ch->soa_from, buf);
+	if (ret == KNOT_EOK) {
+		ret = changeset_iter_rem(&it, ch, false);
+	}
+	if (ret == KNOT_EOK) {
+		ret = dump_iter(out, &it, buf);
+		changeset_iter_clear(&it);
+	}
+
+	if (ret == KNOT_EOK) {
+		fprintf(out, ";; added\n");
+		ret = dump_rrset(out, ch->soa_to, buf);
+	}
+	if (ret == KNOT_EOK) {
+		ret = changeset_iter_add(&it, ch, false);
+	}
+	if (ret == KNOT_EOK) {
+		ret = dump_iter(out, &it, buf);
+		changeset_iter_clear(&it);
+	}
+
+	free(buf);
+	if (fclose(out) != 0 && ret == KNOT_EOK) {
+		ret = knot_map_errno(EIO);
+	}
+
+	return ret;
+}
+
+/*!
+ * \brief Load, sign and store the zone.
+ */
+static int sign_zone(conf_zone_t *config, const char *output,
+                     const char *changes, bool force, unsigned threads)
+{
+	zloader_t zl;
+	int ret = zonefile_open(&zl, config->file, config->name, false);
+	if (ret != KNOT_EOK) {
+		fprintf(stderr, "Cannot open zone file '%s' (%s)\n",
+		        config->file, knot_strerror(ret));
+		return ret;
+	}
+
+	zl.creator->master = true;
+	zone_contents_t *contents = zonefile_load(&zl);
+	zonefile_close(&zl);
+	if (contents == NULL) {
+		fprintf(stderr, "Cannot load zone file '%s'\n", config->file);
+		return KNOT_EMALF;
+	}
+
+	ret = zone_contents_load_nsec3param(contents);
+	if (ret != KNOT_EOK) {
+		fprintf(stderr, "Invalid NSEC3PARAM record (%s)\n",
+		        knot_strerror(ret));
+		zone_contents_deep_free(&contents);
+		return ret;
+	}
+
+	changeset_t ch;
+	ret = changeset_init(&ch, contents->apex->owner);
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(&contents);
+		return ret;
+	}
+
+	uint32_t refresh_at = 0;
+	ret = knot_dnssec_zone_sign_parallel(contents, config, &ch, force,
+	                                     threads, &refresh_at);
+	if (ret != KNOT_EOK) {
+		fprintf(stderr, "Cannot sign zone (%s)\n", knot_strerror(ret));
+		changeset_clear(&ch);
+		zone_contents_deep_free(&contents);
+		return ret;
+	}
+
+	if (changes != NULL) {
+		ret = write_changes(changes, &ch);
+		if (ret != KNOT_EOK) {
+			fprintf(stderr, "Cannot write changes to '%s' (%s)\n",
+			        changes, knot_strerror(ret));
+			changeset_clear(&ch);
+			zone_contents_deep_free(&contents);
+			return ret;
+		}
+	}
+
+	if (!changeset_empty(&ch)) {
+		ret = apply_changeset_directly(contents, &ch);
+		update_cleanup(&ch);
+	}
+	changeset_clear(&ch);
+	if (ret != KNOT_EOK) {
+		fprintf(stderr, "Cannot apply signatures (%s)\n",
+		        knot_strerror(ret));
+		zone_contents_deep_free(&contents);
+		return ret;
+	}
+
+	ret = zonefile_write(output, contents, NULL, false);
+	if (ret != KNOT_EOK) {
+		fprintf(stderr, "Cannot write zone file '%s' (%s)\n",
+		        output, knot_strerror(ret));
+	} else {
+		uint32_t now = time(NULL);
+		printf("Signed zone serial %u, next refresh in %u seconds\n",
+		       zone_contents_serial(contents),
+		       refresh_at > now ? refresh_at - now : 0);
+	}
+
+	zone_contents_deep_free(&contents);
+	return ret;
+}
+
+/*!
+ * \brief Entry point of 'kzonesign'.
+ */
+int main(int argc, char *argv[])
+{
+	struct option options[] = {
+		{ "keydir",   required_argument, 0, 'k' },
+		{ "origin",   required_argument, 0, 'o' },
+		{ "lifetime", required_argument, 0, 'l' },
+		{ "jobs",     required_argument, 0, 'j' },
+		{ "changes",  required_argument, 0, 'c' },
+		{ "force",    no_argument,       0, 'f' },
+		{ "version",  no_argument,       0, 'V' },
+		{ "help",     no_argument,       0, 'h' },
+		{ NULL }
+	};
+
+	conf_zone_t config;
+	conf_init_zone(&config);
+	config.serial_policy = CONFIG_SERIAL_DEFAULT;
+
+	const char *changes = NULL;
+	bool force = false;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint16_t threads = cpus > 0 && cpus <= UINT16_MAX ? cpus : 1;
+
+	int opt = 0;
+	int li = 0;
+	while ((opt = getopt_long(argc, argv, "k:o:l:j:c:fhV", options, &li)) != -1) {
+		switch(opt) {
+		case 'k':
+			config.dnssec_keydir = optarg;
+			break;
+		case 'o':
+			config.name = optarg;
+			break;
+		case 'l':
+			if (knot_str2int(optarg, &config.sig_lifetime) != KNOT_EOK ||
+			    config.sig_lifetime <= 0) {
+				fprintf(stderr, "Invalid signature lifetime.\n");
+				return 1;
+			}
+			break;
+		case 'j':
+			if (knot_str2uint16t(optarg, &threads) != KNOT_EOK ||
+			    threads == 0) {
+				fprintf(stderr, "Invalid number of threads.\n");
+				return 1;
+			}
+			break;
+		case 'c':
+			changes = optarg;
+			break;
+		case 'f':
+			force = true;
+			break;
+		case 'V':
+			printf("%s, version %s\n", PROGRAM_NAME, PACKAGE_VERSION);
+			return 0;
+		case 'h':
+			usage(stdout);
+			return 0;
+		default:
+			usage(stderr);
+			return 1;
+		}
+	}
+
+	// kzonesign -o <origin> -k <keydir> <zonefile> <output>
+	if (config.name == NULL || config.dnssec_keydir == NULL ||
+	    argc - optind != 2) {
+		usage(stderr);
+		return 1;
+	}
+	config.file = argv[optind];
+
+	knot_crypto_init();
+	knot_crypto_init_threads();
+	atexit(knot_crypto_cleanup);
+	atexit(knot_crypto_cleanup_threads);
+
+	log_init();
+
+	int ret = sign_zone(&config, argv[optind + 1], changes, force, threads);
+
+	knot_zone_keys_cache_clear();
+	log_close();
+
+	return ret == KNOT_EOK ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <tap/basic.h>
+
+#include "knot/conf/conf.h"
+#include "knot/modules/dnsproxy.h"
+#include "knot/nameserver/process_query.h"
+#include "libknot/descriptor.h"
+#include "libknot/internal/net.h"
+#include "libknot/internal/sockaddr.h"
+
+/*! \brief Time to wait for a message (ms), longer than the proxy timeout. */
+#define WAIT_MS 3000
+
+/*! \brief Bound UDP socket on the loopback, address with assigned port. */
+static int bound_socket(struct sockaddr_storage *addr)
+{
+	sockaddr_set(addr, AF_INET, "127.0.0.1", 0);
+	int fd = net_bound_socket(SOCK_DGRAM, addr);
+	assert(fd >= 0);
+	socklen_t addr_len = sizeof(*addr);
+	getsockname(fd, (struct sockaddr *)addr, &addr_len);
+
+	return fd;
+}
+
+/*! \brief Receive message with timeout, returns length or -1. */
+static int receive(int fd, uint8_t *buf, size_t size,
+                   struct sockaddr_storage *from)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	if (poll(&pfd, 1, WAIT_MS) <= 0) {
+		return -1;
+	}
+
+	socklen_t from_len = sizeof(*from);
+	return recvfrom(fd, buf, size, 0, (struct sockaddr *)from, &from_len);
+}
+
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*! \brief Query received by the upstream. */
+struct upstream_query {
+	uint8_t wire[KNOT_WIRE_MAX_PKTSIZE];
+	int len;
+	struct sockaddr_storage from;
+};
+
+/*! \brief Pass the query to the module as if received over UDP. */
+static int forward(const struct query_step *step, int server_fd,
+                   const struct sockaddr_storage *client, const char *qname,
+                   uint16_t id)
+{
+	knot_pkt_t *query = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	knot_pkt_t *answer = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	knot_dname_t *name = knot_dname_from_str_alloc(qname);
+	knot_pkt_put_question(query, name, KNOT_CLASS_IN, KNOT_RRTYPE_A);
+	knot_wire_set_id(query->wire, id);
+	knot_dname_free(&name, NULL);
+
+	struct process_query_param param = { 0 };
+	param.socket = server_fd;
+	param.remote = client;
+	struct query_data qdata;
+	memset(&qdata, 0, sizeof(qdata));
+	qdata.query = query;
+	qdata.param = &param;
+
+	int state = step->process(KNOT_NS_PROC_FULL, answer, &qdata, step->ctx);
+
+	knot_pkt_free(&query);
+	knot_pkt_free(&answer);
+
+	return state;
+}
+
+/*! \brief Answer the forwarded query, optionally change the question. */
+static void reply(int fd, struct upstream_query *query, bool change_question)
+{
+	knot_wire_set_qr(query->wire);
+	if (change_question) {
+		query->wire[KNOT_WIRE_HEADER_SIZE + 1] ^= 0x20;
+	}
+	(void)sendto(fd, query->wire, query->len, 0,
+	             (struct sockaddr *)&query->from,
+	             sockaddr_len((struct sockaddr *)&query->from));
+}
+
+int main(int argc, char *argv[])
+{
+	plan(9);
+
+	/* Proxy timeout is the handshake timeout. */
+	s_config = conf_new(strdup("rc:/noconf"));
+	conf()->max_conn_hs = 1;
+
+	struct sockaddr_storage upstream_addr, server_addr, client_addr;
+	int upstream = bound_socket(&upstream_addr);
+	int server = bound_socket(&server_addr);
+	int client = bound_socket(&client_addr);
+
+	/* Load module forwarding to the local upstream. */
+	char param[64];
+	snprintf(param, sizeof(param), "127.0.0.1@%d", sockaddr_port(&upstream_addr));
+	struct query_plan *plan = query_plan_create(NULL);
+	struct query_module module;
+	memset(&module, 0, sizeof(module));
+	module.param = param;
+	int ret = dnsproxy_load(plan, &module);
+	ok(ret == KNOT_EOK && !EMPTY_LIST(plan->stage[QPLAN_BEGIN]),
+	   "dnsproxy: load");
+	if (ret != KNOT_EOK) {
+		skip_block(8, "module not loaded");
+		goto cleanup;
+	}
+	const struct query_step *step = HEAD(plan->stage[QPLAN_BEGIN]);
+
+	/* Two queries in flight. */
+	struct upstream_query first, second;
+	ret = forward(step, server, &client_addr, "first.example.com", 0x1111);
+	first.len = receive(upstream, first.wire, sizeof(first.wire), &first.from);
+	ok(ret == KNOT_NS_PROC_NOOP && first.len > KNOT_WIRE_HEADER_SIZE,
+	   "dnsproxy: query taken over and forwarded");
+
+	ret = forward(step, server, &client_addr, "second.example.com", 0x2222);
+	second.len = receive(upstream, second.wire, sizeof(second.wire), &second.from);
+	ok(ret == KNOT_NS_PROC_NOOP && second.len > KNOT_WIRE_HEADER_SIZE,
+	   "dnsproxy: second query forwarded");
+	ok(sockaddr_port(&first.from) != sockaddr_port(&second.from),
+	   "dnsproxy: queries forwarded from different ports");
+
+	/* Mismatched answer to the second query, then answer to the first one. */
+	uint64_t sent = now_ms();
+	reply(upstream, &second, true);
+	reply(upstream, &first, false);
+
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+	struct sockaddr_storage from;
+	int len = receive(client, buf, sizeof(buf), &from);
+	ok(len == first.len && knot_wire_get_id(buf) == 0x1111 &&
+	   knot_wire_get_qr(buf) && knot_wire_get_rcode(buf) == KNOT_RCODE_NOERROR,
+	   "dnsproxy: answer relayed with client message ID");
+	ok(sockaddr_cmp(&from, &server_addr) == 0,
+	   "dnsproxy: answer sent from server socket");
+
+	/* Mismatched answer ignored, the query times out. */
+	len = receive(client, buf, sizeof(buf), &from);
+	uint64_t elapsed = now_ms() - sent;
+	ok(len >= KNOT_WIRE_HEADER_SIZE && knot_wire_get_id(buf) == 0x2222 &&
+	   knot_wire_get_qr(buf) && knot_wire_get_rcode(buf) == KNOT_RCODE_SERVFAIL,
+	   "dnsproxy: mismatched question ignored, timeout gives SERVFAIL");
+	ok(elapsed >= 900, "dnsproxy: SERVFAIL after timeout");
+
+	/* Answer after timeout is not relayed. */
+	reply(upstream, &second, true);
+	struct pollfd pfd = { .fd = client, .events = POLLIN };
+	ok(poll(&pfd, 1, 200) == 0, "dnsproxy: late answer dropped");
+
+	dnsproxy_unload(&module);
+cleanup:
+	query_plan_free(plan);
+	close(upstream);
+	close(server);
+	close(client);
+	conf_free(conf());
+
+	return 0;
+}
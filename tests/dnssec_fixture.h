@@ -0,0 +1,180 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libknot/binary.h"
+#include "libknot/dname.h"
+#include "libknot/dnssec/key.h"
+#include "libknot/dnssec/sign.h"
+#include "libknot/errcode.h"
+
+/* RSA (algorithm 5) fixture key fields. */
+#define RSA_MODULUS "pSxiFXG8wB1SSHdok+OdaAp6QdvqjpZ17ucNge21iYVfv+DZq52l21KdmmyEqoG9wG/87O7XG8XVLNyYPue8Mw=="
+#define RSA_PUBLIC_EXPONENT "AQAB"
+#define RSA_PRIVATE_EXPONENT "UuNK9Wf2SJJuUF9b45s9ypA3egVaV+O5mwHoDWO0ziWJxFXNMMsobDdusEDjCw64xnlLmrbzNJ3+ClrOnV04gQ=="
+#define RSA_PRIME1 "0/wjqkgVZxqrFi5OMzq2qQYpxKn3HgS87Io9UG6iqis="
+#define RSA_PRIME2 "x3gFCPpaJ4etPEM1hRd6WMAcmx5FBMjvuuzID6SWWhk="
+#define RSA_EXPONENT1 "Z8qUS9NvZ0QPcJTLhRnCRY/W84ukivYW6lnlG3SQAHE="
+#define RSA_EXPONENT2 "C0kjH8rqZuoqRwqWcJ1Pcs4L0Er6JLcpuS3Ec/4f86E="
+#define RSA_COEFFICIENT "VYc62FQX0Vnd27VxkX6hsBcl7Oh00wVCeh3WTDutndg="
+
+/* DSA (algorithm 6) fixture key fields. */
+#define DSA_PRIME "u7tr4jc7CH0+r2muVEZyjYu7hpMrQ1dHGAMv7hr5dBFYzkutfdBmDSW4C+qxaXWo14gi+jJ8XqFqQ7rQn23DdQ=="
+#define DSA_SUBPRIME "tgZ5X6pFoCOM2NzfiAYVG1434Mk="
+#define DSA_BASE "bHidtFIFYAHXp7ZxTFd6poJJG8brqO9eyJygvYSFCej/FGDqhF2TsboVvS/evW/qTaSvhkd/aiDg5eAfu1HvrQ=="
+#define DSA_PRIVATE_VALUE "FiTBDsbFDNTw7IrhPeVbzM0DMmI="
+#define DSA_PUBLIC_VALUE "G1pX04Bcew8wyHsmno4Q0tNdmBLlaEdbqvQ03W5XVXUM6MPrtzxgc6jdOogqZsvGK4c+FbThBu42Z1t/ioQr8A=="
+
+/* Key files of the fixture keys, the public key lacks owner and flags. */
+#define FIXTURE_RSA_KEY_PUBLIC "3 5 " \
+	"AwEAAaUsYhVxvMAdUkh3aJPjnWgKekHb6o6Wde7nDYHttYmFX7/g2audpdtSnZpshKqBvcBv/Ozu1xvF1SzcmD7nvDM="
+#define FIXTURE_RSA_KEY_PRIVATE \
+	"Private-key-format: v1.2\n" \
+	"Algorithm: 5 (RSASHA1)\n" \
+	"Modulus: " RSA_MODULUS "\n" \
+	"PublicExponent: " RSA_PUBLIC_EXPONENT "\n" \
+	"PrivateExponent: " RSA_PRIVATE_EXPONENT "\n" \
+	"Prime1: " RSA_PRIME1 "\n" \
+	"Prime2: " RSA_PRIME2 "\n" \
+	"Exponent1: " RSA_EXPONENT1 "\n" \
+	"Exponent2: " RSA_EXPONENT2 "\n" \
+	"Coefficient: " RSA_COEFFICIENT "\n"
+#define FIXTURE_DSA_KEY_PUBLIC "3 6 " \
+	"ALYGeV+qRaAjjNjc34gGFRteN+DJu7tr4jc7CH0+r2muVEZyjYu7hpMrQ1dHGAMv7hr5dBFY" \
+	"zkutfdBmDSW4C+qxaXWo14gi+jJ8XqFqQ7rQn23DdWx4nbRSBWAB16e2cUxXeqaCSRvG66jv" \
+	"XsicoL2EhQno/xRg6oRdk7G6Fb0v3r1v6k2kr4ZHf2og4OXgH7tR760bWlfTgFx7DzDIeyae" \
+	"jhDS012YEuVoR1uq9DTdbldVdQzow+u3PGBzqN06iCpmy8Yrhz4VtOEG7jZnW3+KhCvw"
+#define FIXTURE_DSA_KEY_PRIVATE \
+	"Private-key-format: v1.2\n" \
+	"Algorithm: 6 (DSA-NSEC3-SHA1)\n" \
+	"Prime(p): " DSA_PRIME "\n" \
+	"Subprime(q): " DSA_SUBPRIME "\n" \
+	"Base(g): " DSA_BASE "\n" \
+	"Private_value(x): " DSA_PRIVATE_VALUE "\n" \
+	"Public_value(y): " DSA_PUBLIC_VALUE "\n"
+
+/* Build DNSKEY RDATA (zone key) from public key fields, set key tag. */
+static inline int fixture_dnskey(knot_key_params_t *kp, const uint8_t *prefix,
+                                 size_t prefix_size, const knot_binary_t *parts,
+                                 size_t count)
+{
+	uint8_t rdata[1024] = { 0x01, 0x00, 0x03, kp->algorithm };
+	size_t size = 4;
+	memcpy(rdata + size, prefix, prefix_size);
+	size += prefix_size;
+	for (size_t i = 0; i < count; i++) {
+		memcpy(rdata + size, parts[i].data, parts[i].size);
+		size += parts[i].size;
+	}
+
+	kp->keytag = knot_keytag(rdata, size);
+	return knot_binary_from_string(rdata, size, &kp->rdata);
+}
+
+/* Create RSA (algorithm 5) signing key for the zone. */
+static inline int fixture_rsa_key(const char *zone, knot_dnssec_key_t *key)
+{
+	knot_key_params_t kp = { 0 };
+	kp.name = knot_dname_from_str_alloc(zone);
+	kp.algorithm = 5;
+	knot_binary_from_base64(RSA_MODULUS, &kp.modulus);
+	knot_binary_from_base64(RSA_PUBLIC_EXPONENT, &kp.public_exponent);
+	knot_binary_from_base64(RSA_PRIVATE_EXPONENT, &kp.private_exponent);
+	knot_binary_from_base64(RSA_PRIME1, &kp.prime_one);
+	knot_binary_from_base64(RSA_PRIME2, &kp.prime_two);
+	knot_binary_from_base64(RSA_EXPONENT1, &kp.exponent_one);
+	knot_binary_from_base64(RSA_EXPONENT2, &kp.exponent_two);
+	knot_binary_from_base64(RSA_COEFFICIENT, &kp.coefficient);
+
+	const uint8_t exponent_size = kp.public_exponent.size;
+	const knot_binary_t parts[] = { kp.public_exponent, kp.modulus };
+	int ret = fixture_dnskey(&kp, &exponent_size, 1, parts, 2);
+	if (ret == KNOT_EOK) {
+		ret = knot_dnssec_key_from_params(&kp, key);
+	}
+	knot_free_key_params(&kp);
+
+	return ret;
+}
+
+/* Create DSA (algorithm 6) signing key for the zone. */
+static inline int fixture_dsa_key(const char *zone, knot_dnssec_key_t *key)
+{
+	knot_key_params_t kp = { 0 };
+	kp.name = knot_dname_from_str_alloc(zone);
+	kp.algorithm = 6;
+	knot_binary_from_base64(DSA_PRIME, &kp.prime);
+	knot_binary_from_base64(DSA_SUBPRIME, &kp.subprime);
+	knot_binary_from_base64(DSA_BASE, &kp.base);
+	knot_binary_from_base64(DSA_PRIVATE_VALUE, &kp.private_value);
+	knot_binary_from_base64(DSA_PUBLIC_VALUE, &kp.public_value);
+
+	const uint8_t t = 0; // 64 octet prime
+	const knot_binary_t parts[] = {
+		kp.subprime, kp.prime, kp.base, kp.public_value
+	};
+	int ret = fixture_dnskey(&kp, &t, 1, parts, 4);
+	if (ret == KNOT_EOK) {
+		ret = knot_dnssec_key_from_params(&kp, key);
+	}
+	knot_free_key_params(&kp);
+
+	return ret;
+}
+
+/* Write key files 'K<zone>.+<id>.key' and '.private' into the directory,
+ * flags are DNSKEY flags, extra are additional private key file lines. */
+static inline int fixture_key_files(const char *dir, const char *zone,
+                                    const char *id, unsigned flags,
+                                    const char *public, const char *private,
+                                    const char *extra)
+{
+	char path[1024];
+	const char *suffixes[] = { "key", "private" };
+
+	for (int i = 0; i < 2; i++) {
+		snprintf(path, sizeof(path), "%s/K%s.+%s.%s", dir, zone, id,
+		         suffixes[i]);
+		FILE *file = fopen(path, "w");
+		if (file == NULL) {
+			return KNOT_EACCES;
+		}
+		if (i == 0) {
+			fprintf(file, "%s. IN DNSKEY %u %s\n", zone, flags, public);
+		} else {
+			fprintf(file, "%s%s", private, extra ? extra : "");
+		}
+		fclose(file);
+	}
+
+	return KNOT_EOK;
+}
+
+/* Remove key files written by fixture_key_files(). */
+static inline void fixture_key_files_remove(const char *dir, const char *zone,
+                                            const char *id)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/K%s.+%s.key", dir, zone, id);
+	remove(path);
+	snprintf(path, sizeof(path), "%s/K%s.+%s.private", dir, zone, id);
+	remove(path);
+}
@@ -0,0 +1,398 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tap/basic.h>
+
+#include "knot/dnssec/online-sign.h"
+#include "knot/nameserver/process_query.h"
+#include "libknot/descriptor.h"
+#include "libknot/dnssec/crypto.h"
+#include "libknot/dnssec/rrset-sign.h"
+#include "libknot/internal/mempool.h"
+#include "libknot/packet/wire.h"
+#include "libknot/rrtype/opt.h"
+#include "libknot/rrtype/rrsig.h"
+#include "dnssec_fixture.h"
+#include "fake_server.h"
+#include "zone_fixture.h"
+
+#define ZONE "example.com"
+#define KEY_ID "006+00001"
+
+/* SOA with minimum TTL 300, differs from the TTL of the records. */
+#define SOA_MINIMUM 300
+#define SOA_RDATA "\x00\x00\x00\x00\x00\x01\x00\x00\x0e\x10\x00\x00\x0e\x10" \
+                  "\x00\x00\x0e\x10\x00\x00\x01\x2c", 22
+
+/* NSEC type bitmaps: A NSEC RRSIG and NSEC RRSIG. */
+#define BITMAP_A "\x00\x06\x40\x00\x00\x00\x00\x03"
+#define BITMAP_EMPTY "\x00\x06\x00\x00\x00\x00\x00\x03"
+#define BITMAP_SIZE 8
+
+/*! \brief Zone with online signing, key to verify its answers. */
+typedef struct {
+	server_t server;
+	zone_t *zone;
+	knot_dnssec_key_t key;
+	knot_dnssec_sign_context_t *ctx;
+} online_t;
+
+/*! \brief Resolve query, return parsed response. */
+static knot_pkt_t *query(online_t *online, const char *qname, uint16_t type,
+                         bool dnssec, unsigned thread_id)
+{
+	mm_ctx_t mm;
+	mm_ctx_mempool(&mm, MM_DEFAULT_BLKSIZE);
+
+	knot_layer_t proc;
+	memset(&proc, 0, sizeof(proc));
+	proc.mm = &mm;
+
+	struct sockaddr_storage ss;
+	memset(&ss, 0, sizeof(ss));
+	sockaddr_set(&ss, AF_INET, "127.0.0.1", 53);
+	struct process_query_param param = { 0 };
+	param.remote = &ss;
+	param.server = &online->server;
+	param.thread_id = thread_id;
+
+	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, &mm);
+	knot_dname_t *name = knot_dname_from_str(NULL, qname, 0);
+	knot_pkt_put_question(pkt, name, KNOT_CLASS_IN, type);
+	free(name);
+	if (dnssec) {
+		knot_rrset_t opt_rr;
+		knot_edns_init(&opt_rr, KNOT_WIRE_MAX_PKTSIZE, 0, 0, &mm);
+		knot_edns_set_do(&opt_rr);
+		knot_pkt_begin(pkt, KNOT_ADDITIONAL);
+		knot_pkt_put(pkt, KNOT_COMPR_HINT_NONE, &opt_rr, KNOT_PF_FREE);
+	}
+	knot_pkt_parse(pkt, 0);
+
+	knot_pkt_t *answer = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, &mm);
+	knot_layer_begin(&proc, NS_PROC_QUERY, &param);
+	knot_layer_in(&proc, pkt);
+	int state = knot_layer_out(&proc, answer);
+	knot_layer_finish(&proc);
+
+	knot_pkt_t *result = NULL;
+	if (state == KNOT_NS_PROC_DONE) {
+		result = knot_pkt_new(NULL, answer->size, NULL);
+		if (result != NULL) {
+			memcpy(result->wire, answer->wire, answer->size);
+			result->size = answer->size;
+			if (knot_pkt_parse(result, 0) != KNOT_EOK) {
+				knot_pkt_free(&result);
+			}
+		}
+	}
+
+	mp_delete(mm.ctx);
+
+	return result;
+}
+
+/*! \brief Find RR set (or RRSIG covering the type) in packet section. */
+static const knot_rrset_t *find_rr(const knot_pkt_t *pkt, knot_section_t id,
+                                   const char *owner, uint16_t type, bool rrsig)
+{
+	knot_dname_t *name = knot_dname_from_str_alloc(owner);
+	const knot_pktsection_t *section = knot_pkt_section(pkt, id);
+	const knot_rrset_t *found = NULL;
+	for (uint16_t i = 0; found == NULL && i < section->count; i++) {
+		const knot_rrset_t *rr = &section->rr[i];
+		if (!knot_dname_is_equal(rr->owner, name)) {
+			continue;
+		}
+		if (!rrsig && rr->type == type) {
+			found = rr;
+		}
+		if (rrsig && rr->type == KNOT_RRTYPE_RRSIG &&
+		    knot_rrsig_type_covered(&rr->rrs, 0) == type) {
+			found = rr;
+		}
+	}
+	knot_dname_free(&name, NULL);
+
+	return found;
+}
+
+/*! \brief Check that the RR set in the section is signed by the zone key. */
+static bool is_signed(online_t *online, const knot_pkt_t *pkt,
+                      knot_section_t id, const char *owner, uint16_t type)
+{
+	const knot_rrset_t *covered = find_rr(pkt, id, owner, type, false);
+	const knot_rrset_t *rrsig = find_rr(pkt, id, owner, type, true);
+	if (covered == NULL || rrsig == NULL || rrsig->rrs.rr_count != 1) {
+		return false;
+	}
+
+	// signatures near expiration are valid as well
+	knot_dnssec_policy_t policy;
+	knot_dnssec_init_default_policy(&policy);
+	policy.refresh_before = policy.now;
+
+	return knot_rrsig_original_ttl(&rrsig->rrs, 0) ==
+	       knot_rdata_ttl(knot_rdataset_at(&covered->rrs, 0)) &&
+	       knot_is_valid_signature(covered, rrsig, 0, &online->key,
+	                               online->ctx, &policy) == KNOT_EOK;
+}
+
+/*! \brief Check minimally covering NSEC in the authority section. */
+static bool is_black_lie(online_t *online, const knot_pkt_t *pkt,
+                         const char *owner, const char *bitmap)
+{
+	const knot_rrset_t *nsec = find_rr(pkt, KNOT_AUTHORITY, owner,
+	                                   KNOT_RRTYPE_NSEC, false);
+	if (nsec == NULL || nsec->rrs.rr_count != 1) {
+		return false;
+	}
+
+	// next name is \000.owner
+	knot_dname_t *name = knot_dname_from_str_alloc(owner);
+	size_t name_size = knot_dname_size(name);
+	uint8_t expected[2 + KNOT_DNAME_MAXLEN + BITMAP_SIZE] = { 1, 0 };
+	memcpy(expected + 2, name, name_size);
+	memcpy(expected + 2 + name_size, bitmap, BITMAP_SIZE);
+	size_t expected_size = 2 + name_size + BITMAP_SIZE;
+	knot_dname_free(&name, NULL);
+
+	const knot_rdata_t *rdata = knot_rdataset_at(&nsec->rrs, 0);
+	return knot_rdata_ttl(rdata) == SOA_MINIMUM &&
+	       knot_rdata_rdlen(rdata) == expected_size &&
+	       memcmp(knot_rdata_data(rdata), expected, expected_size) == 0 &&
+	       is_signed(online, pkt, KNOT_AUTHORITY, owner, KNOT_RRTYPE_NSEC) &&
+	       is_signed(online, pkt, KNOT_AUTHORITY, ZONE, KNOT_RRTYPE_SOA);
+}
+
+/*! \brief Get signature of the record in the answer section. */
+static bool get_signature(const knot_pkt_t *pkt, const char *owner,
+                          uint16_t type, uint8_t *signature, size_t *size)
+{
+	const knot_rrset_t *rrsig = find_rr(pkt, KNOT_ANSWER, owner, type, true);
+	if (rrsig == NULL) {
+		return false;
+	}
+
+	uint8_t *data = NULL;
+	knot_rrsig_signature(&rrsig->rrs, 0, &data, size);
+	if (data == NULL) {
+		return false;
+	}
+	memcpy(signature, data, *size);
+
+	return true;
+}
+
+/*!
+ * \brief Query the record and compare its signature with the previous one.
+ *
+ * DSA signatures of the same data differ, so equal signatures come from
+ * the cache.
+ */
+static bool same_signature(online_t *online, const char *owner,
+                           unsigned thread_id, uint8_t *previous,
+                           size_t *previous_size)
+{
+	uint8_t signature[128];
+	size_t size = 0;
+	knot_pkt_t *pkt = query(online, owner, KNOT_RRTYPE_A, true, thread_id);
+	bool found = pkt && get_signature(pkt, owner, KNOT_RRTYPE_A,
+	                                  signature, &size);
+	knot_pkt_free(&pkt);
+
+	bool same = found && size == *previous_size &&
+	            memcmp(signature, previous, size) == 0;
+	if (found) {
+		memcpy(previous, signature, size);
+		*previous_size = size;
+	}
+
+	return same;
+}
+
+static int create_zone(online_t *online, const char *keydir)
+{
+	conf_zone_t *conf = malloc(sizeof(conf_zone_t));
+	conf_init_zone(conf);
+	conf->name = strdup(ZONE ".");
+	conf->dnssec_keydir = strdup(keydir);
+	conf->dnssec_enable = true;
+	conf->dnssec_online = true;
+
+	online->zone = zone_new(conf);
+	zone_contents_t *contents = zone_contents_new(online->zone->name);
+	online->zone->contents = contents;
+	if (contents == NULL ||
+	    fixture_add_rr(contents, ZONE, KNOT_RRTYPE_SOA, SOA_RDATA) != KNOT_EOK ||
+	    fixture_add_rr(contents, "www." ZONE, KNOT_RRTYPE_A, FIXTURE_A) != KNOT_EOK ||
+	    fixture_add_rr(contents, "c.b." ZONE, KNOT_RRTYPE_A, FIXTURE_A) != KNOT_EOK ||
+	    zone_contents_adjust_full(contents, NULL, NULL) != KNOT_EOK) {
+		return KNOT_ERROR;
+	}
+
+	online->zone->online_sign = knot_online_sign_new(contents, conf);
+	if (online->zone->online_sign == NULL) {
+		return KNOT_ERROR;
+	}
+
+	/* Serve the zone next to the root zone. */
+	zone_t *root = knot_zonedb_find(online->server.zone_db, ROOT_DNAME);
+	knot_zonedb_t *db = knot_zonedb_new(2);
+	knot_zonedb_insert(db, root);
+	knot_zonedb_insert(db, online->zone);
+	knot_zonedb_build_index(db);
+	knot_zonedb_free(&online->server.zone_db);
+	online->server.zone_db = db;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Replace online signing context, use given signature lifetime. */
+static void set_lifetime(online_t *online, uint32_t lifetime)
+{
+	zone_t *zone = online->zone;
+	zone->conf->sig_lifetime = lifetime;
+	knot_online_sign_free(zone->online_sign);
+	zone->online_sign = knot_online_sign_new(zone->contents, zone->conf);
+}
+
+int main(int argc, char *argv[])
+{
+	plan(17);
+
+	online_t online;
+	memset(&online, 0, sizeof(online));
+
+	char *keydir = test_tmpdir();
+	int ret = fixture_key_files(keydir, ZONE, KEY_ID, 257,
+	                            FIXTURE_DSA_KEY_PUBLIC,
+	                            FIXTURE_DSA_KEY_PRIVATE, NULL);
+	if (ret == KNOT_EOK) {
+		ret = fixture_dsa_key(ZONE, &online.key);
+	}
+	if (ret == KNOT_EOK) {
+		online.ctx = knot_dnssec_sign_init(&online.key);
+		ret = create_fake_server(&online.server, NULL);
+	}
+	if (ret == KNOT_EOK) {
+		ret = create_zone(&online, keydir);
+	}
+	ok(ret == KNOT_EOK, "create zone signed online");
+	if (ret != KNOT_EOK) {
+		skip_block(16, "no zone");
+		goto cleanup;
+	}
+
+	// existing record
+	knot_pkt_t *pkt = query(&online, "www." ZONE, KNOT_RRTYPE_A, true, 0);
+	ok(pkt && knot_wire_get_rcode(pkt->wire) == KNOT_RCODE_NOERROR &&
+	   is_signed(&online, pkt, KNOT_ANSWER, "www." ZONE, KNOT_RRTYPE_A),
+	   "existing record, signed answer");
+	knot_pkt_free(&pkt);
+
+	// no data at existing name, empty non-terminal, non-existent name
+	pkt = query(&online, "www." ZONE, KNOT_RRTYPE_TXT, true, 0);
+	ok(pkt && knot_wire_get_rcode(pkt->wire) == KNOT_RCODE_NOERROR &&
+	   knot_wire_get_ancount(pkt->wire) == 0 &&
+	   is_black_lie(&online, pkt, "www." ZONE, BITMAP_A),
+	   "no data, NSEC with types at the name");
+	knot_pkt_free(&pkt);
+
+	pkt = query(&online, "b." ZONE, KNOT_RRTYPE_A, true, 0);
+	ok(pkt && knot_wire_get_rcode(pkt->wire) == KNOT_RCODE_NOERROR &&
+	   knot_wire_get_ancount(pkt->wire) == 0 &&
+	   is_black_lie(&online, pkt, "b." ZONE, BITMAP_EMPTY),
+	   "empty non-terminal, NSEC without data types");
+	knot_pkt_free(&pkt);
+
+	pkt = query(&online, "nx." ZONE, KNOT_RRTYPE_A, true, 0);
+	ok(pkt && knot_wire_get_rcode(pkt->wire) == KNOT_RCODE_NOERROR &&
+	   knot_wire_get_ancount(pkt->wire) == 0 &&
+	   is_black_lie(&online, pkt, "nx." ZONE, BITMAP_EMPTY),
+	   "non-existent name, NOERROR with NSEC");
+	knot_pkt_free(&pkt);
+
+	pkt = query(&online, "nx." ZONE, KNOT_RRTYPE_A, false, 0);
+	ok(pkt && knot_wire_get_rcode(pkt->wire) == KNOT_RCODE_NXDOMAIN &&
+	   find_rr(pkt, KNOT_AUTHORITY, "nx." ZONE, KNOT_RRTYPE_NSEC, false) == NULL,
+	   "non-existent name without DO, NXDOMAIN");
+	knot_pkt_free(&pkt);
+
+	// cached signatures
+	uint8_t signature[128];
+	size_t size = 0;
+	same_signature(&online, "www." ZONE, 0, signature, &size);
+	ok(size > 0 && same_signature(&online, "www." ZONE, 0, signature, &size),
+	   "cache: signature reused");
+	ok(same_signature(&online, "www." ZONE, ONLINE_SIGN_SLOTS, signature, &size),
+	   "cache: shared by threads with the same slot");
+	ok(!same_signature(&online, "www." ZONE, 1, signature, &size),
+	   "cache: other slot signs again");
+	ok(same_signature(&online, "www." ZONE, 1, signature, &size),
+	   "cache: other slot reuses its signature");
+	uint8_t other_slot[128];
+	size_t other_slot_size = size;
+	memcpy(other_slot, signature, size);
+
+	// least recently used signatures evicted, only NSEC of each name added
+	same_signature(&online, "www." ZONE, 0, signature, &size);
+	bool filled = true;
+	for (int i = 0; filled && i < ONLINE_SIGN_CACHE_SIZE; i++) {
+		char owner[64];
+		snprintf(owner, sizeof(owner), "nx%d." ZONE, i);
+		pkt = query(&online, owner, KNOT_RRTYPE_A, true, 0);
+		filled = pkt && is_black_lie(&online, pkt, owner, BITMAP_EMPTY);
+		knot_pkt_free(&pkt);
+	}
+	ok(filled, "cache: filled with other signatures");
+	ok(!same_signature(&online, "www." ZONE, 0, signature, &size),
+	   "cache: evicted signature created again");
+	ok(same_signature(&online, "www." ZONE, 1, other_slot, &other_slot_size),
+	   "cache: other slot not affected by eviction");
+	ok(same_signature(&online, "www." ZONE, 0, signature, &size),
+	   "cache: signature created again is cached");
+
+	// signatures near expiration created again
+	set_lifetime(&online, 4000);
+	same_signature(&online, "www." ZONE, 0, signature, &size);
+	ok(!same_signature(&online, "www." ZONE, 0, signature, &size),
+	   "expiring signature created again");
+	pkt = query(&online, "www." ZONE, KNOT_RRTYPE_A, true, 0);
+	ok(pkt && is_signed(&online, pkt, KNOT_ANSWER, "www." ZONE, KNOT_RRTYPE_A),
+	   "expiring signature valid");
+	knot_pkt_free(&pkt);
+
+	set_lifetime(&online, 0);
+	same_signature(&online, "www." ZONE, 0, signature, &size);
+	ok(same_signature(&online, "www." ZONE, 0, signature, &size),
+	   "default lifetime, signature cached");
+
+cleanup:
+	server_deinit(&online.server);
+	conf_free(conf());
+	knot_dnssec_sign_free(online.ctx);
+	knot_dnssec_key_free(&online.key);
+	knot_zone_keys_cache_clear();
+	fixture_key_files_remove(keydir, ZONE, KEY_ID);
+	test_tmpdir_free(keydir);
+	knot_crypto_cleanup();
+
+	return 0;
+}
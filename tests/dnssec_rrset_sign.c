@@ -0,0 +1,155 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <tap/basic.h>
+
+#include "libknot/descriptor.h"
+#include "libknot/dnssec/crypto.h"
+#include "libknot/dnssec/rrset-sign.h"
+#include "dnssec_fixture.h"
+
+/*! \brief Number of RR sets signed in one batch. */
+#define COUNT 8
+
+/*! \brief Create RR sets of different owners, types and sizes. */
+static void create_rrsets(knot_rrset_t *covered, knot_rrset_t *rrsigs)
+{
+	for (int i = 0; i < COUNT; i++) {
+		char owner[64];
+		snprintf(owner, sizeof(owner), "%s%d.example.com",
+		         i % 2 ? "*.w" : "n", i);
+		knot_dname_t *name = knot_dname_from_str_alloc(owner);
+		uint16_t type = i % 3 ? KNOT_RRTYPE_A : KNOT_RRTYPE_TXT;
+
+		knot_rrset_init(&covered[i], name, type, KNOT_CLASS_IN);
+		knot_rrset_init(&rrsigs[i], name, KNOT_RRTYPE_RRSIG, KNOT_CLASS_IN);
+		for (int j = 0; j <= i; j++) {
+			// TXT with single string, A without the length
+			uint8_t rdata[] = { 4, 192, 0, 2, i * COUNT + j };
+			size_t skip = (type == KNOT_RRTYPE_A) ? 1 : 0;
+			knot_rrset_add_rdata(&covered[i], rdata + skip,
+			                     sizeof(rdata) - skip, 3600 + i, NULL);
+		}
+	}
+}
+
+static void clear_rrsets(knot_rrset_t *rrsets)
+{
+	for (int i = 0; i < COUNT; i++) {
+		knot_rrset_clear(&rrsets[i], NULL);
+	}
+}
+
+static void clear_rdata(knot_rrset_t *rrsets)
+{
+	for (int i = 0; i < COUNT; i++) {
+		knot_rdataset_clear(&rrsets[i].rrs, NULL);
+	}
+}
+
+/*!
+ * \brief Sign RR sets in one batch and one by one, compare the results.
+ *
+ * \param deterministic  Signatures of the same data are the same.
+ */
+static void test_batch(const char *alg, knot_dnssec_key_t *key,
+                       bool deterministic)
+{
+	knot_dnssec_sign_context_t *ctx = knot_dnssec_sign_init(key);
+	knot_dnssec_policy_t policy;
+	knot_dnssec_init_default_policy(&policy);
+
+	knot_rrset_t covered[COUNT], batch[COUNT], single[COUNT];
+	create_rrsets(covered, batch);
+	for (int i = 0; i < COUNT; i++) {
+		knot_rrset_init(&single[i], batch[i].owner, KNOT_RRTYPE_RRSIG,
+		                KNOT_CLASS_IN);
+	}
+
+	int ret = knot_sign_rrsets(batch, covered, COUNT, key, ctx, &policy);
+	ok(ret == KNOT_EOK, "%s: sign batch", alg);
+
+	bool single_ok = true;
+	for (int i = 0; i < COUNT; i++) {
+		ret = knot_sign_rrset(&single[i], &covered[i], key, ctx, &policy);
+		single_ok = single_ok && ret == KNOT_EOK;
+	}
+	ok(single_ok, "%s: sign one by one", alg);
+
+	bool batch_valid = true, single_valid = true, same = true;
+	for (int i = 0; i < COUNT; i++) {
+		batch_valid = batch_valid && batch[i].rrs.rr_count == 1 &&
+		              knot_is_valid_signature(&covered[i], &batch[i], 0,
+		                                      key, ctx, &policy) == KNOT_EOK;
+		single_valid = single_valid && single[i].rrs.rr_count == 1 &&
+		               knot_is_valid_signature(&covered[i], &single[i], 0,
+		                                       key, ctx, &policy) == KNOT_EOK;
+		if (!deterministic) {
+			continue;
+		}
+		const knot_rdata_t *b = knot_rdataset_at(&batch[i].rrs, 0);
+		const knot_rdata_t *s = knot_rdataset_at(&single[i].rrs, 0);
+		same = same && b && s && knot_rdata_cmp(b, s) == 0 &&
+		       knot_rdata_ttl(b) == knot_rdata_ttl(s);
+	}
+	ok(batch_valid, "%s: batch signatures valid", alg);
+	ok(single_valid, "%s: single signatures valid", alg);
+	if (deterministic) {
+		ok(same, "%s: batch and single signatures equal", alg);
+	} else {
+		skip("%s: signatures not deterministic", alg);
+	}
+
+	// signature of other RR set must not validate
+	ret = knot_is_valid_signature(&covered[0], &batch[1], 0, key, ctx, &policy);
+	ok(ret != KNOT_EOK, "%s: batch signature bound to its RR set", alg);
+
+	ret = knot_sign_rrsets(batch, covered, 0, key, ctx, &policy);
+	ok(ret == KNOT_EOK, "%s: empty batch", alg);
+
+	clear_rdata(single);
+	clear_rdata(batch);
+	clear_rrsets(covered);
+	knot_dnssec_sign_free(ctx);
+}
+
+int main(int argc, char *argv[])
+{
+	plan(2 * 7);
+
+	knot_dnssec_key_t key = { 0 };
+	int ret = fixture_rsa_key("example.com", &key);
+	if (ret == KNOT_EOK) {
+		test_batch("RSA", &key, true);
+	} else {
+		skip_block(7, "RSA: cannot create key");
+	}
+	knot_dnssec_key_free(&key);
+
+	memset(&key, 0, sizeof(key));
+	ret = fixture_dsa_key("example.com", &key);
+	if (ret == KNOT_EOK) {
+		test_batch("DSA", &key, false);
+	} else {
+		skip_block(7, "DSA: cannot create key");
+	}
+	knot_dnssec_key_free(&key);
+
+	knot_crypto_cleanup();
+
+	return 0;
+}
@@ -0,0 +1,148 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <tap/basic.h>
+
+#include "knot/dnssec/sig-cache.h"
+#include "libknot/descriptor.h"
+#include "libknot/dnssec/crypto.h"
+#include "libknot/dnssec/rrset-sign.h"
+#include "libknot/rrtype/rrsig.h"
+#include "dnssec_fixture.h"
+
+/*! \brief Verify the first signature, report if it was taken from cache. */
+static int verify(knot_sig_cache_t *cache, const knot_rrset_t *covered,
+                  const knot_rrset_t *rrsigs, const knot_dnssec_key_t *key,
+                  knot_dnssec_sign_context_t *ctx,
+                  const knot_dnssec_policy_t *policy, bool *hit)
+{
+	size_t hits = cache->hits;
+	int ret = knot_sig_cache_verify(cache, covered, rrsigs, 0, key, ctx, policy);
+	*hit = cache->hits > hits;
+
+	return ret;
+}
+
+static knot_rrset_t *create_rrset(const char *owner, uint32_t ttl,
+                                  const uint8_t *address)
+{
+	knot_dname_t *name = knot_dname_from_str_alloc(owner);
+	knot_rrset_t *rrset = knot_rrset_new(name, KNOT_RRTYPE_A, KNOT_CLASS_IN, NULL);
+	knot_dname_free(&name, NULL);
+	if (rrset != NULL) {
+		knot_rrset_add_rdata(rrset, address, 4, ttl, NULL);
+	}
+
+	return rrset;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	knot_dnssec_key_t key = { 0 }, other_key = { 0 };
+	int ret = fixture_rsa_key("example.com", &key);
+	ok(ret == KNOT_EOK, "create key");
+	ret = fixture_dsa_key("example.com", &other_key);
+	ok(ret == KNOT_EOK, "create other key");
+
+	knot_dnssec_sign_context_t *ctx = knot_dnssec_sign_init(&key);
+	knot_dnssec_sign_context_t *other_ctx = knot_dnssec_sign_init(&other_key);
+	knot_dnssec_policy_t policy;
+	knot_dnssec_init_default_policy(&policy);
+
+	const uint8_t address[] = { 192, 0, 2, 1 };
+	const uint8_t other_address[] = { 192, 0, 2, 2 };
+	knot_rrset_t *covered = create_rrset("www.example.com", 3600, address);
+	knot_rrset_t *other_rdata = create_rrset("www.example.com", 3600, other_address);
+	knot_rrset_t *other_ttl = create_rrset("www.example.com", 7200, address);
+
+	knot_rrset_t *rrsigs = knot_rrset_new(covered->owner, KNOT_RRTYPE_RRSIG,
+	                                      KNOT_CLASS_IN, NULL);
+	ret = knot_sign_rrset(rrsigs, covered, &key, ctx, &policy);
+	ok(ret == KNOT_EOK, "sign records");
+
+	knot_sig_cache_t cache;
+	ret = knot_sig_cache_init(&cache);
+	ok(ret == KNOT_EOK, "cache: init");
+
+	// cached after successful verification
+	bool hit = false;
+	ret = verify(&cache, covered, rrsigs, &key, ctx, &policy, &hit);
+	ok(ret == KNOT_EOK && !hit && hattrie_weight(cache.entries) == 1,
+	   "cache: verified signature stored");
+	ret = verify(&cache, covered, rrsigs, &key, ctx, &policy, &hit);
+	ok(ret == KNOT_EOK && hit, "cache: hit after verification");
+
+	// changed signed data
+	ret = verify(&cache, other_rdata, rrsigs, &key, ctx, &policy, &hit);
+	ok(ret == KNOT_DNSSEC_EINVALID_SIGNATURE && !hit,
+	   "cache: miss for changed RDATA");
+	ret = verify(&cache, other_ttl, rrsigs, &key, ctx, &policy, &hit);
+	ok(ret == KNOT_DNSSEC_EINVALID_SIGNATURE && !hit,
+	   "cache: miss for changed TTL");
+	ret = verify(&cache, covered, rrsigs, &other_key, other_ctx, &policy, &hit);
+	ok(ret != KNOT_EOK && !hit,
+	   "cache: miss for other DNSKEY");
+
+	knot_rrset_t *bad_rrsigs = knot_rrset_copy(rrsigs, NULL);
+	uint8_t *signature = NULL;
+	size_t signature_size = 0;
+	knot_rrsig_signature(&bad_rrsigs->rrs, 0, &signature, &signature_size);
+	signature[signature_size / 2] ^= 0xff;
+	ret = verify(&cache, covered, bad_rrsigs, &key, ctx, &policy, &hit);
+	ok(ret == KNOT_DNSSEC_EINVALID_SIGNATURE && !hit,
+	   "cache: miss for changed RRSIG");
+
+	// failed verifications not cached
+	size_t misses = cache.misses;
+	ret = verify(&cache, covered, bad_rrsigs, &key, ctx, &policy, &hit);
+	ok(ret == KNOT_DNSSEC_EINVALID_SIGNATURE && !hit &&
+	   cache.misses == misses + 1 && hattrie_weight(cache.entries) == 1,
+	   "cache: failed verification not stored");
+
+	// expiration
+	uint32_t expiration = knot_rrsig_sig_expiration(&rrsigs->rrs, 0);
+	knot_dnssec_policy_t late = policy;
+	late.refresh_before = expiration;
+	ret = verify(&cache, covered, rrsigs, &key, ctx, &late, &hit);
+	ok(ret == KNOT_DNSSEC_EINVALID_SIGNATURE && !hit,
+	   "cache: expired signature not taken from cache");
+
+	// sweep
+	ret = knot_sig_cache_sweep(&cache, expiration - 1);
+	ok(ret == KNOT_EOK && hattrie_weight(cache.entries) == 1,
+	   "cache: sweep keeps valid signature");
+	ret = knot_sig_cache_sweep(&cache, expiration);
+	ok(ret == KNOT_EOK && hattrie_weight(cache.entries) == 0,
+	   "cache: sweep drops expiring signature");
+	ret = verify(&cache, covered, rrsigs, &key, ctx, &policy, &hit);
+	ok(ret == KNOT_EOK && !hit, "cache: miss after sweep");
+
+	knot_sig_cache_deinit(&cache);
+	knot_rrset_free(&bad_rrsigs, NULL);
+	knot_rrset_free(&rrsigs, NULL);
+	knot_rrset_free(&covered, NULL);
+	knot_rrset_free(&other_rdata, NULL);
+	knot_rrset_free(&other_ttl, NULL);
+	knot_dnssec_sign_free(ctx);
+	knot_dnssec_sign_free(other_ctx);
+	knot_dnssec_key_free(&key);
+	knot_dnssec_key_free(&other_key);
+	knot_crypto_cleanup();
+
+	return 0;
+}
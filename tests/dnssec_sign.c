@@ -22,6 +22,8 @@
 #include "libknot/dnssec/config.h"
 #include "libknot/dnssec/crypto.h"
 #include "libknot/dnssec/sign.h"
+#include "libknot/descriptor.h"
+#include "knot/dnssec/zone-sign.h"
 
 static void test_algorithm(const char *alg, const knot_key_params_t *kp)
 {
@@ -85,9 +87,71 @@ static void test_algorithm(const char *alg, const knot_key_params_t *kp)
 	knot_dnssec_key_free(&key);
 }
 
+static void add_rrsig(changeset_t *ch, const char *owner)
+{
+	knot_dname_t *name = knot_dname_from_str_alloc(owner);
+	knot_rrset_t *rrsig = knot_rrset_new(name, KNOT_RRTYPE_RRSIG,
+	                                     KNOT_CLASS_IN, NULL);
+	const uint8_t rdata[] = {
+		0x00, 0x01, 0x08, 0x02, 0x00, 0x00, 0x0e, 0x10, // A, alg, TTL
+		0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, // validity
+		0x00, 0x01, 0x00, 0x00                          // tag, signer
+	};
+	knot_rrset_add_rdata(rrsig, rdata, sizeof(rdata), 3600, NULL);
+	changeset_add_rrset(ch, rrsig);
+	knot_rrset_free(&rrsig, NULL);
+	knot_dname_free(&name, NULL);
+}
+
+static void test_sign_index(void)
+{
+	knot_zone_sign_index_t index;
+	int result = knot_zone_sign_index_init(&index);
+	is_int(KNOT_EOK, result, "sign index: init");
+
+	knot_dname_t *apex = knot_dname_from_str_alloc("example.com");
+	changeset_t ch;
+	changeset_init(&ch, apex);
+	add_rrsig(&ch, "a.example.com");
+	add_rrsig(&ch, "b.example.com");
+
+	knot_dnssec_policy_t policy;
+	knot_dnssec_init_default_policy(&policy);
+
+	result = knot_zone_sign_index_note_changeset(&index, &ch, &policy);
+	ok(result == KNOT_EOK && index.heap.num == 2,
+	   "sign index: note signed nodes");
+
+	policy.now += 3600;
+	result = knot_zone_sign_index_note_changeset(&index, &ch, &policy);
+	ok(result == KNOT_EOK && index.heap.num == 2,
+	   "sign index: no duplicates for re-signed nodes");
+
+	changeset_t ch_c;
+	changeset_init(&ch_c, apex);
+	add_rrsig(&ch_c, "c.example.com");
+	add_rrsig(&ch_c, "a.example.com");
+	result = knot_zone_sign_index_note_changeset(&index, &ch_c, &policy);
+	ok(result == KNOT_EOK && index.heap.num == 3,
+	   "sign index: note new node");
+
+	knot_zone_sign_index_clear(&index);
+	ok(index.heap.num == 0, "sign index: clear");
+	result = knot_zone_sign_index_note_changeset(&index, &ch, &policy);
+	ok(result == KNOT_EOK && index.heap.num == 2,
+	   "sign index: note signed nodes after clear");
+
+	knot_zone_sign_index_deinit(&index);
+	changeset_clear(&ch);
+	changeset_clear(&ch_c);
+	knot_dname_free(&apex, NULL);
+}
+
 int main(int argc, char *argv[])
 {
-	plan(4 * 14);
+	plan(4 * 14 + 6);
+
+	test_sign_index();
 
 	knot_key_params_t kp = { 0 };
 
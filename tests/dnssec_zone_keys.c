@@ -0,0 +1,238 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <tap/basic.h>
+
+#include "knot/dnssec/zone-keys.h"
+#include "libknot/descriptor.h"
+#include "libknot/dnssec/crypto.h"
+#include "libknot/dnssec/rrset-sign.h"
+#include "dnssec_fixture.h"
+
+#define ZONE "example.com"
+#define KEY_ID "005+00001"
+
+/*! \brief Ignored line changing the size of the private key file. */
+#define EXTRA_LINE "Created: 20150101000000\n"
+
+/*! \brief Zone keys loaded from the key directory, with the first key. */
+typedef struct {
+	knot_zone_keys_t keys;
+	const knot_zone_key_t *key;
+} loaded_t;
+
+static int load(const char *keydir, const knot_dname_t *apex, loaded_t *out)
+{
+	knot_init_zone_keys(&out->keys);
+	int ret = knot_load_zone_keys(keydir, apex, false, &out->keys);
+	out->key = (ret == KNOT_EOK) ? HEAD(out->keys.list) : NULL;
+
+	return ret;
+}
+
+static void unload(loaded_t *loaded)
+{
+	knot_free_zone_keys(&loaded->keys);
+	loaded->key = NULL;
+}
+
+/*! \brief Write private key file, set its modification time. */
+static int write_private(const char *path, const char *content, time_t mtime)
+{
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		return KNOT_EACCES;
+	}
+	fputs(content, file);
+	fclose(file);
+
+	struct timeval times[2] = { { mtime, 0 }, { mtime, 0 } };
+	return utimes(path, times) == 0 ? KNOT_EOK : KNOT_EACCES;
+}
+
+static ino_t file_inode(const char *path)
+{
+	struct stat st = { 0 };
+	stat(path, &st);
+	return st.st_ino;
+}
+
+/*! \brief Check that the key can still sign and verify with its context. */
+static bool key_usable(const knot_zone_key_t *key)
+{
+	if (key == NULL || key->context == NULL) {
+		return false;
+	}
+
+	knot_dnssec_policy_t policy;
+	knot_dnssec_init_default_policy(&policy);
+
+	const uint8_t address[] = { 192, 0, 2, 1 };
+	knot_dname_t *owner = knot_dname_from_str_alloc("www." ZONE);
+	knot_rrset_t covered, rrsigs;
+	knot_rrset_init(&covered, owner, KNOT_RRTYPE_A, KNOT_CLASS_IN);
+	knot_rrset_init(&rrsigs, owner, KNOT_RRTYPE_RRSIG, KNOT_CLASS_IN);
+	knot_rrset_add_rdata(&covered, address, sizeof(address), 3600, NULL);
+
+	int ret = knot_sign_rrset(&rrsigs, &covered, &key->dnssec_key,
+	                          key->context, &policy);
+	if (ret == KNOT_EOK) {
+		ret = knot_is_valid_signature(&covered, &rrsigs, 0,
+		                              &key->dnssec_key, key->context,
+		                              &policy);
+	}
+
+	knot_rdataset_clear(&rrsigs.rrs, NULL);
+	knot_rrset_clear(&covered, NULL);
+
+	return ret == KNOT_EOK;
+}
+
+int main(int argc, char *argv[])
+{
+	plan(16);
+
+	char *keydir = test_tmpdir();
+	char private_path[1024];
+	snprintf(private_path, sizeof(private_path), "%s/K%s.+%s.private",
+	         keydir, ZONE, KEY_ID);
+	knot_dname_t *apex = knot_dname_from_str_alloc(ZONE);
+
+	loaded_t first, second, third, mtime, size, inode, replaced, cleared;
+
+	// initial load, unchanged file reuses the cache entry
+	int ret = fixture_key_files(keydir, ZONE, KEY_ID, 257,
+	                            FIXTURE_RSA_KEY_PUBLIC,
+	                            FIXTURE_RSA_KEY_PRIVATE, NULL);
+	if (ret == KNOT_EOK) {
+		ret = write_private(private_path, FIXTURE_RSA_KEY_PRIVATE, 1000000);
+	}
+	if (ret == KNOT_EOK) {
+		ret = load(keydir, apex, &first);
+	}
+	ok(ret == KNOT_EOK && first.key->dnssec_key.algorithm == 5 &&
+	   key_usable(first.key), "load key");
+	if (ret != KNOT_EOK) {
+		skip_block(15, "cannot load key");
+		goto cleanup;
+	}
+
+	ret = load(keydir, apex, &second);
+	ok(ret == KNOT_EOK && second.key->cached == first.key->cached &&
+	   second.key->context != first.key->context,
+	   "unchanged file, cached key reused");
+
+	// idle signing context returned to the pool and reused
+	const knot_dnssec_sign_context_t *idle = second.key->context;
+	unload(&second);
+	ret = load(keydir, apex, &third);
+	ok(ret == KNOT_EOK && third.key->cached == first.key->cached &&
+	   third.key->context == idle, "idle signing context reused");
+
+	// modification time changed
+	ret = write_private(private_path, FIXTURE_RSA_KEY_PRIVATE, 2000000);
+	if (ret == KNOT_EOK) {
+		ret = load(keydir, apex, &mtime);
+	}
+	ok(ret == KNOT_EOK && mtime.key->cached != first.key->cached &&
+	   key_usable(mtime.key), "changed mtime, key reloaded");
+	ok(key_usable(first.key) && key_usable(third.key),
+	   "changed mtime, holders of old key valid");
+
+	// size changed, same modification time
+	ret = write_private(private_path, FIXTURE_RSA_KEY_PRIVATE EXTRA_LINE,
+	                    2000000);
+	if (ret == KNOT_EOK) {
+		ret = load(keydir, apex, &size);
+	}
+	ok(ret == KNOT_EOK && size.key->cached != mtime.key->cached &&
+	   key_usable(size.key), "changed size, key reloaded");
+
+	// inode changed, same modification time and size
+	char tmp_path[1024];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", private_path);
+	ino_t old_inode = file_inode(private_path);
+	ret = write_private(tmp_path, FIXTURE_RSA_KEY_PRIVATE EXTRA_LINE, 2000000);
+	if (ret == KNOT_EOK && rename(tmp_path, private_path) != 0) {
+		ret = KNOT_EACCES;
+	}
+	if (ret == KNOT_EOK) {
+		ret = load(keydir, apex, &inode);
+	}
+	ok(ret == KNOT_EOK && file_inode(private_path) != old_inode &&
+	   inode.key->cached != size.key->cached && key_usable(inode.key),
+	   "changed inode, key reloaded");
+
+	// the last holder of a replaced key releases it
+	unload(&first);
+	unload(&third);
+	unload(&size);
+	ok(key_usable(mtime.key) && key_usable(inode.key),
+	   "replaced keys released, other holders valid");
+
+	// other key in the same file
+	ret = fixture_key_files(keydir, ZONE, KEY_ID, 257,
+	                        FIXTURE_DSA_KEY_PUBLIC,
+	                        FIXTURE_DSA_KEY_PRIVATE, NULL);
+	if (ret == KNOT_EOK) {
+		ret = load(keydir, apex, &replaced);
+	}
+	ok(ret == KNOT_EOK && replaced.key->dnssec_key.algorithm == 6 &&
+	   replaced.key->dnssec_key.keytag != inode.key->dnssec_key.keytag,
+	   "replaced file, new key loaded");
+	ok(ret == KNOT_EOK && key_usable(replaced.key),
+	   "replaced file, new key usable");
+	ok(inode.key->dnssec_key.algorithm == 5 && key_usable(inode.key),
+	   "replaced file, holder of old key valid");
+	ok(key_usable(mtime.key), "replaced file, older holder valid");
+	unload(&mtime);
+	unload(&inode);
+
+	// clearing the cache keeps keys in use
+	knot_zone_keys_cache_clear();
+	ok(key_usable(replaced.key), "cache cleared, key in use valid");
+
+	ret = load(keydir, apex, &cleared);
+	ok(ret == KNOT_EOK && cleared.key->cached == replaced.key->cached &&
+	   key_usable(cleared.key), "cache cleared, key in use kept");
+
+	// keys not in use are dropped
+	unload(&replaced);
+	unload(&cleared);
+	knot_zone_keys_cache_clear();
+	ret = load(keydir, apex, &cleared);
+	ok(ret == KNOT_EOK && key_usable(cleared.key),
+	   "unused keys dropped, key loaded again");
+	unload(&cleared);
+
+	// removed key file
+	fixture_key_files_remove(keydir, ZONE, KEY_ID);
+	ret = load(keydir, apex, &cleared);
+	ok(ret == KNOT_DNSSEC_ENOKEY, "removed file, no keys");
+	unload(&cleared);
+
+cleanup:
+	knot_zone_keys_cache_clear();
+	fixture_key_files_remove(keydir, ZONE, KEY_ID);
+	knot_dname_free(&apex, NULL);
+	test_tmpdir_free(keydir);
+	knot_crypto_cleanup();
+
+	return 0;
+}
@@ -16,12 +16,165 @@
 
 #include <tap/basic.h>
 
-#include "libknot/dname.h"
 #include "knot/dnssec/zone-nsec.h"
+#include "zone_fixture.h"
+
+#define NSEC3_TTL FIXTURE_TTL
+
+static int add_a(changeset_t *ch, const char *owner)
+{
+	return fixture_change_rr(ch, true, owner, KNOT_RRTYPE_A, FIXTURE_A);
+}
+
+static int rem_a(changeset_t *ch, const char *owner)
+{
+	return fixture_change_rr(ch, false, owner, KNOT_RRTYPE_A, FIXTURE_A);
+}
+
+/*! \brief Checks that the record is in the added (removed) part of changeset. */
+static bool has_rrset(const changeset_t *ch, bool add, const knot_rrset_t *rr)
+{
+	changeset_iter_t itt;
+	if (add) {
+		changeset_iter_add(&itt, ch, false);
+	} else {
+		changeset_iter_rem(&itt, ch, false);
+	}
+
+	bool found = false;
+	knot_rrset_t cur = changeset_iter_next(&itt);
+	while (!found && !knot_rrset_empty(&cur)) {
+		found = knot_rrset_equal(&cur, rr, KNOT_RRSET_COMPARE_WHOLE);
+		cur = changeset_iter_next(&itt);
+	}
+	changeset_iter_clear(&itt);
+
+	return found;
+}
+
+/*! \brief Checks that the part of the first changeset is in the second one. */
+static bool is_subset(const changeset_t *a, const changeset_t *b, bool add)
+{
+	changeset_iter_t itt;
+	if (add) {
+		changeset_iter_add(&itt, a, false);
+	} else {
+		changeset_iter_rem(&itt, a, false);
+	}
+
+	bool found = true;
+	knot_rrset_t cur = changeset_iter_next(&itt);
+	while (found && !knot_rrset_empty(&cur)) {
+		found = has_rrset(b, add, &cur);
+		cur = changeset_iter_next(&itt);
+	}
+	changeset_iter_clear(&itt);
+
+	return found;
+}
+
+static bool same_changes(const changeset_t *a, const changeset_t *b)
+{
+	return is_subset(a, b, true) && is_subset(b, a, true) &&
+	       is_subset(a, b, false) && is_subset(b, a, false);
+}
+
+/*!
+ * \brief Applies update to the zone and checks the fixed NSEC3 chain against
+ *        the one created from scratch.
+ */
+static void test_fix_chain(zone_contents_t *zone, changeset_t *update,
+                           int ret, const char *msg)
+{
+	if (ret == KNOT_EOK) {
+		ret = fixture_keep_soa(update, zone);
+	}
+	if (ret == KNOT_EOK) {
+		ret = apply_changeset_directly(zone, update);
+	}
+	ok(ret == KNOT_EOK, "nsec3 fix: apply update, %s", msg);
+
+	changeset_t fix, full;
+	changeset_init(&fix, zone->apex->owner);
+	changeset_init(&full, zone->apex->owner);
+
+	ret = knot_nsec3_fix_chain(zone, update, NSEC3_TTL, &fix);
+	ok(ret == KNOT_EOK && !changeset_empty(&fix),
+	   "nsec3 fix: fix chain, %s", msg);
+	ret = knot_nsec3_create_chain(zone, NSEC3_TTL, &full);
+	ok(ret == KNOT_EOK && same_changes(&fix, &full),
+	   "nsec3 fix: same as full chain, %s", msg);
+
+	if (ret == KNOT_EOK) {
+		ret = fixture_keep_soa(&fix, zone);
+	}
+	if (ret == KNOT_EOK) {
+		ret = apply_changeset_directly(zone, &fix);
+	}
+	ok(ret == KNOT_EOK, "nsec3 fix: apply fixed chain, %s", msg);
+
+	update_cleanup(update);
+	update_cleanup(&fix);
+	changeset_clear(update);
+	changeset_clear(&fix);
+	changeset_clear(&full);
+}
+
+static void test_nsec3_fix(void)
+{
+	zone_contents_t *zone = fixture_zone("example.com", true);
+	const char *names[] = { "a.example.com", "b.example.com",
+	                        "c.example.com", "d.sub.example.com" };
+	int ret = zone ? KNOT_EOK : KNOT_ENOMEM;
+	for (int i = 0; ret == KNOT_EOK && i < 4; i++) {
+		ret = fixture_add_rr(zone, names[i], KNOT_RRTYPE_A, FIXTURE_A);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_full(zone, NULL, NULL);
+	}
+	ok(ret == KNOT_EOK && knot_is_nsec3_enabled(zone),
+	   "nsec3 fix: zone with NSEC3PARAM");
+	if (ret != KNOT_EOK) {
+		skip_block(1 + 4 * 4, "no zone");
+		zone_contents_deep_free(&zone);
+		return;
+	}
+
+	ret = fixture_nsec3_chain(zone);
+	ok(ret == KNOT_EOK && !zone_tree_is_empty(zone->nsec3_nodes),
+	   "nsec3 fix: initial chain");
+
+	const knot_dname_t *apex = zone->apex->owner;
+	changeset_t update;
+
+	changeset_init(&update, apex);
+	ret = add_a(&update, "e.example.com");
+	test_fix_chain(zone, &update, ret, "added name");
+
+	changeset_init(&update, apex);
+	ret = rem_a(&update, "b.example.com");
+	test_fix_chain(zone, &update, ret, "removed name");
+
+	changeset_init(&update, apex);
+	ret = add_a(&update, "x.ent.example.com");
+	if (ret == KNOT_EOK) {
+		ret = rem_a(&update, "c.example.com");
+	}
+	test_fix_chain(zone, &update, ret, "added empty non-terminal");
+
+	changeset_init(&update, apex);
+	ret = rem_a(&update, "x.ent.example.com");
+	if (ret == KNOT_EOK) {
+		ret = rem_a(&update, "d.sub.example.com");
+	}
+	test_fix_chain(zone, &update, ret, "removed empty non-terminals");
+
+	zone_contents_deep_free(&zone);
+}
 
 int main(int argc, char *argv[])
 {
-	plan(1);
+	plan(1 + 2 + 4 * 4);
 
 	knot_dname_t *owner  = knot_dname_from_str_alloc("name.example.com");
 	knot_dname_t *apex   = knot_dname_from_str_alloc("example.com");
@@ -40,5 +193,7 @@ int main(int argc, char *argv[])
 	knot_dname_free(&apex, NULL);
 	knot_dname_free(&expect, NULL);
 
+	test_nsec3_fix();
+
 	return 0;
 }
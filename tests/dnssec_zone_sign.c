@@ -0,0 +1,207 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <unistd.h>
+#include <tap/basic.h>
+
+#include "knot/dnssec/zone-keys.h"
+#include "knot/dnssec/zone-sign.h"
+#include "libknot/dnssec/crypto.h"
+#include "dnssec_fixture.h"
+#include "zone_fixture.h"
+
+#define NS_DELEG "\x02ns\x05" "deleg\x07" "example\x03" "com\x00", 22
+#define MX_MAIL "\x00\x0a\x04mail\x07" "example\x03" "com\x00", 20
+
+/*! \brief Thread counts compared with serial signing. */
+static const unsigned THREADS[] = { 2, 3, 8 };
+#define THREADS_COUNT (sizeof(THREADS) / sizeof(*THREADS))
+
+/*! \brief Checks that the record is in the added (removed) part of changeset. */
+static bool has_rrset(const changeset_t *ch, bool add, const knot_rrset_t *rr)
+{
+	changeset_iter_t itt;
+	if (add) {
+		changeset_iter_add(&itt, ch, false);
+	} else {
+		changeset_iter_rem(&itt, ch, false);
+	}
+
+	bool found = false;
+	knot_rrset_t cur = changeset_iter_next(&itt);
+	while (!found && !knot_rrset_empty(&cur)) {
+		found = knot_rrset_equal(&cur, rr, KNOT_RRSET_COMPARE_WHOLE);
+		cur = changeset_iter_next(&itt);
+	}
+	changeset_iter_clear(&itt);
+
+	return found;
+}
+
+/*! \brief Checks that the part of the first changeset is in the second one. */
+static bool is_subset(const changeset_t *a, const changeset_t *b, bool add)
+{
+	changeset_iter_t itt;
+	if (add) {
+		changeset_iter_add(&itt, a, false);
+	} else {
+		changeset_iter_rem(&itt, a, false);
+	}
+
+	bool found = true;
+	knot_rrset_t cur = changeset_iter_next(&itt);
+	while (found && !knot_rrset_empty(&cur)) {
+		found = has_rrset(b, add, &cur);
+		cur = changeset_iter_next(&itt);
+	}
+	changeset_iter_clear(&itt);
+
+	return found;
+}
+
+static bool same_changes(const changeset_t *a, const changeset_t *b)
+{
+	return is_subset(a, b, true) && is_subset(b, a, true) &&
+	       is_subset(a, b, false) && is_subset(b, a, false);
+}
+
+/*!
+ * \brief Sign the zone serially and with multiple threads, compare changes.
+ *
+ * RSA signatures are deterministic, so the changesets must be the same.
+ *
+ * \param serial  Changeset filled with changes made by serial signing.
+ */
+static void test_parallel(const zone_contents_t *zone,
+                          const knot_zone_keys_t *keys,
+                          const knot_dnssec_policy_t *policy,
+                          changeset_t *serial, const char *msg)
+{
+	changeset_init(serial, zone->apex->owner);
+	uint32_t serial_refresh = 0;
+	int ret = knot_zone_sign(zone, keys, policy, serial, NULL,
+	                         &serial_refresh);
+	ok(ret == KNOT_EOK, "%s: serial signing", msg);
+
+	for (int i = 0; i < THREADS_COUNT; i++) {
+		changeset_t parallel;
+		changeset_init(&parallel, zone->apex->owner);
+		uint32_t parallel_refresh = 0;
+		ret = knot_zone_sign_parallel(zone, keys, policy, &parallel,
+		                              THREADS[i], &parallel_refresh);
+		ok(ret == KNOT_EOK && same_changes(serial, &parallel) &&
+		   serial_refresh == parallel_refresh,
+		   "%s: %u threads, same as serial", msg, THREADS[i]);
+		changeset_clear(&parallel);
+	}
+}
+
+static zone_contents_t *create_zone(void)
+{
+	zone_contents_t *zone = fixture_zone("example.com", false);
+	if (zone == NULL) {
+		return NULL;
+	}
+
+	int ret = KNOT_EOK;
+	for (int i = 0; ret == KNOT_EOK && i < 100; i++) {
+		char owner[64];
+		snprintf(owner, sizeof(owner), "n%d.example.com", i);
+		ret = fixture_add_rr(zone, owner, KNOT_RRTYPE_A, FIXTURE_A);
+		if (ret == KNOT_EOK && i % 10 == 0) {
+			ret = fixture_add_rr(zone, owner, KNOT_RRTYPE_MX, MX_MAIL);
+		}
+	}
+
+	if (ret != KNOT_EOK ||
+	    fixture_add_rr(zone, "deleg.example.com", KNOT_RRTYPE_NS, NS_DELEG) != KNOT_EOK ||
+	    fixture_add_rr(zone, "ns.deleg.example.com", KNOT_RRTYPE_A, FIXTURE_A) != KNOT_EOK ||
+	    zone_contents_adjust_full(zone, NULL, NULL) != KNOT_EOK) {
+		zone_contents_deep_free(&zone);
+	}
+
+	return zone;
+}
+
+/*! \brief Apply changes made by signing. */
+static int apply_signing(zone_contents_t *zone, changeset_t *ch)
+{
+	int ret = fixture_keep_soa(ch, zone);
+	if (ret == KNOT_EOK) {
+		ret = apply_changeset_directly(zone, ch);
+	}
+	update_cleanup(ch);
+	changeset_clear(ch);
+
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	plan(1 + 3 * (1 + THREADS_COUNT) + 4);
+
+	char *keydir = test_tmpdir();
+	int ret = fixture_key_files(keydir, "example.com", "005+00001", 257,
+	                            FIXTURE_RSA_KEY_PUBLIC,
+	                            FIXTURE_RSA_KEY_PRIVATE, NULL);
+
+	knot_dname_t *apex = knot_dname_from_str_alloc("example.com");
+	knot_zone_keys_t keys;
+	knot_init_zone_keys(&keys);
+	if (ret == KNOT_EOK) {
+		ret = knot_load_zone_keys(keydir, apex, false, &keys);
+	}
+	ok(ret == KNOT_EOK, "load zone keys");
+
+	zone_contents_t *zone = create_zone();
+	if (ret != KNOT_EOK || zone == NULL) {
+		skip_block(3 * (1 + THREADS_COUNT) + 4, "no zone or keys");
+		goto cleanup;
+	}
+
+	knot_dnssec_policy_t policy;
+	knot_dnssec_init_default_policy(&policy);
+
+	// unsigned zone
+	changeset_t serial;
+	test_parallel(zone, &keys, &policy, &serial, "unsigned");
+	ok(!changeset_empty(&serial), "unsigned: signatures created");
+	ret = apply_signing(zone, &serial);
+	ok(ret == KNOT_EOK, "apply signatures");
+
+	// valid signatures are kept
+	test_parallel(zone, &keys, &policy, &serial, "signed");
+	ok(changeset_empty(&serial), "signed: no changes");
+	changeset_clear(&serial);
+
+	// all signatures dropped and created again
+	policy.forced_sign = true;
+	test_parallel(zone, &keys, &policy, &serial, "forced");
+	ok(!changeset_empty(&serial), "forced: signatures replaced");
+	changeset_clear(&serial);
+
+cleanup:
+	zone_contents_deep_free(&zone);
+	knot_free_zone_keys(&keys);
+	knot_zone_keys_cache_clear();
+	knot_dname_free(&apex, NULL);
+	fixture_key_files_remove(keydir, "example.com", "005+00001");
+	test_tmpdir_free(keydir);
+	knot_crypto_cleanup();
+
+	return 0;
+}
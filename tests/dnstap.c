@@ -0,0 +1,229 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <tap/basic.h>
+
+#include "knot/modules/dnstap.c"
+#include "dnstap/message.h"
+#include "libknot/internal/sockaddr.h"
+
+/*! \brief Size of the message padded to need longer length encoding. */
+#define LARGE_SIZE 3000
+
+/*! \brief Encoded message case. */
+struct encode_case {
+	const char *name;
+	Dnstap__Message__Type type;
+	int family;
+	int protocol;
+	size_t size;   /*!< Message size, 0 for the bare message. */
+};
+
+static const struct encode_case ENCODE_CASES[] = {
+	{ "IPv4 UDP query",     DNSTAP__MESSAGE__TYPE__AUTH_QUERY,    AF_INET,  IPPROTO_UDP, 0 },
+	{ "IPv4 TCP query",     DNSTAP__MESSAGE__TYPE__AUTH_QUERY,    AF_INET,  IPPROTO_TCP, 0 },
+	{ "IPv6 UDP query",     DNSTAP__MESSAGE__TYPE__AUTH_QUERY,    AF_INET6, IPPROTO_UDP, 0 },
+	{ "IPv6 TCP query",     DNSTAP__MESSAGE__TYPE__AUTH_QUERY,    AF_INET6, IPPROTO_TCP, 0 },
+	{ "IPv4 UDP response",  DNSTAP__MESSAGE__TYPE__AUTH_RESPONSE, AF_INET,  IPPROTO_UDP, 0 },
+	{ "IPv4 TCP response",  DNSTAP__MESSAGE__TYPE__AUTH_RESPONSE, AF_INET,  IPPROTO_TCP, 0 },
+	{ "IPv6 UDP response",  DNSTAP__MESSAGE__TYPE__AUTH_RESPONSE, AF_INET6, IPPROTO_UDP, 0 },
+	{ "IPv6 TCP response",  DNSTAP__MESSAGE__TYPE__AUTH_RESPONSE, AF_INET6, IPPROTO_TCP, 0 },
+	{ "large TCP response", DNSTAP__MESSAGE__TYPE__AUTH_RESPONSE, AF_INET6, IPPROTO_TCP, LARGE_SIZE }
+};
+#define ENCODE_CASES_COUNT (sizeof(ENCODE_CASES) / sizeof(*ENCODE_CASES))
+
+/*! \brief Options parsing case, expected values are valid on success. */
+struct option_case {
+	const char *param;
+	int ret;
+	unsigned sample;
+	uint16_t rcodes;
+};
+
+static const struct option_case OPTION_CASES[] = {
+	{ "/tmp/capture.tap",                           KNOT_EOK, 0, 0 },
+	{ "/tmp/capture.tap sample 100",                KNOT_EOK, 100, 0 },
+	{ "/tmp/capture.tap sample 65535",              KNOT_EOK, 65535, 0 },
+	{ "/tmp/capture.tap rcode SERVFAIL",            KNOT_EOK, 0, 1 << KNOT_RCODE_SERVFAIL },
+	{ "/tmp/capture.tap rcode NOERROR,NXDOMAIN",    KNOT_EOK, 0,
+	  1 << KNOT_RCODE_NOERROR | 1 << KNOT_RCODE_NXDOMAIN },
+	{ "unix:/tmp/capture.tap sample 10 rcode REFUSED", KNOT_EOK, 10, 1 << KNOT_RCODE_REFUSED },
+	{ "/tmp/capture.tap sample 0",                  KNOT_EINVAL },
+	{ "/tmp/capture.tap sample 65536",              KNOT_EINVAL },
+	{ "/tmp/capture.tap sample 10x",                KNOT_EINVAL },
+	{ "/tmp/capture.tap sample",                    KNOT_EINVAL },
+	{ "/tmp/capture.tap rcode NOSUCH",              KNOT_EINVAL },
+	{ "/tmp/capture.tap rcode NOERROR,BADVERS",     KNOT_EINVAL },
+	{ "/tmp/capture.tap rcode",                     KNOT_EINVAL },
+	{ "/tmp/capture.tap level 1",                   KNOT_EINVAL }
+};
+#define OPTION_CASES_COUNT (sizeof(OPTION_CASES) / sizeof(*OPTION_CASES))
+
+static knot_pkt_t *create_pkt(const struct encode_case *test)
+{
+	size_t size = test->size > 0 ? test->size : KNOT_WIRE_MAX_PKTSIZE;
+	knot_pkt_t *pkt = knot_pkt_new(NULL, size, NULL);
+	if (pkt == NULL) {
+		return NULL;
+	}
+
+	knot_dname_t *qname = knot_dname_from_str_alloc("example.com");
+	knot_pkt_put_question(pkt, qname, KNOT_CLASS_IN, KNOT_RRTYPE_A);
+	knot_dname_free(&qname, NULL);
+	knot_wire_set_id(pkt->wire, 0x1234);
+	if (dt_message_type_is_response(test->type)) {
+		knot_wire_set_qr(pkt->wire);
+		knot_wire_set_rcode(pkt->wire, KNOT_RCODE_NXDOMAIN);
+	}
+
+	/* Padding is opaque to the encoder. */
+	if (test->size > pkt->size) {
+		memset(pkt->wire + pkt->size, 0xab, test->size - pkt->size);
+		pkt->size = test->size;
+	}
+
+	return pkt;
+}
+
+static bool binary_equal(protobuf_c_boolean has_a, const ProtobufCBinaryData *a,
+                         protobuf_c_boolean has_b, const ProtobufCBinaryData *b)
+{
+	if (!has_a || !has_b) {
+		return has_a == has_b;
+	}
+
+	return a->len == b->len && memcmp(a->data, b->data, a->len) == 0;
+}
+
+#define FIELD_EQUAL(a, b, field) \
+	((a)->has_##field == (b)->has_##field && \
+	 (!(a)->has_##field || (a)->field == (b)->field))
+
+#define BINARY_EQUAL(a, b, field) \
+	binary_equal((a)->has_##field, &(a)->field, (b)->has_##field, &(b)->field)
+
+/*! \brief Compare all fields of the decoded and the filled message. */
+static bool message_equal(const Dnstap__Message *a, const Dnstap__Message *b)
+{
+	return a->type == b->type &&
+	       FIELD_EQUAL(a, b, socket_family) &&
+	       FIELD_EQUAL(a, b, socket_protocol) &&
+	       BINARY_EQUAL(a, b, query_address) &&
+	       BINARY_EQUAL(a, b, response_address) &&
+	       FIELD_EQUAL(a, b, query_port) &&
+	       FIELD_EQUAL(a, b, response_port) &&
+	       FIELD_EQUAL(a, b, query_time_sec) &&
+	       FIELD_EQUAL(a, b, query_time_nsec) &&
+	       BINARY_EQUAL(a, b, query_message) &&
+	       BINARY_EQUAL(a, b, query_zone) &&
+	       FIELD_EQUAL(a, b, response_time_sec) &&
+	       FIELD_EQUAL(a, b, response_time_nsec) &&
+	       BINARY_EQUAL(a, b, response_message);
+}
+
+/*! \brief Encode the message, decode the frame, compare with the filled one. */
+static void test_encode(const struct encode_case *test)
+{
+	struct sockaddr_storage remote;
+	if (test->family == AF_INET) {
+		sockaddr_set(&remote, AF_INET, "192.0.2.1", 53000);
+	} else {
+		sockaddr_set(&remote, AF_INET6, "2001:db8::1", 53001);
+	}
+	struct timeval tv = { .tv_sec = 1420070400, .tv_usec = 999999 };
+
+	knot_pkt_t *pkt = create_pkt(test);
+	uint8_t *buf = malloc(pkt->size + FRAME_HDR_MAX + FRAME_OVERHEAD);
+	size_t len = 0;
+	uint8_t *frame = dt_encode(buf, test->type, &remote, test->protocol, pkt,
+	                           &tv, &len);
+
+	Dnstap__Message expected;
+	dt_message_fill(&expected, test->type, (struct sockaddr *)&remote, NULL,
+	                test->protocol, pkt->wire, pkt->size, &tv, &tv);
+
+	Dnstap__Dnstap *decoded = dnstap__dnstap__unpack(NULL, len, frame);
+	ok(decoded != NULL && decoded->type == DNSTAP__DNSTAP__TYPE__MESSAGE &&
+	   decoded->message != NULL && message_equal(decoded->message, &expected),
+	   "dnstap: encode %s", test->name);
+
+	if (decoded != NULL) {
+		dnstap__dnstap__free_unpacked(decoded, NULL);
+	}
+	free(buf);
+	knot_pkt_free(&pkt);
+}
+
+/*! \brief Parse module parameter with options. */
+static void test_options(const struct option_case *test)
+{
+	struct dnstap_ctx ctx = { 0 };
+	char *param = strdup(test->param);
+	char *saveptr = NULL;
+	strtok_r(param, " ", &saveptr);
+	int ret = dnstap_options(&ctx, saveptr);
+	free(param);
+
+	if (test->ret != KNOT_EOK) {
+		ok(ret == test->ret, "dnstap: options '%s' invalid", test->param);
+	} else {
+		ok(ret == KNOT_EOK && ctx.sample == test->sample &&
+		   ctx.rcodes == test->rcodes,
+		   "dnstap: options '%s'", test->param);
+	}
+}
+
+/*! \brief Query and response with the same ID are sampled alike. */
+static void test_sampling(void)
+{
+	struct dnstap_ctx ctx = { .sample = 4 };
+	knot_pkt_t *pkt = create_pkt(&ENCODE_CASES[0]);
+
+	knot_wire_set_id(pkt->wire, 4 * 1000);
+	bool logged = message_sampled(&ctx, pkt);
+	knot_wire_set_qr(pkt->wire);
+	logged = logged && message_sampled(&ctx, pkt);
+
+	bool skipped = true;
+	for (uint16_t id = 4 * 1000 + 1; id < 4 * 1000 + 4; id++) {
+		knot_wire_set_id(pkt->wire, id);
+		skipped = skipped && !message_sampled(&ctx, pkt);
+	}
+	ok(logged && skipped, "dnstap: one of 'sample' messages logged");
+
+	ctx.sample = 0;
+	ok(message_sampled(&ctx, pkt), "dnstap: all messages logged without sample");
+
+	knot_pkt_free(&pkt);
+}
+
+int main(int argc, char *argv[])
+{
+	plan(ENCODE_CASES_COUNT + OPTION_CASES_COUNT + 2);
+
+	for (size_t i = 0; i < ENCODE_CASES_COUNT; i++) {
+		test_encode(&ENCODE_CASES[i]);
+	}
+
+	for (size_t i = 0; i < OPTION_CASES_COUNT; i++) {
+		test_options(&OPTION_CASES[i]);
+	}
+
+	test_sampling();
+
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <time.h>
+#include <tap/basic.h>
+
+#include "knot/common/evsched.h"
+#include "libknot/errcode.h"
+
+/*! \brief Get monotonic time in milliseconds. */
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*! \brief Move the scheduler time forward without waiting. */
+static void time_shift(evsched_t *sched, uint64_t ms)
+{
+	pthread_mutex_lock(&sched->wheel_lock);
+	sched->base -= ms;
+	pthread_mutex_unlock(&sched->wheel_lock);
+}
+
+/*! \brief Fetch next event and finish its processing. */
+static event_t *next_event(evsched_t *sched)
+{
+	event_t *ev = evsched_begin_process(sched);
+	evsched_end_process(sched);
+	return ev;
+}
+
+/*! \brief Number of events in the wheel. */
+static unsigned wheel_count(evsched_t *sched)
+{
+	unsigned count = 0;
+	for (unsigned level = 0; level < EVSCHED_LEVELS; level++) {
+		count += sched->count[level];
+	}
+	return count;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	evsched_t sched;
+	int ret = evsched_init(&sched, NULL);
+	ok(ret == KNOT_EOK, "evsched: init");
+
+	event_t *first = evsched_event_create(&sched, NULL, NULL);
+	event_t *second = evsched_event_create(&sched, NULL, NULL);
+	ok(first != NULL && second != NULL, "evsched: create events");
+
+	// immediate event
+	ret = evsched_schedule(first, 0);
+	ok(ret == KNOT_EOK && next_event(&sched) == first,
+	   "evsched: immediate event");
+
+	// events in the order of expiration
+	evsched_schedule(first, 20);
+	evsched_schedule(second, 10);
+	event_t *ev1 = next_event(&sched);
+	event_t *ev2 = next_event(&sched);
+	ok(ev1 == second && ev2 == first, "evsched: events in order");
+
+	// cancel
+	evsched_schedule(first, 10);
+	evsched_schedule(second, 20);
+	ret = evsched_cancel(first);
+	ok(ret == KNOT_EOK && wheel_count(&sched) == 1,
+	   "evsched: cancel event");
+	ok(next_event(&sched) == second, "evsched: canceled event not run");
+	ret = evsched_cancel(first);
+	ok(ret == KNOT_EOK, "evsched: cancel unscheduled event");
+
+	// reschedule
+	evsched_schedule(first, 5000);
+	ok(sched.count[1] == 1, "evsched: event at the second level");
+	evsched_schedule(first, 10);
+	ok(sched.count[0] == 1 && sched.count[1] == 0 && wheel_count(&sched) == 1,
+	   "evsched: reschedule event");
+	ok(next_event(&sched) == first, "evsched: rescheduled event run");
+
+	// cascading to the first level
+	uint64_t begin = now_ms();
+	evsched_schedule(first, 300);
+	ok(sched.count[1] == 1, "evsched: event beyond the first level");
+	ok(next_event(&sched) == first && now_ms() - begin >= 300,
+	   "evsched: event cascaded and run on time");
+
+	// cascading from the higher levels
+	const uint32_t delays[] = { 20 * 1000, 2 * 3600 * 1000, UINT32_MAX };
+	for (unsigned i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+		evsched_schedule(first, delays[i]);
+		ok(sched.count[i + 2] == 1, "evsched: event at level %u", i + 2);
+		time_shift(&sched, delays[i] - 100);
+		evsched_schedule(second, 0);
+		ok(next_event(&sched) == second && wheel_count(&sched) == 1,
+		   "evsched: level %u event not run early", i + 2);
+		time_shift(&sched, 100);
+		ok(next_event(&sched) == first && wheel_count(&sched) == 0,
+		   "evsched: level %u event run on time", i + 2);
+	}
+
+	// far-future event not run
+	evsched_schedule(first, UINT32_MAX);
+	evsched_schedule(second, UINT32_MAX / 2);
+	time_shift(&sched, UINT32_MAX / 2);
+	ok(next_event(&sched) == second && wheel_count(&sched) == 1,
+	   "evsched: far-future event kept");
+
+	// scheduled events are freed with the scheduler
+	evsched_deinit(&sched);
+	evsched_event_free(second);
+
+	return 0;
+}
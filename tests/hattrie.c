@@ -176,7 +176,7 @@ int main(int argc, char *argv[])
 	passed = true;
 	for (unsigned i = 0; i < key_count - 1 && passed; ++i) {
 		value_t *val;
-		hattrie_find_next(trie, keys[i], strlen(keys[i]), &val);
+		hattrie_find_next(trie, keys[i], strlen(keys[i]) + 1, &val);
 		passed = val && *val == (void *)keys[(i + 1)];
 	}
 	ok(passed, "hattrie: find next for all keys");
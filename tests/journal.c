@@ -23,6 +23,7 @@
 #include <tap/basic.h>
 
 #include "knot/server/journal.h"
+#include "knot/updates/apply.h"
 #include "knot/zone/zone-diff.h"
 
 #define RAND_RR_LABEL 16
@@ -261,6 +262,118 @@ static void test_store_load(const char *jfilename)
 	ok(ret == KNOT_EOK, "journal: load changesets after flush");
 }
 
+/*! \brief Test that changes are written to journal only if applied. */
+static void test_apply_commit(const char *jfilename)
+{
+	const size_t filesize = 100 * 1024;
+	uint8_t *apex = (uint8_t *)"\4test";
+
+	/* Create adjusted zone with SOA. */
+	conf_zone_t zconf;
+	conf_init_zone(&zconf);
+	zconf.ixfr_db = (char *)jfilename;
+	zconf.ixfr_fslimit = filesize;
+	zone_t z = { .name = apex, .conf = &zconf };
+	pthread_mutex_init(&z.journal_lock, NULL);
+
+	z.contents = zone_contents_new(apex);
+	knot_rrset_t soa;
+	init_soa(&soa, 0, apex);
+	zone_node_t *n = NULL;
+	int ret = zone_contents_add_rr(z.contents, &soa, &n);
+	assert(ret == KNOT_EOK);
+	knot_rrset_clear(&soa, NULL);
+	ret = zone_contents_adjust_full(z.contents, NULL, NULL);
+	assert(ret == KNOT_EOK);
+
+	/* Changeset adding records. */
+	changeset_t *ch = changeset_new(apex);
+	assert(ch);
+	init_soa(&soa, 0, apex);
+	ch->soa_from = knot_rrset_copy(&soa, NULL);
+	knot_rrset_clear(&soa, NULL);
+	init_soa(&soa, 1, apex);
+	ch->soa_to = knot_rrset_copy(&soa, NULL);
+	knot_rrset_clear(&soa, NULL);
+	for (int i = 0; i < 4; i++) {
+		knot_rrset_t rr;
+		init_random_rr(&rr, apex);
+		ret = changeset_add_rrset(ch, &rr);
+		assert(ret == KNOT_EOK);
+		knot_rrset_clear(&rr, NULL);
+	}
+	list_t chgs;
+	init_list(&chgs);
+	add_tail(&chgs, &ch->n);
+
+	/* Changeset with unsupported NSEC3PARAM, adjusting it fails. */
+	changeset_t *bad = changeset_new(apex);
+	assert(bad);
+	bad->soa_from = knot_rrset_copy(ch->soa_from, NULL);
+	bad->soa_to = knot_rrset_copy(ch->soa_to, NULL);
+	knot_rrset_t param;
+	knot_rrset_init(&param, knot_dname_copy(apex, NULL),
+	                KNOT_RRTYPE_NSEC3PARAM, KNOT_CLASS_IN);
+	const uint8_t param_data[] = { 2, 0, 0, 10, 0 };
+	ret = knot_rrset_add_rdata(&param, param_data, sizeof(param_data), 0, NULL);
+	assert(ret == KNOT_EOK);
+	ret = changeset_add_rrset(bad, &param);
+	assert(ret == KNOT_EOK);
+	knot_rrset_clear(&param, NULL);
+	list_t bad_chgs;
+	init_list(&bad_chgs);
+	add_tail(&bad_chgs, &bad->n);
+
+	/* Failed adjustment must not write the journal. */
+	apply_ctx_t ctx;
+	ret = apply_begin(&ctx, &z);
+	if (ret == KNOT_EOK) {
+		ret = apply_step(&ctx, bad);
+	}
+	ok(ret == KNOT_EOK, "journal: stage changes");
+
+	zone_contents_t *new_contents = NULL;
+	bool applied = true;
+	ret = apply_commit(&ctx, &z, &bad_chgs, &new_contents, &applied);
+	ok(ret != KNOT_EOK && !applied && new_contents == NULL,
+	   "journal: commit of failed adjustment");
+	updates_rollback(&bad_chgs);
+	apply_abort(&ctx);
+	changesets_free(&bad_chgs);
+
+	list_t l;
+	init_list(&l);
+	ret = journal_load_changesets(&z, &l, 0, 1);
+	changesets_free(&l);
+	ok(ret != KNOT_EOK, "journal: no changes stored after failed adjustment");
+
+	/* Successful adjustment writes the journal. */
+	ret = apply_begin(&ctx, &z);
+	if (ret == KNOT_EOK) {
+		ret = apply_step(&ctx, ch);
+	}
+	if (ret == KNOT_EOK) {
+		ret = apply_commit(&ctx, &z, &chgs, &new_contents, &applied);
+	}
+	ok(ret == KNOT_EOK && applied && new_contents != NULL,
+	   "journal: commit of applied changes");
+
+	init_list(&l);
+	ret = journal_load_changesets(&z, &l, 0, 1);
+	ok(ret == KNOT_EOK && !EMPTY_LIST(l) && changesets_eq(TAIL(l), ch),
+	   "journal: changes stored after apply");
+	changesets_free(&l);
+
+	if (new_contents != NULL) {
+		update_free_zone(&z.contents);
+		updates_cleanup(&chgs);
+		z.contents = new_contents;
+	}
+	changesets_free(&chgs);
+	zone_contents_deep_free(&z.contents);
+	pthread_mutex_destroy(&z.journal_lock);
+}
+
 /*! \brief Test behavior when writing to jurnal and flushing it. */
 static void test_stress(const char *jfilename)
 {
@@ -391,6 +504,9 @@ int main(int argc, char *argv[])
 	test_stress(jfilename);
 	remove(jfilename);
 
+	test_apply_commit(jfilename);
+	remove(jfilename);
+
 	free(tmpdir);
 
 skip_all:
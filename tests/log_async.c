@@ -0,0 +1,124 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <urcu.h>
+#include <tap/basic.h>
+
+#include "knot/common/log.h"
+#include "libknot/errcode.h"
+
+/*! \brief Number of logging threads, each overflows its own ring. */
+#define THREADS 4
+/*! \brief Messages logged by each thread. */
+#define MESSAGES 20000
+
+static void *logger_thread(void *data)
+{
+	rcu_register_thread();
+
+	for (int i = 0; i < MESSAGES; i++) {
+		log_info("message %d", i);
+	}
+
+	rcu_unregister_thread();
+
+	return NULL;
+}
+
+/*! \brief Log into the file only. */
+static int log_to_file(const char *path)
+{
+	conf_log_map_t map = { .source = LOG_ANY, .prios = LOG_UPTO(LOG_INFO) };
+	conf_log_t file = { .type = LOGT_FILE, .file = (char *)path };
+	init_list(&file.map);
+	add_tail(&file.map, &map.n);
+
+	list_t logs;
+	init_list(&logs);
+	add_tail(&logs, &file.n);
+
+	return log_reconfigure(&logs, NULL);
+}
+
+/*! \brief Count logged messages and warnings about dropped messages. */
+static void count_lines(const char *path, unsigned *messages, unsigned *warnings)
+{
+	*messages = *warnings = 0;
+
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		return;
+	}
+
+	char line[1024];
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (strstr(line, "info: message ") != NULL) {
+			*messages += 1;
+		} else if (strstr(line, "messages dropped") != NULL) {
+			*warnings += 1;
+		}
+	}
+	fclose(f);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	rcu_register_thread();
+
+	char *tmpdir = test_tmpdir();
+	char path[512];
+	snprintf(path, sizeof(path), "%s/log_async.log", tmpdir);
+
+	log_init();
+	int ret = log_to_file(path);
+	ok(ret == KNOT_EOK, "log: open file");
+
+	ret = log_async_start();
+	ok(ret == KNOT_EOK, "log: start writer");
+
+	pthread_t threads[THREADS];
+	for (int i = 0; i < THREADS; i++) {
+		pthread_create(&threads[i], NULL, logger_thread, NULL);
+	}
+	for (int i = 0; i < THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	log_async_stop();
+	uint64_t dropped = log_async_dropped();
+	ok(dropped > 0, "log: full rings drop messages");
+
+	log_close();
+
+	unsigned messages = 0, warnings = 0;
+	count_lines(path, &messages, &warnings);
+	ok(messages + dropped == THREADS * MESSAGES,
+	   "log: written and dropped messages match");
+	ok(warnings > 0, "log: dropped messages reported");
+
+	unlink(path);
+	test_tmpdir_free(tmpdir);
+
+	rcu_unregister_thread();
+
+	return 0;
+}
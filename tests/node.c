@@ -19,6 +19,9 @@
 
 #include "knot/zone/node.h"
 #include "libknot/errcode.h"
+#include "zone_fixture.h"
+
+#define FIXTURE_A2 "\x7f\x00\x00\x02", 4
 
 static knot_rrset_t *create_dummy_rrset(const knot_dname_t *owner,
                                         uint16_t type)
@@ -48,7 +51,7 @@ static knot_rrset_t *create_dummy_rrsig(const knot_dname_t *owner,
 
 int main(int argc, char *argv[])
 {
-	plan(23);
+	plan(28);
 	
 	knot_dname_t *dummy_owner = knot_dname_from_str_alloc("test.");
 	// Test new
@@ -136,10 +139,37 @@ int main(int argc, char *argv[])
 	knot_rrset_free(&dummy_rrset, NULL);
 	
 	
+	// Test fingerprints
+	uint64_t hash = node_hash(node);
+	ok(hash != 0 && node->hash == hash && node->rrs[0].hash != 0 &&
+	   node->rrs[1].hash != 0, "Node: fingerprint computed.");
+
+	dummy_rrset = create_dummy_rrset(dummy_owner, KNOT_RRTYPE_TXT);
+	knot_rdata_data(knot_rdataset_at(&dummy_rrset->rrs, 0))[0] = 'T';
+	ret = node_add_rrset(node, dummy_rrset, NULL);
+	knot_rrset_free(&dummy_rrset, NULL);
+	const struct rr_data *txt_data = node->rrs[0].type == KNOT_RRTYPE_TXT ?
+	                                 &node->rrs[0] : &node->rrs[1];
+	ok(ret == KNOT_EOK && node->hash == 0 && txt_data->hash == 0 &&
+	   node_hash(node) != hash, "Node: fingerprint invalidated by merged RRSet.");
+	hash = node_hash(node);
+
+	dummy_rrset = create_dummy_rrset(dummy_owner, KNOT_RRTYPE_AAAA);
+	ret = node_add_rrset(node, dummy_rrset, NULL);
+	knot_rrset_free(&dummy_rrset, NULL);
+	ok(ret == KNOT_EOK && node->hash == 0 && node_hash(node) != hash,
+	   "Node: fingerprint invalidated by added RRSet.");
+
+	void *to_free = node_rdataset(node, KNOT_RRTYPE_AAAA)->data;
+	node_remove_rdataset(node, KNOT_RRTYPE_AAAA);
+	free(to_free);
+	ok(node->hash == 0 && node_hash(node) == hash,
+	   "Node: fingerprint invalidated by removed RRSet.");
+
 	// Test remove RRset
 	node_remove_rdataset(node, KNOT_RRTYPE_AAAA);
 	ok(node->rrset_count == 2, "Node: remove non-existent rdataset.");
-	void *to_free = node_rdataset(node, KNOT_RRTYPE_TXT)->data;
+	to_free = node_rdataset(node, KNOT_RRTYPE_TXT)->data;
 	node_remove_rdataset(node, KNOT_RRTYPE_TXT);
 	ok(node->rrset_count == 1, "Node: remove existing rdataset.");
 	
@@ -154,5 +184,37 @@ int main(int argc, char *argv[])
 	
 	knot_dname_free(&dummy_owner, NULL);
 
+	// Test fingerprint invalidation by changes applied to zone
+	zone_contents_t *zone = fixture_zone("example.com", false);
+	knot_rrset_t *www = fixture_rrset("www.example.com", KNOT_RRTYPE_A,
+	                                  FIXTURE_A);
+	ret = (zone && www) ? zone_contents_add_rr(zone, www, &node) : KNOT_ENOMEM;
+	if (ret == KNOT_EOK) {
+		ret = fixture_add_rr(zone, "www.example.com", KNOT_RRTYPE_A,
+		                     FIXTURE_A2);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_full(zone, NULL, NULL);
+	}
+	hash = node_hash(node);
+
+	changeset_t ch;
+	changeset_init(&ch, zone->apex->owner);
+	fixture_change_rr(&ch, false, "www.example.com", KNOT_RRTYPE_A, FIXTURE_A2);
+	if (ret == KNOT_EOK) {
+		ret = fixture_keep_soa(&ch, zone);
+	}
+	if (ret == KNOT_EOK) {
+		ret = apply_changeset_directly(zone, &ch);
+	}
+	ok(ret == KNOT_EOK && node->hash == 0 && node->rrs[0].hash == 0 &&
+	   node->rrs[0].rrs.rr_count == 1 && node_hash(node) != hash,
+	   "Node: fingerprint invalidated by applied changes.");
+	update_cleanup(&ch);
+	changeset_clear(&ch);
+
+	knot_rrset_free(&www, NULL);
+	zone_contents_deep_free(&zone);
+
 	return 0;
 }
@@ -0,0 +1,165 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <tap/basic.h>
+
+#include "knot/zone/nsec3-cache.h"
+#include "zone_fixture.h"
+
+static zone_contents_t *create_zone(bool nsec3)
+{
+	zone_contents_t *zone = fixture_zone("example.com", nsec3);
+	if (zone == NULL) {
+		return NULL;
+	}
+
+	if (fixture_add_rr(zone, "a.example.com", KNOT_RRTYPE_A, FIXTURE_A) != KNOT_EOK ||
+	    fixture_add_rr(zone, "b.example.com", KNOT_RRTYPE_A, FIXTURE_A) != KNOT_EOK) {
+		zone_contents_deep_free(&zone);
+	}
+
+	return zone;
+}
+
+static void test_cache(void)
+{
+	nsec3_cache_t *cache = nsec3_cache_new(NSEC3_CACHE_MAX_SIZE);
+	ok(cache != NULL, "cache: create");
+
+	knot_dname_t *name = knot_dname_from_str_alloc("a.example.com");
+	nsec3_cache_result_t result = { 0 };
+
+	ok(!nsec3_cache_get(cache, name, &result), "cache: miss");
+
+	zone_node_t *node = node_new(name, NULL);
+	nsec3_cache_result_t stored = {
+		.node = node, .previous = NULL, .match = ZONE_NAME_FOUND
+	};
+	nsec3_cache_put(cache, name, &stored);
+	ok(nsec3_cache_get(cache, name, &result) && result.node == node &&
+	   result.match == ZONE_NAME_FOUND, "cache: hit");
+
+	uint64_t hits = 0, misses = 0;
+	nsec3_cache_stats(cache, &hits, &misses);
+	ok(hits == 1 && misses == 1, "cache: counters");
+
+	nsec3_cache_flush(cache);
+	ok(!nsec3_cache_get(cache, name, &result), "cache: miss after flush");
+
+	node_free(&node, NULL);
+	knot_dname_free(&name, NULL);
+	nsec3_cache_free(cache);
+
+	// bounded size
+	const size_t max_names = 32;
+	const int count = 1000;
+	cache = nsec3_cache_new(max_names);
+	char str[32];
+	for (int i = 0; i < count; i++) {
+		snprintf(str, sizeof(str), "%d.example.com", i);
+		name = knot_dname_from_str_alloc(str);
+		nsec3_cache_put(cache, name, &stored);
+		knot_dname_free(&name, NULL);
+	}
+	size_t cached = 0;
+	for (int i = 0; i < count; i++) {
+		snprintf(str, sizeof(str), "%d.example.com", i);
+		name = knot_dname_from_str_alloc(str);
+		cached += nsec3_cache_get(cache, name, &result) ? 1 : 0;
+		knot_dname_free(&name, NULL);
+	}
+	ok(cached > 0 && cached <= max_names, "cache: bounded size");
+	nsec3_cache_free(cache);
+}
+
+static void test_contents(void)
+{
+	// no cache without NSEC3PARAM
+	zone_contents_t *zone = create_zone(false);
+	ok(zone != NULL && zone->nsec3_cache == NULL,
+	   "contents: no cache for new contents");
+	int ret = zone ? zone_contents_adjust_full(zone, NULL, NULL) : KNOT_ENOMEM;
+	ok(ret == KNOT_EOK && zone->nsec3_cache == NULL,
+	   "contents: no cache without NSEC3PARAM");
+	zone_contents_deep_free(&zone);
+
+	// cache created with NSEC3PARAM
+	zone = create_zone(true);
+	ret = zone ? zone_contents_adjust_full(zone, NULL, NULL) : KNOT_ENOMEM;
+	ok(ret == KNOT_EOK && zone->nsec3_cache != NULL,
+	   "contents: cache with NSEC3PARAM");
+	if (ret != KNOT_EOK) {
+		skip_block(5, "no zone");
+		zone_contents_deep_free(&zone);
+		return;
+	}
+
+	ret = fixture_nsec3_chain(zone);
+	ok(ret == KNOT_EOK, "contents: NSEC3 chain");
+
+	// repeated wildcard lookup is a hit
+	knot_dname_t *name = knot_dname_from_str_alloc("*.example.com");
+	const zone_node_t *node = NULL, *prev = NULL;
+	const zone_node_t *cached_node = NULL, *cached_prev = NULL;
+	int match = zone_contents_find_nsec3_for_name(zone, name, &node, &prev);
+	int cached_match = zone_contents_find_nsec3_for_name(zone, name,
+	                                                     &cached_node,
+	                                                     &cached_prev);
+	uint64_t hits = 0, misses = 0;
+	nsec3_cache_stats(zone->nsec3_cache, &hits, &misses);
+	ok(match == ZONE_NAME_NOT_FOUND && cached_match == match &&
+	   cached_node == node && cached_prev == prev && hits == 1 && misses == 1,
+	   "contents: repeated lookup from cache");
+
+	// adjusting again invalidates the results
+	ret = zone_contents_adjust_full(zone, NULL, NULL);
+	zone_contents_find_nsec3_for_name(zone, name, &node, &prev);
+	nsec3_cache_stats(zone->nsec3_cache, &hits, &misses);
+	ok(ret == KNOT_EOK && hits == 1 && misses == 2,
+	   "contents: lookup after adjusting not cached");
+
+	// flood of random next closer names bypasses the cache
+	char str[32];
+	for (int i = 0; i < 1000; i++) {
+		snprintf(str, sizeof(str), "r%d.example.com", i);
+		knot_dname_t *random = knot_dname_from_str_alloc(str);
+		zone_contents_find_nsec3_for_name(zone, random, &node, &prev);
+		knot_dname_free(&random, NULL);
+	}
+	uint64_t flood_hits = 0, flood_misses = 0;
+	nsec3_cache_stats(zone->nsec3_cache, &flood_hits, &flood_misses);
+	ok(flood_hits == hits && flood_misses == misses,
+	   "contents: random names not cached");
+
+	zone_contents_find_nsec3_for_name(zone, name, &node, &prev);
+	nsec3_cache_stats(zone->nsec3_cache, &hits, &misses);
+	ok(hits == flood_hits + 1 && misses == flood_misses,
+	   "contents: wildcard kept after flood");
+
+	knot_dname_free(&name, NULL);
+	zone_contents_deep_free(&zone);
+}
+
+int main(int argc, char *argv[])
+{
+	plan(6 + 8);
+
+	test_cache();
+	test_contents();
+
+	return 0;
+}
@@ -17,6 +17,7 @@
 #include <tap/basic.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "libknot/internal/mempool.h"
 #include "libknot/processing/layer.h"
@@ -58,11 +59,42 @@ static void* responder_thread(void *arg)
 	return NULL;
 }
 
+/*! \brief Responder keeping connections open, counts accepted connections. */
+struct persistent_responder {
+	int fd;
+	int accepted;
+};
+
+static void* persistent_responder_thread(void *arg)
+{
+	struct persistent_responder *responder = arg;
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+	while(true) {
+		int client = accept(responder->fd, NULL, NULL);
+		if (client < 0) {
+			break;
+		}
+		responder->accepted += 1;
+		int len = 0;
+		while ((len = tcp_recv_msg(client, buf, sizeof(buf), NULL)) >=
+		       KNOT_WIRE_HEADER_SIZE) {
+			knot_wire_set_qr(buf);
+			tcp_send_msg(client, buf, len);
+		}
+		close(client);
+	}
+	return NULL;
+}
+
 /* Test implementations. */
 
 #define DISCONNECTED_TESTS 2
 #define CONNECTED_TESTS    4
-#define TESTS_COUNT DISCONNECTED_TESTS + CONNECTED_TESTS
+#define POOL_TESTS         6
+#define POOL_REUSE_TESTS   3
+#define EXEC_ALL_TESTS     3
+#define TESTS_COUNT DISCONNECTED_TESTS + CONNECTED_TESTS + POOL_TESTS + \
+                    POOL_REUSE_TESTS + EXEC_ALL_TESTS
 
 static struct knot_request *make_query(struct knot_requestor *requestor,  conf_iface_t *remote)
 {
@@ -114,6 +146,160 @@ static void test_connected(struct knot_requestor *requestor, conf_iface_t *remot
 	is_int(KNOT_EOK, ret, "requestor: multiple wait");
 }
 
+/*! \brief Listening socket bound to a random local port. */
+static int listen_random(struct sockaddr_storage *addr)
+{
+	sockaddr_set(addr, AF_INET, "127.0.0.1", 0);
+	int fd = net_bound_socket(SOCK_STREAM, addr);
+	assert(fd > 0);
+	socklen_t addr_len = sockaddr_len((struct sockaddr *)addr);
+	getsockname(fd, (struct sockaddr *)addr, &addr_len);
+	int ret = listen(fd, 10);
+	assert(ret == 0);
+
+	return fd;
+}
+
+static void test_pool(void)
+{
+	struct sockaddr_storage remote, other, origin;
+	sockaddr_set(&remote, AF_INET, "127.0.0.1", 53);
+	sockaddr_set(&other, AF_INET, "127.0.0.2", 53);
+	sockaddr_set(&origin, AF_INET, "127.0.0.1", 0);
+
+	struct knot_conn_pool *pool = knot_conn_pool_new(2, 1);
+	ok(pool != NULL, "connpool: create");
+
+	int pair[2];
+	int ret = socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+	assert(ret == 0);
+
+	/* Reuse connection to the same remote only. */
+	knot_conn_pool_put(pool, &remote, &origin, pair[0]);
+	ok(knot_conn_pool_get(pool, &other, &origin) == -1,
+	   "connpool: no connection to other remote");
+	int fd = knot_conn_pool_get(pool, &remote, &origin);
+	ok(fd == pair[0] && knot_conn_pool_get(pool, &remote, &origin) == -1,
+	   "connpool: reuse idle connection once");
+
+	/* Connection closed by peer. */
+	knot_conn_pool_put(pool, &remote, &origin, pair[0]);
+	close(pair[1]);
+	ok(knot_conn_pool_get(pool, &remote, &origin) == -1,
+	   "connpool: drop connection closed by peer");
+
+	/* Idle expiry. */
+	ret = socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+	assert(ret == 0);
+	knot_conn_pool_put(pool, &remote, &origin, pair[0]);
+	sleep(1);
+	ok(knot_conn_pool_get(pool, &remote, &origin) == -1,
+	   "connpool: drop idle connection");
+	close(pair[1]);
+
+	/* Capacity. */
+	int pairs[3][2];
+	for (int i = 0; i < 3; i++) {
+		ret = socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]);
+		assert(ret == 0);
+		knot_conn_pool_put(pool, &remote, &origin, pairs[i][0]);
+	}
+	int kept = 0;
+	while ((fd = knot_conn_pool_get(pool, &remote, &origin)) != -1) {
+		kept += 1;
+		close(fd);
+	}
+	ok(kept == 2, "connpool: keep at most capacity connections");
+	for (int i = 0; i < 3; i++) {
+		close(pairs[i][1]);
+	}
+
+	knot_conn_pool_free(pool);
+}
+
+static void test_pool_reuse(struct knot_requestor *requestor)
+{
+	struct persistent_responder responder = { 0 };
+	conf_iface_t remote;
+	memset(&remote, 0, sizeof(conf_iface_t));
+	responder.fd = listen_random(&remote.addr);
+	sockaddr_set(&remote.via, AF_INET, "127.0.0.1", 0);
+
+	pthread_t thread;
+	pthread_create(&thread, 0, persistent_responder_thread, &responder);
+
+	requestor->pool = knot_conn_pool_new(4, 60);
+
+	int ret = KNOT_EOK;
+	for (unsigned i = 0; i < 3; ++i) {
+		ret |= knot_requestor_enqueue(requestor, make_query(requestor, &remote));
+		struct timeval tv = { 5, 0 };
+		ret |= knot_requestor_exec(requestor, &tv);
+	}
+	is_int(KNOT_EOK, ret, "requestor: queries over pooled connection");
+	is_int(1, responder.accepted, "requestor: pooled connection reused");
+
+	/* Connection is back in the pool after the last query. */
+	int fd = knot_conn_pool_get(requestor->pool, &remote.addr, &remote.via);
+	ok(fd >= 0 && knot_conn_pool_get(requestor->pool, &remote.addr,
+	                                 &remote.via) == -1,
+	   "requestor: one idle connection after queries");
+	close(fd);
+
+	knot_conn_pool_free(requestor->pool);
+	requestor->pool = NULL;
+
+	shutdown(responder.fd, SHUT_RDWR);
+	(void) pthread_join(thread, 0);
+	close(responder.fd);
+}
+
+static void test_exec_all(struct knot_requestor *requestor, conf_iface_t *remote)
+{
+	/* Enqueue queries with own processing. */
+	int ret = KNOT_EOK;
+	for (unsigned i = 0; i < 3; ++i) {
+		struct knot_request *req = make_query(requestor, remote);
+		ret |= knot_request_overlay(req, &dummy_module, NULL);
+		ret |= knot_requestor_enqueue(requestor, req);
+	}
+
+	struct timeval tv = { 5, 0 };
+	ret |= knot_requestor_exec_all(requestor, &tv);
+	bool all_ok = true;
+	while (!knot_requestor_finished(requestor)) {
+		struct knot_request *req = HEAD(requestor->pending);
+		all_ok = all_ok && req->ret == KNOT_EOK;
+		knot_requestor_dequeue(requestor);
+	}
+	ok(ret == KNOT_EOK && all_ok, "requestor: exec all");
+
+	/* Remote accepting connections, but never answering. */
+	conf_iface_t silent;
+	memset(&silent, 0, sizeof(conf_iface_t));
+	int silent_fd = listen_random(&silent.addr);
+	sockaddr_set(&silent.via, AF_INET, "127.0.0.1", 0);
+
+	struct knot_request *req = make_query(requestor, &silent);
+	ret = knot_request_overlay(req, &dummy_module, NULL);
+	ret |= knot_requestor_enqueue(requestor, req);
+	struct timeval short_tv = { 0, 200 * 1000 };
+	ret |= knot_requestor_exec_all(requestor, &short_tv);
+	ok(ret == KNOT_EOK && req->ret == KNOT_ETIMEOUT,
+	   "requestor: exec all timeout");
+	knot_requestor_dequeue(requestor);
+
+	/* Requests without own processing are refused. */
+	req = make_query(requestor, &silent);
+	knot_requestor_enqueue(requestor, req);
+	ret = knot_requestor_exec_all(requestor, &tv);
+	ok(ret == KNOT_EOK && req->ret == KNOT_EINVAL,
+	   "requestor: exec all without own processing");
+	knot_requestor_dequeue(requestor);
+
+	close(silent_fd);
+}
+
 int main(int argc, char *argv[])
 {
 	plan(TESTS_COUNT + 1);
@@ -154,6 +340,13 @@ int main(int argc, char *argv[])
 	/* Test requestor in connected environment. */
 	test_connected(&requestor, &remote);
 
+	/* Test concurrent requests. */
+	test_exec_all(&requestor, &remote);
+
+	/* Test connection pool. */
+	test_pool();
+	test_pool_reuse(&requestor);
+
 	/*! \todo #243 TSIG secured requests test should be implemented. */
 
 	/* Terminate responder. */
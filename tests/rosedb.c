@@ -0,0 +1,701 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <tap/basic.h>
+
+/* The tool including the module, its main() is not used. */
+#define main rosedb_tool_main
+#include "knot/modules/rosedb_tool.c"
+#undef main
+
+/*! \brief Number of names in the generated input. */
+#define NAMES 200
+
+/*! \brief Thread counts used for bulk import. */
+static const char *THREADS[] = { "1", "3", "8" };
+#define THREADS_COUNT (sizeof(THREADS) / sizeof(*THREADS))
+
+/*! \brief Number of A records of the name, more names share a key. */
+#define NAME_A_COUNT(i) (1 + (i) % 3)
+#define NAME_HAS_TXT(i) ((i) % 5 == 0)
+
+/*! \brief Labels and depth of generated names for the closest name search. */
+static const char *LABELS[] = { "a", "b", "c" };
+#define LABELS_COUNT (sizeof(LABELS) / sizeof(*LABELS))
+#define MAX_DEPTH 4
+
+static void name_str(char *buf, size_t size, unsigned i)
+{
+	snprintf(buf, size, "h%u.z%u.example.", i, i % 7);
+}
+
+/*!
+ * \brief Write import file with all records of the names.
+ *
+ * Records are shuffled, some lines are repeated, some with the owner in upper
+ * case, so that duplicates end up in parts parsed by different threads.
+ */
+static size_t write_input(const char *path)
+{
+	char *lines[4 * NAMES];
+	size_t count = 0, distinct = 0;
+	char owner[64];
+	for (unsigned i = 0; i < NAMES; i++) {
+		name_str(owner, sizeof(owner), i);
+		for (unsigned j = 0; j < NAME_A_COUNT(i); j++) {
+			lines[count++] = sprintf_alloc("add\t%s\tA\t3600\t192.0.2.%u\t"
+			                               "malware\t192.0.2.1\n", owner, j + 1);
+		}
+		if (NAME_HAS_TXT(i)) {
+			lines[count++] = sprintf_alloc("add\t%s\tTXT\t7200\tt%u\t"
+			                               "phishing\t192.0.2.2\n", owner, i);
+		}
+	}
+	distinct = count;
+
+	/* Deterministic shuffle. */
+	unsigned seed = 1;
+	for (size_t i = count - 1; i > 0; i--) {
+		seed = seed * 1103515245 + 12345;
+		size_t j = (seed >> 8) % (i + 1);
+		char *tmp = lines[i];
+		lines[i] = lines[j];
+		lines[j] = tmp;
+	}
+
+	FILE *fp = fopen(path, "w");
+	if (fp == NULL) {
+		return 0;
+	}
+	for (size_t i = 0; i < count; i++) {
+		fputs(lines[i], fp);
+		if (i % 4 == 0) {
+			fputs(lines[i], fp);
+		}
+		if (i % 9 == 0) {
+			char *upper = strdup(lines[i]);
+			upper[4] = 'H';
+			fputs(upper, fp);
+			free(upper);
+		}
+	}
+	fputs(lines[0], fp);
+	fclose(fp);
+
+	for (size_t i = 0; i < count; i++) {
+		free(lines[i]);
+	}
+
+	return distinct;
+}
+
+/*! \brief Redirect standard output to the file, return the saved one. */
+static int stdout_to(const char *path)
+{
+	fflush(stdout);
+	int saved = dup(STDOUT_FILENO);
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	dup2(fd, STDOUT_FILENO);
+	close(fd);
+	return saved;
+}
+
+static void stdout_restore(int saved)
+{
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+}
+
+static char *read_file(const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL) {
+		return NULL;
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	char *data = malloc(size + 1);
+	if (data != NULL) {
+		data[fread(data, 1, size, fp)] = '\0';
+	}
+	fclose(fp);
+
+	return data;
+}
+
+static struct cache *open_db(const char *tmpdir, const char *name)
+{
+	char *dir = sprintf_alloc("%s/%s", tmpdir, name);
+	mkdir(dir, 0755);
+	struct cache *cache = cache_open(dir, 0, 0, NULL);
+	free(dir);
+
+	return cache;
+}
+
+static void remove_db(const char *tmpdir, const char *name)
+{
+	const char *files[] = { "data.mdb", "lock.mdb" };
+	for (int i = 0; i < 2; i++) {
+		char *file = sprintf_alloc("%s/%s/%s", tmpdir, name, files[i]);
+		remove(file);
+		free(file);
+	}
+	char *dir = sprintf_alloc("%s/%s", tmpdir, name);
+	rmdir(dir);
+	free(dir);
+}
+
+/*! \brief Run a tool action in its own transaction, output into the file. */
+static int run_action(struct cache *cache,
+                      int (*func)(struct cache *, MDB_txn *, int, char *[]),
+                      char *arg, const char *output)
+{
+	MDB_txn *txn = NULL;
+	int ret = mdb_txn_begin(cache->env, NULL, 0, &txn);
+	if (ret != MDB_SUCCESS) {
+		return ret;
+	}
+
+	char *argv[] = { arg };
+	int saved = stdout_to(output);
+	ret = func(cache, txn, arg != NULL ? 1 : 0, argv);
+	stdout_restore(saved);
+
+	if (ret == KNOT_EOK) {
+		return mdb_txn_commit(txn);
+	}
+	mdb_txn_abort(txn);
+	return ret;
+}
+
+static int bulk(struct cache *cache, char *file, const char *threads)
+{
+	char *argv[] = { file, (char *)threads };
+	int saved = stdout_to("/dev/null");
+	int ret = rosedb_bulk(cache, NULL, 2, argv);
+	stdout_restore(saved);
+
+	return ret;
+}
+
+/*! \brief Output of 'list' action. */
+static char *list_output(struct cache *cache, const char *tmpfile)
+{
+	if (run_action(cache, rosedb_list, NULL, tmpfile) != KNOT_EOK) {
+		return NULL;
+	}
+	return read_file(tmpfile);
+}
+
+/*! \brief Output of 'get' action for all names. */
+static char *lookup_output(struct cache *cache, const char *tmpfile)
+{
+	MDB_txn *txn = NULL;
+	if (mdb_txn_begin(cache->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS) {
+		return NULL;
+	}
+
+	int saved = stdout_to(tmpfile);
+	char owner[64];
+	for (unsigned i = 0; i < NAMES; i++) {
+		name_str(owner, sizeof(owner), i);
+		char *argv[] = { owner };
+		rosedb_get(cache, txn, 1, argv);
+	}
+	stdout_restore(saved);
+	mdb_txn_abort(txn);
+
+	return read_file(tmpfile);
+}
+
+/*! \brief Count all records and compare them with the other database. */
+static bool same_records(struct cache *a, struct cache *b, size_t *count)
+{
+	MDB_txn *txn_a = NULL, *txn_b = NULL;
+	mdb_txn_begin(a->env, NULL, MDB_RDONLY, &txn_a);
+	mdb_txn_begin(b->env, NULL, MDB_RDONLY, &txn_b);
+	MDB_cursor *cur_a = cursor_acquire(txn_a, a->dbi);
+	MDB_cursor *cur_b = cursor_acquire(txn_b, b->dbi);
+
+	MDB_val key_a, val_a, key_b, val_b;
+	int ret_a = mdb_cursor_get(cur_a, &key_a, &val_a, MDB_FIRST);
+	int ret_b = mdb_cursor_get(cur_b, &key_b, &val_b, MDB_FIRST);
+	bool same = true;
+	*count = 0;
+	while (same && ret_a == 0 && ret_b == 0) {
+		same = key_a.mv_size == key_b.mv_size && val_a.mv_size == val_b.mv_size &&
+		       memcmp(key_a.mv_data, key_b.mv_data, key_a.mv_size) == 0 &&
+		       memcmp(val_a.mv_data, val_b.mv_data, val_a.mv_size) == 0;
+		*count += 1;
+		ret_a = mdb_cursor_get(cur_a, &key_a, &val_a, MDB_NEXT);
+		ret_b = mdb_cursor_get(cur_b, &key_b, &val_b, MDB_NEXT);
+	}
+
+	cursor_release(cur_a);
+	cursor_release(cur_b);
+	mdb_txn_abort(txn_a);
+	mdb_txn_abort(txn_b);
+
+	return same && ret_a == MDB_NOTFOUND && ret_b == MDB_NOTFOUND;
+}
+
+/*! \brief Number of entries found for the name. */
+static unsigned name_entries(struct cache *cache, unsigned i)
+{
+	char owner[64];
+	name_str(owner, sizeof(owner), i);
+	knot_dname_t *name = knot_dname_from_str_alloc(owner);
+
+	MDB_txn *txn = NULL;
+	mdb_txn_begin(cache->env, NULL, MDB_RDONLY, &txn);
+	struct iter it;
+	unsigned count = 0;
+	if (cache_query_fetch(txn, cache->dbi, &it, name) == 0) {
+		do {
+			count += 1;
+		} while (cache_iter_next(&it) == 0);
+		cache_iter_free(&it);
+	}
+	mdb_txn_abort(txn);
+	knot_dname_free(&name, NULL);
+
+	return count;
+}
+
+static void test_bulk(const char *tmpdir, char *input, size_t distinct)
+{
+	char *tmpfile = sprintf_alloc("%s/output", tmpdir);
+
+	/* Reference database imported line by line. */
+	struct cache *ref = open_db(tmpdir, "import");
+	int ret = ref ? run_action(ref, rosedb_import, input, "/dev/null") : KNOT_ERROR;
+	ok(ret == KNOT_EOK, "rosedb: import");
+	if (ret != KNOT_EOK) {
+		skip_block(3 + 4 * THREADS_COUNT, "no reference database");
+		cache_close(ref);
+		free(tmpfile);
+		return;
+	}
+	char *ref_list = list_output(ref, tmpfile);
+	char *ref_lookup = lookup_output(ref, tmpfile);
+
+	size_t count = 0;
+	bool same = same_records(ref, ref, &count);
+	ok(same && count == distinct,
+	   "rosedb: import, %zu records, duplicates stored once", count);
+	ok(name_entries(ref, 0) == NAME_A_COUNT(0) + 1 &&
+	   name_entries(ref, 2) == NAME_A_COUNT(2),
+	   "rosedb: import, records sharing names");
+
+	for (int i = 0; i < THREADS_COUNT; i++) {
+		char *name = sprintf_alloc("bulk%s", THREADS[i]);
+		struct cache *db = open_db(tmpdir, name);
+		ret = db ? bulk(db, input, THREADS[i]) : KNOT_ERROR;
+		ok(ret == KNOT_EOK, "rosedb: bulk, %s threads", THREADS[i]);
+
+		char *db_list = (ret == KNOT_EOK) ? list_output(db, tmpfile) : NULL;
+		char *db_lookup = (ret == KNOT_EOK) ? lookup_output(db, tmpfile) : NULL;
+		ok(db_list && ref_list && strcmp(db_list, ref_list) == 0,
+		   "rosedb: bulk, %s threads, list same as import", THREADS[i]);
+		ok(db_lookup && ref_lookup && strcmp(db_lookup, ref_lookup) == 0,
+		   "rosedb: bulk, %s threads, lookup same as import", THREADS[i]);
+		ok(ret == KNOT_EOK && same_records(db, ref, &count),
+		   "rosedb: bulk, %s threads, records same as import", THREADS[i]);
+
+		free(db_list);
+		free(db_lookup);
+		cache_close(db);
+		remove_db(tmpdir, name);
+		free(name);
+	}
+
+	/* Bulk into non-empty database doesn't append, keeps the records. */
+	ret = bulk(ref, input, "2");
+	char *again = (ret == KNOT_EOK) ? list_output(ref, tmpfile) : NULL;
+	ok(ret == KNOT_EOK && again && strcmp(again, ref_list) == 0 &&
+	   same_records(ref, ref, &count) && count == distinct,
+	   "rosedb: bulk into non-empty database");
+
+	free(again);
+	free(ref_list);
+	free(ref_lookup);
+	cache_close(ref);
+	remove_db(tmpdir, "import");
+	remove(tmpfile);
+	free(tmpfile);
+}
+
+/*! \brief Insert an entry for the name. */
+static int insert_name(struct cache *cache, const char *owner)
+{
+	knot_dname_t *name = knot_dname_from_str_alloc(owner);
+	struct entry entry;
+	memset(&entry, 0, sizeof(entry));
+	entry.data.type = KNOT_RRTYPE_A;
+	entry.threat_code = "test";
+	entry.syslog_ip = "192.0.2.1";
+
+	MDB_txn *txn = NULL;
+	int ret = mdb_txn_begin(cache->env, NULL, 0, &txn);
+	if (ret == 0) {
+		ret = cache_insert(txn, cache->dbi, name, &entry);
+		if (ret == 0) {
+			ret = mdb_txn_commit(txn);
+		} else {
+			mdb_txn_abort(txn);
+		}
+	}
+	knot_dname_free(&name, NULL);
+
+	return ret;
+}
+
+/*! \brief Found key of the closest name, empty if not found. */
+struct closest {
+	bool found;
+	uint8_t key[KNOT_DNAME_MAXLEN];
+	size_t key_len;
+};
+
+static void closest_set(struct closest *res, int ret, const struct iter *it)
+{
+	res->found = (ret == 0);
+	res->key_len = res->found ? it->key.mv_size : 0;
+	if (res->found) {
+		memcpy(res->key, it->key.mv_data, res->key_len);
+	}
+}
+
+/*! \brief Closest name found by probing every suffix of the name. */
+static void closest_probe(MDB_cursor *cur, const knot_dname_t *name,
+                          struct closest *res)
+{
+	struct iter it = { .cur = cur };
+	const knot_dname_t *key = name;
+	int ret = cache_iter_begin(&it, key);
+	while (ret != 0 && *key != '\0') {
+		key = knot_wire_next_label(key, NULL);
+		ret = cache_iter_begin(&it, key);
+	}
+	closest_set(res, ret, &it);
+}
+
+/*! \brief Closest name found by the search used in queries. */
+static void closest_search(MDB_cursor *cur, const knot_dname_t *name,
+                           struct closest *res)
+{
+	struct iter it = { .cur = cur };
+	int ret = cache_iter_closest(&it, name);
+	closest_set(res, ret, &it);
+
+	/* Cursor must be at the first entry of the found name. */
+	if (res->found) {
+		MDB_val key, val;
+		if (mdb_cursor_get(cur, &key, &val, MDB_PREV) == 0 &&
+		    key.mv_size == res->key_len &&
+		    memcmp(key.mv_data, res->key, res->key_len) == 0) {
+			res->found = false;
+		}
+	}
+}
+
+static bool closest_equal(const struct closest *a, const struct closest *b)
+{
+	return a->found == b->found && a->key_len == b->key_len &&
+	       memcmp(a->key, b->key, a->key_len) == 0;
+}
+
+/*! \brief Check the search against the probe and the expected closest name. */
+static bool closest_check(struct cache *cache, const char *qname,
+                          const char *expect)
+{
+	knot_dname_t *name = knot_dname_from_str_alloc(qname);
+	MDB_txn *txn = NULL;
+	mdb_txn_begin(cache->env, NULL, MDB_RDONLY, &txn);
+	MDB_cursor *cur = cursor_acquire(txn, cache->dbi);
+
+	struct closest search, probe, expected = { false };
+	closest_search(cur, name, &search);
+	closest_probe(cur, name, &probe);
+	if (expect != NULL) {
+		knot_dname_t *expect_name = knot_dname_from_str_alloc(expect);
+		uint8_t lf[KNOT_DNAME_MAXLEN];
+		MDB_val key = pack_key(expect_name, lf);
+		expected.found = true;
+		expected.key_len = key.mv_size;
+		memcpy(expected.key, key.mv_data, key.mv_size);
+		knot_dname_free(&expect_name, NULL);
+	}
+
+	cursor_release(cur);
+	mdb_txn_abort(txn);
+	knot_dname_free(&name, NULL);
+
+	return closest_equal(&search, &probe) && closest_equal(&search, &expected);
+}
+
+static void test_closest_cases(const char *tmpdir)
+{
+	struct cache *cache = open_db(tmpdir, "closest");
+	const char *names[] = { "example.com", "b.a.example.com", "org", "a.org" };
+	int ret = cache ? KNOT_EOK : KNOT_ERROR;
+	for (int i = 0; ret == KNOT_EOK && i < 4; i++) {
+		ret = insert_name(cache, names[i]);
+	}
+	ok(ret == KNOT_EOK, "rosedb: closest, insert names");
+	if (ret != KNOT_EOK) {
+		skip_block(7, "no database");
+		cache_close(cache);
+		return;
+	}
+
+	ok(closest_check(cache, "b.a.example.com", "b.a.example.com") &&
+	   closest_check(cache, "org", "org"),
+	   "rosedb: closest, exact match");
+	ok(closest_check(cache, "x.b.a.example.com", "b.a.example.com") &&
+	   closest_check(cache, "x.a.org", "a.org"),
+	   "rosedb: closest, name below");
+	ok(closest_check(cache, "c.a.example.com", "example.com") &&
+	   closest_check(cache, "a.example.com", "example.com"),
+	   "rosedb: closest, deeper sibling without entries");
+	ok(closest_check(cache, "z.org", "org") &&
+	   closest_check(cache, "y.z.org", "org"),
+	   "rosedb: closest, searched key after the last one");
+	ok(closest_check(cache, "x.net", NULL) && closest_check(cache, "com", NULL) &&
+	   closest_check(cache, "zz", NULL) && closest_check(cache, ".", NULL),
+	   "rosedb: closest, no match without root");
+
+	ret = insert_name(cache, ".");
+	ok(ret == KNOT_EOK && closest_check(cache, "x.net", ".") &&
+	   closest_check(cache, "zz", ".") && closest_check(cache, "com", ".") &&
+	   closest_check(cache, ".", "."),
+	   "rosedb: closest, root fallback");
+	ok(closest_check(cache, "c.a.example.com", "example.com") &&
+	   closest_check(cache, "z.org", "org"),
+	   "rosedb: closest, deeper names preferred to root");
+
+	cache_close(cache);
+	remove_db(tmpdir, "closest");
+}
+
+/*! \brief Generated name of given index, the index encodes the labels. */
+static void gen_name(char *buf, size_t size, unsigned index, unsigned depth)
+{
+	buf[0] = '\0';
+	for (unsigned d = 0; d < depth; d++) {
+		size_t len = strlen(buf);
+		snprintf(buf + len, size - len, "%s.", LABELS[index % LABELS_COUNT]);
+		index /= LABELS_COUNT;
+	}
+	if (depth == 0) {
+		snprintf(buf, size, ".");
+	}
+}
+
+/*! \brief Compare search with the probe for all generated names. */
+static unsigned closest_mismatches(struct cache *cache)
+{
+	unsigned mismatches = 0;
+	unsigned count = 1;
+	for (unsigned depth = 0; depth <= MAX_DEPTH + 1; depth++) {
+		for (unsigned i = 0; i < count; i++) {
+			char qname[64];
+			gen_name(qname, sizeof(qname), i, depth);
+			knot_dname_t *name = knot_dname_from_str_alloc(qname);
+
+			MDB_txn *txn = NULL;
+			mdb_txn_begin(cache->env, NULL, MDB_RDONLY, &txn);
+			MDB_cursor *cur = cursor_acquire(txn, cache->dbi);
+			struct closest search, probe;
+			closest_search(cur, name, &search);
+			closest_probe(cur, name, &probe);
+			if (!closest_equal(&search, &probe)) {
+				diag("closest name of '%s' differs", qname);
+				mismatches += 1;
+			}
+			cursor_release(cur);
+			mdb_txn_abort(txn);
+			knot_dname_free(&name, NULL);
+		}
+		count *= LABELS_COUNT;
+	}
+
+	return mismatches;
+}
+
+static void test_closest_generated(const char *tmpdir)
+{
+	struct cache *cache = open_db(tmpdir, "generated");
+	int ret = cache ? KNOT_EOK : KNOT_ERROR;
+
+	/* Pseudo-random subset of names up to the depth, without root. */
+	unsigned seed = 7, inserted = 0, count = LABELS_COUNT;
+	for (unsigned depth = 1; ret == KNOT_EOK && depth <= MAX_DEPTH; depth++) {
+		for (unsigned i = 0; ret == KNOT_EOK && i < count; i++) {
+			seed = seed * 1103515245 + 12345;
+			if ((seed >> 8) % 3 != 0) {
+				continue;
+			}
+			char owner[64];
+			gen_name(owner, sizeof(owner), i, depth);
+			ret = insert_name(cache, owner);
+			inserted += 1;
+		}
+		count *= LABELS_COUNT;
+	}
+	ok(ret == KNOT_EOK && inserted > 0,
+	   "rosedb: closest, %u generated names inserted", inserted);
+	if (ret != KNOT_EOK) {
+		skip_block(2, "no database");
+		cache_close(cache);
+		return;
+	}
+
+	ok(closest_mismatches(cache) == 0,
+	   "rosedb: closest, generated names same as probe");
+	ret = insert_name(cache, ".");
+	ok(ret == KNOT_EOK && closest_mismatches(cache) == 0,
+	   "rosedb: closest, generated names with root same as probe");
+
+	cache_close(cache);
+	remove_db(tmpdir, "generated");
+}
+
+static void *adopt_thread(void *arg)
+{
+	cache_adopt_mapsize(arg);
+	return NULL;
+}
+
+/*! \brief Kept reader of the second thread, set when in transaction. */
+static volatile bool second_began;
+
+static void *reader_thread(void *arg)
+{
+	struct cache *cache = arg;
+	if (reader_begin(cache, &cache->readers[1], true) != NULL) {
+		second_began = true;
+		reader_end(cache, &cache->readers[1], true);
+	}
+	return NULL;
+}
+
+static void test_readers(const char *tmpdir)
+{
+	struct cache *cache = open_db(tmpdir, "readers");
+	int ret = cache ? cache_readers_init(cache, 2) : KNOT_ERROR;
+	ok(ret == KNOT_EOK, "rosedb: readers, init");
+	if (ret != KNOT_EOK) {
+		skip_block(4, "no database");
+		cache_close(cache);
+		return;
+	}
+
+	/* Kept transaction renewed, active only in the transaction. */
+	struct reader *reader = &cache->readers[0];
+	bool valid = reader_begin(cache, reader, true) != NULL && reader->active;
+	reader_end(cache, reader, true);
+	valid = valid && !reader->active && reader->txn != NULL &&
+	        reader_begin(cache, reader, true) != NULL;
+	reader_end(cache, reader, true);
+	ok(valid && !reader->active, "rosedb: readers, kept transaction");
+
+	/* Map grown by another environment. */
+	MDB_envinfo info;
+	mdb_env_info(cache->env, &info);
+	size_t grown = 2 * info.me_mapsize;
+	char *dir = sprintf_alloc("%s/readers", tmpdir);
+	MDB_env *other = NULL;
+	MDB_txn *txn = NULL;
+	mdb_env_create(&other);
+	ret = mdb_env_open(other, dir, 0, 0644);
+	if (ret == 0) {
+		ret = mdb_env_set_mapsize(other, grown);
+	}
+	if (ret == 0 && (ret = mdb_txn_begin(other, NULL, 0, &txn)) == 0) {
+		ret = mdb_txn_commit(txn);
+	}
+	mdb_env_close(other);
+	free(dir);
+
+	struct reader tmp = { NULL, NULL, false };
+	valid = (ret == 0) && reader_begin(cache, &tmp, false) != NULL;
+	reader_end(cache, &tmp, false);
+	valid = valid && reader_begin(cache, reader, true) != NULL;
+	reader_end(cache, reader, true);
+	mdb_env_info(cache->env, &info);
+	ok(valid && info.me_mapsize == grown && !cache->resizing,
+	   "rosedb: readers, map size grown by other process adopted");
+
+	/* Adoption waits for the kept transaction. */
+	pthread_t thread;
+	valid = reader_begin(cache, reader, true) != NULL;
+	pthread_create(&thread, NULL, adopt_thread, cache);
+	while (!cache->resizing) {
+		sched_yield();
+	}
+	usleep(50 * 1000);
+	bool waited = cache->resizing;
+	reader_end(cache, reader, true);
+	pthread_join(thread, NULL);
+	ok(valid && waited && !cache->resizing,
+	   "rosedb: readers, adoption waits for kept transaction");
+
+	/* Kept reader waits for the adoption. */
+	pthread_rwlock_wrlock(&cache->resize_lock);
+	cache->resizing = true;
+	pthread_create(&thread, NULL, reader_thread, cache);
+	usleep(50 * 1000);
+	waited = !second_began && !cache->readers[1].active;
+	cache->resizing = false;
+	pthread_rwlock_unlock(&cache->resize_lock);
+	pthread_join(thread, NULL);
+	ok(waited && second_began, "rosedb: readers, kept reader waits for adoption");
+
+	cache_close(cache);
+	remove_db(tmpdir, "readers");
+}
+
+int main(int argc, char *argv[])
+{
+	plan(3 + 4 * THREADS_COUNT + 1 + 8 + 3 + 5);
+
+	g_scanner = zs_scanner_create(".", KNOT_CLASS_IN, 0, NULL, parse_err, NULL);
+
+	char *tmpdir = test_tmpdir();
+	char *input = sprintf_alloc("%s/input", tmpdir);
+	size_t distinct = write_input(input);
+
+	test_bulk(tmpdir, input, distinct);
+	test_closest_cases(tmpdir);
+	test_closest_generated(tmpdir);
+	test_readers(tmpdir);
+
+	remove(input);
+	free(input);
+	test_tmpdir_free(tmpdir);
+	zs_scanner_free(g_scanner);
+
+	return 0;
+}
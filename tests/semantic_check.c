@@ -0,0 +1,111 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <tap/basic.h>
+
+#include "knot/zone/semantic-check.h"
+#include "zone_fixture.h"
+
+/*! \brief Number of names, enough for four checking threads. */
+#define NAMES (4 * 4096 + 100)
+
+/*! \brief Every n-th name is an insecure delegation outside the NSEC3 chain. */
+#define DELEGATION_STEP 50
+
+static int create_zone(zone_contents_t **out)
+{
+	zone_contents_t *zone = fixture_zone("example.com", true);
+	if (zone == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	char owner[64];
+	for (int i = 0; ret == KNOT_EOK && i < NAMES; i++) {
+		snprintf(owner, sizeof(owner), "n%d.example.com", i);
+		ret = fixture_add_rr(zone, owner, KNOT_RRTYPE_A, FIXTURE_A);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_full(zone, NULL, NULL);
+	}
+	if (ret == KNOT_EOK) {
+		ret = fixture_nsec3_chain(zone);
+	}
+
+	// delegations without NSEC3 records, looked up during the checks
+	for (int i = 0; ret == KNOT_EOK && i < NAMES; i += DELEGATION_STEP) {
+		snprintf(owner, sizeof(owner), "d%d.example.com", i);
+		ret = fixture_add_rr(zone, owner, KNOT_RRTYPE_NS,
+		                     "\x02ns\x07" "example\x03" "com\x00", 16);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_full(zone, NULL, NULL);
+	}
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(&zone);
+		return ret;
+	}
+
+	*out = zone;
+	return KNOT_EOK;
+}
+
+static int run_checks(zone_contents_t *zone, unsigned threads,
+                      err_handler_t *handler)
+{
+	err_handler_init(handler);
+
+	const zone_node_t *first = zone_tree_get_next(zone->nsec3_nodes, NULL);
+	const zone_node_t *last = first ? first->prev : NULL;
+
+	return zone_do_sem_checks(zone, SEM_CHECK_NSEC3, handler,
+	                          (zone_node_t *)first, (zone_node_t *)last,
+	                          100, threads);
+}
+
+int main(int argc, char *argv[])
+{
+	plan(5);
+
+	zone_contents_t *zone = NULL;
+	int ret = create_zone(&zone);
+	ok(ret == KNOT_EOK, "semantic check: create zone");
+	if (ret != KNOT_EOK) {
+		skip_block(4, "no zone");
+		return 0;
+	}
+
+	err_handler_t serial, parallel;
+	ret = run_checks(zone, 1, &serial);
+	ok(ret == KNOT_EOK && serial.error_count > 0,
+	   "semantic check: serial run");
+
+	ret = run_checks(zone, 4, &parallel);
+	ok(ret == KNOT_EOK, "semantic check: parallel run");
+	ok(parallel.error_count == serial.error_count &&
+	   memcmp(parallel.errors, serial.errors, sizeof(serial.errors)) == 0,
+	   "semantic check: parallel result same as serial");
+
+	uint64_t hits = 0, misses = 0;
+	nsec3_cache_stats(zone->nsec3_cache, &hits, &misses);
+	ok(hits == 0 && misses == 0, "semantic check: NSEC3 cache not used");
+
+	zone_contents_deep_free(&zone);
+
+	return 0;
+}
@@ -0,0 +1,85 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <tap/basic.h>
+
+#include "knot/server/stats.h"
+#include "libknot/errcode.h"
+
+int main(void)
+{
+	plan_lazy();
+
+	server_stats_t stats;
+	memset(&stats, 0, sizeof(stats));
+
+	// no threads
+
+	ok(stats_thread(&stats, 0) == NULL, "no counters without threads");
+
+	// allocate
+
+	int ret = stats_reset_threads(&stats, 2);
+	ok(ret == KNOT_EOK, "allocate counters");
+
+	stats_data_t *first = stats_thread(&stats, 0);
+	stats_data_t *second = stats_thread(&stats, 1);
+	ok(first != NULL && second != NULL, "counters for each thread");
+	ok(stats_thread(&stats, 2) == NULL, "no counters for unknown thread");
+	ok(((uintptr_t)second - (uintptr_t)first) % STATS_CACHELINE == 0 &&
+	   (uintptr_t)first % STATS_CACHELINE == 0, "counters cache aligned");
+
+	// count
+
+	stats_inc(first, STATS_UDP_QUERIES);
+	stats_inc(second, STATS_UDP_QUERIES);
+	stats_inc(NULL, STATS_UDP_QUERIES);
+	stats_rcode(first, 3);
+	stats_rcode(first, 4000);
+	stats_qtype(second, 1);
+	stats_qtype(second, 65535);
+	stats_resp_size(first, 1);
+	stats_resp_size(first, 512);
+	stats_resp_size(second, 1023);
+	stats_resp_size(second, 65535);
+
+	stats_data_t total;
+	stats_sum(&stats, &total);
+	ok(total.counter[STATS_UDP_QUERIES] == 2, "sum of general counters");
+	ok(total.rcode[3] == 1 && total.rcode[STATS_RCODE_OTHER] == 1,
+	   "sum of rcodes");
+	ok(total.qtype[1] == 1 && total.qtype[STATS_QTYPE_OTHER] == 1,
+	   "sum of qtypes");
+	ok(total.resp_size[0] == 1 && total.resp_size[9] == 2 &&
+	   total.resp_size[15] == 1, "sum of response sizes");
+
+	// resize keeps totals
+
+	ret = stats_reset_threads(&stats, 4);
+	ok(ret == KNOT_EOK, "reallocate counters");
+	stats_inc(stats_thread(&stats, 3), STATS_UDP_QUERIES);
+	stats_sum(&stats, &total);
+	ok(total.counter[STATS_UDP_QUERIES] == 3, "totals kept after resize");
+
+	ok(strcmp(stats_counter_name(STATS_TCP_ACCEPTED), "tcp-accepted") == 0,
+	   "counter name");
+
+	stats_deinit(&stats);
+
+	return 0;
+}
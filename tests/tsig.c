@@ -0,0 +1,269 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <time.h>
+#include <tap/basic.h>
+
+#include "libknot/dnssec/crypto.h"
+#include "libknot/errcode.h"
+#include "libknot/packet/pkt.h"
+#include "libknot/packet/wire.h"
+#include "libknot/tsig-op.h"
+
+/*! \brief Time the vectors were signed at, used as the current time. */
+#define TIME_SIGNED 1400000000
+
+/*! \brief Size of HMAC-SHA512 digest, the longest one. */
+#define DIGEST_MAXLEN 64
+
+/*!
+ * \brief Fixed current time, the MACs depend on the time signed.
+ *
+ * Overrides the C library function for the whole test program.
+ */
+time_t time(time_t *t)
+{
+	if (t != NULL) {
+		*t = TIME_SIGNED;
+	}
+
+	return TIME_SIGNED;
+}
+
+#define QUESTION "\x07""example\x03""com\x00\x00\x01\x00\x01"
+
+/*! \brief Query, response and continuation of the response (RFC 2845 4.4). */
+static const uint8_t QUERY[] = "\x12\x34\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00" QUESTION;
+static const uint8_t RESPONSE[] = "\x12\x34\x81\x80\x00\x01\x00\x00\x00\x00\x00\x00" QUESTION;
+static const uint8_t NEXT[] = "\x12\x34\x80\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+
+/*! \brief Key secret: octets 0x00 to 0x1f. */
+static const uint8_t SECRET[] =
+	"\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+	"\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f";
+
+/*!
+ * \brief Known-answer MACs for key 'tsig-key.', fudge 300.
+ *
+ * Computed independently from the RFC 2845 digest layout (sections 3.4 and
+ * 4.4) with the RFC 4635 algorithm names.
+ */
+typedef struct {
+	knot_tsig_algorithm_t algorithm;
+	const char *name;
+	const char *query_mac;    /*!< Query signature. */
+	const char *response_mac; /*!< Response, signed with the query MAC. */
+	const char *next_mac;     /*!< Next message, signed with response MAC. */
+} tsig_vector_t;
+
+static const tsig_vector_t VECTORS[] = {
+	{ KNOT_TSIG_ALG_HMAC_MD5, "hmac-md5",
+	  "\x5a\x2f\xba\xad\xa9\xbe\xd6\x9e\x82\x64\x14\xfa\x6c\x50\x8b\xae",
+	  "\x75\x0c\x7a\xbb\xe3\x61\xeb\xa0\x46\xd5\xe8\xd1\xdf\x7b\xdd\x9a",
+	  "\xca\xf8\xaa\xe1\xa8\x74\x67\x12\xcb\xa8\xb4\xd8\x69\xc7\x2b\x4b",
+	},
+	{ KNOT_TSIG_ALG_HMAC_SHA1, "hmac-sha1",
+	  "\xf0\xb2\x69\xd0\x27\xf6\x5f\x37\xfc\x34\x26\xa9\x31\xbd\xe7\x86"
+	  "\x5c\x7e\x6f\x5a",
+	  "\x59\xe4\x5e\xd4\x2b\x01\xf2\x81\xf6\x41\xd6\x89\x29\xed\xa1\x22"
+	  "\x69\x6a\x5e\x2e",
+	  "\x91\x37\x81\x6c\xbb\x9f\x66\xc2\xc1\xc1\x3b\x8b\xdf\xa5\xb1\x11"
+	  "\x85\x3f\x02\x12",
+	},
+	{ KNOT_TSIG_ALG_HMAC_SHA224, "hmac-sha224",
+	  "\xac\x05\x26\xb9\xd4\xd7\x79\x55\x81\xbb\x9b\xc4\x2f\x43\x14\x8f"
+	  "\x93\x89\x95\x8f\x2a\x50\x80\x08\xee\xfe\xa6\x6f",
+	  "\xb3\x71\x03\xb2\x69\x45\x1e\x28\x75\x06\xe9\xff\xf2\xb4\x21\x97"
+	  "\x71\x22\x17\xe0\xb8\x84\x22\x7a\x2b\xc1\x86\xfc",
+	  "\xbf\x0c\x73\x90\x55\x4b\x1b\xa0\xc7\x77\x58\x16\x17\xda\x69\x04"
+	  "\x90\x1d\xd9\xd8\x61\xdc\x9a\x93\x70\xb4\xcd\xe7",
+	},
+	{ KNOT_TSIG_ALG_HMAC_SHA256, "hmac-sha256",
+	  "\x71\x16\xc1\xfd\x09\xb8\x8c\x90\x7d\x67\x55\x1d\x84\xd6\xb7\x60"
+	  "\x14\x2f\x22\xd7\x99\xf5\x08\x70\x4a\x85\x0a\x7e\x38\x1b\x08\x3c",
+	  "\xa2\x2a\x3f\x1f\x1d\xed\x1a\x7e\x09\x43\xe2\x0f\x6d\x8f\x06\xb6"
+	  "\x57\x11\x8b\xb0\x76\x8e\xa3\x4e\x64\x37\xca\xa7\x42\x5f\x03\x42",
+	  "\x7e\x58\x6b\x2a\x90\xa6\xb5\xa0\xa9\xb2\xb7\x6f\xc2\x86\x42\x04"
+	  "\x32\x09\x8b\xeb\x43\x56\xd8\x60\xd4\x1a\x72\x47\xb9\xf4\xf4\x0e",
+	},
+	{ KNOT_TSIG_ALG_HMAC_SHA384, "hmac-sha384",
+	  "\xf2\x15\x6c\xd6\x59\xaf\xe7\x53\x83\xbf\x5e\x9e\x9e\x7a\xf6\x38"
+	  "\xf9\x5d\xed\xd8\xdf\x49\xcb\x65\xe6\x9c\x97\x3f\xf2\x00\xc6\x66"
+	  "\x4f\x54\x0b\x09\x86\xfd\xa2\x86\x16\xb5\x30\x3e\xcf\xba\xd4\x0c",
+	  "\xc3\xed\xf7\x36\xdf\x5c\xe7\x44\xed\x5b\x4f\xe7\x3d\xa5\xcf\x2c"
+	  "\x24\xea\xf8\xaf\x76\x8f\xe1\xd9\xe8\x07\x19\x20\x93\x72\xdb\x23"
+	  "\xb4\x85\x6b\xe1\x6a\xcb\x4b\x45\x97\x57\x0d\x13\x98\xf8\x23\x54",
+	  "\x78\x0d\xa8\xb1\xce\x37\xa9\xc7\xec\x06\x0b\x27\x98\x87\x5a\x8e"
+	  "\x9e\xf8\x55\x62\x4b\xd9\x1c\x0f\x27\x10\x1a\x6a\xfa\x30\x99\x2e"
+	  "\x9a\x99\x64\x38\x71\xd1\x99\x38\xfc\x1e\x58\xb5\xe4\x24\x1e\x3a",
+	},
+	{ KNOT_TSIG_ALG_HMAC_SHA512, "hmac-sha512",
+	  "\x9b\xc8\x62\x27\x77\xcc\xc3\xb1\x95\xe7\x49\xee\xd3\x85\xf5\x46"
+	  "\x19\x98\x46\x85\x3a\x57\xb0\xc5\xce\xb8\xc5\x67\xc7\xa5\xce\x51"
+	  "\x93\x4c\xa1\x98\x83\xa0\x5d\x7b\x12\x13\x68\x04\x2c\x05\x3c\x08"
+	  "\x10\x95\x10\xa8\x62\xab\xd2\x8d\x2c\xd3\x08\xcc\x11\xc9\xf9\x2c",
+	  "\x7c\x00\xe4\x45\xf8\xb1\x2b\x70\x28\xbf\x14\xff\x15\xaa\x58\x2c"
+	  "\xc3\xee\xd6\x81\x70\xdf\x24\x9a\x24\x51\xa8\x33\x45\x0d\x40\x49"
+	  "\xd1\x71\x80\xe9\xf9\xac\x74\x57\x79\xbf\x0c\x81\x20\xe2\xda\xe1"
+	  "\xa3\x2e\x70\xcb\x3a\xba\x88\xa3\xd5\x12\x8b\x22\x9d\x5b\x75\x39",
+	  "\x84\x05\x56\xe3\x41\x6b\xf5\xc0\x84\x02\xb2\x10\x50\x64\x39\x37"
+	  "\x5f\xe7\x9c\x18\xf3\x4b\x9e\xf4\xe4\xc7\x3f\xa0\x6d\x09\xe9\xf6"
+	  "\xcd\x34\x63\xde\xba\x7c\xca\x01\x51\x56\x9d\x90\x25\x2e\x7f\xf1"
+	  "\x3d\xf2\x84\x47\x71\xe0\x7e\x6e\x77\xe3\x28\xc6\x31\xc9\x09\xe0",
+	},
+};
+
+/*! \brief Sign message, digest of the previous message is optional. */
+static int sign(uint8_t *wire, size_t *size, const uint8_t *msg, size_t msg_size,
+                const uint8_t *prev, size_t prev_size, bool next,
+                uint8_t *digest, size_t *digest_size,
+                const knot_tsig_key_t *key)
+{
+	memcpy(wire, msg, msg_size);
+	*size = msg_size;
+	*digest_size = DIGEST_MAXLEN;
+
+	if (next) {
+		return knot_tsig_sign_next(wire, size, KNOT_WIRE_MAX_PKTSIZE,
+		                           prev, prev_size, digest, digest_size,
+		                           key, wire, msg_size);
+	}
+
+	return knot_tsig_sign(wire, size, KNOT_WIRE_MAX_PKTSIZE, prev, prev_size,
+	                      digest, digest_size, key, 0, 0);
+}
+
+/*! \brief Parse signed message and verify it as the receiver would. */
+static int verify(uint8_t *wire, size_t size, const uint8_t *prev,
+                  size_t prev_size, bool next, const knot_tsig_key_t *key)
+{
+	knot_pkt_t *pkt = knot_pkt_new(wire, size, NULL);
+	if (pkt == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = knot_pkt_parse(pkt, 0);
+	if (ret == KNOT_EOK) {
+		if (next) {
+			ret = knot_tsig_client_check_next(pkt->tsig_rr, pkt->wire,
+			                                  pkt->size, prev, prev_size,
+			                                  key, 0);
+		} else if (prev != NULL) {
+			ret = knot_tsig_client_check(pkt->tsig_rr, pkt->wire,
+			                             pkt->size, prev, prev_size,
+			                             key, 0);
+		} else {
+			ret = knot_tsig_server_check(pkt->tsig_rr, pkt->wire,
+			                             pkt->size, key);
+		}
+	}
+
+	knot_pkt_free(&pkt);
+
+	return ret;
+}
+
+/*!
+ * \brief Sign and verify the query, response and next message.
+ *
+ * Each MAC is compared with the known answer, each signed message is
+ * verified, and a modified message must fail verification.
+ */
+static void test_vector(const tsig_vector_t *vector, const knot_tsig_key_t *key,
+                        const char *mode)
+{
+	const struct {
+		const char *what;
+		const uint8_t *msg;
+		size_t msg_size;
+		const char *mac;
+		bool next;
+	} steps[] = {
+		{ "query",    QUERY,    sizeof(QUERY) - 1,    vector->query_mac,    false },
+		{ "response", RESPONSE, sizeof(RESPONSE) - 1, vector->response_mac, false },
+		{ "next",     NEXT,     sizeof(NEXT) - 1,     vector->next_mac,     true },
+	};
+
+	size_t mac_size = knot_tsig_digest_length(vector->algorithm);
+	uint8_t prev[DIGEST_MAXLEN];
+	size_t prev_size = 0;
+
+	for (int i = 0; i < sizeof(steps) / sizeof(*steps); i++) {
+		uint8_t wire[KNOT_WIRE_MAX_PKTSIZE];
+		size_t size = 0;
+		uint8_t digest[DIGEST_MAXLEN];
+		size_t digest_size = 0;
+
+		const uint8_t *prev_mac = (i > 0) ? prev : NULL;
+		int ret = sign(wire, &size, steps[i].msg, steps[i].msg_size,
+		               prev_mac, prev_size, steps[i].next,
+		               digest, &digest_size, key);
+		ok(ret == KNOT_EOK && digest_size == mac_size &&
+		   memcmp(digest, steps[i].mac, mac_size) == 0,
+		   "%s, %s: %s MAC matches known answer", vector->name, mode,
+		   steps[i].what);
+
+		uint8_t modified[KNOT_WIRE_MAX_PKTSIZE];
+		memcpy(modified, wire, size);
+		modified[3] ^= 0x01; // RCODE
+
+		ret = verify(wire, size, prev_mac, prev_size, steps[i].next, key);
+		ok(ret == KNOT_EOK, "%s, %s: %s verified", vector->name, mode,
+		   steps[i].what);
+
+		ret = verify(modified, size, prev_mac, prev_size, steps[i].next, key);
+		ok(ret == KNOT_TSIG_EBADSIG, "%s, %s: modified %s rejected",
+		   vector->name, mode, steps[i].what);
+
+		memcpy(prev, digest, digest_size);
+		prev_size = digest_size;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const size_t count = sizeof(VECTORS) / sizeof(*VECTORS);
+	plan(count * 2 * 3 * 3);
+
+	for (size_t i = 0; i < count; i++) {
+		const tsig_vector_t *vector = &VECTORS[i];
+
+		// key built by hand, nothing precomputed
+		knot_tsig_key_t key;
+		key.name = knot_dname_from_str_alloc("tsig-key");
+		key.algorithm = vector->algorithm;
+		key.secret.data = (uint8_t *)SECRET;
+		key.secret.size = sizeof(SECRET) - 1;
+
+		test_vector(vector, &key, "plain");
+
+		// precomputed key schedule
+		int ret = knot_tsig_key_hmac_init(&key);
+		if (ret == KNOT_EOK) {
+			test_vector(vector, &key, "precomputed");
+		} else {
+			skip_block(3 * 3, "%s: cannot precompute key", vector->name);
+		}
+		knot_tsig_key_hmac_free(&key);
+
+		knot_dname_free(&key.name, NULL);
+	}
+
+	knot_crypto_cleanup();
+
+	return 0;
+}
@@ -20,6 +20,7 @@
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
+#include <string.h>
 #include <time.h>
 
 #include "knot/worker/pool.h"
@@ -61,6 +62,15 @@ static void task_counting(task_t *task)
 	pthread_mutex_unlock(&log->mx);
 }
 
+/*!
+ * Task recording the order of execution.
+ */
+static void task_ordering(task_t *task)
+{
+	char **order = task->ctx;
+	*(*order)++ = '0' + task->prio;
+}
+
 static void interrupt_handle(int s)
 {
 }
@@ -148,5 +158,34 @@ int main(void)
 
 	pthread_mutex_destroy(&log.mx);
 
+	// priority classes
+
+	pool = worker_pool_create(1);
+	ok(pool != NULL, "create single worker pool");
+	if (!pool) {
+		return 1;
+	}
+
+	char order[8] = { '\0' };
+	char *order_pos = order;
+	task_t tasks[] = {
+		{ .run = task_ordering, .ctx = &order_pos, .prio = TASK_PRIO_LOW },
+		{ .run = task_ordering, .ctx = &order_pos, .prio = TASK_PRIO_NORMAL },
+		{ .run = task_ordering, .ctx = &order_pos, .prio = TASK_PRIO_HIGH },
+		{ .run = task_ordering, .ctx = &order_pos, .prio = TASK_PRIO_LOW },
+		{ .run = task_ordering, .ctx = &order_pos, .prio = TASK_PRIO_HIGH },
+	};
+	for (int i = 0; i < sizeof(tasks) / sizeof(*tasks); i++) {
+		worker_pool_assign(pool, &tasks[i]);
+	}
+
+	worker_pool_start(pool);
+	worker_pool_wait(pool);
+	ok(strcmp(order, "00122") == 0, "execution order by priority");
+
+	worker_pool_stop(pool);
+	worker_pool_join(pool);
+	worker_pool_destroy(pool);
+
 	return 0;
 }
@@ -0,0 +1,182 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tap/basic.h>
+
+#include "zone_fixture.h"
+
+#define NS_DELEG "\x02ns\x05" "deleg\x07" "example\x03" "com\x00", 22
+#define NS_DELEG2 "\x02ns\x06" "deleg2\x07" "example\x03" "com\x00", 23
+#define NS_A "\x02ns\x01" "a\x07" "example\x03" "com\x00", 18
+#define MX_MAIL "\x00\x0a\x04mail\x07" "example\x03" "com\x00", 20
+
+/*! \brief Text dump of the adjusted state of all zone nodes. */
+typedef struct {
+	char *data;
+	size_t len;
+	size_t max;
+} dump_t;
+
+static void dump_printf(dump_t *dump, const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	int len = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+
+	if (dump->len + len + 1 > dump->max) {
+		dump->max = 2 * (dump->len + len + 1);
+		dump->data = realloc(dump->data, dump->max);
+	}
+
+	va_start(ap, fmt);
+	vsnprintf(dump->data + dump->len, len + 1, fmt, ap);
+	va_end(ap);
+	dump->len += len;
+}
+
+static void dump_name(dump_t *dump, const char *what, const zone_node_t *node)
+{
+	char *name = node ? knot_dname_to_str_alloc(node->owner) : NULL;
+	dump_printf(dump, " %s=%s", what, name ? name : "-");
+	free(name);
+}
+
+static int dump_node(zone_node_t **tnode, void *data)
+{
+	dump_t *dump = data;
+	const zone_node_t *node = *tnode;
+
+	dump_name(dump, "node", node);
+	dump_name(dump, "prev", node->prev);
+	dump_name(dump, "parent", node->parent);
+	dump_name(dump, "nsec3", node->nsec3_node);
+	dump_printf(dump, " children=%u flags=%u", node->children, node->flags);
+
+	for (uint16_t i = 0; i < node->rrset_count; ++i) {
+		const struct rr_data *rr_data = &node->rrs[i];
+		if (rr_data->additional == NULL) {
+			continue;
+		}
+		for (uint16_t j = 0; j < rr_data->rrs.rr_count; ++j) {
+			dump_name(dump, "additional", rr_data->additional[j]);
+		}
+	}
+	dump_printf(dump, "\n");
+
+	return KNOT_EOK;
+}
+
+static char *dump_zone(zone_contents_t *zone)
+{
+	dump_t dump = { strdup(""), 0, 1 };
+	zone_tree_apply_inorder(zone->nodes, dump_node, &dump);
+	zone_tree_apply_inorder(zone->nsec3_nodes, dump_node, &dump);
+
+	return dump.data;
+}
+
+/*! \brief Apply changeset with incremental adjusting, compare with full one. */
+static void test_adjust(zone_contents_t *zone, changeset_t *ch, const char *msg)
+{
+	int ret = fixture_keep_soa(ch, zone);
+	if (ret == KNOT_EOK) {
+		ret = apply_changeset_directly(zone, ch);
+	}
+	update_cleanup(ch);
+	changeset_clear(ch);
+	ok(ret == KNOT_EOK, "%s: apply", msg);
+
+	char *incremental = dump_zone(zone);
+	ret = zone_contents_adjust_full(zone, NULL, NULL);
+	char *full = dump_zone(zone);
+
+	ok(ret == KNOT_EOK && strcmp(incremental, full) == 0,
+	   "%s: same as full adjusting", msg);
+	if (strcmp(incremental, full) != 0) {
+		diag("incremental:\n%s", incremental);
+		diag("full:\n%s", full);
+	}
+
+	free(incremental);
+	free(full);
+}
+
+static zone_contents_t *create_zone(void)
+{
+	zone_contents_t *zone = fixture_zone("example.com", true);
+	if (zone == NULL) {
+		return NULL;
+	}
+
+	if (fixture_add_rr(zone, "a.example.com", KNOT_RRTYPE_A, FIXTURE_A) != KNOT_EOK ||
+	    fixture_add_rr(zone, "b.example.com", KNOT_RRTYPE_A, FIXTURE_A) != KNOT_EOK ||
+	    fixture_add_rr(zone, "c.b.example.com", KNOT_RRTYPE_A, FIXTURE_A) != KNOT_EOK ||
+	    fixture_add_rr(zone, "www.example.com", KNOT_RRTYPE_MX, MX_MAIL) != KNOT_EOK ||
+	    fixture_add_rr(zone, "deleg.example.com", KNOT_RRTYPE_NS, NS_DELEG) != KNOT_EOK ||
+	    fixture_add_rr(zone, "ns.deleg.example.com", KNOT_RRTYPE_A, FIXTURE_A) != KNOT_EOK ||
+	    zone_contents_adjust_full(zone, NULL, NULL) != KNOT_EOK ||
+	    fixture_nsec3_chain(zone) != KNOT_EOK) {
+		zone_contents_deep_free(&zone);
+	}
+
+	return zone;
+}
+
+int main(int argc, char *argv[])
+{
+	plan(1 + 3 * 2);
+
+	zone_contents_t *zone = create_zone();
+	ok(zone != NULL, "zone: create");
+	if (zone == NULL) {
+		skip_block(3 * 2, "no zone");
+		return 0;
+	}
+
+	changeset_t ch;
+
+	// added names, missing additional resolved, new delegation with glue
+	changeset_init(&ch, zone->apex->owner);
+	fixture_change_rr(&ch, true, "mail.example.com", KNOT_RRTYPE_A, FIXTURE_A);
+	fixture_change_rr(&ch, true, "deleg2.example.com", KNOT_RRTYPE_NS, NS_DELEG2);
+	fixture_change_rr(&ch, true, "ns.deleg2.example.com", KNOT_RRTYPE_A, FIXTURE_A);
+	fixture_change_rr(&ch, true, "x.y.z.example.com", KNOT_RRTYPE_A, FIXTURE_A);
+	test_adjust(zone, &ch, "add");
+
+	// removed subtree and glue
+	changeset_init(&ch, zone->apex->owner);
+	fixture_change_rr(&ch, false, "b.example.com", KNOT_RRTYPE_A, FIXTURE_A);
+	fixture_change_rr(&ch, false, "c.b.example.com", KNOT_RRTYPE_A, FIXTURE_A);
+	fixture_change_rr(&ch, false, "ns.deleg.example.com", KNOT_RRTYPE_A, FIXTURE_A);
+	fixture_change_rr(&ch, false, "mail.example.com", KNOT_RRTYPE_A, FIXTURE_A);
+	test_adjust(zone, &ch, "remove");
+
+	// wildcard covering the additional, existing name becomes delegation
+	changeset_init(&ch, zone->apex->owner);
+	fixture_change_rr(&ch, true, "*.example.com", KNOT_RRTYPE_A, FIXTURE_A);
+	fixture_change_rr(&ch, true, "a.example.com", KNOT_RRTYPE_NS, NS_A);
+	fixture_change_rr(&ch, true, "ns.a.example.com", KNOT_RRTYPE_A, FIXTURE_A);
+	test_adjust(zone, &ch, "wildcard and delegation");
+
+	zone_contents_deep_free(&zone);
+
+	return 0;
+}
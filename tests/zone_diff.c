@@ -0,0 +1,215 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <tap/basic.h>
+
+#include "knot/zone/zone-diff.h"
+#include "zone_fixture.h"
+
+#define SOA_SERIAL2 "\x00\x00\x00\x00\x00\x02\x00\x00\x0e\x10\x00\x00\x0e\x10" \
+                    "\x00\x00\x0e\x10\x00\x00\x0e\x10", 22
+#define FIXTURE_A2 "\x7f\x00\x00\x02", 4
+#define TXT_DATA "\x04" "test", 5
+
+/*! \brief Names with the same data in both zones. */
+#define UNCHANGED 50
+
+/*! \brief Add record with given TTL into the zone. */
+static int add_rr_ttl(zone_contents_t *zone, const char *owner, uint16_t type,
+                      const char *rdata, size_t rdata_size, uint32_t ttl)
+{
+	knot_rrset_t *rr = fixture_rrset(owner, type, rdata, rdata_size);
+	if (rr == NULL) {
+		return KNOT_ENOMEM;
+	}
+	knot_rdata_set_ttl(knot_rdataset_at(&rr->rrs, 0), ttl);
+
+	zone_node_t *n = NULL;
+	int ret = zone_contents_add_rr(zone, rr, &n);
+	knot_rrset_free(&rr, NULL);
+
+	return ret;
+}
+
+/*!
+ * \brief Create zone version.
+ *
+ * The second version has higher serial, TTL of ttl.example.com changed,
+ * RDATA of rdata.example.com changed, and TXT at txt.example.com added.
+ */
+static zone_contents_t *create_zone(bool second)
+{
+	knot_dname_t *apex = knot_dname_from_str_alloc("example.com");
+	zone_contents_t *zone = zone_contents_new(apex);
+	knot_dname_free(&apex, NULL);
+	if (zone == NULL) {
+		return NULL;
+	}
+
+	int ret = second ?
+	          fixture_add_rr(zone, "example.com", KNOT_RRTYPE_SOA, SOA_SERIAL2) :
+	          fixture_add_rr(zone, "example.com", KNOT_RRTYPE_SOA, FIXTURE_SOA);
+	for (int i = 0; ret == KNOT_EOK && i < UNCHANGED; i++) {
+		char owner[64];
+		snprintf(owner, sizeof(owner), "n%d.example.com", i);
+		ret = fixture_add_rr(zone, owner, KNOT_RRTYPE_A, FIXTURE_A);
+	}
+	if (ret == KNOT_EOK) {
+		ret = add_rr_ttl(zone, "ttl.example.com", KNOT_RRTYPE_A, FIXTURE_A,
+		                 second ? 7200 : FIXTURE_TTL);
+	}
+	if (ret == KNOT_EOK) {
+		ret = second ?
+		      fixture_add_rr(zone, "rdata.example.com", KNOT_RRTYPE_A, FIXTURE_A2) :
+		      fixture_add_rr(zone, "rdata.example.com", KNOT_RRTYPE_A, FIXTURE_A);
+	}
+	if (ret == KNOT_EOK) {
+		ret = fixture_add_rr(zone, "txt.example.com", KNOT_RRTYPE_A, FIXTURE_A);
+	}
+	if (ret == KNOT_EOK && second) {
+		ret = fixture_add_rr(zone, "txt.example.com", KNOT_RRTYPE_TXT, TXT_DATA);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_full(zone, NULL, NULL);
+	}
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(&zone);
+	}
+
+	return zone;
+}
+
+static int hash_node(zone_node_t **node, void *data)
+{
+	node_hash(*node);
+	return KNOT_EOK;
+}
+
+/*! \brief Checks that the record is in the added (removed) part of changeset. */
+static bool has_rr(const changeset_t *ch, bool add, const char *owner,
+                   uint16_t type, const char *rdata, size_t rdata_size,
+                   uint32_t ttl)
+{
+	knot_rrset_t *rr = fixture_rrset(owner, type, rdata, rdata_size);
+	if (rr == NULL) {
+		return false;
+	}
+	knot_rdata_set_ttl(knot_rdataset_at(&rr->rrs, 0), ttl);
+
+	const zone_contents_t *part = add ? ch->add : ch->remove;
+	const zone_node_t *node = zone_contents_find_node(part, rr->owner);
+	const knot_rdataset_t *rrs = node ? node_rdataset(node, type) : NULL;
+	bool found = rrs != NULL &&
+	             knot_rdataset_member(rrs, knot_rdataset_at(&rr->rrs, 0), true);
+	knot_rrset_free(&rr, NULL);
+
+	return found;
+}
+
+/*! \brief Count RR sets in the added (removed) part of changeset. */
+static size_t count_rrsets(const changeset_t *ch, bool add)
+{
+	changeset_iter_t itt;
+	if (add) {
+		changeset_iter_add(&itt, ch, false);
+	} else {
+		changeset_iter_rem(&itt, ch, false);
+	}
+
+	size_t count = 0;
+	knot_rrset_t rr = changeset_iter_next(&itt);
+	while (!knot_rrset_empty(&rr)) {
+		count += 1;
+		rr = changeset_iter_next(&itt);
+	}
+	changeset_iter_clear(&itt);
+
+	return count;
+}
+
+/*! \brief Diff the zones, check that exactly the changed records are found. */
+static void test_diff(const zone_contents_t *zone1, const zone_contents_t *zone2,
+                      const char *msg)
+{
+	changeset_t ch;
+	changeset_init(&ch, zone1->apex->owner);
+	int ret = zone_contents_create_diff(zone1, zone2, &ch);
+	ok(ret == KNOT_EOK, "%s: diff", msg);
+
+	ok(has_rr(&ch, false, "ttl.example.com", KNOT_RRTYPE_A, FIXTURE_A, FIXTURE_TTL) &&
+	   has_rr(&ch, true, "ttl.example.com", KNOT_RRTYPE_A, FIXTURE_A, 7200),
+	   "%s: TTL change", msg);
+	ok(has_rr(&ch, false, "rdata.example.com", KNOT_RRTYPE_A, FIXTURE_A, FIXTURE_TTL) &&
+	   has_rr(&ch, true, "rdata.example.com", KNOT_RRTYPE_A, FIXTURE_A2, FIXTURE_TTL),
+	   "%s: RDATA change", msg);
+	ok(has_rr(&ch, true, "txt.example.com", KNOT_RRTYPE_TXT, TXT_DATA, FIXTURE_TTL),
+	   "%s: added RR set", msg);
+	ok(count_rrsets(&ch, false) == 2 && count_rrsets(&ch, true) == 3,
+	   "%s: nothing else changed", msg);
+
+	changeset_clear(&ch);
+}
+
+/*! \brief Make fingerprints of node data in the second zone collide. */
+static void fake_collision(const zone_contents_t *zone1,
+                           const zone_contents_t *zone2, const char *owner)
+{
+	knot_dname_t *name = knot_dname_from_str_alloc(owner);
+	zone_node_t *node1 = NULL, *node2 = NULL;
+	zone_tree_get(zone1->nodes, name, &node1);
+	zone_tree_get(zone2->nodes, name, &node2);
+	knot_dname_free(&name, NULL);
+
+	assert(node1 && node2 && node1->rrset_count == node2->rrset_count);
+	node2->hash = node_hash(node1);
+	for (uint16_t i = 0; i < node2->rrset_count; i++) {
+		node2->rrs[i].hash = node1->rrs[i].hash;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	plan(1 + 3 * 5);
+
+	zone_contents_t *zone1 = create_zone(false);
+	zone_contents_t *zone2 = create_zone(true);
+	ok(zone1 != NULL && zone2 != NULL, "create zones");
+	if (zone1 == NULL || zone2 == NULL) {
+		skip_block(3 * 5, "no zones");
+		goto cleanup;
+	}
+
+	// fingerprints computed during the diff
+	test_diff(zone1, zone2, "lazy fingerprints");
+
+	// fingerprints computed at load
+	zone_tree_apply(zone1->nodes, hash_node, NULL);
+	zone_tree_apply(zone2->nodes, hash_node, NULL);
+	test_diff(zone1, zone2, "precomputed fingerprints");
+
+	// colliding fingerprints do not hide changes
+	fake_collision(zone1, zone2, "ttl.example.com");
+	fake_collision(zone1, zone2, "rdata.example.com");
+	test_diff(zone1, zone2, "colliding fingerprints");
+
+cleanup:
+	zone_contents_deep_free(&zone1);
+	zone_contents_deep_free(&zone2);
+
+	return 0;
+}
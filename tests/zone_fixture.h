@@ -0,0 +1,147 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "libknot/descriptor.h"
+#include "libknot/dname.h"
+#include "knot/dnssec/nsec3-chain.h"
+#include "knot/updates/apply.h"
+#include "knot/updates/changesets.h"
+#include "knot/zone/contents.h"
+
+/* TTL of the fixture records. */
+#define FIXTURE_TTL 3600
+
+/* Record data, usable as the last two arguments of the functions below. */
+#define FIXTURE_SOA "\x00\x00\x00\x00\x00\x01\x00\x00\x0e\x10\x00\x00\x0e\x10" \
+                    "\x00\x00\x0e\x10\x00\x00\x0e\x10", 22
+#define FIXTURE_NSEC3PARAM "\x01\x00\x00\x0a\x02\xc0\x01", 7
+#define FIXTURE_A "\x7f\x00\x00\x01", 4
+
+/* Create record set with a single record. */
+static inline knot_rrset_t *fixture_rrset(const char *owner, uint16_t type,
+                                          const char *rdata, size_t rdata_size)
+{
+	knot_dname_t *name = knot_dname_from_str_alloc(owner);
+	if (name == NULL) {
+		return NULL;
+	}
+
+	knot_rrset_t *rr = knot_rrset_new(name, type, KNOT_CLASS_IN, NULL);
+	knot_dname_free(&name, NULL);
+	if (rr == NULL) {
+		return NULL;
+	}
+
+	if (knot_rrset_add_rdata(rr, (const uint8_t *)rdata, rdata_size,
+	                         FIXTURE_TTL, NULL) != KNOT_EOK) {
+		knot_rrset_free(&rr, NULL);
+		return NULL;
+	}
+
+	return rr;
+}
+
+/* Add record into the zone. */
+static inline int fixture_add_rr(zone_contents_t *zone, const char *owner,
+                                 uint16_t type, const char *rdata,
+                                 size_t rdata_size)
+{
+	knot_rrset_t *rr = fixture_rrset(owner, type, rdata, rdata_size);
+	if (rr == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	zone_node_t *n = NULL;
+	int ret = zone_contents_add_rr(zone, rr, &n);
+	knot_rrset_free(&rr, NULL);
+
+	return ret;
+}
+
+/* Add record into the added (removed) part of the changeset. */
+static inline int fixture_change_rr(changeset_t *ch, bool add, const char *owner,
+                                    uint16_t type, const char *rdata,
+                                    size_t rdata_size)
+{
+	knot_rrset_t *rr = fixture_rrset(owner, type, rdata, rdata_size);
+	if (rr == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = add ? changeset_add_rrset(ch, rr) : changeset_rem_rrset(ch, rr);
+	knot_rrset_free(&rr, NULL);
+
+	return ret;
+}
+
+/* Keep the zone SOA in the changeset, needed to apply it. */
+static inline int fixture_keep_soa(changeset_t *ch, const zone_contents_t *zone)
+{
+	knot_rrset_t soa = node_rrset(zone->apex, KNOT_RRTYPE_SOA);
+	ch->soa_from = knot_rrset_copy(&soa, NULL);
+	ch->soa_to = knot_rrset_copy(&soa, NULL);
+
+	return (ch->soa_from && ch->soa_to) ? KNOT_EOK : KNOT_ENOMEM;
+}
+
+/* Create zone with SOA (and NSEC3PARAM if requested), not adjusted. */
+static inline zone_contents_t *fixture_zone(const char *apex, bool nsec3)
+{
+	knot_dname_t *name = knot_dname_from_str_alloc(apex);
+	zone_contents_t *zone = name ? zone_contents_new(name) : NULL;
+	knot_dname_free(&name, NULL);
+	if (zone == NULL) {
+		return NULL;
+	}
+
+	int ret = fixture_add_rr(zone, apex, KNOT_RRTYPE_SOA, FIXTURE_SOA);
+	if (ret == KNOT_EOK && nsec3) {
+		ret = fixture_add_rr(zone, apex, KNOT_RRTYPE_NSEC3PARAM,
+		                     FIXTURE_NSEC3PARAM);
+	}
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(&zone);
+		return NULL;
+	}
+
+	return zone;
+}
+
+/* Create NSEC3 chain of the adjusted zone and apply it. */
+static inline int fixture_nsec3_chain(zone_contents_t *zone)
+{
+	changeset_t chain;
+	int ret = changeset_init(&chain, zone->apex->owner);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = knot_nsec3_create_chain(zone, FIXTURE_TTL, &chain);
+	if (ret == KNOT_EOK) {
+		ret = fixture_keep_soa(&chain, zone);
+	}
+	if (ret == KNOT_EOK) {
+		ret = apply_changeset_directly(zone, &chain);
+	}
+	update_cleanup(&chain);
+	changeset_clear(&chain);
+
+	return ret;
+}
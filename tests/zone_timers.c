@@ -103,6 +103,27 @@ int main(int argc, char *argv[])
 	ok(ret == KNOT_EOK &&
 	   memcmp(timers, empty_timers, sizeof(timers)) == 0, "zone timers: read unset");
 
+	// Write modified timers in batch and read all timers at once.
+	zone_events_schedule_at(zone_2, ZONE_EVENT_REFRESH, REFRESH_TIME);
+	zone_2->events.timers_dirty = true;
+	ret = write_timer_db(db, zone_db);
+	ok(ret == KNOT_EOK && !zone_2->events.timers_dirty, "zone timers: write batch");
+
+	timer_map_t map;
+	ret = read_timer_db(db, &map);
+	time_t timers_2[ZONE_EVENT_COUNT];
+	if (ret == KNOT_EOK) {
+		timer_map_find(&map, zone_1, timers);
+		timer_map_find(&map, zone_2, timers_2);
+	}
+	ok(ret == KNOT_EOK &&
+	   timers[ZONE_EVENT_REFRESH] == REFRESH_TIME &&
+	   timers[ZONE_EVENT_EXPIRE] == EXPIRE_TIME &&
+	   timers[ZONE_EVENT_FLUSH] == FLUSH_TIME &&
+	   timers_2[ZONE_EVENT_REFRESH] == REFRESH_TIME &&
+	   timers_2[ZONE_EVENT_EXPIRE] == 0, "zone timers: read all");
+	timer_map_free(&map);
+
 	// Remove first zone from db and sweep.
 	ret = knot_zonedb_del(zone_db, zone_1->name);
 	assert(ret == KNOT_EOK);
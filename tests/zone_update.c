@@ -17,7 +17,12 @@
 #include <assert.h>
 #include <tap/basic.h>
 
+#include "knot/common/evsched.h"
+#include "knot/nameserver/process_query.h"
 #include "knot/updates/zone-update.h"
+#include "knot/worker/pool.h"
+#include "knot/zone/zone.h"
+#include "libknot/processing/requestor.h"
 #include "zscanner/scanner.h"
 #include "libknot/internal/getline.h"
 #include "libknot/internal/macros.h"
@@ -56,9 +61,94 @@ static void process_rr(zs_scanner_t *scanner)
 	assert(ret == KNOT_EOK);
 }
 
+static void enqueue_update(zone_t *zone, knot_pkt_t *query)
+{
+	struct sockaddr_storage remote = { 0 };
+	struct process_query_param param = { 0 };
+	param.socket = -1;
+	param.remote = &remote;
+
+	int ret = zone_update_enqueue(zone, query, &param);
+	assert(ret == KNOT_EOK);
+	UNUSED(ret);
+}
+
+static void free_updates(list_t *updates)
+{
+	struct knot_request *req = NULL;
+	node_t *nxt = NULL;
+	WALK_LIST_DELSAFE(req, nxt, *updates) {
+		knot_pkt_free(&req->query);
+		free(req);
+	}
+	init_list(updates);
+}
+
+static void test_update_queue(void)
+{
+	evsched_t sched;
+	evsched_init(&sched, NULL);
+	worker_pool_t *pool = worker_pool_create(1);
+	assert(pool);
+
+	conf_zone_t *conf = malloc(sizeof(conf_zone_t));
+	assert(conf);
+	conf_init_zone(conf);
+	conf->name = strdup("test.");
+	conf->ddns_window = 0;
+	conf->ddns_batch = 2;
+
+	zone_t *zone = zone_new(conf);
+	assert(zone);
+	zone_events_setup(zone, pool, &sched, NULL, NULL);
+
+	knot_pkt_t *query = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	assert(query);
+	knot_pkt_put_question(query, zone->name, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
+
+	// Dequeue is limited by the commit size
+	list_t updates;
+	for (int i = 0; i < 3; i++) {
+		enqueue_update(zone, query);
+	}
+	ok(zone_events_is_scheduled(zone, ZONE_EVENT_UPDATE),
+	   "update queue: no window, update scheduled");
+	size_t count = zone_update_dequeue(zone, &updates);
+	ok(count == 2 && list_size(&updates) == 2 && zone->ddns_queue_size == 1,
+	   "update queue: dequeue limited by commit size");
+	free_updates(&updates);
+	count = zone_update_dequeue(zone, &updates);
+	ok(count == 1 && list_size(&updates) == 1 && zone->ddns_queue_size == 0,
+	   "update queue: dequeue remaining");
+	free_updates(&updates);
+	ok(zone_update_dequeue(zone, &updates) == 0,
+	   "update queue: dequeue from empty");
+	zone_events_cancel(zone, ZONE_EVENT_UPDATE);
+
+	// Commit window delays the update until the batch is full
+	conf->ddns_window = 60000;
+	conf->ddns_batch = 3;
+	enqueue_update(zone, query);
+	enqueue_update(zone, query);
+	ok(zone->ddns_timer != NULL && zone->ddns_timer->expires > 0 &&
+	   !zone_events_is_scheduled(zone, ZONE_EVENT_UPDATE),
+	   "update queue: window open, update delayed");
+	enqueue_update(zone, query);
+	ok(zone_events_is_scheduled(zone, ZONE_EVENT_UPDATE),
+	   "update queue: full batch, update scheduled");
+	count = zone_update_dequeue(zone, &updates);
+	ok(count == 3, "update queue: dequeue whole batch");
+	free_updates(&updates);
+
+	knot_pkt_free(&query);
+	zone_free(&zone);
+	worker_pool_destroy(pool);
+	evsched_deinit(&sched);
+}
+
 int main(int argc, char *argv[])
 {
-	plan(5);
+	plan(12);
 
 	knot_dname_t *apex = knot_dname_from_str_alloc("test");
 	assert(apex);
@@ -113,5 +203,7 @@ int main(int argc, char *argv[])
 	zs_scanner_free(sc);
 	zone_contents_deep_free(&zone);
 
+	test_update_queue();
+
 	return 0;
 }
@@ -0,0 +1,170 @@
+/*  Copyright (C) 2015 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <tap/basic.h>
+
+#include "libknot/descriptor.h"
+#include "knot/zone/contents.h"
+#include "knot/zone/zonefile.h"
+
+/*! \brief Number of generated names, enough for several dump chunks. */
+#define NAMES 5000
+
+static const char *ZONE_HEAD =
+	"$ORIGIN example.com.\n"
+	"$TTL 3600\n"
+	"@ SOA ns admin 2015010101 3600 900 604800 300\n"
+	"@ NS ns\n"
+	"@ MX 10 mail\n"
+	"@ TXT \"text with spaces\" \"and more\"\n"
+	"ns A 192.0.2.1\n"
+	"ns AAAA 2001:db8::1\n"
+	"mail A 192.0.2.2\n"
+	"www CNAME @\n"
+	"sub NS ns.sub\n"
+	"ns.sub A 192.0.2.3\n";
+
+static int write_text_zone(const char *path)
+{
+	FILE *f = fopen(path, "w");
+	if (f == NULL) {
+		return KNOT_ERROR;
+	}
+
+	fputs(ZONE_HEAD, f);
+	for (int i = 0; i < NAMES; i++) {
+		fprintf(f, "host%d A 198.51.100.%d\n", i, i % 256);
+	}
+	fclose(f);
+
+	return KNOT_EOK;
+}
+
+static zone_contents_t *load(const char *path, const char *origin)
+{
+	zloader_t loader;
+	if (zonefile_open(&loader, path, origin, true) != KNOT_EOK) {
+		return NULL;
+	}
+
+	zone_contents_t *zone = zonefile_load(&loader);
+	zonefile_close(&loader);
+
+	return zone;
+}
+
+typedef struct {
+	const zone_contents_t *other;
+	size_t count;
+	bool same;
+} compare_ctx_t;
+
+static int compare_node(zone_node_t *node, void *data)
+{
+	compare_ctx_t *ctx = data;
+	ctx->count += 1;
+
+	const zone_node_t *other = zone_contents_find_node(ctx->other,
+	                                                   node->owner);
+	if (other == NULL || other->rrset_count != node->rrset_count) {
+		ctx->same = false;
+		return KNOT_EOK;
+	}
+
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		knot_rrset_t rrset = node_rrset_at(node, i);
+		knot_rrset_t other_rrset = node_rrset(other, rrset.type);
+		if (!knot_rrset_equal(&rrset, &other_rrset,
+		                      KNOT_RRSET_COMPARE_WHOLE)) {
+			ctx->same = false;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Check that the zones have the same nodes with the same records. */
+static bool same_zones(zone_contents_t *a, zone_contents_t *b)
+{
+	compare_ctx_t ctx = { .other = b, .count = 0, .same = true };
+	zone_contents_tree_apply_inorder(a, compare_node, &ctx);
+
+	return ctx.same && ctx.count == zone_tree_weight(b->nodes);
+}
+
+int main(int argc, char *argv[])
+{
+	plan(8);
+
+	char *tmpdir = test_tmpdir();
+	char text_path[512], binary_path[512];
+	snprintf(text_path, sizeof(text_path), "%s/zonefile.txt", tmpdir);
+	snprintf(binary_path, sizeof(binary_path), "%s/zonefile.bin", tmpdir);
+
+	int ret = write_text_zone(text_path);
+	zone_contents_t *text = (ret == KNOT_EOK) ?
+	                        load(text_path, "example.com") : NULL;
+	ok(text != NULL, "zonefile: load text zone file");
+	if (text == NULL) {
+		skip_block(7, "no text zone");
+		goto cleanup;
+	}
+
+	ret = zonefile_write(binary_path, text, NULL, true);
+	ok(ret == KNOT_EOK, "zonefile: write binary zone file");
+
+	zone_contents_t *binary = load(binary_path, "example.com");
+	ok(binary != NULL, "zonefile: load binary zone file");
+	ok(binary != NULL && same_zones(text, binary) &&
+	   same_zones(binary, text), "zonefile: same records after round trip");
+	zone_contents_deep_free(&binary);
+
+	// header of another zone
+	binary = load(binary_path, "example.net");
+	ok(binary == NULL, "zonefile: refuse binary zone file of another zone");
+
+	// truncated dump
+	FILE *f = fopen(binary_path, "r+");
+	if (f != NULL) {
+		fseek(f, 0, SEEK_END);
+		ret = ftruncate(fileno(f), ftell(f) - 1);
+		fclose(f);
+	}
+	binary = load(binary_path, "example.com");
+	ok(f != NULL && ret == 0 && binary == NULL,
+	   "zonefile: refuse truncated binary zone file");
+
+	// text dump
+	ret = zonefile_write(binary_path, text, NULL, false);
+	zone_contents_t *dumped = (ret == KNOT_EOK) ?
+	                          load(binary_path, "example.com") : NULL;
+	ok(dumped != NULL, "zonefile: write text zone file");
+	ok(dumped != NULL && same_zones(text, dumped) &&
+	   same_zones(dumped, text), "zonefile: same records in text dump");
+	zone_contents_deep_free(&dumped);
+
+	zone_contents_deep_free(&text);
+
+cleanup:
+	unlink(text_path);
+	unlink(binary_path);
+	test_tmpdir_free(tmpdir);
+
+	return 0;
+}